@@ -95,7 +95,7 @@ OSBoolean::taggedRelease(__unused const void *tag, __unused const int when) cons
 {
 }
 
-OSBoolean *
+OSPtr<OSBoolean>
 OSBoolean::withBoolean(bool inValue)
 {
 	return (inValue) ? kOSBooleanTrue : kOSBooleanFalse;
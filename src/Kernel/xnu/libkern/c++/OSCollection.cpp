@@ -129,6 +129,8 @@ OSCollection::iterateObjects(void * refcon, bool (*callback)(void * refcon, OSOb
 	return initialUpdateStamp == updateStamp;
 }
 
+#ifdef __BLOCKS__
+
 static bool
 OSCollectionIterateObjectsBlock(void * refcon, OSObject * object)
 {
@@ -141,3 +143,5 @@ OSCollection::iterateObjects(bool (^block)(OSObject * object))
 {
 	return iterateObjects((void *) block, OSCollectionIterateObjectsBlock);
 }
+
+#endif /* __BLOCKS__ */
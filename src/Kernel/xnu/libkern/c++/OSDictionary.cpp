@@ -78,6 +78,143 @@ OSDictionary::sortBySymbol(void)
 {
 	qsort(dictionary, count, sizeof(OSDictionary::dictEntry),
 	    &OSDictionary::dictEntry::compare);
+	rebuildIndex();
+}
+
+/*
+ * Dictionaries with room for kIndexMinCapacity entries or more keep an
+ * open-addressing index of their keys in the same allocation, after the
+ * last entry.  A slot holds the position of an entry plus one, or zero
+ * when it is empty; keys are hashed on their address, since symbols are
+ * unique, and collisions probe linearly.  The index is sized from the
+ * capacity to be at most 3/4 full, and the entries keep their order, so
+ * iteration, serialization and kSort behave as they always have.
+ */
+#define kIndexMinCapacity       32
+
+static size_t
+indexSlots(size_t capacity)
+{
+	size_t slots = kIndexMinCapacity;
+
+	if (capacity < kIndexMinCapacity) {
+		return 0;
+	}
+	while (slots < capacity + capacity / 3 + 1) {
+		slots <<= 1;
+	}
+	return slots;
+}
+
+static inline size_t
+indexHash(const OSSymbol *aKey, size_t mask)
+{
+	return (size_t)(((uint64_t)(uintptr_t)aKey * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+size_t
+OSDictionary::allocSize(size_t inCapacity)
+{
+	return inCapacity * sizeof(dictEntry) + indexSlots(inCapacity) * sizeof(uint32_t);
+}
+
+uint32_t *
+OSDictionary::getIndex(size_t *mask) const
+{
+	size_t slots = indexSlots(capacity);
+
+	if (!slots) {
+		return NULL;
+	}
+	*mask = slots - 1;
+	return (uint32_t *)(dictionary + capacity);
+}
+
+// Returns the slot holding aKey, or the empty slot where it would go
+size_t
+OSDictionary::findIndexSlot(const OSSymbol *aKey, const uint32_t *index,
+    size_t mask) const
+{
+	size_t slot = indexHash(aKey, mask);
+
+	while (index[slot] && aKey != dictionary[index[slot] - 1].key) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+// Index the entry just stored at position i, behind which the rest moved up
+void
+OSDictionary::addToIndex(unsigned int i)
+{
+	uint32_t *index;
+	size_t mask;
+
+	index = getIndex(&mask);
+	if (!index) {
+		return;
+	}
+
+	if (i + 1 < count) {
+		// branch-free, so the compiler can vectorize the sweep
+		for (size_t slot = 0; slot <= mask; slot++) {
+			index[slot] += (index[slot] > i);
+		}
+	}
+	index[findIndexSlot(dictionary[i].key.get(), index, mask)] = i + 1;
+}
+
+// Drop the entry at position i, found in slot, before the rest move down
+void
+OSDictionary::removeFromIndex(size_t slot, unsigned int i)
+{
+	uint32_t *index;
+	size_t mask, next, home;
+
+	index = getIndex(&mask);
+	if (!index) {
+		return;
+	}
+
+	// Shift back the entries that probed past the emptied slot
+	index[slot] = 0;
+	for (next = (slot + 1) & mask; index[next]; next = (next + 1) & mask) {
+		home = indexHash(dictionary[index[next] - 1].key.get(), mask);
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			index[slot] = index[next];
+			index[next] = 0;
+			slot = next;
+		}
+	}
+
+	// Renumber the entries behind i one by one when there are few of them,
+	// in order so that no slot can match a key it no longer refers to
+	if (count - i - 1 < (mask + 1) / 32) {
+		for (unsigned int j = i + 1; j < count; j++) {
+			index[findIndexSlot(dictionary[j].key.get(), index, mask)]--;
+		}
+	} else {
+		for (slot = 0; slot <= mask; slot++) {
+			index[slot] -= (index[slot] > i + 1);
+		}
+	}
+}
+
+void
+OSDictionary::rebuildIndex(void)
+{
+	uint32_t *index;
+	size_t mask;
+
+	index = getIndex(&mask);
+	if (!index) {
+		return;
+	}
+
+	bzero(index, (mask + 1) * sizeof(uint32_t));
+	for (unsigned int i = 0; i < count; i++) {
+		index[findIndexSlot(dictionary[i].key.get(), index, mask)] = i + 1;
+	}
 }
 
 bool
@@ -91,7 +228,7 @@ OSDictionary::initWithCapacity(unsigned int inCapacity)
 		return false;
 	}
 
-	unsigned int size = inCapacity * sizeof(dictEntry);
+	size_t size = allocSize(inCapacity);
 //fOptions |= kSort;
 
 	dictionary = (dictEntry *) kalloc_container(size);
@@ -105,6 +242,7 @@ OSDictionary::initWithCapacity(unsigned int inCapacity)
 	count = 0;
 	capacity = inCapacity;
 	capacityIncrement = (inCapacity)? inCapacity : 16;
+	rebuildIndex();
 
 	return true;
 }
@@ -216,6 +354,8 @@ OSDictionary::initWithDictionary(const OSDictionary *dict,
 
 	if ((kSort & fOptions) && !(kSort & dict->fOptions)) {
 		sortBySymbol();
+	} else {
+		rebuildIndex();
 	}
 
 	return true;
@@ -282,8 +422,8 @@ OSDictionary::free()
 	(void) super::setOptions(0, kImmutable);
 	flushCollection();
 	if (dictionary) {
-		kfree(dictionary, capacity * sizeof(dictEntry));
-		OSCONTAINER_ACCUMSIZE( -(capacity * sizeof(dictEntry)));
+		kfree(dictionary, allocSize(capacity));
+		OSCONTAINER_ACCUMSIZE( -(allocSize(capacity)));
 	}
 
 	super::free();
@@ -334,19 +474,27 @@ OSDictionary::ensureCapacity(unsigned int newCapacity)
 		return capacity;
 	}
 
-	newSize = sizeof(dictEntry) * finalCapacity;
+	// indexed dictionaries grow by half so rebuilding the index amortizes
+	if (indexSlots(finalCapacity) && finalCapacity < capacity + capacity / 2) {
+		finalCapacity = capacity + capacity / 2;
+	}
+
+	newSize = allocSize(finalCapacity);
 
 	newDict = (dictEntry *) kallocp_container(&newSize);
 	if (newDict) {
-		// use all of the actual allocation size
-		finalCapacity = (newSize / sizeof(dictEntry));
+		// use all of the actual allocation size, unless it needs an index
+		if (!indexSlots(newSize / sizeof(dictEntry))) {
+			finalCapacity = (newSize / sizeof(dictEntry));
+		}
 		if (finalCapacity > UINT_MAX) {
 			// failure, too large
 			kfree(newDict, newSize);
 			return capacity;
 		}
 
-		oldSize = sizeof(dictEntry) * capacity;
+		oldSize = allocSize(capacity);
+		newSize = allocSize(finalCapacity);
 
 		os::uninitialized_move(dictionary, dictionary + capacity, newDict);
 		os::uninitialized_value_construct(newDict + capacity, newDict + finalCapacity);
@@ -357,6 +505,7 @@ OSDictionary::ensureCapacity(unsigned int newCapacity)
 
 		dictionary = newDict;
 		capacity = (unsigned int) finalCapacity;
+		rebuildIndex();
 	}
 
 	return capacity;
@@ -372,6 +521,7 @@ OSDictionary::flushCollection()
 		dictionary[i].value->taggedRelease(OSTypeID(OSCollection));
 	}
 	count = 0;
+	rebuildIndex();
 }
 
 bool
@@ -380,6 +530,8 @@ setObject(const OSSymbol *aKey, const OSMetaClassBase *anObject, bool onlyAdd)
 {
 	unsigned int i;
 	bool exists;
+	uint32_t *index;
+	size_t mask;
 
 	if (!anObject || !aKey) {
 		return false;
@@ -387,7 +539,18 @@ setObject(const OSSymbol *aKey, const OSMetaClassBase *anObject, bool onlyAdd)
 
 	// if the key exists, replace the object
 
-	if (fOptions & kSort) {
+	index = getIndex(&mask);
+	if (index) {
+		i = index[findIndexSlot(aKey, index, mask)];
+		exists = (i != 0);
+		if (exists) {
+			i--;
+		} else if (fOptions & kSort) {
+			i = OSSymbol::bsearch(aKey, &dictionary[0], count, sizeof(dictionary[0]));
+		} else {
+			i = count;
+		}
+	} else if (fOptions & kSort) {
 		i = OSSymbol::bsearch(aKey, &dictionary[0], count, sizeof(dictionary[0]));
 		exists = (i < count) && (aKey == dictionary[i].key);
 	} else {
@@ -424,6 +587,7 @@ setObject(const OSSymbol *aKey, const OSMetaClassBase *anObject, bool onlyAdd)
 	dictionary[i].key.reset(aKey, OSRetain);
 	dictionary[i].value.reset(anObject, OSRetain);
 	count++;
+	addToIndex(i);
 
 	return true;
 }
@@ -458,6 +622,8 @@ OSDictionary::removeObject(const OSSymbol *aKey)
 {
 	unsigned int i;
 	bool exists;
+	uint32_t *index;
+	size_t mask, slot = 0;
 
 	if (!aKey) {
 		return;
@@ -465,7 +631,12 @@ OSDictionary::removeObject(const OSSymbol *aKey)
 
 	// if the key exists, remove the object
 
-	if (fOptions & kSort) {
+	index = getIndex(&mask);
+	if (index) {
+		slot = findIndexSlot(aKey, index, mask);
+		exists = (index[slot] != 0);
+		i = index[slot] - 1;
+	} else if (fOptions & kSort) {
 		i = OSSymbol::bsearch(aKey, &dictionary[0], count, sizeof(dictionary[0]));
 		exists = (i < count) && (aKey == dictionary[i].key);
 	} else {
@@ -481,6 +652,7 @@ OSDictionary::removeObject(const OSSymbol *aKey)
 
 		haveUpdated();
 
+		removeFromIndex(slot, i);
 		count--;
 		bcopy(&dictionary[i + 1], &dictionary[i], (count - i) * sizeof(dictionary[0]));
 
@@ -523,11 +695,23 @@ OSObject *
 OSDictionary::getObject(const OSSymbol *aKey) const
 {
 	unsigned int i, l = 0, r = count;
+	uint32_t *index;
+	size_t mask;
 
 	if (!aKey) {
 		return NULL;
 	}
 
+	// large dictionaries go through their index
+	index = getIndex(&mask);
+	if (index) {
+		i = index[findIndexSlot(aKey, index, mask)];
+		if (i) {
+			return const_cast<OSObject *> ((const OSObject *)dictionary[i - 1].value.get());
+		}
+		return NULL;
+	}
+
 	// if the key exists, return the object
 	//
 	// inline OSSymbol::bsearch in this performance critical codepath
@@ -883,6 +1067,8 @@ OSDictionary::iterateObjects(void * refcon, bool (*callback)(void * refcon, cons
 	return initialUpdateStamp == updateStamp;
 }
 
+#ifdef __BLOCKS__
+
 static bool
 OSDictionaryIterateObjectsBlock(void * refcon, const OSSymbol * key, OSObject * object)
 {
@@ -895,3 +1081,5 @@ OSDictionary::iterateObjects(bool (^block)(const OSSymbol * key, OSObject * obje
 {
 	return iterateObjects((void *)block, &OSDictionaryIterateObjectsBlock);
 }
+
+#endif /* __BLOCKS__ */
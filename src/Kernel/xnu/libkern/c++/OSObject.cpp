@@ -414,6 +414,8 @@ OSObject::iterateObjects(void * refcon, bool (*callback)(void * refcon, OSObject
 	return callback(refcon, this);
 }
 
+#ifdef __BLOCKS__
+
 bool
 OSObject::iterateObjects(bool (^block)(OSObject * object))
 {
@@ -423,3 +425,5 @@ OSObject::iterateObjects(bool (^block)(OSObject * object))
 	}
 	return block(this);
 }
+
+#endif /* __BLOCKS__ */
@@ -330,6 +330,8 @@ OSSerializer::forTarget( void * target,
 	return thing;
 }
 
+#ifdef __BLOCKS__
+
 bool
 OSSerializer::callbackToBlock(void * target __unused, void * ref,
     OSSerialize * serializer)
@@ -358,12 +360,16 @@ OSSerializer::withBlock(
 	return serializer;
 }
 
+#endif /* __BLOCKS__ */
+
 void
 OSSerializer::free(void)
 {
+#ifdef __BLOCKS__
 	if (callback == &callbackToBlock) {
 		Block_release(ref);
 	}
+#endif /* __BLOCKS__ */
 
 	super::free();
 }
@@ -47,7 +47,7 @@
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-OSSerialize *
+OSPtr<OSSerialize>
 OSSerialize::binaryWithCapacity(unsigned int inCapacity,
     Editor editor, void * reference)
 {
@@ -352,7 +352,7 @@ OSSerialize::binarySerializeInternal(const OSMetaClassBase *o)
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-OSObject *
+OSPtr<OSObject>
 OSUnserializeBinary(const char *buffer, size_t bufferSize, OSString **errorString)
 {
 	OSObject ** objsArray;
@@ -544,7 +544,7 @@ OSUnserializeBinary(const char *buffer, size_t bufferSize, OSString **errorStrin
 				str = sym;
 				sym = OSDynamicCast(OSSymbol, sym);
 				if (!sym && (str = OSDynamicCast(OSString, str))) {
-					sym = const_cast<OSSymbol *>(OSSymbol::withString(str));
+					sym = const_cast<OSSymbol *>((const OSSymbol *) OSSymbol::withString(str));
 					ok = (sym != NULL);
 					if (!ok) {
 						break;
@@ -632,7 +632,7 @@ OSUnserializeBinary(const char *buffer, size_t bufferSize, OSString **errorStrin
 	return result;
 }
 
-OSObject*
+OSPtr<OSObject>
 OSUnserializeXML(
 	const char  * buffer,
 	OSSharedPtr<OSString>& errorString)
@@ -643,7 +643,7 @@ OSUnserializeXML(
 	return result;
 }
 
-OSObject*
+OSPtr<OSObject>
 OSUnserializeXML(
 	const char  * buffer,
 	size_t        bufferSize,
@@ -655,7 +655,7 @@ OSUnserializeXML(
 	return result;
 }
 
-OSObject*
+OSPtr<OSObject>
 OSUnserializeBinary(const char *buffer, size_t bufferSize, OSSharedPtr<OSString>& errorString)
 {
 	OSString* errorStringRaw = NULL;
@@ -664,7 +664,7 @@ OSUnserializeBinary(const char *buffer, size_t bufferSize, OSSharedPtr<OSString>
 	return result;
 }
 
-OSObject*
+OSPtr<OSObject>
 OSUnserialize(const char *buffer, OSSharedPtr<OSString>& errorString)
 {
 	OSString* errorStringRaw = NULL;
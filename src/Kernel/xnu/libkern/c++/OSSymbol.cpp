@@ -29,9 +29,12 @@
 
 #define IOKIT_ENABLE_SHARED_PTR
 
+#include <stddef.h>
 #include <string.h>
 #include <sys/cdefs.h>
 
+#include <kern/cpu_data.h>
+#include <kern/cpu_number.h>
 #include <kern/locks.h>
 
 #include <libkern/c++/OSSymbol.h>
@@ -44,72 +47,187 @@
 
 typedef struct { unsigned int i, j; } OSSymbolPoolState;
 
-#define INITIAL_POOL_SIZE  ((unsigned int)((exp2ml(1 + log2(kInitBucketCount)))))
+#define INITIAL_POOL_SIZE  (kInitBucketCount)
 
 #define GROW_FACTOR   (1)
 #define SHRINK_FACTOR (3)
 
 #define GROW_POOL()     do \
-    if (count * GROW_FACTOR > nBuckets) { \
-	reconstructSymbols(true); \
+    if (!table->prev && count * GROW_FACTOR > table->nBuckets) { \
+	startResize(table->nBuckets * 2); \
     } \
 while (0)
 
 #define SHRINK_POOL()     do \
-    if (count * SHRINK_FACTOR < nBuckets && \
-	nBuckets > INITIAL_POOL_SIZE) { \
-	reconstructSymbols(false); \
+    if (!table->prev && count * SHRINK_FACTOR < table->nBuckets && \
+	table->nBuckets > INITIAL_POOL_SIZE) { \
+	startResize(table->nBuckets / 2); \
     } \
 while (0)
 
+/*
+ * The pool is read without locks.  Writers serialize on poolLock and
+ * never change anything a reader can see in place: a bucket holds either
+ * one symbol or a tagged pointer to an immutable chain, and adding to or
+ * removing from a chain publishes a new one.  Memory that readers may
+ * still hold, old chains and tables and the symbols themselves, is only
+ * freed after a grace period.  It is retired in batches of up to
+ * kRetireMax, all freed by the next synchronize(), so that removing a
+ * symbol seldom waits for readers.
+ *
+ * Grace periods work like sleepable RCU.  A reader counts itself in for
+ * the current phase on its CPU's slot, then checks that the phase has not
+ * flipped in between.  synchronize() flips the phase and waits for the
+ * readers counted in the old one to leave; readers that come in after the
+ * flip already see everything that was unlinked before it.
+ *
+ * Growing or shrinking the table is incremental.  The new table is
+ * published with the old one as its prev, writers move the bucket they
+ * are about to change plus a few more on every insert and remove, and
+ * readers look in the old table before the new one, which is the order
+ * buckets are moved in.  A reader that misses retries if the table was
+ * replaced meanwhile.
+ */
 class OSSymbolPool
 {
 private:
 	static const unsigned int kInitBucketCount = 16;
+	static const unsigned int kMigrateStep = 8;
+	static const unsigned int kReaderSlots = 32;
+	static const unsigned int kRetireMax = 64;
+	static const uintptr_t kChainTag = 1;
+
+	typedef struct { unsigned int count; OSSymbol *symbols[]; } Chain;
+
+	typedef struct Table {
+		unsigned int nBuckets;
+		unsigned int migrated;
+		struct Table *prev;
+		uintptr_t buckets[];
+	} Table;
+
+	typedef struct {
+		unsigned int count[2];
+		char pad[64 - 2 * sizeof(unsigned int)];
+	} ReaderSlot;
+
+	Table *table;
+	unsigned int count;
+	lck_mtx_t *poolLock;
 
-	typedef struct { unsigned int count; OSSymbol **symbolP; } Bucket;
+	unsigned int phase;
+	mutable ReaderSlot readers[kReaderSlots];
 
-	Bucket *buckets;
-	unsigned int nBuckets;
-	unsigned int count;
-	lck_rw_t *poolGate;
+	struct { void *mem; size_t size; } retired[kRetireMax];
+	unsigned int nRetired;
+	OSSymbol *retiredSymbols[kRetireMax];
+	unsigned int nRetiredSymbols;
 
-	static inline void
-	hashSymbol(const char *s,
-	    unsigned int *hashP,
-	    unsigned int *lenP)
+	static inline uint64_t
+	hashMix(uint64_t a, uint64_t b)
 	{
-		unsigned int hash = 0;
-		unsigned int len = 0;
+#if defined(__SIZEOF_INT128__)
+		__uint128_t r = (__uint128_t) a * b;
 
-		/* Unroll the loop. */
-		for (;;) {
-			if (!*s) {
-				break;
-			}
-			len++; hash ^= (unsigned int)(unsigned char) *s++;
-			if (!*s) {
-				break;
-			}
-			len++; hash ^= ((unsigned int)(unsigned char) *s++) <<  8;
-			if (!*s) {
-				break;
+		return (uint64_t) r ^ (uint64_t) (r >> 64);
+#else
+		uint64_t ha = a >> 32, hb = b >> 32;
+		uint64_t la = (uint32_t) a, lb = (uint32_t) b;
+		uint64_t rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+		uint64_t t = rl + (rm0 << 32), lo = t + (rm1 << 32);
+		uint64_t hi = ha * hb + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+
+		return lo ^ hi;
+#endif
+	}
+
+	static inline uint64_t
+	read64(const char *p)
+	{
+		uint64_t v;
+
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint64_t
+	read32(const char *p)
+	{
+		uint32_t v;
+
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	/* wyhash, one lane: multiply-fold 16 bytes at a time */
+	static inline uint64_t
+	hashSymbol(const char *s, size_t len)
+	{
+		const uint64_t s0 = 0xa0761d6478bd642full;
+		const uint64_t s1 = 0xe7037ed1a0b428dbull;
+		uint64_t seed = s0, a, b;
+		size_t i = len;
+
+		if (len <= 16) {
+			if (len >= 4) {
+				a = (read32(s) << 32) | read32(s + ((len >> 3) << 2));
+				b = (read32(s + len - 4) << 32) |
+				    read32(s + len - 4 - ((len >> 3) << 2));
+			} else if (len > 0) {
+				a = ((uint64_t)(unsigned char) s[0] << 16) |
+				    ((uint64_t)(unsigned char) s[len >> 1] << 8) |
+				    (unsigned char) s[len - 1];
+				b = 0;
+			} else {
+				a = b = 0;
 			}
-			len++; hash ^= ((unsigned int)(unsigned char) *s++) << 16;
-			if (!*s) {
-				break;
+		} else {
+			for (; i > 16; i -= 16, s += 16) {
+				seed = hashMix(read64(s) ^ s1, read64(s + 8) ^ seed);
 			}
-			len++; hash ^= ((unsigned int)(unsigned char) *s++) << 24;
+			a = read64(s + i - 16);
+			b = read64(s + i - 8);
+		}
+		return hashMix(s1 ^ len, hashMix(a ^ s1, b ^ seed));
+	}
+
+	static inline unsigned int
+	bucketCount(uintptr_t bucket)
+	{
+		if (bucket & kChainTag) {
+			return ((const Chain *)(bucket & ~kChainTag))->count;
+		}
+		return bucket ? 1 : 0;
+	}
+
+	static inline OSSymbol *
+	bucketSymbol(uintptr_t bucket, unsigned int i)
+	{
+		if (bucket & kChainTag) {
+			return ((const Chain *)(bucket & ~kChainTag))->symbols[i];
 		}
-		*lenP = len;
-		*hashP = hash;
+		return (OSSymbol *) bucket;
 	}
 
-	static unsigned long log2(unsigned int x);
-	static unsigned long exp2ml(unsigned long x);
+	static inline uintptr_t
+	loadBucket(const Table *t, uint64_t hash)
+	{
+		return __atomic_load_n(&t->buckets[hash & (t->nBuckets - 1)],
+		           __ATOMIC_ACQUIRE);
+	}
+
+	static OSSymbol * findInBucket(uintptr_t bucket, const char *cString,
+	    unsigned int inLen);
 
-	void reconstructSymbols(void);
-	void reconstructSymbols(bool grow);
+	Table * allocTable(unsigned int nBuckets);
+	Chain * allocChain(unsigned int count);
+	void retire(void *mem, size_t size);
+	void publish(uintptr_t *bucketP, uintptr_t bucket);
+	void addToBucket(uintptr_t *bucketP, OSSymbol *sym);
+	bool removeFromBucket(uintptr_t *bucketP, OSSymbol *sym);
+	void migrateBucket(unsigned int i);
+	void migrate(uint64_t hash);
+	void startResize(unsigned int nBuckets);
 
 public:
 	static void *operator new(size_t size);
@@ -118,37 +236,52 @@ public:
 	OSSymbolPool()
 	{
 	}
-	OSSymbolPool(const OSSymbolPool *old);
 	virtual
 	~OSSymbolPool();
 
 	bool init();
 
-	inline void
-	closeReadGate()
+	inline unsigned int
+	enterReader() const
 	{
-		lck_rw_lock(poolGate, LCK_RW_TYPE_SHARED);
+		unsigned int slot, p;
+
+		disable_preemption();
+		slot = cpu_number() & (kReaderSlots - 1);
+		for (;;) {
+			p = __atomic_load_n(&phase, __ATOMIC_RELAXED) & 1;
+			__atomic_fetch_add(&readers[slot].count[p], 1, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if ((__atomic_load_n(&phase, __ATOMIC_ACQUIRE) & 1) == p) {
+				return slot * 2 + p;
+			}
+			__atomic_fetch_sub(&readers[slot].count[p], 1, __ATOMIC_RELAXED);
+		}
 	}
 
 	inline void
-	openReadGate()
+	exitReader(unsigned int token) const
 	{
-		lck_rw_unlock(poolGate, LCK_RW_TYPE_SHARED);
+		__atomic_fetch_sub(&readers[token / 2].count[token & 1], 1,
+		    __ATOMIC_RELEASE);
+		enable_preemption();
 	}
 
-
 	inline void
 	closeWriteGate()
 	{
-		lck_rw_lock(poolGate, LCK_RW_TYPE_EXCLUSIVE);
+		lck_mtx_lock(poolLock);
 	}
 
 	inline void
 	openWriteGate()
 	{
-		lck_rw_unlock(poolGate, LCK_RW_TYPE_EXCLUSIVE);
+		lck_mtx_unlock(poolLock);
 	}
 
+	void synchronize();
+	void retireSymbol(OSSymbol *sym);
+
 	OSSharedPtr<OSSymbol> findSymbol(const char *cString) const;
 	OSSharedPtr<OSSymbol> insertSymbol(OSSymbol *sym);
 	void removeSymbol(OSSymbol *sym);
@@ -181,239 +314,343 @@ bool
 OSSymbolPool::init()
 {
 	count = 0;
-	nBuckets = INITIAL_POOL_SIZE;
-	buckets = (Bucket *) kalloc_tag(nBuckets * sizeof(Bucket), VM_KERN_MEMORY_LIBKERN);
-	OSMETA_ACCUMSIZE(nBuckets * sizeof(Bucket));
-	if (!buckets) {
+	table = allocTable(INITIAL_POOL_SIZE);
+	if (!table) {
 		return false;
 	}
-	bzero(buckets, nBuckets * sizeof(Bucket));
 
-	poolGate = lck_rw_alloc_init(IOLockGroup, LCK_ATTR_NULL);
+	poolLock = lck_mtx_alloc_init(IOLockGroup, LCK_ATTR_NULL);
 
-	return poolGate != NULL;
+	return poolLock != NULL;
 }
 
-OSSymbolPool::OSSymbolPool(const OSSymbolPool *old)
+OSSymbolPool::~OSSymbolPool()
 {
-	count = old->count;
-	nBuckets = old->nBuckets;
-	buckets = old->buckets;
+	for (Table *t = table, *prev; t; t = prev) {
+		size_t size = sizeof(Table) + t->nBuckets * sizeof(uintptr_t);
 
-	poolGate = NULL; // Do not duplicate the poolGate
-}
+		prev = t->prev;
+		for (unsigned int i = 0; i < t->nBuckets; i++) {
+			uintptr_t bucket = t->buckets[i];
 
-OSSymbolPool::~OSSymbolPool()
-{
-	if (buckets) {
-		Bucket *thisBucket;
-		for (thisBucket = &buckets[0]; thisBucket < &buckets[nBuckets]; thisBucket++) {
-			if (thisBucket->count > 1) {
-				kfree(thisBucket->symbolP, thisBucket->count * sizeof(OSSymbol *));
-				OSMETA_ACCUMSIZE(-(thisBucket->count * sizeof(OSSymbol *)));
+			if (bucket & kChainTag) {
+				retire((void *)(bucket & ~kChainTag), offsetof(Chain, symbols) +
+				    bucketCount(bucket) * sizeof(OSSymbol *));
 			}
 		}
-		kfree(buckets, nBuckets * sizeof(Bucket));
-		OSMETA_ACCUMSIZE(-(nBuckets * sizeof(Bucket)));
+		retire(t, size);
 	}
+	synchronize();
 
-	if (poolGate) {
-		lck_rw_free(poolGate, IOLockGroup);
+	if (poolLock) {
+		lck_mtx_free(poolLock, IOLockGroup);
 	}
 }
 
-unsigned long
-OSSymbolPool::log2(unsigned int x)
+OSSymbolPool::Table *
+OSSymbolPool::allocTable(unsigned int nBuckets)
 {
-	unsigned long i;
+	size_t size = sizeof(Table) + nBuckets * sizeof(uintptr_t);
+	Table *t;
 
-	for (i = 0; x > 1; i++) {
-		x >>= 1;
+	t = (Table *) kalloc_tag(size, VM_KERN_MEMORY_LIBKERN);
+	if (t) {
+		OSMETA_ACCUMSIZE(size);
+		bzero(t, size);
+		t->nBuckets = nBuckets;
 	}
-	return i;
+	return t;
 }
 
-unsigned long
-OSSymbolPool::exp2ml(unsigned long x)
+OSSymbolPool::Chain *
+OSSymbolPool::allocChain(unsigned int n)
 {
-	return (1 << x) - 1;
+	size_t size = offsetof(Chain, symbols) + n * sizeof(OSSymbol *);
+	Chain *c;
+
+	c = (Chain *) kalloc_tag(size, VM_KERN_MEMORY_LIBKERN);
+	/* @@@ gvdl: Zero test and panic if can't set up pool */
+	OSMETA_ACCUMSIZE(size);
+	c->count = n;
+	return c;
 }
 
-OSSymbolPoolState
-OSSymbolPool::initHashState()
+// Free mem after the next grace period; poolLock is held
+void
+OSSymbolPool::retire(void *mem, size_t size)
 {
-	OSSymbolPoolState newState = { nBuckets, 0 };
-	return newState;
+	if (nRetired == kRetireMax) {
+		synchronize();
+	}
+	retired[nRetired].mem = mem;
+	retired[nRetired].size = size;
+	nRetired++;
 }
 
-OSSymbol *
-OSSymbolPool::nextHashState(OSSymbolPoolState *stateP)
+// Free a symbol removed from the pool after the next grace period; poolLock is held
+void
+OSSymbolPool::retireSymbol(OSSymbol *sym)
 {
-	Bucket *thisBucket = &buckets[stateP->i];
+	if (nRetiredSymbols == kRetireMax) {
+		synchronize();
+	}
+	retiredSymbols[nRetiredSymbols++] = sym;
+}
 
-	while (!stateP->j) {
-		if (!stateP->i) {
-			return NULL;
+// Wait until no reader can see what was unlinked so far; poolLock is held
+void
+OSSymbolPool::synchronize()
+{
+	unsigned int old = phase & 1;
+
+	__atomic_store_n(&phase, phase + 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	for (unsigned int slot = 0; slot < kReaderSlots; slot++) {
+		while (__atomic_load_n(&readers[slot].count[old], __ATOMIC_ACQUIRE)) {
+			;
 		}
-		stateP->i--;
-		thisBucket--;
-		stateP->j = thisBucket->count;
 	}
 
-	stateP->j--;
-	if (thisBucket->count == 1) {
-		return (OSSymbol *) thisBucket->symbolP;
-	} else {
-		return thisBucket->symbolP[stateP->j];
+	for (unsigned int i = 0; i < nRetired; i++) {
+		kfree(retired[i].mem, retired[i].size);
+		OSMETA_ACCUMSIZE(-retired[i].size);
+	}
+	nRetired = 0;
+
+	for (unsigned int i = 0; i < nRetiredSymbols; i++) {
+		retiredSymbols[i]->OSString::free();
 	}
+	nRetiredSymbols = 0;
 }
 
 void
-OSSymbolPool::reconstructSymbols(void)
+OSSymbolPool::publish(uintptr_t *bucketP, uintptr_t bucket)
 {
-	this->reconstructSymbols(true);
+	__atomic_store_n(bucketP, bucket, __ATOMIC_RELEASE);
 }
 
 void
-OSSymbolPool::reconstructSymbols(bool grow)
+OSSymbolPool::addToBucket(uintptr_t *bucketP, OSSymbol *sym)
 {
-	unsigned int new_nBuckets = nBuckets;
-	OSSymbol *insert;
-	OSSymbolPoolState state;
+	uintptr_t bucket = *bucketP;
+	unsigned int j = bucketCount(bucket);
+	Chain *list;
 
-	if (grow) {
-		new_nBuckets += new_nBuckets + 1;
+	if (!j) {
+		publish(bucketP, (uintptr_t) sym);
+		return;
+	}
+
+	list = allocChain(j + 1);
+	list->symbols[0] = sym;
+	for (unsigned int i = 0; i < j; i++) {
+		list->symbols[i + 1] = bucketSymbol(bucket, i);
+	}
+	publish(bucketP, (uintptr_t) list | kChainTag);
+	if (bucket & kChainTag) {
+		retire((void *)(bucket & ~kChainTag),
+		    offsetof(Chain, symbols) + j * sizeof(OSSymbol *));
+	}
+}
+
+bool
+OSSymbolPool::removeFromBucket(uintptr_t *bucketP, OSSymbol *sym)
+{
+	uintptr_t bucket = *bucketP;
+	unsigned int j = bucketCount(bucket), i, k;
+	Chain *list;
+
+	for (i = 0; i < j && bucketSymbol(bucket, i) != sym; i++) {
+		;
+	}
+	if (i == j) {
+		return false;
+	}
+
+	if (j == 1) {
+		publish(bucketP, 0);
+		return true;
+	}
+
+	if (j == 2) {
+		publish(bucketP, (uintptr_t) bucketSymbol(bucket, 1 - i));
 	} else {
-		/* Don't shrink the pool below the default initial size.
-		 */
-		if (nBuckets <= INITIAL_POOL_SIZE) {
-			return;
+		list = allocChain(j - 1);
+		for (k = 0; k < j - 1; k++) {
+			list->symbols[k] = bucketSymbol(bucket, k < i ? k : k + 1);
 		}
-		new_nBuckets = (new_nBuckets - 1) / 2;
+		publish(bucketP, (uintptr_t) list | kChainTag);
 	}
+	retire((void *)(bucket & ~kChainTag),
+	    offsetof(Chain, symbols) + j * sizeof(OSSymbol *));
+	return true;
+}
 
-	/* Create old pool to iterate after doing above check, cause it
-	 * gets finalized at return.
-	 */
-	OSSymbolPool old(this);
+// Move bucket i of the table being drained into the current one
+void
+OSSymbolPool::migrateBucket(unsigned int i)
+{
+	Table *prev = table->prev;
+	uintptr_t bucket = prev->buckets[i];
+	unsigned int j = bucketCount(bucket);
 
-	count = 0;
-	nBuckets = new_nBuckets;
-	buckets = (Bucket *) kalloc_tag(nBuckets * sizeof(Bucket), VM_KERN_MEMORY_LIBKERN);
-	OSMETA_ACCUMSIZE(nBuckets * sizeof(Bucket));
-	/* @@@ gvdl: Zero test and panic if can't set up pool */
-	bzero(buckets, nBuckets * sizeof(Bucket));
+	if (!j) {
+		return;
+	}
+
+	for (unsigned int k = 0; k < j; k++) {
+		OSSymbol *sym = bucketSymbol(bucket, k);
+		uint64_t hash = hashSymbol(sym->string, sym->length - 1);
 
-	state = old.initHashState();
-	while ((insert = old.nextHashState(&state))) {
-		insertSymbol(insert);
+		addToBucket(&table->buckets[hash & (table->nBuckets - 1)], sym);
+	}
+	publish(&prev->buckets[i], 0);
+	if (bucket & kChainTag) {
+		retire((void *)(bucket & ~kChainTag),
+		    offsetof(Chain, symbols) + j * sizeof(OSSymbol *));
 	}
 }
 
-OSSharedPtr<OSSymbol>
-OSSymbolPool::findSymbol(const char *cString) const
+// Move hash's old bucket, and a few more, before a write to the table
+void
+OSSymbolPool::migrate(uint64_t hash)
 {
-	Bucket *thisBucket;
-	unsigned int j, inLen, hash;
-	OSSymbol *probeSymbol, **list;
-	OSSharedPtr<OSSymbol> ret;
+	Table *prev = table->prev;
 
-	hashSymbol(cString, &hash, &inLen); inLen++;
-	thisBucket = &buckets[hash % nBuckets];
-	j = thisBucket->count;
+	if (!prev) {
+		return;
+	}
 
-	if (!j) {
-		return NULL;
+	migrateBucket(hash & (prev->nBuckets - 1));
+	for (unsigned int n = 0; n < kMigrateStep && prev->migrated < prev->nBuckets; n++) {
+		migrateBucket(prev->migrated++);
+	}
+	if (prev->migrated == prev->nBuckets) {
+		__atomic_store_n(&table->prev, (Table *) NULL, __ATOMIC_RELEASE);
+		retire(prev, sizeof(Table) + prev->nBuckets * sizeof(uintptr_t));
 	}
+}
 
-	if (j == 1) {
-		probeSymbol = (OSSymbol *) thisBucket->symbolP;
+void
+OSSymbolPool::startResize(unsigned int nBuckets)
+{
+	Table *t = allocTable(nBuckets);
 
-		if (inLen == probeSymbol->length
-		    && strncmp(probeSymbol->string, cString, probeSymbol->length) == 0
-		    && probeSymbol->taggedTryRetain(nullptr)) {
-			ret.reset(probeSymbol, OSNoRetain);
-			return ret;
+	if (!t) {
+		return;
+	}
+	t->prev = table;
+	__atomic_store_n(&table, t, __ATOMIC_RELEASE);
+}
+
+OSSymbolPoolState
+OSSymbolPool::initHashState()
+{
+	OSSymbolPoolState newState = { 0, 0 };
+	return newState;
+}
+
+// Walks the table being drained, then the current one; poolLock is held
+OSSymbol *
+OSSymbolPool::nextHashState(OSSymbolPoolState *stateP)
+{
+	for (;;) {
+		Table *t = table->prev;
+		unsigned int i = stateP->i;
+		uintptr_t bucket;
+
+		if (!t || i >= t->nBuckets) {
+			i -= t ? t->nBuckets : 0;
+			t = table;
+			if (i >= t->nBuckets) {
+				return NULL;
+			}
 		}
-		return NULL;
+
+		bucket = t->buckets[i];
+		if (stateP->j < bucketCount(bucket)) {
+			return bucketSymbol(bucket, stateP->j++);
+		}
+		stateP->i++;
+		stateP->j = 0;
 	}
+}
 
-	for (list = thisBucket->symbolP; j--; list++) {
-		probeSymbol = *list;
+OSSymbol *
+OSSymbolPool::findInBucket(uintptr_t bucket, const char *cString,
+    unsigned int inLen)
+{
+	unsigned int j = bucketCount(bucket);
+	OSSymbol *probeSymbol;
+
+	for (unsigned int i = 0; i < j; i++) {
+		probeSymbol = bucketSymbol(bucket, i);
 		if (inLen == probeSymbol->length
 		    && strncmp(probeSymbol->string, cString, probeSymbol->length) == 0
 		    && probeSymbol->taggedTryRetain(nullptr)) {
-			ret.reset(probeSymbol, OSNoRetain);
-			return ret;
+			return probeSymbol;
 		}
 	}
-
 	return NULL;
 }
 
 OSSharedPtr<OSSymbol>
-OSSymbolPool::insertSymbol(OSSymbol *sym)
+OSSymbolPool::findSymbol(const char *cString) const
 {
-	const char *cString = sym->string;
-	Bucket *thisBucket;
-	unsigned int j, inLen, hash;
-	OSSymbol *probeSymbol, **list;
+	size_t len = strlen(cString);
+	uint64_t hash = hashSymbol(cString, len);
+	unsigned int inLen = (unsigned int) len + 1;
+	unsigned int token;
+	OSSymbol *probeSymbol = NULL;
+	Table *t, *prev, *now;
 	OSSharedPtr<OSSymbol> ret;
 
-	hashSymbol(cString, &hash, &inLen); inLen++;
-	thisBucket = &buckets[hash % nBuckets];
-	j = thisBucket->count;
-
-	if (!j) {
-		thisBucket->symbolP = (OSSymbol **) sym;
-		thisBucket->count++;
-		count++;
-		return nullptr;
+	token = enterReader();
+	t = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+	for (;;) {
+		prev = __atomic_load_n(&t->prev, __ATOMIC_ACQUIRE);
+		if (prev) {
+			probeSymbol = findInBucket(loadBucket(prev, hash), cString, inLen);
+		}
+		if (!probeSymbol) {
+			probeSymbol = findInBucket(loadBucket(t, hash), cString, inLen);
+		}
+		if (probeSymbol) {
+			break;
+		}
+		// a resize may have moved it out from under us
+		now = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+		if (now == t) {
+			break;
+		}
+		t = now;
 	}
+	exitReader(token);
 
-	if (j == 1) {
-		probeSymbol = (OSSymbol *) thisBucket->symbolP;
-
-		if (inLen == probeSymbol->length
-		    && strncmp(probeSymbol->string, cString, probeSymbol->length) == 0
-		    && probeSymbol->taggedTryRetain(nullptr)) {
-			ret.reset(probeSymbol, OSNoRetain);
-			return ret;
-		}
+	ret.reset(probeSymbol, OSNoRetain);
+	return ret;
+}
 
-		list = (OSSymbol **) kalloc_tag(2 * sizeof(OSSymbol *), VM_KERN_MEMORY_LIBKERN);
-		OSMETA_ACCUMSIZE(2 * sizeof(OSSymbol *));
-		/* @@@ gvdl: Zero test and panic if can't set up pool */
-		list[0] = sym;
-		list[1] = probeSymbol;
-		thisBucket->symbolP = list;
-		thisBucket->count++;
-		count++;
-		GROW_POOL();
+OSSharedPtr<OSSymbol>
+OSSymbolPool::insertSymbol(OSSymbol *sym)
+{
+	const char *cString = sym->string;
+	uint64_t hash = hashSymbol(cString, sym->length - 1);
+	uintptr_t *bucketP;
+	OSSymbol *probeSymbol;
+	OSSharedPtr<OSSymbol> ret;
 
-		return nullptr;
-	}
+	migrate(hash);
+	bucketP = &table->buckets[hash & (table->nBuckets - 1)];
 
-	for (list = thisBucket->symbolP; j--; list++) {
-		probeSymbol = *list;
-		if (inLen == probeSymbol->length
-		    && strncmp(probeSymbol->string, cString, probeSymbol->length) == 0
-		    && probeSymbol->taggedTryRetain(nullptr)) {
-			ret.reset(probeSymbol, OSNoRetain);
-			return ret;
-		}
+	probeSymbol = findInBucket(*bucketP, cString, sym->length);
+	if (probeSymbol) {
+		ret.reset(probeSymbol, OSNoRetain);
+		return ret;
 	}
 
-	j = thisBucket->count++;
+	addToBucket(bucketP, sym);
 	count++;
-	list = (OSSymbol **) kalloc_tag(thisBucket->count * sizeof(OSSymbol *), VM_KERN_MEMORY_LIBKERN);
-	OSMETA_ACCUMSIZE(thisBucket->count * sizeof(OSSymbol *));
-	/* @@@ gvdl: Zero test and panic if can't set up pool */
-	list[0] = sym;
-	bcopy(thisBucket->symbolP, list + 1, j * sizeof(OSSymbol *));
-	kfree(thisBucket->symbolP, j * sizeof(OSSymbol *));
-	OSMETA_ACCUMSIZE(-(j * sizeof(OSSymbol *)));
-	thisBucket->symbolP = list;
 	GROW_POOL();
 
 	return nullptr;
@@ -422,88 +659,16 @@ OSSymbolPool::insertSymbol(OSSymbol *sym)
 void
 OSSymbolPool::removeSymbol(OSSymbol *sym)
 {
-	Bucket *thisBucket;
-	unsigned int j, inLen, hash;
-	OSSymbol *probeSymbol, **list;
-
-	hashSymbol(sym->string, &hash, &inLen); inLen++;
-	thisBucket = &buckets[hash % nBuckets];
-	j = thisBucket->count;
-	list = thisBucket->symbolP;
+	uint64_t hash = hashSymbol(sym->string, sym->length - 1);
 
-	if (!j) {
-		// couldn't find the symbol; probably means string hash changed
-		panic("removeSymbol %s count %d ", sym->string ? sym->string : "no string", count);
-		return;
-	}
-
-	if (j == 1) {
-		probeSymbol = (OSSymbol *) list;
-
-		if (probeSymbol == sym) {
-			thisBucket->symbolP = NULL;
-			count--;
-			thisBucket->count--;
-			SHRINK_POOL();
-			return;
-		}
-		// couldn't find the symbol; probably means string hash changed
-		panic("removeSymbol %s count %d ", sym->string ? sym->string : "no string", count);
-		return;
-	}
-
-	if (j == 2) {
-		probeSymbol = list[0];
-		if (probeSymbol == sym) {
-			thisBucket->symbolP = (OSSymbol **) list[1];
-			kfree(list, 2 * sizeof(OSSymbol *));
-			OSMETA_ACCUMSIZE(-(2 * sizeof(OSSymbol *)));
-			count--;
-			thisBucket->count--;
-			SHRINK_POOL();
-			return;
-		}
-
-		probeSymbol = list[1];
-		if (probeSymbol == sym) {
-			thisBucket->symbolP = (OSSymbol **) list[0];
-			kfree(list, 2 * sizeof(OSSymbol *));
-			OSMETA_ACCUMSIZE(-(2 * sizeof(OSSymbol *)));
-			count--;
-			thisBucket->count--;
-			SHRINK_POOL();
-			return;
-		}
+	migrate(hash);
+	if (!removeFromBucket(&table->buckets[hash & (table->nBuckets - 1)], sym)) {
 		// couldn't find the symbol; probably means string hash changed
 		panic("removeSymbol %s count %d ", sym->string ? sym->string : "no string", count);
 		return;
 	}
-
-	for (; j--; list++) {
-		probeSymbol = *list;
-		if (probeSymbol == sym) {
-			list = (OSSymbol **)
-			    kalloc_tag((thisBucket->count - 1) * sizeof(OSSymbol *), VM_KERN_MEMORY_LIBKERN);
-			OSMETA_ACCUMSIZE((thisBucket->count - 1) * sizeof(OSSymbol *));
-			if (thisBucket->count - 1 != j) {
-				bcopy(thisBucket->symbolP, list,
-				    (thisBucket->count - 1 - j) * sizeof(OSSymbol *));
-			}
-			if (j) {
-				bcopy(thisBucket->symbolP + thisBucket->count - j,
-				    list + thisBucket->count - 1 - j,
-				    j * sizeof(OSSymbol *));
-			}
-			kfree(thisBucket->symbolP, thisBucket->count * sizeof(OSSymbol *));
-			OSMETA_ACCUMSIZE(-(thisBucket->count * sizeof(OSSymbol *)));
-			thisBucket->symbolP = list;
-			count--;
-			thisBucket->count--;
-			return;
-		}
-	}
-	// couldn't find the symbol; probably means string hash changed
-	panic("removeSymbol %s count %d ", sym->string ? sym->string : "no string", count);
+	count--;
+	SHRINK_POOL();
 }
 
 /*
@@ -573,7 +738,7 @@ OSSymbol::withCString(const char *cString)
 	OSSharedPtr<const OSSymbol> symbol;
 
 	// Check if the symbol exists already, we don't need to take a lock here,
-	// since existingSymbolForCString will take the shared lock.
+	// since the pool is read without one.
 	symbol = OSSymbol::existingSymbolForCString(cString);
 	if (symbol) {
 		return symbol;
@@ -606,7 +771,7 @@ OSSymbol::withCStringNoCopy(const char *cString)
 	OSSharedPtr<OSSymbol> newSymb;
 
 	// Check if the symbol exists already, we don't need to take a lock here,
-	// since existingSymbolForCString will take the shared lock.
+	// since the pool is read without one.
 	symbol = OSSymbol::existingSymbolForCString(cString);
 	if (symbol) {
 		return symbol;
@@ -648,9 +813,7 @@ OSSymbol::existingSymbolForCString(const char *cString)
 {
 	OSSharedPtr<OSSymbol> symbol;
 
-	pool->closeReadGate();
 	symbol = pool->findSymbol(cString);
-	pool->openReadGate();
 
 	return os::move(symbol);
 }
@@ -668,6 +831,8 @@ OSSymbol::checkForPageUnload(void *startAddr, void *endAddr)
 			probeSymbol->OSString::initWithCString(probeSymbol->string);
 		}
 	}
+	// Nobody may still be comparing against the strings being unloaded
+	pool->synchronize();
 	pool->openWriteGate();
 }
 
@@ -688,8 +853,9 @@ OSSymbol::free()
 {
 	pool->closeWriteGate();
 	pool->removeSymbol(this);
+	// Lock-free readers may still be looking at this symbol
+	pool->retireSymbol(this);
 	pool->openWriteGate();
-	super::free();
 }
 
 bool
@@ -652,7 +652,7 @@ __END_DECLS
 static lck_mtx_t *lock = 0;
 extern lck_grp_t *IOLockGroup;
 
-OSObject*
+OSPtr<OSObject>
 OSUnserialize(const char *buffer, OSString **errorString)
 {
 	OSObject *object;
@@ -2926,7 +2926,7 @@ buildSymbol(parser_state_t *state, object_t *o)
 {
 	OSSymbol *symbol;
 
-	symbol = const_cast < OSSymbol * > (OSSymbol::withCString(o->string));
+	symbol = const_cast < OSSymbol * > ((const OSSymbol *) OSSymbol::withCString(o->string));
 	if (o->idref >= 0) {
 		rememberObject(state, o->idref, symbol);
 	}
@@ -2981,7 +2981,7 @@ buildBoolean(parser_state_t *state __unused, object_t *o)
 	return o;
 };
 
-OSObject*
+OSPtr<OSObject>
 OSUnserializeXML(const char *buffer, OSString **errorString)
 {
 	OSObject *object;
@@ -3023,7 +3023,7 @@ OSUnserializeXML(const char *buffer, OSString **errorString)
 
 #include <libkern/OSSerializeBinary.h>
 
-OSObject*
+OSPtr<OSObject>
 OSUnserializeXML(const char *buffer, size_t bufferSize, OSString **errorString)
 {
 	if (!buffer) {
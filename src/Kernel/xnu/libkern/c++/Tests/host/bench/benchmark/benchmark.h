@@ -0,0 +1,315 @@
+/*
+ * The part of the Google Benchmark interface that containers_bench.cpp
+ * uses, for hosts without the library: BENCHMARK(fn)->Arg(n) and
+ * ->ThreadRange(lo, hi), State with range(), thread_index(), counters and
+ * PauseTiming(), DoNotOptimize(), and a main() that takes
+ * --benchmark_filter=<substring> and --benchmark_min_time=<seconds>.
+ * When CMake finds the real library it is used instead.
+ */
+
+#ifndef _HOST_BENCHMARK_BENCHMARK_H_
+#define _HOST_BENCHMARK_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace benchmark {
+class State {
+public:
+	State(int64_t arg, int64_t iterations, int thread = 0, int threads = 1)
+		: arg_(arg), max_(iterations), thread_(thread), threads_(threads)
+	{
+	}
+
+	int64_t
+	range(size_t pos = 0) const
+	{
+		return pos == 0 ? arg_ : 0;
+	}
+
+	int64_t
+	iterations() const
+	{
+		return max_;
+	}
+
+	int
+	thread_index() const
+	{
+		return thread_;
+	}
+
+	int
+	threads() const
+	{
+		return threads_;
+	}
+
+	void
+	SetItemsProcessed(int64_t items)
+	{
+		items_ = items;
+	}
+
+	void
+	SetBytesProcessed(int64_t bytes)
+	{
+		bytes_ = bytes;
+	}
+
+	void
+	SetLabel(const char *label)
+	{
+		label_ = label;
+	}
+
+	void
+	PauseTiming()
+	{
+		paused_ += clock::now() - start_;
+	}
+
+	void
+	ResumeTiming()
+	{
+		start_ = clock::now();
+	}
+
+	struct iterator {
+		State *s;
+		int64_t left;
+
+		bool
+		operator!=(const iterator &) const
+		{
+			if (left > 0) {
+				return true;
+			}
+			s->finish();
+			return false;
+		}
+		void
+		operator++()
+		{
+			left--;
+		}
+		int
+		operator*() const
+		{
+			return 0;
+		}
+	};
+
+	iterator
+	begin()
+	{
+		start_ = clock::now();
+		return iterator{this, max_};
+	}
+
+	iterator
+	end()
+	{
+		return iterator{this, 0};
+	}
+
+	typedef std::chrono::steady_clock clock;
+
+	double
+	seconds() const
+	{
+		return std::chrono::duration<double>(paused_).count();
+	}
+
+	int64_t items_ = 0, bytes_ = 0;
+	std::string label_;
+
+private:
+	void
+	finish()
+	{
+		paused_ += clock::now() - start_;
+	}
+
+	int64_t arg_, max_;
+	int thread_, threads_;
+	clock::time_point start_;
+	clock::duration paused_{};
+};
+
+namespace internal {
+struct Benchmark {
+	const char *name;
+	void (*fn)(State &);
+	std::vector<int64_t> args;
+	std::vector<int> threads;
+
+	Benchmark *
+	Arg(int64_t a)
+	{
+		args.push_back(a);
+		return this;
+	}
+
+	Benchmark *
+	RangeMultiplier(int)
+	{
+		return this;
+	}
+
+	Benchmark *
+	Range(int64_t lo, int64_t hi)
+	{
+		for (int64_t a = lo; a < hi; a *= 8) {
+			args.push_back(a);
+		}
+		args.push_back(hi);
+		return this;
+	}
+
+	Benchmark *
+	ThreadRange(int lo, int hi)
+	{
+		for (int t = lo; t < hi; t *= 2) {
+			threads.push_back(t);
+		}
+		threads.push_back(hi);
+		return this;
+	}
+};
+
+inline std::vector<Benchmark *> &
+registry()
+{
+	static std::vector<Benchmark *> all;
+	return all;
+}
+
+inline Benchmark *
+Register(const char *name, void (*fn)(State &))
+{
+	Benchmark *b = new Benchmark{name, fn, {}};
+	registry().push_back(b);
+	return b;
+}
+
+inline void
+Run(Benchmark *b, int64_t arg, int threads, double min_time)
+{
+	std::string name = b->name;
+	int64_t n = 1;
+	double secs;
+
+	if (!b->args.empty()) {
+		name += "/" + std::to_string(arg);
+	}
+	if (!b->threads.empty()) {
+		name += "/threads:" + std::to_string(threads);
+	}
+	/* Grow the iteration count until a run takes long enough to trust */
+	for (;;) {
+		State s(arg, n, 0, threads);
+		std::vector<State> others;
+		std::vector<std::thread> running;
+
+		/* Every thread does n iterations; the slowest one is timed */
+		for (int t = 1; t < threads; t++) {
+			others.emplace_back(arg, n, t, threads);
+		}
+		for (State &o : others) {
+			running.emplace_back(b->fn, std::ref(o));
+		}
+		b->fn(s);
+		for (std::thread &r : running) {
+			r.join();
+		}
+		secs = s.seconds();
+		for (State &o : others) {
+			secs = o.seconds() > secs ? o.seconds() : secs;
+			s.items_ += o.items_;
+			s.bytes_ += o.bytes_;
+		}
+		if (secs >= min_time || n >= ((int64_t)1 << 40)) {
+			printf("%-40s %12.1f ns %12lld", name.c_str(), secs * 1e9 / n,
+			    (long long)n);
+			if (s.items_) {
+				printf(" %10.3fM items/s", s.items_ / secs / 1e6);
+			}
+			if (s.bytes_) {
+				printf(" %10.1fMB/s", s.bytes_ / secs / (1 << 20));
+			}
+			printf(" %s\n", s.label_.c_str());
+			return;
+		}
+		n = secs < min_time / 100 ? n * 100 :
+		    (int64_t)(n * min_time * 1.4 / secs) + 1;
+	}
+}
+} /* namespace internal */
+
+template <class T>
+inline void
+DoNotOptimize(T const &value)
+{
+	asm volatile ("" : : "r,m"(value) : "memory");
+}
+
+inline void
+ClobberMemory()
+{
+	asm volatile ("" : : : "memory");
+}
+
+inline int
+RunMain(int argc, char **argv)
+{
+	const char *filter = "";
+	double min_time = 0.5;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--benchmark_filter=", 19) == 0) {
+			filter = argv[i] + 19;
+		} else if (strncmp(argv[i], "--benchmark_min_time=", 21) == 0) {
+			min_time = atof(argv[i] + 21);
+		}
+	}
+	printf("%-40s %15s %12s\n", "Benchmark", "Time", "Iterations");
+	for (internal::Benchmark *b : internal::registry()) {
+		if (strstr(b->name, filter) == NULL) {
+			continue;
+		}
+		std::vector<int64_t> args = b->args;
+		std::vector<int> threads = b->threads;
+
+		if (args.empty()) {
+			args.push_back(0);
+		}
+		if (threads.empty()) {
+			threads.push_back(1);
+		}
+		for (int64_t arg : args) {
+			for (int t : threads) {
+				internal::Run(b, arg, t, min_time);
+			}
+		}
+	}
+	return 0;
+}
+} /* namespace benchmark */
+
+#define BENCHMARK_CAT_(a, b) a ## b
+#define BENCHMARK_CAT(a, b) BENCHMARK_CAT_(a, b)
+#define BENCHMARK(fn) \
+	static ::benchmark::internal::Benchmark *BENCHMARK_CAT(bench_, __LINE__) \
+	    __attribute__((unused)) = ::benchmark::internal::Register(#fn, fn)
+#define BENCHMARK_MAIN() \
+	int main(int argc, char **argv) { return ::benchmark::RunMain(argc, argv); }
+
+#endif /* _HOST_BENCHMARK_BENCHMARK_H_ */
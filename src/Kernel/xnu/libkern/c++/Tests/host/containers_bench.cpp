@@ -0,0 +1,402 @@
+/*
+ * Benchmarks of the libkern containers as built for the host: dictionary
+ * lookup, insert and iteration, array and set operations, symbol interning,
+ * and XML and binary serialization both ways.  The argument of each is the
+ * number of entries in the container.
+ */
+
+#include <stdio.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <libkern/c++/OSContainers.h>
+#include <libkern/c++/OSCollectionIterator.h>
+#include <libkern/c++/OSUnserialize.h>
+
+/* Keys like the property names of an I/O Registry entry */
+static std::vector<const OSSymbol *>
+make_keys(int64_t n, const char *prefix = "IOProperty")
+{
+	std::vector<const OSSymbol *> keys;
+	char name[64];
+
+	for (int64_t i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "%s%lld", prefix, (long long)i);
+		keys.push_back(OSSymbol::withCString(name));
+	}
+	return keys;
+}
+
+static void
+release_keys(std::vector<const OSSymbol *> &keys)
+{
+	for (const OSSymbol *k : keys) {
+		k->release();
+	}
+}
+
+static OSDictionary *
+make_dictionary(const std::vector<const OSSymbol *> &keys)
+{
+	OSDictionary *dict = OSDictionary::withCapacity((unsigned int)keys.size());
+
+	for (size_t i = 0; i < keys.size(); i++) {
+		OSNumber *num = OSNumber::withNumber(i, 32);
+		dict->setObject(keys[i], num);
+		num->release();
+	}
+	return dict;
+}
+
+static void
+BM_DictionaryLookup(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+	OSDictionary *dict = make_dictionary(keys);
+	size_t i = 0;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(dict->getObject(keys[i]));
+		if (++i == keys.size()) {
+			i = 0;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+	dict->release();
+	release_keys(keys);
+}
+BENCHMARK(BM_DictionaryLookup)->Range(8, 1 << 16);
+
+static void
+BM_DictionaryLookupCString(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+	OSDictionary *dict = make_dictionary(keys);
+	size_t i = 0;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(dict->getObject(keys[i]->getCStringNoCopy()));
+		if (++i == keys.size()) {
+			i = 0;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+	dict->release();
+	release_keys(keys);
+}
+BENCHMARK(BM_DictionaryLookupCString)->Range(8, 1 << 12);
+
+static void
+BM_DictionaryLookupMissing(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+	std::vector<const OSSymbol *> missing = make_keys(64, "IOMissing");
+	OSDictionary *dict = make_dictionary(keys);
+	size_t i = 0;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(dict->getObject(missing[i]));
+		i = (i + 1) & 63;
+	}
+	state.SetItemsProcessed(state.iterations());
+	dict->release();
+	release_keys(keys);
+	release_keys(missing);
+}
+BENCHMARK(BM_DictionaryLookupMissing)->Range(8, 1 << 16);
+
+/* Fill a dictionary from empty, so growth is included */
+static void
+BM_DictionaryInsert(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+
+	for (auto _ : state) {
+		OSDictionary *dict = OSDictionary::withCapacity(1);
+
+		for (const OSSymbol *k : keys) {
+			dict->setObject(k, kOSBooleanTrue);
+		}
+		state.PauseTiming();
+		dict->release();
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	release_keys(keys);
+}
+BENCHMARK(BM_DictionaryInsert)->Range(8, 1 << 14);
+
+static void
+BM_DictionaryRemove(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		OSDictionary *dict = make_dictionary(keys);
+		state.ResumeTiming();
+		for (const OSSymbol *k : keys) {
+			dict->removeObject(k);
+		}
+		state.PauseTiming();
+		dict->release();
+		state.ResumeTiming();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	release_keys(keys);
+}
+BENCHMARK(BM_DictionaryRemove)->Range(8, 1 << 14);
+
+static void
+BM_DictionaryIterate(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+	OSDictionary *dict = make_dictionary(keys);
+	OSCollectionIterator *iter = OSCollectionIterator::withCollection(dict);
+
+	for (auto _ : state) {
+		OSObject *k;
+
+		iter->reset();
+		while ((k = iter->getNextObject()) != NULL) {
+			benchmark::DoNotOptimize(dict->getObject((const OSSymbol *)k));
+		}
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	iter->release();
+	dict->release();
+	release_keys(keys);
+}
+BENCHMARK(BM_DictionaryIterate)->Range(8, 1 << 16);
+
+static bool
+count_entry(void *refcon, const OSSymbol *key __unused, OSObject *object __unused)
+{
+	(*(unsigned int *)refcon)++;
+	return false;
+}
+
+static void
+BM_DictionaryIterateObjects(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+	OSDictionary *dict = make_dictionary(keys);
+
+	for (auto _ : state) {
+		unsigned int count = 0;
+
+		dict->iterateObjects(&count, count_entry);
+		benchmark::DoNotOptimize(count);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	dict->release();
+	release_keys(keys);
+}
+BENCHMARK(BM_DictionaryIterateObjects)->Range(8, 1 << 16);
+
+static void
+BM_ArrayInsertAndScan(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+
+	for (auto _ : state) {
+		OSArray *array = OSArray::withCapacity(1);
+
+		for (const OSSymbol *k : keys) {
+			array->setObject(k);
+		}
+		benchmark::DoNotOptimize(array->getNextIndexOfObject(keys.back(), 0));
+		array->release();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	release_keys(keys);
+}
+BENCHMARK(BM_ArrayInsertAndScan)->Range(8, 1 << 14);
+
+static void
+BM_SetMembership(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+	OSSet *set = OSSet::withCapacity((unsigned int)keys.size());
+	size_t i = 0;
+
+	for (const OSSymbol *k : keys) {
+		set->setObject(k);
+	}
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(set->containsObject(keys[i]));
+		if (++i == keys.size()) {
+			i = 0;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+	set->release();
+	release_keys(keys);
+}
+BENCHMARK(BM_SetMembership)->Range(8, 1 << 14);
+
+/* Symbols that already exist, as when a property name is looked up */
+static void
+BM_SymbolWithCString(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(state.range(0));
+	size_t i = 0;
+
+	for (auto _ : state) {
+		const OSSymbol *sym = OSSymbol::withCString(keys[i]->getCStringNoCopy());
+		sym->release();
+		if (++i == keys.size()) {
+			i = 0;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+	release_keys(keys);
+}
+BENCHMARK(BM_SymbolWithCString)->Range(8, 1 << 16);
+
+/* The same from several threads at once, each over the same 4096 names */
+static void
+BM_SymbolWithCStringThreaded(benchmark::State &state)
+{
+	std::vector<const OSSymbol *> keys = make_keys(4096);
+	size_t i = state.thread_index() * 997;
+
+	for (auto _ : state) {
+		const OSSymbol *sym = OSSymbol::withCString(keys[i % keys.size()]->getCStringNoCopy());
+		sym->release();
+		i++;
+	}
+	state.SetItemsProcessed(state.iterations());
+	release_keys(keys);
+}
+BENCHMARK(BM_SymbolWithCStringThreaded)->ThreadRange(1, 8);
+
+/* Symbols made and released again, so that each is added and freed */
+static void
+BM_SymbolCreateFree(benchmark::State &state)
+{
+	char name[64];
+	size_t i = 0;
+
+	for (auto _ : state) {
+		snprintf(name, sizeof(name), "IOTransient%zu", i++ & 4095);
+		const OSSymbol *sym = OSSymbol::withCString(name);
+		sym->release();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SymbolCreateFree)->ThreadRange(1, 4);
+
+/* A property table with a mix of value types, nested one level */
+static OSDictionary *
+make_properties(int64_t n)
+{
+	std::vector<const OSSymbol *> keys = make_keys(n);
+	OSDictionary *dict = OSDictionary::withCapacity((unsigned int)n);
+	const char bytes[] = "\x01\x02\x03\x04\x05\x06\x07\x08";
+
+	for (int64_t i = 0; i < n; i++) {
+		OSObject *value;
+
+		switch (i % 4) {
+		case 0:
+			value = OSNumber::withNumber(i * 1000003ull, 64);
+			break;
+		case 1:
+			value = OSString::withCString("IOService:/AppleACPIPlatformExpert");
+			break;
+		case 2:
+			value = OSData::withBytes(bytes, sizeof(bytes));
+			break;
+		default:
+			value = OSDictionary::withCapacity(1);
+			((OSDictionary *)value)->setObject("enabled", kOSBooleanTrue);
+			break;
+		}
+		dict->setObject(keys[i], value);
+		value->release();
+	}
+	release_keys(keys);
+	return dict;
+}
+
+static void
+BM_SerializeXML(benchmark::State &state)
+{
+	OSDictionary *dict = make_properties(state.range(0));
+	int64_t bytes = 0;
+
+	for (auto _ : state) {
+		OSSerialize *s = OSSerialize::withCapacity(4096);
+
+		dict->serialize(s);
+		bytes += s->getLength();
+		s->release();
+	}
+	state.SetBytesProcessed(bytes);
+	dict->release();
+}
+BENCHMARK(BM_SerializeXML)->Range(8, 1 << 12);
+
+static void
+BM_SerializeBinary(benchmark::State &state)
+{
+	OSDictionary *dict = make_properties(state.range(0));
+	int64_t bytes = 0;
+
+	for (auto _ : state) {
+		OSSerialize *s = OSSerialize::binaryWithCapacity(4096);
+
+		s->binarySerialize(dict);
+		bytes += s->getLength();
+		s->release();
+	}
+	state.SetBytesProcessed(bytes);
+	dict->release();
+}
+BENCHMARK(BM_SerializeBinary)->Range(8, 1 << 12);
+
+static void
+BM_UnserializeXML(benchmark::State &state)
+{
+	OSDictionary *dict = make_properties(state.range(0));
+	OSSerialize *s = OSSerialize::withCapacity(4096);
+	int64_t bytes = 0;
+
+	dict->serialize(s);
+	for (auto _ : state) {
+		OSObject *back = OSUnserializeXML(s->text());
+
+		benchmark::DoNotOptimize(back);
+		bytes += s->getLength();
+		back->release();
+	}
+	state.SetBytesProcessed(bytes);
+	s->release();
+	dict->release();
+}
+BENCHMARK(BM_UnserializeXML)->Range(8, 1 << 12);
+
+static void
+BM_UnserializeBinary(benchmark::State &state)
+{
+	OSDictionary *dict = make_properties(state.range(0));
+	OSSerialize *s = OSSerialize::binaryWithCapacity(4096);
+	int64_t bytes = 0;
+
+	s->binarySerialize(dict);
+	for (auto _ : state) {
+		OSObject *back = OSUnserializeBinary(s->text(), s->getLength(), NULL);
+
+		benchmark::DoNotOptimize(back);
+		bytes += s->getLength();
+		back->release();
+	}
+	state.SetBytesProcessed(bytes);
+	s->release();
+	dict->release();
+}
+BENCHMARK(BM_UnserializeBinary)->Range(8, 1 << 12);
+
+BENCHMARK_MAIN();
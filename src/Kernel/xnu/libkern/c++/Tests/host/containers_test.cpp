@@ -0,0 +1,461 @@
+/*
+ * Behavior of the libkern containers as built for the host: dictionaries,
+ * arrays, sets, symbols and the symbol pool, casts, and serialization round
+ * trips.  Each check
+ * that fails is printed, and the exit status is the number of failures.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <libkern/c++/OSContainers.h>
+#include <libkern/c++/OSCollectionIterator.h>
+#include <libkern/c++/OSUnserialize.h>
+
+static int failures;
+
+#define CHECK(e)                                                        \
+	do {                                                            \
+	        if (!(e)) {                                             \
+	                printf("%s:%d: %s\n", __FILE__, __LINE__, #e);  \
+	                failures++;                                     \
+	        }                                                       \
+	} while (0)
+
+static const OSSymbol *
+key(unsigned int i)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "key%u", i);
+	return OSSymbol::withCString(name);
+}
+
+static void
+test_dictionary(unsigned int n)
+{
+	OSDictionary * dict = OSDictionary::withCapacity(4);
+	OSCollectionIterator * iter;
+	OSDictionary * copy;
+	const OSSymbol * k;
+	unsigned int seen = 0;
+
+	for (unsigned int i = 0; i < n; i++) {
+		OSNumber * num = OSNumber::withNumber(i, 32);
+
+		k = key(i);
+		CHECK(dict->setObject(k, num));
+		k->release();
+		num->release();
+	}
+	CHECK(dict->getCount() == n);
+	CHECK(dict->getCapacity() >= n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		OSNumber * num;
+
+		k = key(i);
+		num = OSDynamicCast(OSNumber, dict->getObject(k));
+		CHECK(num != NULL && num->unsigned32BitValue() == i);
+		CHECK(dict->getObject(k->getCStringNoCopy()) == num);
+		k->release();
+	}
+	CHECK(dict->getObject("missing") == NULL);
+
+	/* Replacing keeps the count, onlyAdd refuses */
+	k = key(0);
+	CHECK(dict->setObject(k, kOSBooleanTrue));
+	CHECK(dict->getCount() == n);
+	CHECK(dict->getObject(k) == kOSBooleanTrue);
+	CHECK(!dict->setObject(k, kOSBooleanFalse, true));
+	k->release();
+
+	iter = OSCollectionIterator::withCollection(dict);
+	CHECK(iter != NULL);
+	while ((k = OSDynamicCast(OSSymbol, iter->getNextObject())) != NULL) {
+		CHECK(dict->getObject(k) != NULL);
+		seen++;
+	}
+	CHECK(iter->isValid());
+	CHECK(seen == n);
+	iter->release();
+
+	copy = OSDictionary::withDictionary(dict);
+	CHECK(copy != NULL && copy->isEqualTo(dict));
+
+	for (unsigned int i = 0; i < n; i += 2) {
+		k = key(i);
+		dict->removeObject(k);
+		CHECK(dict->getObject(k) == NULL);
+		k->release();
+	}
+	CHECK(dict->getCount() == n / 2);
+	CHECK(!copy->isEqualTo(dict));
+	CHECK(copy->merge(dict));
+	CHECK(copy->getCount() == n);
+
+	copy->release();
+	dict->release();
+}
+
+/* Large dictionaries are indexed, which must not change what they hold */
+static void
+test_dictionary_index(void)
+{
+	const unsigned int n = 2000;
+	OSDictionary * dict = OSDictionary::withCapacity(1);
+	OSDictionary * sorted;
+	OSCollectionIterator * iter;
+	const OSSymbol * k;
+	const OSSymbol * prev = NULL;
+	unsigned int i, seen = 0;
+
+	for (i = 0; i < n; i++) {
+		k = key(i);
+		CHECK(dict->setObject(k, k));
+		k->release();
+	}
+	/* Every third key goes, then comes back at the end */
+	for (i = 0; i < n; i += 3) {
+		k = key(i);
+		dict->removeObject(k);
+		CHECK(dict->getObject(k) == NULL);
+		k->release();
+	}
+	for (i = 1; i < n; i += 3) {
+		k = key(i);
+		CHECK(dict->getObject(k) == k);
+		k->release();
+	}
+	for (i = 0; i < n; i += 3) {
+		k = key(i);
+		CHECK(dict->setObject(k, k, true));
+		k->release();
+	}
+	CHECK(dict->getCount() == n);
+
+	/* Insertion order is kept: survivors first, then the re-added keys */
+	iter = OSCollectionIterator::withCollection(dict);
+	while ((k = OSDynamicCast(OSSymbol, iter->getNextObject())) != NULL) {
+		unsigned int expect = seen < n - (n + 2) / 3 ?
+		    seen + seen / 2 + 1 : (seen - (n - (n + 2) / 3)) * 3;
+		const OSSymbol * e = key(expect);
+
+		CHECK(k == e);
+		CHECK(dict->getObject(k) == k);
+		e->release();
+		seen++;
+	}
+	CHECK(seen == n);
+	iter->release();
+
+	/* A sorted copy keeps its keys in address order and finds them all */
+	sorted = OSDictionary::withDictionary(dict);
+	sorted->setOptions(OSCollection::kSort, OSCollection::kSort);
+	for (i = 0; i < n; i += 2) {
+		k = key(i);
+		sorted->removeObject(k);
+		k->release();
+	}
+	for (i = n; i < n + 500; i++) {
+		k = key(i);
+		CHECK(sorted->setObject(k, k));
+		k->release();
+	}
+	CHECK(sorted->getCount() == n / 2 + 500);
+	iter = OSCollectionIterator::withCollection(sorted);
+	while ((k = OSDynamicCast(OSSymbol, iter->getNextObject())) != NULL) {
+		CHECK(prev == NULL || (uintptr_t)prev < (uintptr_t)k);
+		CHECK(sorted->getObject(k) == k);
+		prev = k;
+	}
+	iter->release();
+	for (i = 0; i < n + 500; i++) {
+		k = key(i);
+		CHECK(sorted->getObject(k) == ((i & 1) || i >= n ? k : NULL));
+		k->release();
+	}
+
+	dict->flushCollection();
+	CHECK(dict->getCount() == 0);
+	k = key(1);
+	CHECK(dict->getObject(k) == NULL);
+	CHECK(dict->setObject(k, k));
+	CHECK(dict->getObject(k) == k);
+	k->release();
+
+	sorted->release();
+	dict->release();
+}
+
+static void
+test_array(void)
+{
+	OSArray * array = OSArray::withCapacity(2);
+	OSString * str;
+
+	for (unsigned int i = 0; i < 1000; i++) {
+		OSNumber * num = OSNumber::withNumber(i, 32);
+		CHECK(array->setObject(num));
+		num->release();
+	}
+	str = OSString::withCString("middle");
+	CHECK(array->setObject(500, str));
+	CHECK(array->getCount() == 1001);
+	CHECK(array->getObject(500) == str);
+	CHECK(array->getNextIndexOfObject(str, 0) == 500);
+	array->removeObject(500);
+	CHECK(array->getNextIndexOfObject(str, 0) == (unsigned int)-1);
+	CHECK(OSDynamicCast(OSNumber, array->getObject(999))->unsigned32BitValue() == 999);
+	CHECK(array->getObject(1000) == NULL);
+	str->release();
+	array->release();
+}
+
+static void
+test_sets(void)
+{
+	OSSet * set = OSSet::withCapacity(1);
+	OSOrderedSet * ordered = OSOrderedSet::withCapacity(1);
+	const OSSymbol * a = OSSymbol::withCString("a");
+	const OSSymbol * b = OSSymbol::withCString("b");
+
+	CHECK(set->setObject(a));
+	CHECK(!set->setObject(a));
+	CHECK(set->setObject(b));
+	CHECK(set->getCount() == 2);
+	CHECK(set->containsObject(b));
+	set->removeObject(b);
+	CHECK(!set->containsObject(b));
+
+	CHECK(ordered->setLastObject(a));
+	CHECK(ordered->setFirstObject(b));
+	CHECK(ordered->getFirstObject() == b);
+	CHECK(ordered->getLastObject() == a);
+
+	a->release();
+	b->release();
+	set->release();
+	ordered->release();
+}
+
+static void
+test_symbols(void)
+{
+	const OSSymbol * a = OSSymbol::withCString("host.symbol");
+	const OSSymbol * b = OSSymbol::withCString("host.symbol");
+	OSString * s = OSString::withCString("host.symbol");
+	const OSSymbol * c = OSSymbol::withString(s);
+	const OSSymbol * found;
+
+	/* One symbol per string, so equal symbols are the same object */
+	CHECK(a == b && b == c);
+	found = OSSymbol::existingSymbolForCString("host.symbol");
+	CHECK(found == a);
+	OSSafeReleaseNULL(found);
+	a->release();
+	CHECK(a->isEqualTo("host.symbol"));
+	CHECK(a->isEqualTo(s));
+	b->release();
+	c->release();
+	s->release();
+	CHECK(OSSymbol::existingSymbolForCString("host.symbol") == NULL);
+	CHECK(OSSymbol::existingSymbolForCString("never.made") == NULL);
+}
+
+/* Enough symbols to grow the pool several times, then shrink it again */
+static void
+test_symbol_pool(void)
+{
+	const unsigned int n = 20000;
+	const OSSymbol ** syms = new const OSSymbol *[n];
+	const OSSymbol * found;
+	char name[32];
+
+	for (unsigned int i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "pool.%u", i);
+		syms[i] = OSSymbol::withCString(name);
+	}
+	for (unsigned int i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "pool.%u", i);
+		found = OSSymbol::existingSymbolForCString(name);
+		CHECK(found == syms[i]);
+		OSSafeReleaseNULL(found);
+	}
+	for (unsigned int i = 0; i < n; i += 2) {
+		syms[i]->release();
+	}
+	for (unsigned int i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "pool.%u", i);
+		found = OSSymbol::existingSymbolForCString(name);
+		CHECK(found == ((i & 1) ? syms[i] : NULL));
+		OSSafeReleaseNULL(found);
+	}
+	for (unsigned int i = 1; i < n; i += 2) {
+		syms[i]->release();
+	}
+	for (unsigned int i = 0; i < n; i += 7) {
+		snprintf(name, sizeof(name), "pool.%u", i);
+		CHECK(OSSymbol::existingSymbolForCString(name) == NULL);
+	}
+	delete [] syms;
+}
+
+/* Lookups racing with symbols coming and going still find the one symbol */
+static const OSSymbol * shared[64];
+static unsigned int symbol_mismatches;
+
+static void *
+symbol_thread(void * arg)
+{
+	unsigned int t = (unsigned int)(uintptr_t)arg;
+	char name[32];
+
+	for (unsigned int i = 0; i < 20000; i++) {
+		const OSSymbol * sym;
+
+		snprintf(name, sizeof(name), "shared.%u", i % 64);
+		sym = OSSymbol::withCString(name);
+		if (sym != shared[i % 64]) {
+			__atomic_fetch_add(&symbol_mismatches, 1, __ATOMIC_RELAXED);
+		}
+		sym->release();
+
+		snprintf(name, sizeof(name), "private.%u.%u", t, i % 1000);
+		sym = OSSymbol::withCString(name);
+		sym->release();
+	}
+	return NULL;
+}
+
+static void
+test_symbol_threads(void)
+{
+	pthread_t threads[4];
+	char name[32];
+
+	for (unsigned int i = 0; i < 64; i++) {
+		snprintf(name, sizeof(name), "shared.%u", i);
+		shared[i] = OSSymbol::withCString(name);
+	}
+	for (unsigned int t = 0; t < 4; t++) {
+		pthread_create(&threads[t], NULL, symbol_thread, (void *)(uintptr_t)t);
+	}
+	for (unsigned int t = 0; t < 4; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	CHECK(symbol_mismatches == 0);
+	for (unsigned int i = 0; i < 64; i++) {
+		shared[i]->release();
+	}
+	CHECK(OSSymbol::existingSymbolForCString("private.0.0") == NULL);
+}
+
+static void
+test_casts(void)
+{
+	const OSSymbol * sym = OSSymbol::withCString("cast");
+	OSObject * obj = (OSObject *)sym;
+
+	CHECK(OSDynamicCast(OSSymbol, obj) == sym);
+	CHECK(OSDynamicCast(OSString, obj) == sym);
+	CHECK(OSDynamicCast(OSObject, obj) == obj);
+	CHECK(OSDynamicCast(OSNumber, obj) == NULL);
+	CHECK(OSDynamicCast(OSCollection, obj) == NULL);
+	CHECK(obj->metaCast("OSString") == obj);
+	CHECK(obj->metaCast("OSArray") == NULL);
+	CHECK(strcmp(obj->getMetaClass()->getClassName(), "OSSymbol") == 0);
+	sym->release();
+}
+
+static OSDictionary *
+make_plist(void)
+{
+	OSDictionary * dict = OSDictionary::withCapacity(8);
+	OSArray * array = OSArray::withCapacity(8);
+	const char bytes[] = { 0, 1, 2, 3, (char)0xfe };
+	OSData * data = OSData::withBytes(bytes, sizeof(bytes));
+	OSNumber * num = OSNumber::withNumber(0x123456789ull, 64);
+	OSString * str = OSString::withCString("a <string> & more");
+
+	for (unsigned int i = 0; i < 20; i++) {
+		OSNumber * n = OSNumber::withNumber(i * 7, 32);
+		array->setObject(n);
+		n->release();
+	}
+	array->setObject(str);
+	dict->setObject("array", array);
+	dict->setObject("data", data);
+	dict->setObject("number", num);
+	dict->setObject("string", str);
+	dict->setObject("true", kOSBooleanTrue);
+	dict->setObject("false", kOSBooleanFalse);
+	array->release();
+	data->release();
+	num->release();
+	str->release();
+	return dict;
+}
+
+static void
+test_serialization(void)
+{
+	OSDictionary * dict = make_plist();
+	OSSerialize * s;
+	OSObject * back;
+	OSString * error = NULL;
+
+	s = OSSerialize::withCapacity(256);
+	CHECK(dict->serialize(s));
+	back = OSUnserializeXML(s->text(), &error);
+	CHECK(back != NULL && error == NULL);
+	CHECK(back != NULL && dict->isEqualTo(back));
+	OSSafeReleaseNULL(back);
+	OSSafeReleaseNULL(error);
+	s->release();
+
+	s = OSSerialize::binaryWithCapacity(256);
+	CHECK(s->binarySerialize(dict));
+	back = OSUnserializeBinary(s->text(), s->getLength(), &error);
+	CHECK(back != NULL && error == NULL);
+	CHECK(back != NULL && dict->isEqualTo(back));
+	OSSafeReleaseNULL(back);
+	OSSafeReleaseNULL(error);
+	s->release();
+
+	back = OSUnserializeXML("<dict><key>a</key>", &error);
+	CHECK(back == NULL && error != NULL);
+	OSSafeReleaseNULL(error);
+
+	dict->release();
+}
+
+int
+main(void)
+{
+	unsigned int dicts = OSDictionary::metaClass->getInstanceCount();
+	unsigned int strings = OSString::metaClass->getInstanceCount();
+
+	test_dictionary(10);
+	test_dictionary(5000);
+	test_dictionary_index();
+	test_array();
+	test_sets();
+	test_symbols();
+	test_symbol_pool();
+	test_symbol_threads();
+	test_casts();
+	test_serialization();
+
+	/*
+	 * Everything made above was released.  Released symbols are freed
+	 * after the next grace period, which unloading forces.
+	 */
+	OSSymbol::checkForPageUnload(NULL, NULL);
+	CHECK(OSDictionary::metaClass->getInstanceCount() == dicts);
+	CHECK(OSString::metaClass->getInstanceCount() == strings);
+
+	printf("%d failures\n", failures);
+	return failures;
+}
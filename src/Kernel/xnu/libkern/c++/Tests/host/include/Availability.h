@@ -0,0 +1,6 @@
+#ifndef _HOST_AVAILABILITY_H_
+#define _HOST_AVAILABILITY_H_
+
+#define __OSX_AVAILABLE_STARTING(mac, ios)
+
+#endif /* _HOST_AVAILABILITY_H_ */
@@ -0,0 +1,13 @@
+#ifndef _HOST_IOKIT_IOKITDEBUG_H_
+#define _HOST_IOKIT_IOKITDEBUG_H_
+
+#include <stdint.h>
+
+enum {
+	kOSRegistryModsMode     = 0x00040000ULL,
+	kIOTracking             = 0x00400000ULL,
+};
+
+extern uint64_t gIOKitDebug;
+
+#endif /* _HOST_IOKIT_IOKITDEBUG_H_ */
@@ -0,0 +1,13 @@
+#ifndef _HOST_IOKIT_IOLIB_H_
+#define _HOST_IOKIT_IOLIB_H_
+
+#include <sys/systm.h>
+#include <kern/locks.h>
+#include <vm/vm_kern.h>
+
+#define IOMemoryTag(map)        ((vm_tag_t)0)
+#define IOLog                   kprintf
+
+extern lck_grp_t *IOLockGroup;
+
+#endif /* _HOST_IOKIT_IOLIB_H_ */
@@ -0,0 +1,8 @@
+/* The message layout IORPC.h carries for DriverKit needs no mach headers */
+#ifndef PLATFORM_DriverKit
+#define PLATFORM_DriverKit 1
+#include_next <IOKit/IORPC.h>
+#undef PLATFORM_DriverKit
+#else
+#include_next <IOKit/IORPC.h>
+#endif
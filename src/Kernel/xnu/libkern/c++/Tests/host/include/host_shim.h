@@ -0,0 +1,31 @@
+/*
+ * Included ahead of every source in the host build.  It stands in for the
+ * predefined macros and <mach/...> types the kernel build gets for free.
+ */
+
+#ifndef _HOST_SHIM_H_
+#define _HOST_SHIM_H_
+
+#define __LITTLE_ENDIAN__ 1
+#ifndef __has_feature
+#define __has_feature(x) 0
+#endif
+#ifndef __has_extension
+#define __has_extension(x) 0
+#endif
+#define __private_extern__ __attribute__((visibility("hidden")))
+
+#include <limits.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef uintptr_t vm_offset_t;
+typedef uintptr_t vm_size_t;
+typedef uintptr_t vm_address_t;
+
+#if defined(__cplusplus) && !defined(__clang__)
+#include <type_traits>
+#define __is_convertible_to(from, to) std::is_convertible<from, to>::value
+#endif
+
+#endif /* _HOST_SHIM_H_ */
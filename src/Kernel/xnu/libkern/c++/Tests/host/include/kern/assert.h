@@ -0,0 +1,8 @@
+#ifndef _HOST_KERN_ASSERT_H_
+#define _HOST_KERN_ASSERT_H_
+
+#include <assert.h>
+
+#define assertf(e, fmt, ...) assert(e)
+
+#endif /* _HOST_KERN_ASSERT_H_ */
@@ -0,0 +1,15 @@
+#ifndef _HOST_KERN_CPU_DATA_H_
+#define _HOST_KERN_CPU_DATA_H_
+
+#include <sys/cdefs.h>
+
+/* Threads can't stop the host from preempting them, so these do nothing */
+__BEGIN_DECLS
+extern void _disable_preemption(void);
+extern void _enable_preemption(void);
+__END_DECLS
+
+#define disable_preemption()    _disable_preemption()
+#define enable_preemption()     _enable_preemption()
+
+#endif /* _HOST_KERN_CPU_DATA_H_ */
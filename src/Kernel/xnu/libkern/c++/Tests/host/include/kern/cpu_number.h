@@ -0,0 +1,11 @@
+#ifndef _HOST_KERN_CPU_NUMBER_H_
+#define _HOST_KERN_CPU_NUMBER_H_
+
+#include <sys/cdefs.h>
+
+/* A small number per thread, standing in for the CPU it runs on */
+__BEGIN_DECLS
+extern int cpu_number(void);
+__END_DECLS
+
+#endif /* _HOST_KERN_CPU_NUMBER_H_ */
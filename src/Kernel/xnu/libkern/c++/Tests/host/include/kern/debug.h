@@ -0,0 +1,12 @@
+#ifndef _HOST_KERN_DEBUG_H_
+#define _HOST_KERN_DEBUG_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <kern/assert.h>
+
+__BEGIN_DECLS
+extern void panic(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+__END_DECLS
+
+#endif /* _HOST_KERN_DEBUG_H_ */
@@ -0,0 +1,35 @@
+#ifndef _HOST_KERN_KALLOC_H_
+#define _HOST_KERN_KALLOC_H_
+
+#include <kern/zalloc.h>
+#include <os/overflow.h>
+
+/* One malloc() heap stands in for all of the kalloc heaps */
+typedef int kalloc_heap_t;
+#define KHEAP_DEFAULT           0
+#define KHEAP_DATA_BUFFERS      1
+
+#define VM_KERN_MEMORY_LIBKERN  0
+#define VM_KERN_MEMORY_IOKIT    0
+
+__BEGIN_DECLS
+extern void *host_kalloc(size_t size, zalloc_flags_t flags);
+extern void *host_kallocp(size_t *sizep);
+extern void host_kfree(void *data, size_t size);
+__END_DECLS
+
+#define kalloc(size)                    host_kalloc(size, Z_WAITOK)
+#define kalloc_tag(size, itag)          host_kalloc(size, Z_WAITOK)
+#define kalloc_tag_bt(size, itag)       host_kalloc(size, Z_WAITOK)
+#define kallocp_tag_bt(sizep, itag)     host_kallocp(sizep)
+#define kheap_alloc(heap, size, flags)  host_kalloc(size, flags)
+#define kheap_alloc_tag_bt(heap, size, flags, itag) \
+	host_kalloc(size, flags)
+#define kfree(data, size)               host_kfree((void *)(data), size)
+#define kheap_free(heap, data, size)    host_kfree((void *)(data), size)
+#define kheap_free_addr(heap, data)     host_kfree((void *)(data), 0)
+#define kern_os_malloc(size)            host_kalloc(size, Z_ZERO)
+#define kern_os_free(addr)              host_kfree(addr, 0)
+#define kern_os_kfree(p, size)          host_kfree(p, size)
+
+#endif /* _HOST_KERN_KALLOC_H_ */
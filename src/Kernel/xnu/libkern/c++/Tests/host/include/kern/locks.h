@@ -0,0 +1,34 @@
+#ifndef _HOST_KERN_LOCKS_H_
+#define _HOST_KERN_LOCKS_H_
+
+#include <pthread.h>
+
+/* lck_rw_t and lck_mtx_t over pthreads */
+typedef struct lck_grp { int unused; } lck_grp_t;
+typedef struct lck_attr { int unused; } lck_attr_t;
+typedef pthread_rwlock_t lck_rw_t;
+typedef pthread_mutex_t lck_mtx_t;
+typedef unsigned int lck_rw_type_t;
+
+#define LCK_RW_TYPE_SHARED      0x01
+#define LCK_RW_TYPE_EXCLUSIVE   0x02
+#define LCK_ATTR_NULL           ((lck_attr_t *)NULL)
+#define LCK_GRP_ATTR_NULL       ((void *)NULL)
+
+__BEGIN_DECLS
+extern lck_grp_t *lck_grp_alloc_init(const char *name, void *attr);
+extern lck_rw_t *lck_rw_alloc_init(lck_grp_t *grp, lck_attr_t *attr);
+extern void lck_rw_free(lck_rw_t *lck, lck_grp_t *grp);
+extern void lck_rw_lock(lck_rw_t *lck, lck_rw_type_t type);
+extern void lck_rw_unlock(lck_rw_t *lck, lck_rw_type_t type);
+extern void lck_rw_lock_shared(lck_rw_t *lck);
+extern void lck_rw_unlock_shared(lck_rw_t *lck);
+extern void lck_rw_lock_exclusive(lck_rw_t *lck);
+extern void lck_rw_unlock_exclusive(lck_rw_t *lck);
+extern lck_mtx_t *lck_mtx_alloc_init(lck_grp_t *grp, lck_attr_t *attr);
+extern void lck_mtx_free(lck_mtx_t *lck, lck_grp_t *grp);
+extern void lck_mtx_lock(lck_mtx_t *lck);
+extern void lck_mtx_unlock(lck_mtx_t *lck);
+__END_DECLS
+
+#endif /* _HOST_KERN_LOCKS_H_ */
@@ -0,0 +1 @@
+/* Nothing from <kern/queue.h> is used by the containers built here */
@@ -0,0 +1,37 @@
+#ifndef _HOST_KERN_ZALLOC_H_
+#define _HOST_KERN_ZALLOC_H_
+
+#include <sys/cdefs.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Zones are just sized calloc()s on the host */
+typedef struct zone {
+	const char *    z_name;
+	size_t          z_elem_size;
+} *zone_t;
+
+typedef uint32_t zone_create_flags_t;
+#define ZC_NONE                 0x0
+#define ZC_ZFREE_CLEARMEM       0x1
+#define ZC_CACHING              0x2
+#define ZC_KASAN_NOQUARANTINE   0x4
+
+__options_decl(zalloc_flags_t, uint32_t, {
+	Z_WAITOK        = 0x0000,
+	Z_NOWAIT        = 0x0001,
+	Z_NOPAGEWAIT    = 0x0002,
+	Z_ZERO          = 0x0004,
+	Z_NOFAIL        = 0x8000,
+});
+
+#define SECURITY_READ_ONLY_LATE(_t) _t
+
+__BEGIN_DECLS
+extern zone_t zone_create(const char *name, size_t size, zone_create_flags_t flags);
+extern void *zalloc_flags(zone_t zone, zalloc_flags_t flags);
+extern void zfree(zone_t zone, void *elem);
+extern void kern_os_zfree(zone_t zone, void *elem, size_t size);
+__END_DECLS
+
+#endif /* _HOST_KERN_ZALLOC_H_ */
@@ -0,0 +1,77 @@
+/*
+ * Sources that do not opt into OSSharedPtr see OSPtr<T> as a plain T *, and
+ * call into sources that did.  That works in the kernel because OSSharedPtr
+ * is trivial_abi, so it is returned in a register like the pointer.  gcc
+ * ignores trivial_abi and returns OSSharedPtr in memory, so for gcc OSPtr<T>
+ * is instead a pointer wrapper that is returned the same way, and that
+ * converts to and from T * without touching the retain count.
+ */
+
+#if defined(__clang__) || defined(IOKIT_ENABLE_SHARED_PTR)
+#include_next <libkern/c++/OSPtr.h>
+#elif !defined(XNU_LIBKERN_LIBKERN_CXX_OS_PTR_H)
+#define XNU_LIBKERN_LIBKERN_CXX_OS_PTR_H
+
+template <typename T>
+class OSSharedPtr;
+
+template <typename T, typename Tag>
+class OSTaggedSharedPtr;
+
+template <typename T>
+class OSHostRawPtr {
+public:
+	OSHostRawPtr() : ptr_(nullptr)
+	{
+	}
+	OSHostRawPtr(T * p) : ptr_(p)
+	{
+	}
+	OSHostRawPtr(const OSHostRawPtr & other) : ptr_(other.ptr_)
+	{
+	}
+	~OSHostRawPtr()
+	{
+	}
+
+	OSHostRawPtr &
+	operator=(const OSHostRawPtr & other)
+	{
+		ptr_ = other.ptr_;
+		return *this;
+	}
+
+	operator T *() const
+	{
+		return ptr_;
+	}
+
+	T *
+	operator->() const
+	{
+		return ptr_;
+	}
+
+	/* For C-style casts, which may also cast away const */
+	template <typename U>
+	explicit
+	operator U *() const
+	{
+		return (U *)ptr_;
+	}
+
+private:
+	T * ptr_;
+};
+
+template <typename T>
+using OSPtr = OSHostRawPtr<T>;
+
+template <typename T>
+using OSTaggedPtr = T *;
+
+#if !__has_feature(cxx_nullptr) && !defined(nullptr)
+# define nullptr NULL
+#endif
+
+#endif
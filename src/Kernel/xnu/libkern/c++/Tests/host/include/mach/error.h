@@ -0,0 +1,16 @@
+#ifndef _HOST_MACH_ERROR_H_
+#define _HOST_MACH_ERROR_H_
+
+typedef int kern_return_t;
+typedef kern_return_t mach_error_t;
+
+#define KERN_SUCCESS            0
+#define KERN_NO_SPACE           3
+#define KERN_RESOURCE_SHORTAGE  6
+
+#define err_system(x)           ((signed)((((unsigned)(x))&0x3f)<<26))
+#define err_sub(x)              (((x)&0xfff)<<14)
+#define sys_libkern             err_system(0x37)
+#define sys_iokit               err_system(0x38)
+
+#endif /* _HOST_MACH_ERROR_H_ */
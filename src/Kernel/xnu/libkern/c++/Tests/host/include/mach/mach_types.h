@@ -0,0 +1,9 @@
+#ifndef _HOST_MACH_MACH_TYPES_H_
+#define _HOST_MACH_MACH_TYPES_H_
+
+#include <mach/error.h>
+
+typedef struct host_vm_map *vm_map_t;
+typedef uint32_t vm_tag_t;
+
+#endif /* _HOST_MACH_MACH_TYPES_H_ */
@@ -0,0 +1,2 @@
+/* No pointer authentication on the host: xnu's header has the no-op forms */
+#include "../../../../../EXTERNAL_HEADERS/ptrauth.h"
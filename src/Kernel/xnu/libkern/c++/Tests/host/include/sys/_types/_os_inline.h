@@ -0,0 +1,3 @@
+#if !defined(OS_INLINE)
+#define OS_INLINE static inline
+#endif /* OS_INLINE */
@@ -0,0 +1 @@
+#include "../../../../../../bsd/sys/appleapiopts.h"
@@ -0,0 +1,42 @@
+#ifndef _HOST_SYS_CDEFS_H_
+#define _HOST_SYS_CDEFS_H_
+
+#include_next <sys/cdefs.h>
+
+/* The parts of xnu's <sys/cdefs.h> that the host C library lacks */
+#define __unused                __attribute__((__unused__))
+#define __used                  __attribute__((__used__))
+#define __dead2                 __attribute__((__noreturn__))
+#define __pure2                 __attribute__((__const__))
+#define __abortlike             __dead2 __attribute__((__cold__, __noinline__))
+#define __deprecated            __attribute__((__deprecated__))
+#define __deprecated_msg(m)     __attribute__((__deprecated__(m)))
+#define __kpi_deprecated(m)
+#define __kpi_unavailable
+#define __exported
+#define __header_always_inline  static inline __attribute__((__always_inline__))
+#define __improbable(x)         __builtin_expect(!!(x), 0)
+#define __probable(x)           __builtin_expect(!!(x), 1)
+#define __XNU_INTERNAL(sym)
+#define __XNU_PRIVATE_EXTERN    __private_extern__
+#define __DARWIN_ALIAS(sym)
+#define __restrict_arr
+
+#define __enum_open
+#define __enum_closed
+#define __enum_options
+#if defined(__cplusplus)
+#define __enum_decl(_name, _type, ...) \
+	typedef enum : _type __VA_ARGS__ _name
+#define __options_decl(_name, _type, ...) \
+	typedef enum : _type __VA_ARGS__ _name
+#else
+#define __enum_decl(_name, _type, ...) \
+	typedef _type _name; enum __VA_ARGS__
+#define __options_decl(_name, _type, ...) \
+	typedef _type _name; enum __VA_ARGS__
+#endif
+#define __enum_closed_decl      __enum_decl
+#define __options_closed_decl   __options_decl
+
+#endif /* _HOST_SYS_CDEFS_H_ */
@@ -0,0 +1,13 @@
+#ifndef _HOST_SYS_SYSTM_H_
+#define _HOST_SYS_SYSTM_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+__BEGIN_DECLS
+extern void kprintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+__END_DECLS
+
+#endif /* _HOST_SYS_SYSTM_H_ */
@@ -0,0 +1,25 @@
+#ifndef _HOST_VM_VM_KERN_H_
+#define _HOST_VM_VM_KERN_H_
+
+#include <mach/mach_types.h>
+
+/* Page-sized kernel_map allocations come from malloc() like the rest */
+#define PAGE_SIZE               4096
+#define PAGE_MASK               (PAGE_SIZE - 1)
+#define round_page_32(x)        (((uint32_t)(x) + PAGE_MASK) & ~(uint32_t)PAGE_MASK)
+#define round_page_overflow(in, out) \
+	__builtin_add_overflow((in), PAGE_MASK, (out)) ? 1 : \
+	((*(out) &= ~(__typeof__(*(out)))PAGE_MASK), 0)
+
+extern vm_map_t kernel_map;
+#define page_size               ((vm_size_t)PAGE_SIZE)
+
+__BEGIN_DECLS
+extern kern_return_t kmem_alloc(vm_map_t map, vm_offset_t *addrp,
+    vm_size_t size, vm_tag_t tag);
+extern kern_return_t kmem_realloc(vm_map_t map, vm_offset_t oldaddr,
+    vm_size_t oldsize, vm_offset_t *newaddrp, vm_size_t newsize, vm_tag_t tag);
+extern void kmem_free(vm_map_t map, vm_offset_t addr, vm_size_t size);
+__END_DECLS
+
+#endif /* _HOST_VM_VM_KERN_H_ */
@@ -0,0 +1,377 @@
+/*
+ * Just enough of OSMetaClass for the containers: every metaclass registers
+ * itself in a table when its static constructor runs, and casts walk the
+ * superclass links.  There are no kexts here, so class names stay C strings
+ * and nothing is ever unloaded.
+ */
+
+#include <string.h>
+
+#include <libkern/c++/OSMetaClass.h>
+#include <libkern/c++/OSObject.h>
+#include <libkern/c++/OSString.h>
+#include <libkern/c++/OSSymbol.h>
+#include <IOKit/IOKitDebug.h>
+#include <IOKit/IOReturn.h>
+
+#define HOST_MAX_CLASSES        256
+
+static const OSMetaClass *sAllClasses[HOST_MAX_CLASSES];
+static unsigned int sAllClassesCount;
+
+/* Placement new is in <new>, which the kernel headers do not pull in */
+void *
+operator new(size_t size __unused, void *p)
+{
+	return p;
+}
+
+#pragma mark OSMetaClassBase
+
+OSMetaClassBase *
+OSMetaClassBase::safeMetaCast(
+	const OSMetaClassBase * me,
+	const OSMetaClass     * toType)
+{
+	return (me)? me->metaCast(toType) : NULL;
+}
+
+OSMetaClassBase::OSMetaClassBase()
+{
+}
+
+OSMetaClassBase::~OSMetaClassBase()
+{
+}
+
+bool
+OSMetaClassBase::isEqualTo(const OSMetaClassBase * anObj) const
+{
+	return this == anObj;
+}
+
+OSMetaClassBase *
+OSMetaClassBase::metaCast(const OSMetaClass * toMeta) const
+{
+	return toMeta->checkMetaCast(this);
+}
+
+OSMetaClassBase *
+OSMetaClassBase::metaCast(const OSSymbol * toMetaSymb) const
+{
+	return OSMetaClass::checkMetaCastWithName(toMetaSymb, this);
+}
+
+OSMetaClassBase *
+OSMetaClassBase::metaCast(const OSString * toMetaStr) const
+{
+	return OSMetaClass::checkMetaCastWithName(toMetaStr, this);
+}
+
+OSMetaClassBase *
+OSMetaClassBase::metaCast(const char * toMetaCStr) const
+{
+	return OSMetaClass::checkMetaCastWithName(toMetaCStr, this);
+}
+
+kern_return_t
+OSMetaClassBase::Dispatch(const IORPC rpc __unused)
+{
+	return kIOReturnUnsupported;
+}
+
+kern_return_t
+OSObject::Dispatch(const IORPC rpc __unused)
+{
+	return kIOReturnUnsupported;
+}
+
+kern_return_t
+OSObject::MetaClass::Dispatch(const IORPC rpc __unused)
+{
+	return kIOReturnUnsupported;
+}
+
+#if APPLE_KEXT_VTABLE_PADDING
+void
+OSMetaClassBase::_RESERVEDOSMetaClassBase4()
+{
+	panic("OSMetaClassBase::_RESERVEDOSMetaClassBase%d called.", 4);
+}
+void
+OSMetaClassBase::_RESERVEDOSMetaClassBase5()
+{
+	panic("OSMetaClassBase::_RESERVEDOSMetaClassBase%d called.", 5);
+}
+void
+OSMetaClassBase::_RESERVEDOSMetaClassBase6()
+{
+	panic("OSMetaClassBase::_RESERVEDOSMetaClassBase%d called.", 6);
+}
+void
+OSMetaClassBase::_RESERVEDOSMetaClassBase7()
+{
+	panic("OSMetaClassBase::_RESERVEDOSMetaClassBase%d called.", 7);
+}
+#endif
+
+#pragma mark OSMetaClassMeta
+
+class OSMetaClassMeta : public OSMetaClass
+{
+public:
+	OSMetaClassMeta();
+	OSObject * alloc() const;
+};
+OSMetaClassMeta::OSMetaClassMeta()
+	: OSMetaClass("OSMetaClass", NULL, sizeof(OSMetaClass))
+{
+}
+OSObject *
+OSMetaClassMeta::alloc() const
+{
+	return NULL;
+}
+
+static OSMetaClassMeta sOSMetaClassMeta;
+
+const OSMetaClass * const OSMetaClass::metaClass = &sOSMetaClassMeta;
+const OSMetaClass *
+OSMetaClass::getMetaClass() const
+{
+	return &sOSMetaClassMeta;
+}
+
+#pragma mark OSMetaClass
+
+OSMetaClass::OSMetaClass(
+	const char        * inClassName,
+	const OSMetaClass * inSuperClass,
+	unsigned int        inClassSize)
+{
+	instanceCount = 0;
+	classSize = inClassSize;
+	superClassLink = inSuperClass;
+	reserved = NULL;
+
+	/* As in the kernel before postModLoad(), the name is still a C string */
+	className = (const OSSymbol *)inClassName;
+
+	if (sAllClassesCount == HOST_MAX_CLASSES) {
+		panic("OSMetaClass: too many classes registering %s", inClassName);
+	}
+	sAllClasses[sAllClassesCount++] = this;
+}
+
+OSMetaClass::OSMetaClass(
+	const char        * inClassName,
+	const OSMetaClass * inSuperClass,
+	unsigned int        inClassSize,
+	zone_t            * inZone,
+	const char        * zone_name,
+	zone_create_flags_t zflags) : OSMetaClass(inClassName, inSuperClass,
+	    inClassSize)
+{
+	*inZone = zone_create(zone_name, inClassSize,
+	    (zone_create_flags_t) (ZC_ZFREE_CLEARMEM | zflags));
+}
+
+OSMetaClass::~OSMetaClass()
+{
+}
+
+void
+OSMetaClass::retain() const
+{
+}
+
+void
+OSMetaClass::release() const
+{
+}
+
+void
+OSMetaClass::release(__unused int when) const
+{
+}
+
+void
+OSMetaClass::taggedRetain(__unused const void * tag) const
+{
+}
+
+void
+OSMetaClass::taggedRelease(__unused const void * tag) const
+{
+}
+
+void
+OSMetaClass::taggedRelease(__unused const void * tag, __unused const int when) const
+{
+}
+
+int
+OSMetaClass::getRetainCount() const
+{
+	return 0;
+}
+
+bool
+OSMetaClass::serialize(__unused OSSerialize * s) const
+{
+	panic("OSMetaClass::serialize");
+}
+
+const char *
+OSMetaClass::getClassName() const
+{
+	return (const char *)className;
+}
+
+unsigned int
+OSMetaClass::getClassSize() const
+{
+	return classSize;
+}
+
+const OSMetaClass *
+OSMetaClass::getSuperClass() const
+{
+	return superClassLink;
+}
+
+unsigned int
+OSMetaClass::getInstanceCount() const
+{
+	return instanceCount;
+}
+
+void
+OSMetaClass::instanceConstructed() const
+{
+	if ((0 == __atomic_fetch_add(&instanceCount, 1, __ATOMIC_RELAXED)) &&
+	    superClassLink) {
+		superClassLink->instanceConstructed();
+	}
+}
+
+void
+OSMetaClass::instanceDestructed() const
+{
+	unsigned int old = __atomic_fetch_sub(&instanceCount, 1, __ATOMIC_RELAXED);
+
+	if ((1 == old) && superClassLink) {
+		superClassLink->instanceDestructed();
+	}
+
+	if (((int)old) <= 0) {
+		panic("OSMetaClass: Class %s - bad retain (%d)",
+		    getClassName(), (int)old - 1);
+	}
+}
+
+const OSMetaClass *
+OSMetaClass::getMetaClassWithName(const OSSymbol * name)
+{
+	const char * cname = name ? name->getCStringNoCopy() : NULL;
+
+	if (!cname) {
+		return NULL;
+	}
+	for (unsigned int i = 0; i < sAllClassesCount; i++) {
+		if (strcmp(sAllClasses[i]->getClassName(), cname) == 0) {
+			return sAllClasses[i];
+		}
+	}
+	return NULL;
+}
+
+OSObject *
+OSMetaClass::allocClassWithName(const OSSymbol * name)
+{
+	const OSMetaClass * meta = getMetaClassWithName(name);
+
+	return meta ? meta->alloc() : NULL;
+}
+
+OSObject *
+OSMetaClass::allocClassWithName(const char * name)
+{
+	const OSSymbol * symbol = OSSymbol::withCString(name);
+	OSObject       * result = NULL;
+
+	if (symbol) {
+		result = allocClassWithName(symbol);
+		symbol->release();
+	}
+	return result;
+}
+
+OSMetaClassBase *
+OSMetaClass::checkMetaCastWithName(
+	const OSSymbol        * name,
+	const OSMetaClassBase * in)
+{
+	const OSMetaClass * meta = getMetaClassWithName(name);
+
+	return meta ? meta->checkMetaCast(in) : NULL;
+}
+
+OSMetaClassBase *
+OSMetaClass::checkMetaCastWithName(
+	const OSString        * name,
+	const OSMetaClassBase * in)
+{
+	return checkMetaCastWithName(name->getCStringNoCopy(), in);
+}
+
+OSMetaClassBase *
+OSMetaClass::checkMetaCastWithName(
+	const char            * name,
+	const OSMetaClassBase * in)
+{
+	const OSSymbol  * symbol = OSSymbol::withCString(name);
+	OSMetaClassBase * result = NULL;
+
+	if (symbol) {
+		result = checkMetaCastWithName(symbol, in);
+		symbol->release();
+	}
+	return result;
+}
+
+OSMetaClassBase *
+OSMetaClass::checkMetaCast(
+	const OSMetaClassBase * check) const
+{
+	const OSMetaClass * const toMeta   = this;
+	const OSMetaClass *       fromMeta;
+
+	for (fromMeta = check->getMetaClass();; fromMeta = fromMeta->superClassLink) {
+		if (toMeta == fromMeta) {
+			return const_cast<OSMetaClassBase *>(check); // Discard const
+		}
+		if (!fromMeta->superClassLink) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+__dead2
+void
+OSMetaClass::reservedCalled(int ind) const
+{
+	const char * cname = getClassName();
+	panic("%s::_RESERVED%s%d called.", cname, cname, ind);
+}
+
+OSMetaClassDefineReservedUnused(OSMetaClass, 0);
+OSMetaClassDefineReservedUnused(OSMetaClass, 1);
+OSMetaClassDefineReservedUnused(OSMetaClass, 2);
+OSMetaClassDefineReservedUnused(OSMetaClass, 3);
+OSMetaClassDefineReservedUnused(OSMetaClass, 4);
+OSMetaClassDefineReservedUnused(OSMetaClass, 5);
+OSMetaClassDefineReservedUnused(OSMetaClass, 6);
+OSMetaClassDefineReservedUnused(OSMetaClass, 7);
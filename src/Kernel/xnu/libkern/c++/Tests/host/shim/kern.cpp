@@ -0,0 +1,283 @@
+/*
+ * The kernel services the libkern containers call into, on top of the host
+ * C library: kalloc and zones over malloc(), kmem over malloc(), lck_rw and
+ * lck_mtx over pthreads, CPU numbers per thread, and panic()/kprintf() over
+ * stdio.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <kern/cpu_data.h>
+#include <kern/cpu_number.h>
+#include <kern/debug.h>
+#include <kern/kalloc.h>
+#include <kern/locks.h>
+#include <kern/zalloc.h>
+#include <vm/vm_kern.h>
+#include <libkern/OSAtomic.h>
+#include <libkern/OSDebug.h>
+#include <IOKit/IOKitDebug.h>
+
+uint64_t gIOKitDebug;
+vm_map_t kernel_map;
+
+static lck_grp_t host_lock_group;
+lck_grp_t *IOLockGroup = &host_lock_group;
+
+void
+panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	fputs("panic: ", stderr);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	abort();
+}
+
+void
+kprintf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+void
+OSReportWithBacktrace(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+}
+
+#undef OSCompareAndSwap
+Boolean
+OSCompareAndSwap(UInt32 oldValue, UInt32 newValue, volatile UInt32 *address)
+{
+	return __atomic_compare_exchange_n(address, &oldValue, newValue, false,
+	           __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+#pragma mark kalloc and zones
+
+void *
+host_kalloc(size_t size, zalloc_flags_t flags)
+{
+	void *p = (flags & Z_ZERO) ? calloc(1, size) : malloc(size);
+
+	if (p == NULL && (flags & Z_NOFAIL)) {
+		panic("kalloc(%zu) failed", size);
+	}
+	return p;
+}
+
+void *
+host_kallocp(size_t *sizep)
+{
+	return malloc(*sizep);
+}
+
+void
+host_kfree(void *data, size_t size __unused)
+{
+	free(data);
+}
+
+zone_t
+zone_create(const char *name, size_t size, zone_create_flags_t flags __unused)
+{
+	zone_t z = (zone_t)calloc(1, sizeof(*z));
+
+	if (z == NULL) {
+		panic("zone_create(%s) failed", name);
+	}
+	z->z_name = name;
+	z->z_elem_size = size;
+	return z;
+}
+
+void *
+zalloc_flags(zone_t zone, zalloc_flags_t flags)
+{
+	/* Zone elements always come back zeroed, as with ZC_ZFREE_CLEARMEM */
+	void *p = calloc(1, zone->z_elem_size);
+
+	if (p == NULL && (flags & Z_NOFAIL)) {
+		panic("zalloc(%s) failed", zone->z_name);
+	}
+	return p;
+}
+
+void
+zfree(zone_t zone __unused, void *elem)
+{
+	free(elem);
+}
+
+void
+kern_os_zfree(zone_t zone __unused, void *elem, size_t size __unused)
+{
+	free(elem);
+}
+
+#pragma mark kmem
+
+kern_return_t
+kmem_alloc(vm_map_t map __unused, vm_offset_t *addrp, vm_size_t size,
+    vm_tag_t tag __unused)
+{
+	void *p = calloc(1, size);
+
+	*addrp = (vm_offset_t)p;
+	return p ? KERN_SUCCESS : KERN_RESOURCE_SHORTAGE;
+}
+
+kern_return_t
+kmem_realloc(vm_map_t map __unused, vm_offset_t oldaddr, vm_size_t oldsize,
+    vm_offset_t *newaddrp, vm_size_t newsize, vm_tag_t tag __unused)
+{
+	/* The old range stays valid, as the callers free it themselves */
+	void *p = calloc(1, newsize);
+
+	if (p == NULL) {
+		return KERN_RESOURCE_SHORTAGE;
+	}
+	memcpy(p, (void *)oldaddr, oldsize < newsize ? oldsize : newsize);
+	*newaddrp = (vm_offset_t)p;
+	return KERN_SUCCESS;
+}
+
+void
+kmem_free(vm_map_t map __unused, vm_offset_t addr, vm_size_t size __unused)
+{
+	free((void *)addr);
+}
+
+#pragma mark locks
+
+lck_grp_t *
+lck_grp_alloc_init(const char *name __unused, void *attr __unused)
+{
+	return &host_lock_group;
+}
+
+lck_rw_t *
+lck_rw_alloc_init(lck_grp_t *grp __unused, lck_attr_t *attr __unused)
+{
+	lck_rw_t *lck = (lck_rw_t *)malloc(sizeof(*lck));
+
+	if (lck != NULL) {
+		pthread_rwlock_init(lck, NULL);
+	}
+	return lck;
+}
+
+void
+lck_rw_free(lck_rw_t *lck, lck_grp_t *grp __unused)
+{
+	pthread_rwlock_destroy(lck);
+	free(lck);
+}
+
+void
+lck_rw_lock(lck_rw_t *lck, lck_rw_type_t type)
+{
+	if (type == LCK_RW_TYPE_SHARED) {
+		pthread_rwlock_rdlock(lck);
+	} else {
+		pthread_rwlock_wrlock(lck);
+	}
+}
+
+void
+lck_rw_unlock(lck_rw_t *lck, lck_rw_type_t type __unused)
+{
+	pthread_rwlock_unlock(lck);
+}
+
+void
+lck_rw_lock_shared(lck_rw_t *lck)
+{
+	pthread_rwlock_rdlock(lck);
+}
+
+void
+lck_rw_unlock_shared(lck_rw_t *lck)
+{
+	pthread_rwlock_unlock(lck);
+}
+
+void
+lck_rw_lock_exclusive(lck_rw_t *lck)
+{
+	pthread_rwlock_wrlock(lck);
+}
+
+void
+lck_rw_unlock_exclusive(lck_rw_t *lck)
+{
+	pthread_rwlock_unlock(lck);
+}
+
+lck_mtx_t *
+lck_mtx_alloc_init(lck_grp_t *grp __unused, lck_attr_t *attr __unused)
+{
+	lck_mtx_t *lck = (lck_mtx_t *)malloc(sizeof(*lck));
+
+	if (lck != NULL) {
+		pthread_mutex_init(lck, NULL);
+	}
+	return lck;
+}
+
+void
+lck_mtx_free(lck_mtx_t *lck, lck_grp_t *grp __unused)
+{
+	pthread_mutex_destroy(lck);
+	free(lck);
+}
+
+void
+lck_mtx_lock(lck_mtx_t *lck)
+{
+	pthread_mutex_lock(lck);
+}
+
+void
+lck_mtx_unlock(lck_mtx_t *lck)
+{
+	pthread_mutex_unlock(lck);
+}
+
+void
+_disable_preemption(void)
+{
+}
+
+void
+_enable_preemption(void)
+{
+}
+
+int
+cpu_number(void)
+{
+	static unsigned int next_cpu;
+	static __thread int cpu = -1;
+
+	if (cpu < 0) {
+		cpu = (int)(__atomic_fetch_add(&next_cpu, 1, __ATOMIC_RELAXED) & 0xffff);
+	}
+	return cpu;
+}
@@ -97,9 +97,10 @@ typedef OSDictionary* OSDictionaryPtr;
  * An OSDictionary also grows as necessary to accommodate new key/value pairs,
  * <i>unlike</i> Core Foundation collections (it does not, however, shrink).
  *
- * <b>Note:</b> OSDictionary currently uses a linear search algorithm,
- * and is not designed for high-performance access of many values.
- * It is intended as a simple associative-storage mechanism only.
+ * <b>Note:</b> Small dictionaries are searched linearly.
+ * Once its capacity reaches 32 entries, an OSDictionary also keeps
+ * a hash index of its keys, so large dictionaries are searched
+ * in constant time; the order of the keys is not affected.
  *
  * <b>Use Restrictions</b>
  *
@@ -948,6 +949,13 @@ public:
 	bool setObject(const OSSymbol *aKey, const OSMetaClassBase *anObject, bool onlyAdd);
 	void sortBySymbol(void);
 	OSPtr<OSArray> copyKeys(void);
+
+	static size_t allocSize(size_t capacity);
+	uint32_t * getIndex(size_t * mask) const;
+	size_t findIndexSlot(const OSSymbol * aKey, const uint32_t * index, size_t mask) const;
+	void addToIndex(unsigned int i);
+	void removeFromIndex(size_t slot, unsigned int i);
+	void rebuildIndex(void);
 #endif /* XNU_KERNEL_PRIVATE */
 
 
@@ -36,10 +36,17 @@ struct os_map_config_s
 {
 	const char *name; // Only used when DEBUG is set
 	uint32_t initial_size; // If 0, default will be used
+	uint32_t flags; // OS_MAP_CONFIG_* flags below, since version 2
 };
 
 // Increment this when changing os_map_config_s
-#define OS_MAP_CONFIG_S_VERSION 1
+#define OS_MAP_CONFIG_S_VERSION 2
+
+// Probe 16 slots at a time using a byte of hash per slot (SwissTable style)
+// instead of linear probing. Lookups touch fewer keys, which pays off for
+// large maps or keys that are expensive to compare, at a cost of one more
+// byte per slot.
+#define OS_MAP_CONFIG_GROUP_PROBING 0x1
 
 typedef struct os_map_config_s os_map_config_t;
 
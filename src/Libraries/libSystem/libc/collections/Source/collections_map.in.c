@@ -63,8 +63,197 @@ struct _os_map_internal_struct {
 		uint16_t	grow_shift;
 		uint16_t	max_bucket_offset;
 		// Keys are at data; values are at (data + count * sizeof(keys))
+		// Group probing maps set grow_shift to _MAP_GROUP_PROBING_SHIFT,
+		// and lay out data as described below.
 };
 
+// Group probing (OS_MAP_CONFIG_GROUP_PROBING)
+//
+// data starts with a header, followed by one control byte per slot, then the
+// slots themselves, each holding a key next to its value. A control byte is
+// either EMPTY, DELETED, or the low 7 bits of the hash of the key in a full
+// slot. The rest of the hash selects a group of _MAP_GROUP_WIDTH slots to
+// start probing from, and probing then moves on by whole groups, with
+// triangular steps. Lookups compare the control bytes of a group to the
+// hash all at once, and only look at the keys that matched; they stop at the
+// first group with an EMPTY slot.
+//
+// Linear probing maps never use a grow_shift below MAP_MINSHIFT, so the grow
+// shift tells both kinds of maps apart without changing the map structure.
+// The size is the number of slots, a power of 2.
+
+#define _MAP_GROUP_PROBING_SHIFT 0
+#define _MAP_GROUP_MAX_FILL_NUMER 7
+#define _MAP_GROUP_MAX_FILL_DENOM 8
+
+#define _MAP_CTRL_EMPTY		((uint8_t)0x80)
+#define _MAP_CTRL_DELETED	((uint8_t)0xfe)
+#define _MAP_CTRL_FULL(hash)	((uint8_t)((hash) & 0x7f))
+#define _MAP_CTRL_IS_FULL(ctrl)	((ctrl) < 0x80)
+
+struct _os_map_group_header {
+		// Slots that can still go from EMPTY to full before a rehash
+		uint32_t	growth_left;
+} __attribute__((aligned(16)));
+
+// Group operations return a mask with a bit set, every
+// (1 << _MAP_GROUP_MASK_SHIFT) bits, for each matching slot of the group.
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+#define _MAP_GROUP_WIDTH 16
+#define _MAP_GROUP_MASK_SHIFT 0
+
+typedef __m128i _map_group_t;
+
+OS_ALWAYS_INLINE
+static inline _map_group_t
+_map_group_load(const uint8_t *ctrl)
+{
+	return _mm_load_si128((const __m128i *)ctrl);
+}
+
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match(_map_group_t g, uint8_t ctrl)
+{
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g,
+			_mm_set1_epi8((char)ctrl)));
+}
+
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match_empty(_map_group_t g)
+{
+	return _map_group_match(g, _MAP_CTRL_EMPTY);
+}
+
+// EMPTY and DELETED are the only control bytes with the top bit set
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match_empty_or_deleted(_map_group_t g)
+{
+	return (uint32_t)_mm_movemask_epi8(g);
+}
+
+#elif defined(__arm64__) || defined(__aarch64__)
+#include <arm_neon.h>
+
+#define _MAP_GROUP_WIDTH 16
+#define _MAP_GROUP_MASK_SHIFT 2
+
+typedef uint8x16_t _map_group_t;
+
+OS_ALWAYS_INLINE
+static inline _map_group_t
+_map_group_load(const uint8_t *ctrl)
+{
+	return vld1q_u8(ctrl);
+}
+
+// There is no movemask: a narrowing shift leaves a nibble per byte instead
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_mask(uint8x16_t eq)
+{
+	uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) &
+			0x8888888888888888ull;
+}
+
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match(_map_group_t g, uint8_t ctrl)
+{
+	return _map_group_mask(vceqq_u8(g, vdupq_n_u8(ctrl)));
+}
+
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match_empty(_map_group_t g)
+{
+	return _map_group_match(g, _MAP_CTRL_EMPTY);
+}
+
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match_empty_or_deleted(_map_group_t g)
+{
+	return _map_group_mask(vcltzq_s8(vreinterpretq_s8_u8(g)));
+}
+
+#else
+
+// Eight control bytes at a time in a 64 bit word
+#define _MAP_GROUP_WIDTH 8
+#define _MAP_GROUP_MASK_SHIFT 3
+#define _MAP_GROUP_LSBS 0x0101010101010101ull
+#define _MAP_GROUP_MSBS 0x8080808080808080ull
+
+typedef uint64_t _map_group_t;
+
+OS_ALWAYS_INLINE
+static inline _map_group_t
+_map_group_load(const uint8_t *ctrl)
+{
+	uint64_t g;
+	memcpy(&g, ctrl, sizeof(g));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	g = __builtin_bswap64(g);
+#endif
+	return g;
+}
+
+// Can report a full slot right after a match as matching too, which is
+// harmless as keys are compared next.
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match(_map_group_t g, uint8_t ctrl)
+{
+	uint64_t x = g ^ (_MAP_GROUP_LSBS * ctrl);
+	return (x - _MAP_GROUP_LSBS) & ~x & _MAP_GROUP_MSBS;
+}
+
+// Of the control bytes with the top bit set, only DELETED has bit 1 set
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match_empty(_map_group_t g)
+{
+	return g & ~(g << 6) & _MAP_GROUP_MSBS;
+}
+
+OS_ALWAYS_INLINE
+static inline uint64_t
+_map_group_match_empty_or_deleted(_map_group_t g)
+{
+	return g & _MAP_GROUP_MSBS;
+}
+
+#endif
+
+// Index within the group of the first slot in a non zero mask
+OS_ALWAYS_INLINE
+static inline uint32_t
+_map_group_first(uint64_t mask)
+{
+	return (uint32_t)__builtin_ctzll(mask) >> _MAP_GROUP_MASK_SHIFT;
+}
+
+OS_ALWAYS_INLINE
+static inline uint32_t
+_map_group_max_fill(uint32_t size)
+{
+	return size / _MAP_GROUP_MAX_FILL_DENOM * _MAP_GROUP_MAX_FILL_NUMER;
+}
+
+OS_ALWAYS_INLINE
+static inline bool
+_map_is_group_probing(struct _os_map_internal_struct *m)
+{
+	return m->grow_shift == _MAP_GROUP_PROBING_SHIFT;
+}
+
 #endif
 
 // =========== Helpers, defined per map ===========
@@ -383,6 +572,204 @@ _os_map_remove_entry(_os_map_t *m, uint32_t current_index)
 	}
 }
 
+// =========== Group probing, defined per map ===========
+
+#define _os_map_group_slot IN_MAP(_,_group_slot)
+struct _os_map_group_slot {
+	os_map_key_t	key;
+	void		*val;
+};
+
+#define _os_map_group_ref_t IN_MAP(_,_group_ref_t)
+typedef struct {
+	struct _os_map_group_header	*header;
+	uint8_t				*ctrl;
+	struct _os_map_group_slot	*slots;
+} _os_map_group_ref_t;
+
+#define _os_map_group_alloc IN_MAP(_,_group_alloc)
+
+static void
+_os_map_group_alloc(_os_map_t *m, uint32_t size)
+{
+	assert(size >= MAP_MINSIZE && size <= (UINT32_MAX >> 1) + 1);
+	assert((size & (size - 1)) == 0);
+
+	size_t length = sizeof(struct _os_map_group_header) + size +
+			(size_t)size * sizeof(struct _os_map_group_slot);
+	struct _os_map_group_header *header = malloc(length);
+	assert(header != NULL);
+
+	header->growth_left = _map_group_max_fill(size);
+	memset(header + 1, _MAP_CTRL_EMPTY, size);
+	m->data = header;
+	m->size = size;
+	m->count = 0;
+	m->max_bucket_offset = 0;
+	m->grow_shift = _MAP_GROUP_PROBING_SHIFT;
+}
+
+#define _os_map_group_get_ref IN_MAP(_,_group_get_ref)
+
+static inline void
+_os_map_group_get_ref(_os_map_t *m, _os_map_group_ref_t *data)
+{
+	data->header = m->data;
+	data->ctrl = (uint8_t *)(data->header + 1);
+	data->slots = (struct _os_map_group_slot *)(data->ctrl + m->size);
+}
+
+#define _os_map_group_find_helper IN_MAP(_,_group_find_helper)
+
+static inline void *
+_os_map_group_find_helper(_os_map_t *m, os_map_key_t key, uint32_t *i)
+{
+	if (m->count == 0) {
+		return NULL;
+	}
+
+	_os_map_group_ref_t data;
+	_os_map_group_get_ref(m, &data);
+
+	uint32_t hash = os_map_hash(key);
+	uint32_t groups_mask = m->size / _MAP_GROUP_WIDTH - 1;
+	uint32_t group = (hash >> 7) & groups_mask;
+
+	for (uint32_t stride = 0; stride <= groups_mask; ) {
+		uint32_t base = group * _MAP_GROUP_WIDTH;
+		_map_group_t g = _map_group_load(&data.ctrl[base]);
+
+		uint64_t match = _map_group_match(g, _MAP_CTRL_FULL(hash));
+		for (; match; match &= match - 1) {
+			uint32_t index = base + _map_group_first(match);
+			if (os_map_key_equals(key, data.slots[index].key)) {
+				*i = index;
+				return data.slots[index].val;
+			}
+		}
+		if (_map_group_match_empty(g)) {
+			return NULL;
+		}
+		group = (group + ++stride) & groups_mask;
+	}
+	return NULL;
+}
+
+#define _os_map_group_find_free IN_MAP(_,_group_find_free)
+
+// Returns the first EMPTY or DELETED slot of the probe sequence for hash
+static inline uint32_t
+_os_map_group_find_free(_os_map_t *m, _os_map_group_ref_t data, uint32_t hash)
+{
+	uint32_t groups_mask = m->size / _MAP_GROUP_WIDTH - 1;
+	uint32_t group = (hash >> 7) & groups_mask;
+
+	for (uint32_t stride = 0; ; ) {
+		uint32_t base = group * _MAP_GROUP_WIDTH;
+		uint64_t match = _map_group_match_empty_or_deleted(
+				_map_group_load(&data.ctrl[base]));
+		if (match) {
+			return base + _map_group_first(match);
+		}
+		// The map is never full, so some group has a free slot
+		assert(stride < groups_mask);
+		group = (group + ++stride) & groups_mask;
+	}
+}
+
+#define _os_map_group_rehash IN_MAP(_,_group_rehash)
+
+static void
+_os_map_group_rehash(_os_map_t *m, uint32_t new_size)
+{
+	_os_map_group_ref_t old_data;
+	_os_map_group_get_ref(m, &old_data);
+	uint32_t old_size = m->size, count = m->count;
+
+	_os_map_group_alloc(m, new_size);
+
+	_os_map_group_ref_t data;
+	_os_map_group_get_ref(m, &data);
+
+	for (uint32_t i = 0; i < old_size; i++) {
+		if (!_MAP_CTRL_IS_FULL(old_data.ctrl[i])) {
+			continue;
+		}
+		uint32_t j = _os_map_group_find_free(m, data,
+				os_map_hash(old_data.slots[i].key));
+		data.ctrl[j] = old_data.ctrl[i];
+		data.slots[j] = old_data.slots[i];
+	}
+	m->count = count;
+	data.header->growth_left -= count;
+	free(old_data.header);
+}
+
+#define _os_map_group_insert IN_MAP(_,_group_insert)
+
+static void
+_os_map_group_insert(_os_map_t *m, os_map_key_t key, void *val)
+{
+	_os_map_group_ref_t data;
+	_os_map_group_get_ref(m, &data);
+
+#ifdef DEBUG
+	// Doesn't support inserting twice
+	uint32_t existing;
+	assert(_os_map_group_find_helper(m, key, &existing) == NULL);
+#endif
+
+	uint32_t hash = os_map_hash(key);
+	uint32_t i = _os_map_group_find_free(m, data, hash);
+
+	if (data.ctrl[i] == _MAP_CTRL_EMPTY && data.header->growth_left == 0) {
+		// Grow if the map is really full, otherwise only get rid of
+		// the DELETED slots
+		uint32_t new_size = m->size;
+		if (m->count >= _map_group_max_fill(m->size) / 2) {
+			new_size *= 2;
+		}
+		_os_map_group_rehash(m, new_size);
+		_os_map_group_get_ref(m, &data);
+		i = _os_map_group_find_free(m, data, hash);
+	}
+
+	if (data.ctrl[i] == _MAP_CTRL_EMPTY) {
+		data.header->growth_left--;
+	}
+	data.ctrl[i] = _MAP_CTRL_FULL(hash);
+	data.slots[i].key = key;
+	data.slots[i].val = val;
+	m->count++;
+}
+
+#define _os_map_group_remove_entry IN_MAP(_,_group_remove_entry)
+
+static void
+_os_map_group_remove_entry(_os_map_t *m, uint32_t i)
+{
+	_os_map_group_ref_t data;
+	_os_map_group_get_ref(m, &data);
+
+	// Lookups stop at groups with an EMPTY slot: if there is one in this
+	// group, no probe sequence goes on past it, and the slot can be EMPTY
+	// again. Otherwise it has to be DELETED to keep them going.
+	uint32_t base = i & ~(uint32_t)(_MAP_GROUP_WIDTH - 1);
+	if (_map_group_match_empty(_map_group_load(&data.ctrl[base]))) {
+		data.ctrl[i] = _MAP_CTRL_EMPTY;
+		data.header->growth_left++;
+	} else {
+		data.ctrl[i] = _MAP_CTRL_DELETED;
+	}
+	m->count--;
+
+	if ((m->size >= MAP_MINSIZE * 2) &&
+	    (m->count < m->size / _MAP_MIN_FILL_DENOM)) {
+		// if the map density drops below 12%, shrink it
+		_os_map_group_rehash(m, m->size / 2);
+	}
+}
+
 // =========== Implementation ===========
 
 
@@ -390,12 +777,25 @@ _os_map_remove_entry(_os_map_t *m, uint32_t current_index)
 
 void
 os_map_init(opaque_os_map_t *m_raw, os_map_config_t *config,
-	      __unused int struct_version)
+	      int struct_version)
 {
 	static_assert(sizeof(opaque_os_map_t) == sizeof(_os_map_t),
 		      "Opaque string map incorrect size");
 	_os_map_t *m = (_os_map_t *)m_raw;
 
+	// flags only exist since version 2
+	if (config && struct_version >= 2 &&
+	    (config->flags & OS_MAP_CONFIG_GROUP_PROBING)) {
+		uint32_t size = MAP_MINSIZE;
+		while (size < config->initial_size) {
+			assert(size <= UINT32_MAX / 4);
+			size *= 2;
+		}
+		_os_map_group_alloc(m, size);
+		DEBUG_ASSERT_MAP_INVARIANTS(m);
+		return;
+	}
+
 	if (config) {
 		m->size =  MAX(config->initial_size, MAP_MINSIZE);
 	} else {
@@ -431,6 +831,12 @@ os_map_insert(opaque_os_map_t *m_raw, os_map_key_t key, void *val)
 
 	assert(val != NULL);
 
+	if (_map_is_group_probing(m)) {
+		_os_map_group_insert(m, key, val);
+		DEBUG_ASSERT_MAP_INVARIANTS(m);
+		return;
+	}
+
 	if (m->count >= _MAP_MAX_FILL_NUMER * m->size /
 		_MAP_MAX_FILL_DENOM) {
 		_os_map_rehash(m, 1);
@@ -449,6 +855,9 @@ os_map_find(opaque_os_map_t *m_raw, os_map_key_t key)
 {
 	_os_map_t *m = (_os_map_t *)m_raw;
 	uint32_t i;
+	if (_map_is_group_probing(m)) {
+		return _os_map_group_find_helper(m, key, &i);
+	}
 	return _os_map_find_helper(m, key, &i);
 }
 
@@ -461,6 +870,14 @@ os_map_delete(opaque_os_map_t *m_raw, os_map_key_t key)
 	_os_map_t *m = (_os_map_t *)m_raw;
 	uint32_t i;
 
+	if (_map_is_group_probing(m)) {
+		void *val = _os_map_group_find_helper(m, key, &i);
+		if (val != NULL) {
+			_os_map_group_remove_entry(m, i);
+		}
+		return val;
+	}
+
 	void *val = _os_map_find_helper(m, key, &i);
 	if (val == NULL) {
 		return NULL;
@@ -482,6 +899,27 @@ os_map_clear(opaque_os_map_t *m_raw,
 {
 	_os_map_t *m = (_os_map_t *)m_raw;
 
+	if (_map_is_group_probing(m)) {
+		_os_map_group_ref_t oldData;
+		_os_map_group_get_ref(m, &oldData);
+		uint32_t oldSize = m->size;
+
+		_os_map_group_alloc(m, MAP_MINSIZE);
+		DEBUG_ASSERT_MAP_INVARIANTS(m);
+
+		if (handler != NULL) {
+			for (uint32_t i = 0; i < oldSize; i++) {
+				if (_MAP_CTRL_IS_FULL(oldData.ctrl[i])) {
+					handler(oldData.slots[i].key,
+						oldData.slots[i].val);
+				}
+			}
+		}
+
+		free(oldData.header);
+		return;
+	}
+
 	_os_map_data_ref_t oldData;
 	_get_data_ref(m, &oldData);
 	uint32_t oldSize = m->size;
@@ -524,6 +962,20 @@ os_map_foreach(opaque_os_map_t *m_raw,
 		 OS_NOESCAPE os_map_payload_handler_t handler)
 {
 	_os_map_t *m = (_os_map_t *)m_raw;
+
+	if (_map_is_group_probing(m)) {
+		_os_map_group_ref_t data;
+		_os_map_group_get_ref(m, &data);
+
+		for (uint32_t i = 0; i < m->size; i++) {
+			if (_MAP_CTRL_IS_FULL(data.ctrl[i])) {
+				if (!handler(data.slots[i].key,
+					     data.slots[i].val)) break;
+			}
+		}
+		return;
+	}
+
 	_os_map_data_ref_t data;
 	_get_data_ref(m, &data);
 
@@ -544,10 +996,20 @@ os_map_key_t
 os_map_entry(opaque_os_map_t *m_raw, os_map_key_t key)
 {
 	_os_map_t *m = (_os_map_t *)m_raw;
+	uint32_t i;
+
+	if (_map_is_group_probing(m)) {
+		if (_os_map_group_find_helper(m, key, &i) == NULL) {
+			return (os_map_key_t)NULL;
+		}
+		_os_map_group_ref_t data;
+		_os_map_group_get_ref(m, &data);
+		return data.slots[i].key;
+	}
+
 	_os_map_data_ref_t data;
 	_get_data_ref(m, &data);
 
-	uint32_t i;
 	if (_os_map_find_helper(m, key, &i) == NULL) {
 		return (os_map_key_t)NULL;
 	}
@@ -97,6 +97,7 @@ __bt_open(const char *fname, int flags, int mode, const BTREEINFO *openinfo, int
 	pgno_t ncache;
 	ssize_t nr;
 	int machine_lorder, saved_errno;
+	char *envmap;
 
 	t = NULL;
 
@@ -305,6 +306,17 @@ __bt_open(const char *fname, int flags, int mode, const BTREEINFO *openinfo, int
 	if (!F_ISSET(t, B_INMEM))
 		mpool_filter(t->bt_mp, __bt_pgin, __bt_pgout, t);
 
+	/*
+	 * Read-only trees in the machine byte order need neither copies of
+	 * the pages nor the filters, so they may map the file instead.  A
+	 * mapped file that shrinks under us faults rather than failing a
+	 * read, so this is only done when DB_MMAP_READS asks for it.
+	 */
+	if (F_ISSET(t, B_RDONLY) && !F_ISSET(t, B_NEEDSWAP) && sb.st_size &&
+	    issetugid() == 0 && (envmap = getenv("DB_MMAP_READS")) != NULL &&
+	    atoi(envmap) != 0)
+		(void)mpool_mmap(t->bt_mp);
+
 	/* Create a root page if new tree. */
 	if (nroot(t) == RET_ERROR)
 		goto err;
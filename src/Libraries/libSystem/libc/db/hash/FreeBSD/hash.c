@@ -38,6 +38,7 @@ __FBSDID("$FreeBSD: src/lib/libc/db/hash/hash.c,v 1.21 2009/03/28 07:20:39 delph
 
 #include "namespace.h"
 #include <sys/param.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include <errno.h>
@@ -102,6 +103,7 @@ __hash_open(const char *file, int flags, int mode,
 	struct stat statbuf;
 	DB *dbp;
 	int bpages, hdrsize, new_table, nsegs, save_errno;
+	char *envmap;
 
 	if ((flags & O_ACCMODE) == O_WRONLY) {
 		flags += O_RDWR - O_WRONLY; /* POSIX */
@@ -176,6 +178,25 @@ __hash_open(const char *file, int flags, int mode,
 
 		hashp->nmaps = bpages;
 		(void)memset(&hashp->mapp[0], 0, bpages * sizeof(u_int32_t *));
+
+		/*
+		 * Pages of a read-only table may be copied out of a mapping
+		 * of the file rather than read in one system call each.  A
+		 * mapped file that shrinks under us faults rather than failing
+		 * a read, so this is only done when DB_MMAP_READS asks for it.
+		 */
+		if ((flags & O_ACCMODE) == O_RDONLY && statbuf.st_size > 0 &&
+		    (off_t)(size_t)statbuf.st_size == statbuf.st_size &&
+		    issetugid() == 0 &&
+		    (envmap = getenv("DB_MMAP_READS")) != NULL &&
+		    atoi(envmap) != 0) {
+			hashp->map = mmap(NULL, (size_t)statbuf.st_size,
+			    PROT_READ, MAP_SHARED, hashp->fp, 0);
+			if (hashp->map == MAP_FAILED)
+				hashp->map = NULL;
+			else
+				hashp->mapsize = (size_t)statbuf.st_size;
+		}
 	}
 
 	/* Initialize Buffer Manager */
@@ -421,6 +442,8 @@ hdestroy(HTAB *hashp)
 	if (hashp->tmp_buf)
 		free(hashp->tmp_buf);
 
+	if (hashp->map)
+		(void)munmap(hashp->map, hashp->mapsize);
 	if (hashp->fp != -1)
 		(void)_close(hashp->fp);
 
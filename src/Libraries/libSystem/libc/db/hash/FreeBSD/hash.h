@@ -113,6 +113,8 @@ typedef struct htab	 {		/* Memory resident data structure */
 					 * allocate */
 	BUFHEAD 	bufhead;	/* Header of buffer lru list */
 	SEGMENT 	*dir;		/* Hash Bucket directory */
+	char		*map;		/* Read-only mapping of the file */
+	size_t		mapsize;	/* Size of the mapping */
 					/* other flags */
 	int		nextkey_eof :1;	/* dbm_nextkey() reached EOF */
 } HTAB;
@@ -518,6 +518,7 @@ __get_page(HTAB *hashp, char *p, u_int32_t bucket, int is_bucket, int is_disk,
     int is_bitmap)
 {
 	int fd, page, size, rsize;
+	off_t off;
 	u_int16_t *bp;
 
 	fd = hashp->fp;
@@ -531,7 +532,16 @@ __get_page(HTAB *hashp, char *p, u_int32_t bucket, int is_bucket, int is_disk,
 		page = BUCKET_TO_PAGE(bucket);
 	else
 		page = OADDR_TO_PAGE(bucket);
-	if ((rsize = pread(fd, p, size, (off_t)page << hashp->BSHIFT)) == -1)
+	off = (off_t)page << hashp->BSHIFT;
+	if (hashp->map) {
+		/* Same results as pread() on the file as it was opened */
+		if (off >= (off_t)hashp->mapsize)
+			rsize = 0;
+		else {
+			rsize = MIN(size, (off_t)hashp->mapsize - off);
+			memcpy(p, hashp->map + off, rsize);
+		}
+	} else if ((rsize = pread(fd, p, size, off)) == -1)
 		return (-1);
 	bp = (u_int16_t *)p;
 	if (!rsize)
@@ -35,6 +35,7 @@ __FBSDID("$FreeBSD: src/lib/libc/db/mpool/mpool.c,v 1.16 2009/03/28 04:00:46 del
 
 #include "namespace.h"
 #include <sys/param.h>
+#include <sys/mman.h>
 #include <sys/queue.h>
 #include <sys/stat.h>
 
@@ -50,7 +51,27 @@ __FBSDID("$FreeBSD: src/lib/libc/db/mpool/mpool.c,v 1.16 2009/03/28 04:00:46 del
 #define	__MPOOLINTERFACE_PRIVATE
 #include <mpool.h>
 
+/*
+ * The public MPOOL is the head of a larger private structure, so that its
+ * layout stays what <mpool.h> has always described.  The hash table starts
+ * out as the MPOOL's own array and is replaced by a larger one as the cache
+ * grows.
+ */
+struct _mpool_private {
+	MPOOL	mp;			/* public part, must be first */
+	struct _hqh *hqh;		/* hash queue array */
+	pgno_t	hashsize;		/* number of hash queues, a power of 2 */
+	BKT	*hand;			/* next bucket the clock looks at */
+	void	*map;			/* read-only mapping of the file */
+	size_t	mapsize;		/* size of the mapping */
+};
+
+#define	MPOOL_PRIVATE(mp)	((struct _mpool_private *)(mp))
+#define	MPOOL_HASHKEY(pp, pgno)	(((pgno) - 1) & ((pp)->hashsize - 1))
+
 static BKT *mpool_bkt(MPOOL *);
+static void mpool_grow(MPOOL *);
+static void mpool_insert(MPOOL *, BKT *);
 static BKT *mpool_look(MPOOL *, pgno_t);
 static int  mpool_write(MPOOL *, BKT *);
 
@@ -63,6 +84,7 @@ MPOOL *
 mpool_open(void *key, int fd, pgno_t pagesize, pgno_t maxcache)
 {
 	struct stat sb;
+	struct _mpool_private *pp;
 	MPOOL *mp;
 	int entry;
 
@@ -80,11 +102,14 @@ mpool_open(void *key, int fd, pgno_t pagesize, pgno_t maxcache)
 	}
 
 	/* Allocate and initialize the MPOOL cookie. */
-	if ((mp = (MPOOL *)calloc(1, sizeof(MPOOL))) == NULL)
+	if ((pp = calloc(1, sizeof(*pp))) == NULL)
 		return (NULL);
+	mp = &pp->mp;
 	TAILQ_INIT(&mp->lqh);
 	for (entry = 0; entry < HASHSIZE; ++entry)
 		TAILQ_INIT(&mp->hqh[entry]);
+	pp->hqh = mp->hqh;
+	pp->hashsize = HASHSIZE;
 	mp->maxcache = maxcache;
 	mp->npages = sb.st_size / pagesize;
 	mp->pagesize = pagesize;
@@ -92,6 +117,34 @@ mpool_open(void *key, int fd, pgno_t pagesize, pgno_t maxcache)
 	return (mp);
 }
 
+/*
+ * mpool_mmap --
+ *	Map a read-only file instead of caching copies of its pages.
+ */
+int
+mpool_mmap(MPOOL *mp)
+{
+	struct _mpool_private *pp = MPOOL_PRIVATE(mp);
+	void *map;
+	size_t size;
+
+	if (mp->npages == 0 || mp->curcache != 0 || pp->map != NULL) {
+		errno = EINVAL;
+		return (RET_ERROR);
+	}
+	size = (size_t)mp->npages * mp->pagesize;
+	if (size / mp->pagesize != mp->npages) {
+		errno = ENOMEM;
+		return (RET_ERROR);
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, mp->fd, 0);
+	if (map == MAP_FAILED)
+		return (RET_ERROR);
+	pp->map = map;
+	pp->mapsize = size;
+	return (RET_SUCCESS);
+}
+
 /*
  * mpool_filter --
  *	Initialize input/output filters.
@@ -114,9 +167,12 @@ mpool_new(mp, pgnoaddr)
 	MPOOL *mp;
 	pgno_t *pgnoaddr;
 {
-	struct _hqh *head;
 	BKT *bp;
 
+	if (MPOOL_PRIVATE(mp)->map != NULL) {
+		errno = EPERM;
+		return (NULL);
+	}
 	if (mp->npages == MAX_PAGE_NUMBER) {
 		(void)fprintf(stderr, "mpool_new: page allocation overflow.\n");
 		LIBC_ABORT("page allocation overflow");
@@ -126,17 +182,13 @@ mpool_new(mp, pgnoaddr)
 #endif
 	/*
 	 * Get a BKT from the cache.  Assign a new page number, attach
-	 * it to the head of the hash chain, the tail of the lru chain,
-	 * and return.
+	 * it to the hash and clock queues, and return.
 	 */
 	if ((bp = mpool_bkt(mp)) == NULL)
 		return (NULL);
 	*pgnoaddr = bp->pgno = mp->npages++;
 	bp->flags = MPOOL_PINNED;
-
-	head = &mp->hqh[HASHKEY(bp->pgno)];
-	TAILQ_INSERT_HEAD(head, bp, hq);
-	TAILQ_INSERT_TAIL(&mp->lqh, bp, q);
+	mpool_insert(mp, bp);
 	return (bp->page);
 }
 
@@ -149,7 +201,7 @@ void *
 mpool_get(MPOOL *mp, pgno_t pgno,
     u_int flags)		/* XXX not used? */
 {
-	struct _hqh *head;
+	struct _mpool_private *pp = MPOOL_PRIVATE(mp);
 	BKT *bp;
 	off_t off;
 	int nr;
@@ -164,6 +216,10 @@ mpool_get(MPOOL *mp, pgno_t pgno,
 	++mp->pageget;
 #endif
 
+	/* A mapped file is its own cache. */
+	if (pp->map != NULL)
+		return ((char *)pp->map + (size_t)pgno * mp->pagesize);
+
 	/* Check for a page that is cached. */
 	if ((bp = mpool_look(mp, pgno)) != NULL) {
 #ifdef DEBUG
@@ -174,17 +230,11 @@ mpool_get(MPOOL *mp, pgno_t pgno,
 		}
 #endif
 		/*
-		 * Move the page to the head of the hash chain and the tail
-		 * of the lru chain.
+		 * Rather than moving the page in the queues, mark it so that
+		 * the clock hand passes over it once more, and return it
+		 * pinned.
 		 */
-		head = &mp->hqh[HASHKEY(bp->pgno)];
-		TAILQ_REMOVE(head, bp, hq);
-		TAILQ_INSERT_HEAD(head, bp, hq);
-		TAILQ_REMOVE(&mp->lqh, bp, q);
-		TAILQ_INSERT_TAIL(&mp->lqh, bp, q);
-
-		/* Return a pinned page. */
-		bp->flags |= MPOOL_PINNED;
+		bp->flags |= MPOOL_PINNED | MPOOL_REFERENCED;
 		return (bp->page);
 	}
 
@@ -201,20 +251,16 @@ mpool_get(MPOOL *mp, pgno_t pgno,
 	if (nr != mp->pagesize) {
 		if (nr >= 0)
 			errno = EFTYPE;
+		/* The bucket is on no queue: give it back to the heap. */
+		free(bp);
+		--mp->curcache;
 		return (NULL);
 	}
 
-	/* Set the page number, pin the page. */
+	/* Set the page number, pin the page, add it to the queues. */
 	bp->pgno = pgno;
 	bp->flags = MPOOL_PINNED;
-
-	/*
-	 * Add the page to the head of the hash chain and the tail
-	 * of the lru chain.
-	 */
-	head = &mp->hqh[HASHKEY(bp->pgno)];
-	TAILQ_INSERT_HEAD(head, bp, hq);
-	TAILQ_INSERT_TAIL(&mp->lqh, bp, q);
+	mpool_insert(mp, bp);
 
 	/* Run through the user's filter. */
 	if (mp->pgin != NULL)
@@ -236,6 +282,8 @@ mpool_put(MPOOL *mp, void *page, u_int flags)
 #ifdef STATISTICS
 	++mp->pageput;
 #endif
+	if (MPOOL_PRIVATE(mp)->map != NULL)
+		return (RET_SUCCESS);
 	bp = (BKT *)((char *)page - sizeof(BKT));
 #ifdef DEBUG
 	if (!(bp->flags & MPOOL_PINNED)) {
@@ -256,17 +304,22 @@ mpool_put(MPOOL *mp, void *page, u_int flags)
 int
 mpool_close(MPOOL *mp)
 {
+	struct _mpool_private *pp = MPOOL_PRIVATE(mp);
 	BKT *bp;
 
-	/* Free up any space allocated to the lru pages. */
+	/* Free up any space allocated to the cached pages. */
 	while (!TAILQ_EMPTY(&mp->lqh)) {
 		bp = TAILQ_FIRST(&mp->lqh);
 		TAILQ_REMOVE(&mp->lqh, bp, q);
 		free(bp);
 	}
+	if (pp->map != NULL)
+		(void)munmap(pp->map, pp->mapsize);
 
 	/* Free the MPOOL cookie. */
-	free(mp);
+	if (pp->hqh != mp->hqh)
+		free(pp->hqh);
+	free(pp);
 	return (RET_SUCCESS);
 }
 
@@ -279,7 +332,7 @@ mpool_sync(MPOOL *mp)
 {
 	BKT *bp;
 
-	/* Walk the lru chain, flushing any dirty pages to disk. */
+	/* Walk the clock queue, flushing any dirty pages to disk. */
 	TAILQ_FOREACH(bp, &mp->lqh, q) {
 		if (bp->flags & MPOOL_DIRTY) {
 			if (mpool_write(mp, bp) == RET_ERROR) {
@@ -303,41 +356,62 @@ mpool_sync(MPOOL *mp)
 static BKT *
 mpool_bkt(MPOOL *mp)
 {
+	struct _mpool_private *pp = MPOOL_PRIVATE(mp);
 	struct _hqh *head;
-	BKT *bp;
+	BKT *bp, *next;
+	pgno_t n;
 
 	/* If under the max cached, always create a new page. */
 	if (mp->curcache < mp->maxcache)
 		goto new;
 
 	/*
-	 * If the cache is max'd out, walk the lru list for a buffer we
-	 * can flush.  If we find one, write it (if necessary) and take it
-	 * off any lists.  If we don't find anything we grow the cache anyway.
-	 * The cache never shrinks.
+	 * If the cache is max'd out, sweep the clock hand around the queue
+	 * for a buffer we can flush.  Referenced buffers are skipped once,
+	 * losing their mark.  If we find one, write it (if necessary) and
+	 * take it off the queues.  If two turns don't find anything (all
+	 * buffers are pinned), or if no buffer is on the queue at all, we
+	 * grow the cache anyway.  The cache never shrinks.
 	 */
-	TAILQ_FOREACH(bp, &mp->lqh, q)
-		if (!(bp->flags & MPOOL_PINNED)) {
-			/* Flush if dirty. */
-			if (bp->flags & MPOOL_DIRTY &&
-			    mpool_write(mp, bp) == RET_ERROR)
-				return (NULL);
+	bp = pp->hand;
+	for (n = 2 * mp->curcache; n > 0; n--) {
+		if (bp == NULL && (bp = TAILQ_FIRST(&mp->lqh)) == NULL)
+			goto new;
+		next = TAILQ_NEXT(bp, q);
+		if (bp->flags & MPOOL_PINNED) {
+			bp = next;
+			continue;
+		}
+		if (bp->flags & MPOOL_REFERENCED) {
+			bp->flags &= ~MPOOL_REFERENCED;
+			bp = next;
+			continue;
+		}
+
+		/* Flush if dirty. */
+		if (bp->flags & MPOOL_DIRTY &&
+		    mpool_write(mp, bp) == RET_ERROR) {
+			pp->hand = bp;
+			return (NULL);
+		}
 #ifdef STATISTICS
-			++mp->pageflush;
+		++mp->pageflush;
 #endif
-			/* Remove from the hash and lru queues. */
-			head = &mp->hqh[HASHKEY(bp->pgno)];
-			TAILQ_REMOVE(head, bp, hq);
-			TAILQ_REMOVE(&mp->lqh, bp, q);
+		/* Remove from the hash and clock queues. */
+		head = &pp->hqh[MPOOL_HASHKEY(pp, bp->pgno)];
+		TAILQ_REMOVE(head, bp, hq);
+		TAILQ_REMOVE(&mp->lqh, bp, q);
+		pp->hand = next;
 #ifdef DEBUG
-			{ void *spage;
-				spage = bp->page;
-				memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
-				bp->page = spage;
-			}
-#endif
-			return (bp);
+		{ void *spage;
+			spage = bp->page;
+			memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
+			bp->page = spage;
 		}
+#endif
+		return (bp);
+	}
+	pp->hand = bp;
 
 new:	if ((bp = (BKT *)calloc(1, sizeof(BKT) + mp->pagesize)) == NULL)
 		return (NULL);
@@ -349,6 +423,55 @@ new:	if ((bp = (BKT *)calloc(1, sizeof(BKT) + mp->pagesize)) == NULL)
 	return (bp);
 }
 
+/*
+ * mpool_insert
+ *	Add a page to the hash queues, and to the clock queue just behind
+ *	the hand, so that it is the last one the clock looks at.
+ */
+static void
+mpool_insert(MPOOL *mp, BKT *bp)
+{
+	struct _mpool_private *pp = MPOOL_PRIVATE(mp);
+	struct _hqh *head;
+
+	if (mp->curcache > 2 * pp->hashsize)
+		mpool_grow(mp);
+	head = &pp->hqh[MPOOL_HASHKEY(pp, bp->pgno)];
+	TAILQ_INSERT_HEAD(head, bp, hq);
+	if (pp->hand != NULL)
+		TAILQ_INSERT_BEFORE(pp->hand, bp, q);
+	else
+		TAILQ_INSERT_TAIL(&mp->lqh, bp, q);
+}
+
+/*
+ * mpool_grow
+ *	Double the number of hash queues.  Failing to is not an error, the
+ *	chains just get longer.
+ */
+static void
+mpool_grow(MPOOL *mp)
+{
+	struct _mpool_private *pp = MPOOL_PRIVATE(mp);
+	struct _hqh *hqh;
+	BKT *bp;
+	pgno_t entry, hashsize;
+
+	hashsize = pp->hashsize * 2;
+	if (hashsize < pp->hashsize ||
+	    (hqh = calloc(hashsize, sizeof(*hqh))) == NULL)
+		return;
+	for (entry = 0; entry < hashsize; ++entry)
+		TAILQ_INIT(&hqh[entry]);
+	if (pp->hqh != mp->hqh)
+		free(pp->hqh);
+	pp->hqh = hqh;
+	pp->hashsize = hashsize;
+	TAILQ_FOREACH(bp, &mp->lqh, q)
+		TAILQ_INSERT_HEAD(&pp->hqh[MPOOL_HASHKEY(pp, bp->pgno)],
+		    bp, hq);
+}
+
 /*
  * mpool_write
  *	Write a page to disk.
@@ -381,10 +504,11 @@ mpool_write(MPOOL *mp, BKT *bp)
 static BKT *
 mpool_look(MPOOL *mp, pgno_t pgno)
 {
+	struct _mpool_private *pp = MPOOL_PRIVATE(mp);
 	struct _hqh *head;
 	BKT *bp;
 
-	head = &mp->hqh[HASHKEY(pgno)];
+	head = &pp->hqh[MPOOL_HASHKEY(pp, pgno)];
 	TAILQ_FOREACH(bp, head, hq)
 		if (bp->pgno == pgno) {
 #ifdef STATISTICS
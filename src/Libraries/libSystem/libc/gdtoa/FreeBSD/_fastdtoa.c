@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * Fast paths of dtoa() in round-to-nearest mode, for positive, finite and
+ * non-zero values:
+ *
+ * - mode 0, the shortest string that reads back as d, uses Ulf Adams' Ryu
+ *   algorithm ("Ryu: fast float-to-string conversion", PLDI 2018), which
+ *   always succeeds.
+ *
+ * - modes 2 and 3, a number of significant digits or of digits after the
+ *   decimal point as printf's %e, %f and %g ask for, scale d by a power of
+ *   ten with 192-bit arithmetic and round the result to an integer. They
+ *   give up when the approximation of the power of ten leaves the rounding
+ *   in doubt, when more than 17 digits are needed, or when nothing would be
+ *   left after rounding.
+ *
+ * Results are the same as those of the big integer code in dtoa(), which
+ * runs whenever fast_dtoa() returns NULL.
+ */
+
+#include <string.h>
+
+#include "gdtoaimp.h"
+#include "_pow5_128.h"
+
+#ifdef __SIZEOF_INT128__
+
+#define	DBL_MANT_BITS	52
+#define	DBL_EXP_BIAS	1023
+#define	RYU_POW5_BITS	125
+
+static const uint64_t pow10_64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL,
+};
+
+/* ceil(log2(5^e)), and 1 for e == 0 */
+static inline int
+pow5bits(int e)
+{
+	return ((e * 1217359) >> 19) + 1;
+}
+
+/* floor(log10(2^e)) */
+static inline int
+log10pow2(int e)
+{
+	return (e * 78913) >> 18;
+}
+
+/* floor(log10(5^e)) */
+static inline int
+log10pow5(int e)
+{
+	return (e * 732923) >> 20;
+}
+
+static inline int
+multiple_of_pow5(uint64_t v, int p)
+{
+	int n;
+
+	for (n = 0; v % 5 == 0; n++)
+		v /= 5;
+	return n >= p;
+}
+
+static inline int
+multiple_of_pow2(uint64_t v, int p)
+{
+	return (v & ((1ULL << p) - 1)) == 0;
+}
+
+/*
+ * Ryu's tables, taken from pow5_128: 5^i with its top bit at bit 124, and
+ * 2^(pow5bits(q) - 1 + 125) / 5^q rounded up. Low word first.
+ */
+static inline void
+ryu_pow5(int i, uint64_t mul[2])
+{
+	const uint64_t *p = pow5_128[i - POW5_128_MIN];
+
+	mul[0] = p[1] >> 3 | p[0] << 61;
+	mul[1] = p[0] >> 3;
+}
+
+static inline void
+ryu_pow5inv(int q, uint64_t mul[2])
+{
+	const uint64_t *p = pow5_128[-q - POW5_128_MIN];
+
+	if (q == 0) {
+		mul[0] = 1;
+		mul[1] = 1ULL << 61;
+		return;
+	}
+	mul[0] = p[1] >> 3 | p[0] << 61;
+	mul[1] = p[0] >> 3;
+	if (++mul[0] == 0)
+		mul[1]++;
+}
+
+/* (m * mul) >> j, for j >= 64 */
+static inline uint64_t
+mulshift(uint64_t m, const uint64_t mul[2], int j)
+{
+	unsigned __int128 b0 = (unsigned __int128)m * mul[0];
+	unsigned __int128 b2 = (unsigned __int128)m * mul[1];
+
+	return (uint64_t)(((b0 >> 64) + b2) >> (j - 64));
+}
+
+/*
+ * Shortest decimal m * 10^*e10 in the rounding interval of the double with
+ * the given biased exponent and fraction, closest to it. This is Ryu's d2d().
+ */
+static uint64_t
+shortest(uint64_t frac, int bexp, int *e10)
+{
+	uint64_t m2, mv, vr, vp, vm, output, mul[2];
+	int e2, q, i, j, k, removed, mmshift, even;
+	int vm_zeros = 0, vr_zeros = 0, last = 0, roundup = 0;
+
+	if (bexp == 0) {
+		e2 = 1 - DBL_EXP_BIAS - DBL_MANT_BITS - 2;
+		m2 = frac;
+	} else {
+		e2 = bexp - DBL_EXP_BIAS - DBL_MANT_BITS - 2;
+		m2 = 1ULL << DBL_MANT_BITS | frac;
+	}
+	even = (m2 & 1) == 0;
+	mv = 4 * m2;
+	/* the interval below is narrower at powers of two */
+	mmshift = frac != 0 || bexp <= 1;
+
+	/*
+	 * Scale the value and the bounds of its interval, 4 * m2 and
+	 * 4 * m2 +- 2 (or - 1), by a power of ten, keeping track of whether
+	 * the digits dropped on the way are all zero.
+	 */
+	if (e2 >= 0) {
+		q = log10pow2(e2) - (e2 > 3);
+		*e10 = q;
+		k = RYU_POW5_BITS + pow5bits(q) - 1;
+		i = -e2 + q + k;
+		ryu_pow5inv(q, mul);
+		vr = mulshift(mv, mul, i);
+		vp = mulshift(mv + 2, mul, i);
+		vm = mulshift(mv - 1 - mmshift, mul, i);
+		if (q <= 21) {
+			if (mv % 5 == 0)
+				vr_zeros = multiple_of_pow5(mv, q);
+			else if (even)
+				vm_zeros = multiple_of_pow5(mv - 1 - mmshift, q);
+			else
+				vp -= multiple_of_pow5(mv + 2, q);
+		}
+	} else {
+		q = log10pow5(-e2) - (-e2 > 1);
+		*e10 = q + e2;
+		i = -e2 - q;
+		k = pow5bits(i) - RYU_POW5_BITS;
+		j = q - k;
+		ryu_pow5(i, mul);
+		vr = mulshift(mv, mul, j);
+		vp = mulshift(mv + 2, mul, j);
+		vm = mulshift(mv - 1 - mmshift, mul, j);
+		if (q <= 1) {
+			vr_zeros = 1;
+			if (even)
+				vm_zeros = mmshift == 1;
+			else
+				vp--;
+		} else if (q < 63) {
+			vr_zeros = multiple_of_pow2(mv, q);
+		}
+	}
+
+	/* Drop digits while the interval still holds a shorter number. */
+	removed = 0;
+	if (vm_zeros || vr_zeros) {
+		while (vp / 10 > vm / 10) {
+			vm_zeros &= vm % 10 == 0;
+			vr_zeros &= last == 0;
+			last = (int)(vr % 10);
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		if (vm_zeros) {
+			while (vm % 10 == 0) {
+				vr_zeros &= last == 0;
+				last = (int)(vr % 10);
+				vr /= 10;
+				vp /= 10;
+				vm /= 10;
+				removed++;
+			}
+		}
+		/* ties go to even */
+		if (vr_zeros && last == 5 && vr % 2 == 0)
+			last = 4;
+		output = vr + ((vr == vm && (!even || !vm_zeros)) || last >= 5);
+	} else {
+		if (vp / 100 > vm / 100) {
+			roundup = vr % 100 >= 50;
+			vr /= 100;
+			vp /= 100;
+			vm /= 100;
+			removed += 2;
+		}
+		while (vp / 10 > vm / 10) {
+			roundup = vr % 10 >= 5;
+			vr /= 10;
+			vp /= 10;
+			vm /= 10;
+			removed++;
+		}
+		output = vr + (vr == vm || roundup);
+	}
+	*e10 += removed;
+	return output;
+}
+
+/*
+ * round(v * 10^s) for v = m * 2^e, m having its top bit set, ties to even.
+ * Fails when v * 10^s is below one or does not fit in 60 bits, or when it is
+ * too close to a tie to be told apart.
+ */
+static int
+scale_round(uint64_t m, int e, int s, uint64_t *r)
+{
+	uint64_t p[3], mask, half, frac;
+	int b, exact, up;
+
+	if (s < POW5_128_MIN || s > POW5_128_MAX)
+		return 0;
+	pow5_128_mul(m, s, p);
+
+	/*
+	 * v * 10^s is p * 2^(e + s + log2(5^s) - 127). Keep its integer part in
+	 * the top word, and at least 3 bits of the fraction with it.
+	 */
+	b = 127 - e - s - pow5_128_log2(s) - 128;
+	if (b < 4 || b > 63)
+		return 0;
+	mask = (1ULL << b) - 1;
+	half = 1ULL << (b - 1);
+	frac = p[0] & mask;
+
+	/*
+	 * An inexact p is below the exact product by less than m < 2^64: only
+	 * a fraction just below one half cannot be rounded with certainty.
+	 */
+	exact = s >= 0 && s <= POW5_128_EXACT_MAX;
+	if (frac > half)
+		up = 1;
+	else if (frac == half)
+		up = !exact || p[1] || p[2] || (p[0] >> b) & 1;
+	else if (frac < half - 1 || exact || p[1] != UINT64_MAX)
+		up = 0;
+	else
+		return 0;
+	*r = (p[0] >> b) + up;
+	return 1;
+}
+
+/* Digits of v * 10^e10, suppressing trailing zeros as dtoa() does. */
+static char *
+digits(uint64_t v, int e10, int *decpt, char **rve)
+{
+	char *s, *t;
+	int len;
+
+	while (v % 10 == 0) {
+		v /= 10;
+		e10++;
+	}
+	for (len = 1; len < 19 && v >= pow10_64[len]; len++)
+		continue;
+	*decpt = len + e10;
+	s = rv_alloc(len);
+	t = s + len;
+	*t = 0;
+	if (rve)
+		*rve = t;
+	do {
+		*--t = '0' + (char)(v % 10);
+		v /= 10;
+	} while (v);
+	return s;
+}
+
+ char *
+fast_dtoa(double d, int mode, int ndigits, int *decpt, char **rve)
+{
+	uint64_t bits, frac, m, r;
+	int bexp, e, lz, n, s;
+
+	memcpy(&bits, &d, sizeof(bits));
+	frac = bits & ((1ULL << DBL_MANT_BITS) - 1);
+	bexp = (int)(bits >> DBL_MANT_BITS) & 0x7ff;
+
+	switch (mode) {
+	case 0:
+		r = shortest(frac, bexp, &e);
+		return digits(r, e, decpt, rve);
+	case 2:
+	case 3:
+		break;
+	default:
+		return NULL;
+	}
+
+	/* d = m * 2^e, with m normalized */
+	if (bexp == 0) {
+		m = frac;
+		e = 1 - DBL_EXP_BIAS - DBL_MANT_BITS;
+	} else {
+		m = 1ULL << DBL_MANT_BITS | frac;
+		e = bexp - DBL_EXP_BIAS - DBL_MANT_BITS;
+	}
+	lz = __builtin_clzll(m);
+	m <<= lz;
+	e -= lz;
+
+	if (mode == 3) {
+		/* ndigits past the decimal point */
+		if (ndigits < 0 || !scale_round(m, e, ndigits, &r) || r == 0)
+			return NULL;
+		return digits(r, -ndigits, decpt, rve);
+	}
+
+	/*
+	 * max(1, ndigits) significant digits. 10^k <= d < 10^(k + 2) for
+	 * k = floor(log10(2^(e + 63))), try the lower decimal exponent first.
+	 */
+	n = ndigits < 1 ? 1 : ndigits;
+	if (n > 17)
+		return NULL;
+	s = n - 1 - log10pow2(e + 63);
+	if (!scale_round(m, e, s, &r))
+		return NULL;
+	if (r >= pow10_64[n] && !scale_round(m, e, --s, &r))
+		return NULL;
+	return digits(r, -s, decpt, rve);
+}
+
+#else /* !__SIZEOF_INT128__ */
+
+ char *
+fast_dtoa(double d, int mode, int ndigits, int *decpt, char **rve)
+{
+	return NULL;
+}
+
+#endif /* __SIZEOF_INT128__ */
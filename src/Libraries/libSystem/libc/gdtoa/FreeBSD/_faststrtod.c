@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * Fast path of strtod() in round-to-nearest mode, for the decimal numbers
+ * that the floating point arithmetic at its start cannot convert exactly.
+ *
+ * This is the algorithm of Michael Eisel and Daniel Lemire ("Number Parsing
+ * at a Gigabyte per Second", Software: Practice and Experience 51(8), 2021):
+ * the first 19 significant digits are multiplied by a 128-bit approximation
+ * of the power of ten, and the top of the product is rounded to a double.
+ * The approximation is close enough to settle the rounding of all but about
+ * one in 2^64 inputs, and exact ties are only possible with exact powers.
+ * It gives up on those, on results that would be subnormal or overflow, and
+ * on longer inputs whose remaining digits could change the result; the big
+ * integer code in strtod() then runs as before.
+ */
+
+#include <string.h>
+
+#include "gdtoaimp.h"
+#include "_pow5_128.h"
+
+#ifdef __SIZEOF_INT128__
+
+#define	DBL_MANT_BITS	52
+#define	DBL_MAX_BEXP	2046
+
+/* w * 10^q as the bits of a normal double, or 0 if in doubt */
+static uint64_t
+eisel_lemire(uint64_t w, int q)
+{
+	uint64_t p[3], m, low;
+	int lz, top, bexp, exact, up;
+
+	if (q < POW5_128_MIN || q > POW5_128_MAX)
+		return 0;
+	lz = __builtin_clzll(w);
+	pow5_128_mul(w << lz, q, p);
+
+	/*
+	 * w * 10^q is p * 2^(q + log2(5^q) - 127 - lz), p being at least
+	 * 2^190. Its top 54 bits are the mantissa and the rounding bit.
+	 */
+	top = (int)(p[0] >> 63);
+	m = p[0] >> (9 + top);
+	low = p[0] & ((1ULL << (9 + top)) - 1);
+	bexp = q + pow5_128_log2(q) - lz + 1086 + top;
+
+	/*
+	 * An inexact p is below the exact product by less than 2^64, which
+	 * can only matter when carrying into the rounding bit.
+	 */
+	exact = q >= 0 && q <= POW5_128_EXACT_MAX;
+	if ((m & 1) == 0) {
+		if (!exact && low == (1ULL << (9 + top)) - 1 && p[1] == UINT64_MAX)
+			return 0;
+		up = 0;
+	} else {
+		/* ties go to even */
+		up = !exact || low || p[1] || p[2] || (m & 2);
+	}
+	m = (m >> 1) + up;
+	if (m == 1ULL << (DBL_MANT_BITS + 1)) {
+		m >>= 1;
+		bexp++;
+	}
+	if (bexp < 1 || bexp > DBL_MAX_BEXP)
+		return 0;
+	return (uint64_t)bexp << DBL_MANT_BITS | (m & ((1ULL << DBL_MANT_BITS) - 1));
+}
+
+/*
+ * The nd significant digits at s0, the first nd0 of which are followed by a
+ * decimal point dplen characters long, times 10^e.
+ */
+ int
+fast_strtod(CONST char *s0, int nd, int nd0, int dplen, int e, U *rv)
+{
+	CONST char *s;
+	uint64_t w, bits;
+	int i, n;
+
+	n = nd < 19 ? nd : 19;
+	for (w = 0, s = s0, i = 0; i < n; i++, s++) {
+		if (i == nd0)
+			s += dplen;
+		w = 10 * w + (uint64_t)(*s - '0');
+	}
+	e += nd - n;
+	if ((bits = eisel_lemire(w, e)) == 0)
+		return 0;
+
+	/* the digits left out do not matter if w + 1 gives the same double */
+	if (n < nd && eisel_lemire(w + 1, e) != bits)
+		return 0;
+	memcpy(&dval(rv), &bits, sizeof(bits));
+	return 1;
+}
+
+#else /* !__SIZEOF_INT128__ */
+
+ int
+fast_strtod(CONST char *s0, int nd, int nd0, int dplen, int e, U *rv)
+{
+	return 0;
+}
+
+#endif /* __SIZEOF_INT128__ */
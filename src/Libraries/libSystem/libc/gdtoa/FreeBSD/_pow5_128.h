@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+#ifndef _POW5_128_H_
+#define _POW5_128_H_
+
+/*
+ * 128-bit approximations of the powers of five, shared by the fast paths of
+ * dtoa() and strtod(). They need 64x64->128 bit multiplications, so these
+ * fast paths only exist where the compiler has __int128.
+ *
+ * pow5_128[q - POW5_128_MIN] holds the high and low words of
+ *
+ *	floor(5^q * 2^(127 - pow5_128_log2(q)))
+ *
+ * a number in [2^127, 2^128). Entries are exact for
+ * 0 <= q <= POW5_128_EXACT_MAX, and less than one unit too small otherwise.
+ */
+
+#include <stdint.h>
+
+#ifdef __SIZEOF_INT128__
+
+#define	POW5_128_MIN		(-342)
+#define	POW5_128_MAX		325
+#define	POW5_128_EXACT_MAX	55
+
+#define	pow5_128	__pow5_128_D2A
+
+__private_extern__ extern const uint64_t
+pow5_128[POW5_128_MAX - POW5_128_MIN + 1][2];
+
+/* floor(log2(5^q)), exact for POW5_128_MIN <= q <= POW5_128_MAX */
+static inline int
+pow5_128_log2(int q)
+{
+	return (q * 1217359) >> 19;
+}
+
+/*
+ * The 192-bit product of x by the entry for 5^q, high word first. As the
+ * entry is at most one unit too small, the exact product of x by 5^q scaled
+ * the same way is less than x above it.
+ */
+static inline void
+pow5_128_mul(uint64_t x, int q, uint64_t r[3])
+{
+	const uint64_t *p = pow5_128[q - POW5_128_MIN];
+	unsigned __int128 hi = (unsigned __int128)x * p[0];
+	unsigned __int128 lo = (unsigned __int128)x * p[1];
+
+	hi += (uint64_t)(lo >> 64);
+	r[0] = (uint64_t)(hi >> 64);
+	r[1] = (uint64_t)hi;
+	r[2] = (uint64_t)lo;
+}
+
+#endif /* __SIZEOF_INT128__ */
+#endif /* _POW5_128_H_ */
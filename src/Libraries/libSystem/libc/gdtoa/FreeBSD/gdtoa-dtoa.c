@@ -182,6 +182,11 @@ dtoa
 		*decpt = 1;
 		return nrv_alloc("0", rve, 1);
 		}
+#ifdef __APPLE__
+	if (Rounding == 1
+	 && (s = fast_dtoa(dval(&d), mode, ndigits, decpt, rve)) != NULL)
+		return s;
+#endif /* __APPLE__ */
 
 #ifdef SET_INEXACT
 	try_quick = oldinexact = get_inexact();
@@ -406,6 +406,10 @@ strtod_l
 			}
 #endif
 		}
+#ifdef __APPLE__
+	if (Rounding == 1 && fast_strtod(s0, nd, nd0, dplen, e, &rv))
+		goto ret;
+#endif /* __APPLE__ */
 	e1 += nd - k;
 
 #ifdef IEEE_Arith
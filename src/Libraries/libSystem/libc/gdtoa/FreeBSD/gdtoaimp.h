@@ -224,6 +224,8 @@ THIS SOFTWARE.
 #define	decrement	__decrement_D2A
 #define	diff		__diff_D2A
 #define	dtoa_result	__dtoa_result_D2A
+#define	fast_dtoa	__fast_dtoa_D2A
+#define	fast_strtod	__fast_strtod_D2A
 #define	g__fmt		__g__fmt_D2A
 #define	gethex		__gethex_D2A
 #define	hexdig		__hexdig_D2A
@@ -589,6 +591,8 @@ extern void memcpy_D2A ANSI((void*, const void*, size_t));
  extern Bigint *diff ANSI((Bigint*, Bigint*));
  extern char *dtoa ANSI((double d, int mode, int ndigits,
 			int *decpt, int *sign, char **rve));
+ extern char *fast_dtoa ANSI((double, int, int, int*, char**));
+ extern int fast_strtod ANSI((CONST char*, int, int, int, int, U*));
  extern char *g__fmt ANSI((char*, char*, char*, int, ULong, size_t));
  extern int gethex ANSI((CONST char**, CONST FPI*, Long*, Bigint**, int, locale_t));
  extern void hexdig_init_D2A(Void);
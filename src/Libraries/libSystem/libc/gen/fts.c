@@ -70,6 +70,8 @@
 #ifdef __BLOCKS__
 #include <Block.h>
 #endif /* __BLOCKS__ */
+#include <dispatch/dispatch.h>
+#include <pthread/qos.h>
 #include <malloc_private.h>
 
 #pragma clang diagnostic push
@@ -77,7 +79,7 @@
 
 static FTSENT	*fts_alloc(FTS *, char *, ssize_t);
 static FTSENT	*fts_build(FTS *, int);
-static void	 fts_lfree(FTSENT *);
+static void	 fts_lfree(FTS *, FTSENT *);
 static void	 fts_load(FTS *, FTSENT *);
 static size_t	 fts_maxarglen(char * const *);
 static void	 fts_padjust(FTS *, FTSENT *);
@@ -86,6 +88,8 @@ static FTSENT	*fts_sort(FTS *, FTSENT *, int);
 static u_short	 fts_stat(FTS *, FTSENT *, int, int);
 static u_short   fts_stat2(FTS *, FTSENT *, int, int, struct stat *);
 static int	 fts_safe_changedir(FTS *, FTSENT *, int, char *);
+static void	 readahead_abandon(FTS *, FTSENT *);
+static void	 readahead_stop(FTS *);
 
 #define	ISDOT(a)	(a[0] == '.' && (!a[1] || (a[1] == '.' && !a[2])))
 
@@ -100,6 +104,20 @@ static int	 fts_safe_changedir(FTS *, FTSENT *, int, char *);
 #define	BNAMES		2		/* fts_children, names only */
 #define	BREAD		3		/* fts_read */
 
+/* (private) fts_flags of a directory being read ahead, see readahead_start */
+#define	FTS_READAHEAD	0x10
+
+/*
+ * The stream, followed by the FTS_PARALLEL state that has no room in the
+ * public FTS.
+ */
+struct fts_private {
+	FTS fts;
+	struct fts_readahead *ra_jobs;	/* started and not yet taken */
+	int ra_count;			/* length of ra_jobs */
+};
+#define	PRIV(sp)	((struct fts_private *)(sp))
+
 /* 5653270
  * For directories containing > 64k subdirectories (or HFS+ with > 64k files
  * and subdirectories), struct stat's st_nlink (16 bits) will overflow.  This
@@ -146,8 +164,11 @@ __fts_open(char * const *argv, FTS *sp)
 	FTSENT *parent, *tmp;
 	ssize_t len;
 
-	/* Logical walks turn on NOCHDIR; symbolic links are too hard. */
-	if (ISSET(FTS_LOGICAL))
+	/*
+	 * Logical walks turn on NOCHDIR; symbolic links are too hard.  So do
+	 * parallel ones, which read directories on other threads.
+	 */
+	if (ISSET(FTS_LOGICAL) || ISSET(FTS_PARALLEL))
 		SET(FTS_NOCHDIR);
 
 	/*
@@ -222,7 +243,7 @@ __fts_open(char * const *argv, FTS *sp)
 
 	return (sp);
 
-mem3:	fts_lfree(root);
+mem3:	fts_lfree(sp, root);
 	free(parent);
 mem2:	free(sp->fts_path);
 mem1:	free(sp);
@@ -242,7 +263,7 @@ fts_open(char * const *argv, int options, int (*compar)())
 	if (options & FTS_NOSTAT_TYPE) options |= FTS_NOSTAT;
 
 	/* Allocate/initialize the stream */
-	if ((sp = calloc(1, sizeof(FTS))) == NULL)
+	if ((sp = calloc(1, sizeof(struct fts_private))) == NULL)
 		return (NULL);
 	sp->fts_compar = compar;
 	sp->fts_options = options;
@@ -264,7 +285,7 @@ fts_open_b(char * const *argv, int options, int (^compar)(const FTSENT **, const
 	if (options & FTS_NOSTAT_TYPE) options |= FTS_NOSTAT;
 
 	/* Allocate/initialize the stream */
-	if ((sp = calloc(1, sizeof(FTS))) == NULL)
+	if ((sp = calloc(1, sizeof(struct fts_private))) == NULL)
 		return (NULL);
 	sp->fts_compar_b = (int (^)())Block_copy(compar);
 	sp->fts_options = options | FTS_BLOCK_COMPAR;
@@ -303,6 +324,9 @@ fts_close(FTS *sp)
 	FTSENT *freep, *p;
 	int rfd, error = 0;
 
+	/* Wait for the directories still being read ahead. */
+	readahead_stop(sp);
+
 	/*
 	 * This still works if we haven't read anything -- the dummy structure
 	 * points to the root list, so we step through to the end of the root
@@ -322,7 +346,7 @@ fts_close(FTS *sp)
 
 	/* Free up child linked list, sort array, path buffer, stream ptr.*/
 	if (sp->fts_child){
-		fts_lfree(sp->fts_child);
+		fts_lfree(sp, sp->fts_child);
 	}
 	free(sp->fts_array); sp->fts_array = NULL;
 	free(sp->fts_path); sp->fts_path = NULL;
@@ -414,8 +438,10 @@ fts_read(FTS *sp)
 		    (ISSET(FTS_XDEV) && p->fts_dev != sp->fts_dev)) {
 			if (p->fts_flags & FTS_SYMFOLLOW)
 				(void)close(p->fts_symfd);
+			if (p->fts_flags & FTS_READAHEAD)
+				readahead_abandon(sp, p);
 			if (sp->fts_child) {
-				fts_lfree(sp->fts_child);
+				fts_lfree(sp, sp->fts_child);
 				sp->fts_child = NULL;
 			}
 			p->fts_info = FTS_DP;
@@ -425,7 +451,7 @@ fts_read(FTS *sp)
 		/* Rebuild if only read the names and now traversing. */
 		if (sp->fts_child && ISSET(FTS_NAMEONLY)) {
 			CLR(FTS_NAMEONLY);
-			fts_lfree(sp->fts_child);
+			fts_lfree(sp, sp->fts_child);
 			sp->fts_child = NULL;
 		}
 
@@ -483,6 +509,8 @@ next:	tmp = p;
 		 * get back if necessary.
 		 */
 		if (p->fts_instr == FTS_SKIP) {
+			if (p->fts_flags & FTS_READAHEAD)
+				readahead_abandon(sp, p);
 			goto next;
 		}
 		if (p->fts_instr == FTS_FOLLOW) {
@@ -610,7 +638,7 @@ fts_children(FTS *sp, int instr)
 
 	/* Free up any previous child list. */
 	if (sp->fts_child)
-		fts_lfree(sp->fts_child);
+		fts_lfree(sp, sp->fts_child);
 
 	if (instr == FTS_NAMEONLY) {
 		SET(FTS_NAMEONLY);
@@ -738,12 +766,12 @@ error: {
 }
 
 static bool
-open_directory(FTS *sp, dir_handle *handle, const char *path)
+open_directory(dir_handle *handle, const char *path, int options)
 {
 	memset(handle, 0, sizeof(*handle));
 
-	handle->nostat = ISSET(FTS_NOSTAT);
-	handle->needs_dot = handle->needs_dotdot = ISSET(FTS_SEEDOT);
+	handle->nostat = (options & FTS_NOSTAT) != 0;
+	handle->needs_dot = handle->needs_dotdot = (options & FTS_SEEDOT) != 0;
 
 	handle->dirfd = open(path, O_RDONLY | O_NONBLOCK | O_DIRECTORY | O_CLOEXEC);
 	if (handle->dirfd == -1) goto fallback;
@@ -978,6 +1006,296 @@ close_directory(dir_handle *handle)
 	handle->attrbuf = NULL;
 }
 
+/* How fts_build stats the entries of a directory */
+static int
+fts_dostat(FTS *sp, int type)
+{
+	if (type == BNAMES)
+		return (F_NOSTAT);
+	else if (ISSET(FTS_NOSTAT_TYPE))
+		return (ISSET(FTS_PHYSICAL) ? F_D_TYPE : F_D_TYPESYM);
+	else if (ISSET(FTS_NOSTAT))
+		return (ISSET(FTS_PHYSICAL) ? F_STATDIR : F_STATDIRSYM);
+	else
+		return (F_ALWAYSSTAT);
+}
+
+/*
+ * FTS_PARALLEL: reading directories ahead of the walk.
+ *
+ * The walk itself stays on the caller's thread and returns the same nodes in
+ * the same order as without FTS_PARALLEL; what moves to other threads is the
+ * reading of the directories it is about to enter.  Whenever fts_build has
+ * listed a directory, it starts jobs on a global dispatch queue for the
+ * subdirectories in it, and for the directories that follow it in its parent,
+ * up to READAHEAD_MAX jobs at a time.  A job opens its directory by path,
+ * reads it with getattrlistbulk and stats the entries that fts_build would
+ * stat.  When fts_build gets to the directory, it takes the entries from the
+ * job, after waiting for it if need be, instead of reading the directory.
+ *
+ * Jobs for directories that the walk skips are abandoned: they still run to
+ * the end, and are freed once they have.  A job that fails in any way, be it
+ * to open the directory or to allocate memory, is dropped, and fts_build reads
+ * the directory as usual, so errors are reported as they would be without
+ * FTS_PARALLEL.  Entries the job could not stat are stat'ed again the same
+ * way.
+ */
+#define	READAHEAD_MAX	64	/* jobs started and not taken */
+#define	READAHEAD_SCAN	256	/* entries looked at for directories to start */
+
+struct fts_readahead_entry {
+	struct stat sb;
+	size_t nameoff;			/* into ra_names */
+	size_t namlen;
+	int d_type;
+	bool stat_valid;
+};
+
+struct fts_readahead {
+	struct fts_readahead *ra_next;
+	FTSENT *ra_owner;		/* NULL once abandoned */
+	dev_t ra_dev;			/* of the owner, to check it is the same */
+	ino_t ra_ino;
+	int ra_options;
+	int ra_dostat;
+	dispatch_semaphore_t ra_done;
+
+	/* Set by the job */
+	bool ra_ok;			/* read the whole directory */
+	struct fts_readahead_entry *ra_entries;
+	size_t ra_nentries;
+	size_t ra_size;			/* of ra_entries */
+	char *ra_names;
+	size_t ra_nameslen;
+	size_t ra_namessize;
+
+	size_t ra_cur;			/* next entry for fts_build */
+	char ra_path[];
+};
+
+/* Whether fts_build stats an entry of type d_type; see the switch there. */
+static bool
+readahead_needs_stat(int dostat, int d_type)
+{
+	switch (dostat) {
+	case F_ALWAYSSTAT:
+		return (true);
+	case F_STATDIRSYM:
+	case F_D_TYPESYM:
+		if (d_type == DT_LNK)
+			return (true);
+		/* FALLTHROUGH */
+	case F_STATDIR:
+	case F_D_TYPE:
+		return (d_type == DT_DIR || d_type == DT_UNKNOWN);
+	default:
+		return (false);
+	}
+}
+
+static void
+readahead_work(void *ctx)
+{
+	struct fts_readahead *ra = ctx;
+	struct fts_readahead_entry *e;
+	bool logical = (ra->ra_options & FTS_LOGICAL) != 0;
+	dir_handle dirp;
+	dir_entry de;
+	void *p;
+
+	if (!open_directory(&dirp, ra->ra_path, ra->ra_options))
+		goto done;
+	while (read_dirent(&dirp, &de)) {
+		if (!(ra->ra_options & FTS_SEEDOT) && ISDOT(de.d_name))
+			continue;
+		if (ra->ra_nentries == ra->ra_size) {
+			ra->ra_size = ra->ra_size ? 2 * ra->ra_size : 64;
+			if ((p = reallocarray(ra->ra_entries, ra->ra_size,
+			    sizeof(*e))) == NULL)
+				goto fail;
+			ra->ra_entries = p;
+		}
+		if (ra->ra_namessize - ra->ra_nameslen <= de.d_namlen) {
+			ra->ra_namessize = MAX(2 * ra->ra_namessize,
+			    ra->ra_nameslen + de.d_namlen + 1024);
+			if ((p = realloc(ra->ra_names, ra->ra_namessize)) == NULL)
+				goto fail;
+			ra->ra_names = p;
+		}
+
+		/*
+		 * getattrlistbulk describes symbolic links themselves, which
+		 * logical walks need to follow.
+		 */
+		if (readahead_needs_stat(ra->ra_dostat, de.d_type) &&
+		    (!de.stat_valid || (logical && S_ISLNK(de.sb.st_mode))))
+			de.stat_valid = fstatat(dir_fd(&dirp), de.d_name, &de.sb,
+			    logical ? 0 : AT_SYMLINK_NOFOLLOW) == 0;
+
+		e = &ra->ra_entries[ra->ra_nentries++];
+		e->nameoff = ra->ra_nameslen;
+		e->namlen = de.d_namlen;
+		e->d_type = de.d_type;
+		e->stat_valid = de.stat_valid;
+		if (de.stat_valid)
+			e->sb = de.sb;
+		memcpy(ra->ra_names + ra->ra_nameslen, de.d_name, de.d_namlen);
+		ra->ra_names[ra->ra_nameslen + de.d_namlen] = '\0';
+		ra->ra_nameslen += de.d_namlen + 1;
+	}
+	ra->ra_ok = true;
+fail:
+	close_directory(&dirp);
+done:
+	dispatch_semaphore_signal(ra->ra_done);
+}
+
+static void
+readahead_free(struct fts_readahead *ra)
+{
+	dispatch_release(ra->ra_done);
+	free(ra->ra_entries);
+	free(ra->ra_names);
+	free(ra);
+}
+
+/* Free the abandoned jobs that are done. */
+static void
+readahead_reap(FTS *sp)
+{
+	struct fts_readahead **rap, *ra;
+
+	for (rap = &PRIV(sp)->ra_jobs; (ra = *rap) != NULL;) {
+		if (ra->ra_owner == NULL &&
+		    dispatch_semaphore_wait(ra->ra_done, DISPATCH_TIME_NOW) == 0) {
+			*rap = ra->ra_next;
+			PRIV(sp)->ra_count--;
+			readahead_free(ra);
+		} else
+			rap = &ra->ra_next;
+	}
+}
+
+/*
+ * Start reading the directories among the first READAHEAD_SCAN entries of
+ * the list at p.  Their paths are built from the one of their parent, which
+ * has to be in sp->fts_path.
+ */
+static void
+readahead_start(FTS *sp, FTSENT *p)
+{
+	struct fts_readahead *ra;
+	size_t len;
+	int n;
+
+	for (n = 0; p != NULL && n < READAHEAD_SCAN; p = p->fts_link, n++) {
+		if (p->fts_info != FTS_D || p->fts_level <= FTS_ROOTLEVEL ||
+		    (p->fts_flags & FTS_READAHEAD) || p->fts_instr == FTS_SKIP ||
+		    (ISSET(FTS_XDEV) && p->fts_dev != sp->fts_dev))
+			continue;
+		if (PRIV(sp)->ra_count >= READAHEAD_MAX) {
+			readahead_reap(sp);
+			if (PRIV(sp)->ra_count >= READAHEAD_MAX)
+				return;
+		}
+
+		/* The parent's path, a slash and the name. */
+		len = p->fts_pathlen - p->fts_namelen;
+		if ((ra = calloc(1, sizeof(*ra) + p->fts_pathlen + 1)) == NULL)
+			return;
+		if ((ra->ra_done = dispatch_semaphore_create(0)) == NULL) {
+			free(ra);
+			return;
+		}
+		memcpy(ra->ra_path, sp->fts_path, len - 1);
+		ra->ra_path[len - 1] = '/';
+		memcpy(ra->ra_path + len, p->fts_name, p->fts_namelen + 1);
+		ra->ra_owner = p;
+		ra->ra_dev = p->fts_dev;
+		ra->ra_ino = p->fts_ino;
+		ra->ra_options = sp->fts_options;
+		ra->ra_dostat = fts_dostat(sp, BREAD);
+
+		ra->ra_next = PRIV(sp)->ra_jobs;
+		PRIV(sp)->ra_jobs = ra;
+		PRIV(sp)->ra_count++;
+		p->fts_flags |= FTS_READAHEAD;
+		dispatch_async_f(dispatch_get_global_queue(qos_class_self(), 0),
+		    ra, readahead_work);
+	}
+}
+
+/*
+ * The job reading p, once it is done, or NULL if there is none or it could
+ * not read the directory.
+ */
+static struct fts_readahead *
+readahead_take(FTS *sp, FTSENT *p)
+{
+	struct fts_readahead **rap, *ra;
+
+	p->fts_flags &= ~FTS_READAHEAD;
+	for (rap = &PRIV(sp)->ra_jobs; (ra = *rap) != NULL; rap = &ra->ra_next)
+		if (ra->ra_owner == p)
+			break;
+	if (ra == NULL)
+		return (NULL);
+	*rap = ra->ra_next;
+	PRIV(sp)->ra_count--;
+
+	dispatch_semaphore_wait(ra->ra_done, DISPATCH_TIME_FOREVER);
+	if (!ra->ra_ok || ra->ra_dev != p->fts_dev || ra->ra_ino != p->fts_ino) {
+		readahead_free(ra);
+		return (NULL);
+	}
+	return (ra);
+}
+
+static bool
+readahead_next(struct fts_readahead *ra, dir_entry *entry)
+{
+	struct fts_readahead_entry *e;
+
+	if (ra->ra_cur == ra->ra_nentries)
+		return (false);
+	e = &ra->ra_entries[ra->ra_cur++];
+	entry->d_name = ra->ra_names + e->nameoff;
+	entry->d_namlen = e->namlen;
+	entry->d_type = e->d_type;
+	entry->stat_valid = e->stat_valid;
+	if (e->stat_valid)
+		entry->sb = e->sb;
+	return (true);
+}
+
+/* p is being skipped or freed: leave its job to finish on its own. */
+static void
+readahead_abandon(FTS *sp, FTSENT *p)
+{
+	struct fts_readahead *ra;
+
+	p->fts_flags &= ~FTS_READAHEAD;
+	for (ra = PRIV(sp)->ra_jobs; ra != NULL; ra = ra->ra_next)
+		if (ra->ra_owner == p) {
+			ra->ra_owner = NULL;
+			break;
+		}
+}
+
+/* Wait for all the jobs and free them. */
+static void
+readahead_stop(FTS *sp)
+{
+	struct fts_readahead *ra;
+
+	while ((ra = PRIV(sp)->ra_jobs) != NULL) {
+		PRIV(sp)->ra_jobs = ra->ra_next;
+		dispatch_semaphore_wait(ra->ra_done, DISPATCH_TIME_FOREVER);
+		readahead_free(ra);
+	}
+	PRIV(sp)->ra_count = 0;
+}
+
 /*
  * This is the tricky part -- do not casually change *anything* in here.  The
  * idea is to build the linked list of entries that are used by fts_children
@@ -997,6 +1315,7 @@ fts_build(FTS *sp, int type)
 	int nitems;
 	FTSENT *cur, *tail;
 	dir_handle dirp;
+	struct fts_readahead *ra;
 	void *oldaddr;
 	int len, maxlen;
 	int cderrno, descend, level, dostat, doadjust;
@@ -1007,10 +1326,16 @@ fts_build(FTS *sp, int type)
 	cur = sp->fts_cur;
 
 	/*
-	 * Open the directory for reading.  If this fails, we're done.
-	 * If being called from fts_read, set the fts_info field.
+	 * Take the entries read ahead by FTS_PARALLEL, if any, or open the
+	 * directory for reading.  If this fails, we're done.  If being called
+	 * from fts_read, set the fts_info field.
 	 */
-	if (!open_directory(sp, &dirp, cur->fts_accpath)) {
+	ra = NULL;
+	if ((cur->fts_flags & FTS_READAHEAD) &&
+	    (ra = readahead_take(sp, cur)) != NULL) {
+		memset(&dirp, 0, sizeof(dirp));
+		dirp.dirfd = -1;
+	} else if (!open_directory(&dirp, cur->fts_accpath, sp->fts_options)) {
 		if (type == BREAD) {
 			cur->fts_info = FTS_DNR;
 			cur->fts_errno = errno;
@@ -1018,14 +1343,7 @@ fts_build(FTS *sp, int type)
 		return (NULL);
 	}
 
-	if (type == BNAMES)
-		dostat = F_NOSTAT;
-	else if (ISSET(FTS_NOSTAT_TYPE))
-		dostat = ISSET(FTS_PHYSICAL) ? F_D_TYPE : F_D_TYPESYM;
-	else if (ISSET(FTS_NOSTAT))
-		dostat = ISSET(FTS_PHYSICAL) ? F_STATDIR : F_STATDIRSYM;
-	else
-		dostat = F_ALWAYSSTAT;
+	dostat = fts_dostat(sp, type);
 
 #ifdef notdef
 	(void)printf("dostat == %d\n", dostat);
@@ -1092,7 +1410,8 @@ fts_build(FTS *sp, int type)
 
 	/* Read the directory, attaching each entry to the `link' pointer. */
 	doadjust = 0;
-	for (head = tail = NULL, nitems = 0; read_dirent(&dirp, dp) ; ) {
+	for (head = tail = NULL, nitems = 0;
+	    ra ? readahead_next(ra, dp) : read_dirent(&dirp, dp); ) {
 		if (!ISSET(FTS_SEEDOT) && ISDOT(dp->d_name))
 			continue;
 
@@ -1108,8 +1427,10 @@ fts_build(FTS *sp, int type)
 				 */
 mem1:				saved_errno = errno;
 				free(p);
-				fts_lfree(head);
+				fts_lfree(sp, head);
 				close_directory(&dirp);
+				if (ra)
+					readahead_free(ra);
 				cur->fts_info = FTS_ERR;
 				SET(FTS_STOP);
 				errno = saved_errno;
@@ -1132,8 +1453,10 @@ mem1:				saved_errno = errno;
 			 * allocated, then error out with ENAMETOOLONG.
 			 */
 			free(p);
-			fts_lfree(head);
+			fts_lfree(sp, head);
 			close_directory(&dirp);
+			if (ra)
+				readahead_free(ra);
 			cur->fts_info = FTS_ERR;
 			SET(FTS_STOP);
 			errno = ENAMETOOLONG;
@@ -1228,6 +1551,8 @@ common_no_stat:
 		++nitems;
 	}
 	close_directory(&dirp);
+	if (ra)
+		readahead_free(ra);
 
 	/*
 	 * If realloc() changed the address of the path, adjust the
@@ -1265,12 +1590,23 @@ common_no_stat:
 	if (!nitems) {
 		if (type == BREAD)
 			cur->fts_info = FTS_DP;
+		if (ISSET(FTS_PARALLEL))
+			readahead_start(sp, cur->fts_link);
 		return (NULL);
 	}
 
 	/* Sort the entries. */
 	if (sp->fts_compar && nitems > 1)
 		head = fts_sort(sp, head, nitems);
+
+	/*
+	 * Read ahead the subdirectories, which come next in the walk, and
+	 * the directories after this one.
+	 */
+	if (ISSET(FTS_PARALLEL)) {
+		readahead_start(sp, head);
+		readahead_start(sp, cur->fts_link);
+	}
 	return (head);
 }
 
@@ -1452,13 +1788,15 @@ fts_alloc(FTS *sp, char *name, ssize_t namelen)
 }
 
 static void
-fts_lfree(FTSENT *head)
+fts_lfree(FTS *sp, FTSENT *head)
 {
 	FTSENT *p;
 
 	/* Free a linked list of structures. */
 	while ((p = head)) {
 		head = head->fts_link;
+		if (p->fts_flags & FTS_READAHEAD)
+			readahead_abandon(sp, p);
 		free(p);
 	}
 }
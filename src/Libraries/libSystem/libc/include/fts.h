@@ -99,7 +99,8 @@ typedef struct {
 #define	FTS_OPTIONMASK	0x4ff		/* valid user option mask */
 #else
 #define	FTS_NOSTAT_TYPE	0x800		/* (non-std) no stat, but use d_type in struct dirent when available */
-#define	FTS_OPTIONMASK	0xcff		/* valid user option mask */
+#define	FTS_PARALLEL	0x1000		/* (non-std) read directories ahead on other threads */
+#define	FTS_OPTIONMASK	0x1cff		/* valid user option mask */
 #endif
 
 #define	FTS_NAMEONLY	0x100		/* (private) child names only */
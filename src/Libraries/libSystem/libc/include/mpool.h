@@ -41,10 +41,14 @@
 
 /*
  * The memory pool scheme is a simple one.  Each in-memory page is referenced
- * by a bucket which is threaded in up to two of three ways.  All active pages
- * are threaded on a hash chain (hashed by page number) and an lru chain.
- * Inactive pages are threaded on a free chain.  Each reference to a memory
- * pool is handed an opaque MPOOL cookie which stores all of this information.
+ * by a bucket which is threaded in two ways.  All active pages are threaded
+ * on a hash chain (hashed by page number) and on a clock queue, which a clock
+ * hand sweeps to find the next page to evict: pages referenced since its last
+ * pass get a second chance.  Each reference to a memory pool is handed an
+ * opaque MPOOL cookie which stores all of this information.
+ *
+ * A pool on a read-only file may map the file instead (see mpool_mmap()), in
+ * which case pages are handed out from the mapping and no buckets are used.
  */
 #define	HASHSIZE	128
 #define	HASHKEY(pgno)	((pgno - 1) % HASHSIZE)
@@ -52,17 +56,18 @@
 /* The BKT structures are the elements of the queues. */
 typedef struct _bkt {
 	TAILQ_ENTRY(_bkt) hq;		/* hash queue */
-	TAILQ_ENTRY(_bkt) q;		/* lru queue */
+	TAILQ_ENTRY(_bkt) q;		/* clock queue */
 	void    *page;			/* page */
 	pgno_t   pgno;			/* page number */
 
 #define	MPOOL_DIRTY	0x01		/* page needs to be written */
 #define	MPOOL_PINNED	0x02		/* page is pinned into memory */
+#define	MPOOL_REFERENCED 0x04		/* page was used since the last sweep */
 	u_int8_t flags;			/* flags */
 } BKT;
 
 typedef struct MPOOL {
-	TAILQ_HEAD(_lqh, _bkt) lqh;	/* lru queue head */
+	TAILQ_HEAD(_lqh, _bkt) lqh;	/* clock queue head */
 					/* hash queue array */
 	TAILQ_HEAD(_hqh, _bkt) hqh[HASHSIZE];
 	pgno_t	curcache;		/* current number of cached pages */
@@ -90,6 +95,7 @@ typedef struct MPOOL {
 
 __BEGIN_DECLS
 MPOOL	*mpool_open(void *, int, pgno_t, pgno_t);
+int	 mpool_mmap(MPOOL *);
 void	 mpool_filter(MPOOL *, void (*)(void *, pgno_t, void *),
 	    void (*)(void *, pgno_t, void *), void *);
 void	*mpool_new(MPOOL *, pgno_t *);
@@ -423,6 +423,17 @@ void	 psort_b(void *__base, size_t __nel, size_t __width,
 void	 psort_r(void *__base, size_t __nel, size_t __width, void *,
 	    int (* _Nonnull __compar)(void *, const void *, const void *))
 	    __OSX_AVAILABLE_STARTING(__MAC_10_6, __IPHONE_3_2);
+int	 psort_stable(void *__base, size_t __nel, size_t __width,
+	    int (* _Nonnull __compar)(const void *, const void *))
+	    __API_AVAILABLE(macos(10.16), ios(14.0), tvos(14.0), watchos(7.0));
+#ifdef __BLOCKS__
+int	 psort_stable_b(void *__base, size_t __nel, size_t __width,
+	    int (^ _Nonnull __compar)(const void *, const void *) __sort_noescape)
+	    __API_AVAILABLE(macos(10.16), ios(14.0), tvos(14.0), watchos(7.0));
+#endif /* __BLOCKS__ */
+int	 psort_stable_r(void *__base, size_t __nel, size_t __width, void *,
+	    int (* _Nonnull __compar)(void *, const void *, const void *))
+	    __API_AVAILABLE(macos(10.16), ios(14.0), tvos(14.0), watchos(7.0));
 #endif /* UNIFDEF_DRIVERKIT */
 #ifdef __BLOCKS__
 void	 qsort_b(void *__base, size_t __nel, size_t __width,
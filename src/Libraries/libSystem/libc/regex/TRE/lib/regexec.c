@@ -313,9 +313,24 @@ tre_match(const tre_tnfa_t *tnfa, const void *string, size_t len,
 #endif /* TRE_APPROX */
   else
     {
-      /* Exact matching, no back references, use the parallel matcher. */
-      status = tre_tnfa_run_parallel(tnfa, string + offset, (int)len, type,
-				     tags, eflags, &eo);
+      status = REG_ESPACE;
+      if (tnfa->dfa != NULL && (nmatch == 0 || (tnfa->cflags & REG_NOSUB))
+#ifdef TRE_STR_USER
+	  && type != STR_USER
+#endif /* TRE_STR_USER */
+	  )
+	{
+	  /* Only whether there is a match is needed, use the DFA matcher.
+	     It gives up with REG_ESPACE when its state cache is not
+	     effective, or is being used by another thread. */
+	  status = tre_tnfa_run_dfa(tnfa, string + offset, (int)len, type,
+				    eflags);
+	  eo = -1;
+	}
+      if (status == REG_ESPACE)
+	/* Exact matching, no back references, use the parallel matcher. */
+	status = tre_tnfa_run_parallel(tnfa, string + offset, (int)len, type,
+				       tags, eflags, &eo);
     }
 
   if (status == REG_OK)
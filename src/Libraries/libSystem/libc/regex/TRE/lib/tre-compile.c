@@ -3302,6 +3302,8 @@ tre_compile(regex_t *preg, const tre_char_t *regex, size_t n, int cflags,
   tnfa->final = transitions + offs[tree->lastpos[0].position];
   tnfa->num_states = parse_ctx.position;
   tnfa->cflags = cflags;
+  /* Without it, matching just falls back to the parallel matcher. */
+  tnfa->dfa = tre_dfa_new(tnfa);
 
   DPRINT(("final state %d (%p)\n", tree->lastpos[0].position,
 	  (void *)tnfa->final));
@@ -3411,6 +3413,9 @@ tre_free(regex_t *preg)
   if (tnfa->last_matched_branch)
     xfree(tnfa->last_matched_branch);
 
+  if (tnfa->dfa)
+    tre_dfa_free(tnfa->dfa);
+
   xfree(tnfa);
 }
 
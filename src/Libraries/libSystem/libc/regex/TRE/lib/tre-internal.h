@@ -292,6 +292,9 @@ struct tre_submatch_data {
 typedef struct tre_submatch_data tre_submatch_data_t;
 
 
+/* Lazily built DFA, see `tre-match-dfa.c'. */
+typedef struct tre_dfa tre_dfa_t;
+
 /* TNFA definition. */
 typedef struct tnfa tre_tnfa_t;
 
@@ -320,6 +323,7 @@ struct tnfa {
   int num_reorder_tags;
   int have_approx;
   int params_depth;
+  tre_dfa_t *dfa;
 };
 
 __private_extern__ int
@@ -343,6 +347,16 @@ tre_tnfa_run_backtrack(const tre_tnfa_t * __restrict tnfa, const void * __restri
 		       int len, tre_str_type_t type, tre_tag_t * __restrict match_tags,
 		       int eflags, int * __restrict match_end_ofs);
 
+__private_extern__ tre_dfa_t *
+tre_dfa_new(const tre_tnfa_t *tnfa);
+
+__private_extern__ void
+tre_dfa_free(tre_dfa_t *dfa);
+
+__private_extern__ reg_errcode_t
+tre_tnfa_run_dfa(const tre_tnfa_t * __restrict tnfa, const void * __restrict string, int len,
+		 tre_str_type_t type, int eflags);
+
 #ifdef TRE_APPROX
 __private_extern__ reg_errcode_t
 tre_tnfa_run_approx(const tre_tnfa_t * __restrict tnfa, const void * __restrict string, int len,
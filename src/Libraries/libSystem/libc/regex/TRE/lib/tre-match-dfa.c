@@ -0,0 +1,833 @@
+/*
+  tre-match-dfa.c - TRE lazy DFA matching engine
+
+  This software is released under a BSD-style license.
+  See the file LICENSE for details and copyright.
+
+*/
+
+/*
+  This engine only answers whether there is a match, which is all regexec()
+  needs to report when no submatches are asked for (nmatch == 0, or the
+  pattern was compiled with REG_NOSUB).  Since tags then do not matter, a
+  set of TNFA states is enough to describe where the parallel matcher is at
+  a given position, and the sets met while matching become the states of a
+  DFA, built the first time they are reached and cached in the TNFA for
+  later calls.  Matching then costs one table lookup per character, instead
+  of walking every transition of every reached TNFA state.
+
+  TNFA transitions have assertions (^, $, \<, \>, \b, \B) that depend on the
+  characters on both sides of the position the transition reaches.  A DFA
+  state is therefore the set of (state, assertions) pairs pending at a
+  position, along with what is known of the character before it; the
+  assertions are checked when reading the character after it, which also
+  leads to the next DFA state.
+
+  The cache is bounded.  When it is full it is emptied, and when this keeps
+  happening (for patterns like (a|b)*a(a|b){20}, whose DFA is exponentially
+  large) or when another thread is using the cache, the caller falls back to
+  the parallel matcher.
+
+  Whenever the DFA is back in its idle state, where no match is under way,
+  a literal prefix that every match must start with is looked for with
+  vector compares, instead of going through the text one character at a
+  time.
+
+  This algorithm cannot handle TNFAs with back referencing nodes.
+  See `tre-match-backtrack.c'.
+*/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_WCHAR_H
+#include <wchar.h>
+#endif /* HAVE_WCHAR_H */
+#ifdef HAVE_WCTYPE_H
+#include <wctype.h>
+#endif /* HAVE_WCTYPE_H */
+#include <os/lock.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "tre-internal.h"
+#include "tre-match-utils.h"
+#include "tre.h"
+#include "xmalloc.h"
+
+
+/* Characters whose transitions are cached in the DFA states.  Transitions
+   on other characters (and on the NUL character, which can end the string)
+   are computed every time. */
+#define TRE_DFA_CACHED_CHARS	256
+
+/* Bytes of states cached for a TNFA. */
+#define TRE_DFA_CACHE_SIZE	(1024 * 1024)
+
+#define TRE_DFA_BUCKETS		1024
+
+/* Give up when the cache fills up before this many characters have been
+   read per state built since it was last emptied. */
+#define TRE_DFA_MIN_CHARS_PER_STATE	10
+
+#define TRE_DFA_MAX_PREFIX	32
+
+/* What is known about the character before the current position. */
+#define TRE_DFA_CTX_START	0x01	/* there is none */
+#define TRE_DFA_CTX_WORD	0x02	/* it is a word character */
+#define TRE_DFA_CTX_NEWLINE	0x04	/* it is a newline */
+/* The eflags that change how assertions are checked. */
+#define TRE_DFA_CTX_NOTBOL	0x08
+#define TRE_DFA_CTX_NOTEOL	0x10
+
+#define TRE_DFA_CONTEXT_ASSERTIONS \
+  (ASSERT_AT_BOL | ASSERT_AT_EOL | ASSERT_AT_BOW | ASSERT_AT_EOW \
+   | ASSERT_AT_WB | ASSERT_AT_WB_NEG)
+/* Set in the assertions of the items for the final state that come from the
+   initial transitions: they are empty matches starting at the position. */
+#define TRE_DFA_EMPTY_MATCH	(ASSERT_LAST << 1)
+
+typedef struct {
+  int state_id;
+  int assertions;
+} tre_dfa_item_t;
+
+typedef struct tre_dfa_state tre_dfa_state_t;
+
+struct tre_dfa_state {
+  /* Next state for each character, NULL until computed.  Transitions that
+     find a match or reach the idle state are tagged, see below. */
+  tre_dfa_state_t *next[TRE_DFA_CACHED_CHARS];
+  tre_dfa_state_t *hash_next;
+  unsigned int hash;
+  int ctx;
+  /* Whether the end of the string here completes a match, -1 if unknown. */
+  int eos;
+  /* Whether no match is under way, but for one starting here. */
+  int idle;
+  int num_items;
+  tre_dfa_item_t items[0];
+};
+
+/* A match ends at the position before the character. */
+#define TRE_DFA_MATCH		((tre_dfa_state_t *)1)
+/* No match can end any more. */
+#define TRE_DFA_DEAD		((tre_dfa_state_t *)3)
+/* The first match is an empty one, at the position before the character. */
+#define TRE_DFA_MATCH_EMPTY	((tre_dfa_state_t *)5)
+#define TRE_DFA_SPECIAL(s)	((s) == TRE_DFA_MATCH || (s) == TRE_DFA_DEAD \
+				 || (s) == TRE_DFA_MATCH_EMPTY)
+/* The low bit also tags idle states, when there is a prefix to look for. */
+#define TRE_DFA_TAGGED(s)	(((uintptr_t)(s) & 1) != 0)
+#define TRE_DFA_TAG(s)		((tre_dfa_state_t *)((uintptr_t)(s) | 1))
+#define TRE_DFA_UNTAG(s)	((tre_dfa_state_t *)((uintptr_t)(s) & ~(uintptr_t)1))
+
+struct tre_dfa {
+  os_unfair_lock lock;
+  tre_dfa_state_t *buckets[TRE_DFA_BUCKETS];
+  size_t cache_size;
+  unsigned int num_states;
+  /* Incremented every time the cache is emptied. */
+  unsigned int generation;
+  /* Characters read since then, and whether the DFA was given up on. */
+  size_t num_chars;
+  int disabled;
+
+  /* TNFA state for each state ID, and the ID of the final state. */
+  tre_tnfa_transition_t **states;
+  int final_id;
+
+  /* Items of the initial transitions, at the start of the string and
+     elsewhere (where ^ cannot match without REG_NEWLINE). */
+  tre_dfa_item_t *initial_start;
+  int num_initial_start;
+  tre_dfa_item_t *initial;
+  int num_initial;
+
+  /* Scratch space for building states. */
+  tre_dfa_item_t *work;
+  int *reached;
+  int *reached_list;
+  int reached_gen;
+
+  /* Literal prefix of every match, in bytes. */
+  unsigned char prefix[TRE_DFA_MAX_PREFIX];
+  int prefix_len;
+  /* Whether the prefix can be looked for in multibyte strings. */
+  int prefix_mbs;
+};
+
+
+static int
+tre_dfa_item_cmp(const void *a, const void *b)
+{
+  const tre_dfa_item_t *x = a, *y = b;
+  if (x->state_id != y->state_id)
+    return x->state_id < y->state_id ? -1 : 1;
+  return x->assertions - y->assertions;
+}
+
+/* Sorts items and removes duplicates, and the items made useless by an item
+   for the same state without assertions.  Returns the new count. */
+static int
+tre_dfa_items_normalize(tre_dfa_item_t *items, int n)
+{
+  int i, j;
+
+  if (n <= 1)
+    return n;
+  qsort(items, (size_t)n, sizeof(*items), tre_dfa_item_cmp);
+  for (i = 0, j = 0; i < n; i++)
+    {
+      if (j > 0 && items[j - 1].state_id == items[i].state_id
+	  && (items[j - 1].assertions == 0
+	      || items[j - 1].assertions == items[i].assertions))
+	continue;
+      items[j++] = items[i];
+    }
+  return j;
+}
+
+static int
+tre_dfa_ctx_of(const tre_tnfa_t *tnfa, tre_cint_t c)
+{
+  int ctx = 0;
+  if (IS_WORD_CHAR(c))
+    ctx |= TRE_DFA_CTX_WORD;
+  if (c == L'\n')
+    ctx |= TRE_DFA_CTX_NEWLINE;
+  return ctx;
+}
+
+/* The same checks as CHECK_ASSERTIONS(), from the context of the position
+   and the character after it (NUL at the end of the string). */
+static int
+tre_dfa_assertions_fail(const tre_tnfa_t *tnfa, int assertions, int ctx,
+			tre_cint_t next_c, int next_word)
+{
+  int reg_newline = tnfa->cflags & REG_NEWLINE;
+  int start = ctx & TRE_DFA_CTX_START;
+  int prev_word = (ctx & TRE_DFA_CTX_WORD) != 0;
+
+  return (((assertions & ASSERT_AT_BOL)
+	   && (!start || (ctx & TRE_DFA_CTX_NOTBOL))
+	   && (!(ctx & TRE_DFA_CTX_NEWLINE) || !reg_newline))
+	  || ((assertions & ASSERT_AT_EOL)
+	      && (next_c != L'\0' || (ctx & TRE_DFA_CTX_NOTEOL))
+	      && (next_c != L'\n' || !reg_newline))
+	  || ((assertions & ASSERT_AT_BOW)
+	      && (prev_word || !next_word))
+	  || ((assertions & ASSERT_AT_EOW)
+	      && (!prev_word || next_word))
+	  || ((assertions & ASSERT_AT_WB)
+	      && (!start && next_c != L'\0' && prev_word == next_word))
+	  || ((assertions & ASSERT_AT_WB_NEG)
+	      && (start || next_c == L'\0' || prev_word != next_word)));
+}
+
+static void
+tre_dfa_flush(tre_dfa_t *dfa)
+{
+  tre_dfa_state_t *s, *next;
+  int i;
+
+  for (i = 0; i < TRE_DFA_BUCKETS; i++)
+    {
+      for (s = dfa->buckets[i]; s != NULL; s = next)
+	{
+	  next = s->hash_next;
+	  xfree(s);
+	}
+      dfa->buckets[i] = NULL;
+    }
+  dfa->cache_size = 0;
+  dfa->num_states = 0;
+  dfa->num_chars = 0;
+  dfa->generation++;
+}
+
+/* Finds or creates the state with these (normalized) items.  Returns NULL
+   when out of memory. */
+static tre_dfa_state_t *
+tre_dfa_lookup(tre_dfa_t *dfa, const tre_dfa_item_t *items, int n, int ctx)
+{
+  tre_dfa_state_t *s;
+  unsigned int hash = 2166136261u ^ (unsigned int)ctx;
+  size_t size;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      hash = (hash ^ (unsigned int)items[i].state_id) * 16777619u;
+      hash = (hash ^ (unsigned int)items[i].assertions) * 16777619u;
+    }
+  for (s = dfa->buckets[hash % TRE_DFA_BUCKETS]; s != NULL; s = s->hash_next)
+    if (s->hash == hash && s->ctx == ctx && s->num_items == n
+	&& memcmp(s->items, items, sizeof(*items) * (size_t)n) == 0)
+      return s;
+
+  size = sizeof(*s) + sizeof(*items) * (size_t)n;
+  if (dfa->cache_size + size > TRE_DFA_CACHE_SIZE)
+    tre_dfa_flush(dfa);
+  s = xcalloc(1, size);
+  if (s == NULL)
+    return NULL;
+  s->hash = hash;
+  s->ctx = ctx;
+  s->eos = -1;
+  s->idle = (n == dfa->num_initial && !(ctx & TRE_DFA_CTX_START)
+	     && memcmp(items, dfa->initial, sizeof(*items) * (size_t)n) == 0);
+  s->num_items = n;
+  memcpy(s->items, items, sizeof(*items) * (size_t)n);
+  s->hash_next = dfa->buckets[hash % TRE_DFA_BUCKETS];
+  dfa->buckets[hash % TRE_DFA_BUCKETS] = s;
+  dfa->cache_size += size;
+  dfa->num_states++;
+  return s;
+}
+
+/* Checks the assertions of the items of `s' now that the character after
+   them is known, and lists the states reached in dfa->reached_list.
+   Returns the number of states, or -1 if the final state is among them,
+   -2 if it is only reached by an empty match starting here. */
+static int
+tre_dfa_resolve(const tre_tnfa_t *tnfa, tre_dfa_t *dfa,
+		const tre_dfa_state_t *s, tre_cint_t c)
+{
+  int next_word = IS_WORD_CHAR(c);
+  int i, n = 0, gen, empty_match = 0;
+
+  if (dfa->reached_gen == INT_MAX)
+    {
+      memset(dfa->reached, 0, sizeof(*dfa->reached) * (size_t)tnfa->num_states);
+      dfa->reached_gen = 0;
+    }
+  gen = ++dfa->reached_gen;
+
+  for (i = 0; i < s->num_items; i++)
+    {
+      const tre_dfa_item_t *item = &s->items[i];
+      if (dfa->reached[item->state_id] == gen)
+	continue;
+      if ((item->assertions & TRE_DFA_CONTEXT_ASSERTIONS)
+	  && tre_dfa_assertions_fail(tnfa, item->assertions, s->ctx, c,
+				     next_word))
+	continue;
+      if (item->state_id == dfa->final_id)
+	{
+	  if (!(item->assertions & TRE_DFA_EMPTY_MATCH))
+	    return -1;
+	  empty_match = 1;
+	  continue;
+	}
+      dfa->reached[item->state_id] = gen;
+      dfa->reached_list[n++] = item->state_id;
+    }
+  return empty_match ? -2 : n;
+}
+
+/* Computes the transition from `s' on character c, which is not NUL.
+   Returns NULL when out of memory. */
+static tre_dfa_state_t *
+tre_dfa_step(const tre_tnfa_t *tnfa, tre_dfa_t *dfa,
+	     const tre_dfa_state_t *s, tre_cint_t c)
+{
+  tre_tnfa_transition_t *trans;
+  tre_dfa_item_t *work = dfa->work;
+  int i, n = 0, num_reached;
+
+  num_reached = tre_dfa_resolve(tnfa, dfa, s, c);
+  if (num_reached < 0)
+    return num_reached == -1 ? TRE_DFA_MATCH : TRE_DFA_MATCH_EMPTY;
+
+  for (i = 0; i < num_reached; i++)
+    {
+      for (trans = dfa->states[dfa->reached_list[i]]; trans->state; trans++)
+	{
+	  if (trans->code_min > c || trans->code_max < c)
+	    continue;
+	  if ((trans->assertions & ASSERT_BRACKET_MATCH)
+	      && !tre_bracket_match(trans->u.bracket_match_list, c, tnfa))
+	    continue;
+	  work[n].state_id = trans->state_id;
+	  work[n].assertions = trans->assertions & TRE_DFA_CONTEXT_ASSERTIONS;
+	  n++;
+	}
+    }
+  memcpy(work + n, dfa->initial, sizeof(*work) * (size_t)dfa->num_initial);
+  n = tre_dfa_items_normalize(work, n + dfa->num_initial);
+  if (n == 0)
+    return TRE_DFA_DEAD;
+
+  return tre_dfa_lookup(dfa, work, n, tre_dfa_ctx_of(tnfa, c)
+			| (s->ctx & (TRE_DFA_CTX_NOTBOL | TRE_DFA_CTX_NOTEOL)));
+}
+
+static int
+tre_dfa_eos(const tre_tnfa_t *tnfa, tre_dfa_t *dfa, tre_dfa_state_t *s)
+{
+  if (s->eos < 0)
+    s->eos = tre_dfa_resolve(tnfa, dfa, s, L'\0') < 0;
+  return s->eos;
+}
+
+/* The idle state for the context after character c. */
+static tre_dfa_state_t *
+tre_dfa_idle(const tre_tnfa_t *tnfa, tre_dfa_t *dfa, int ctx, tre_cint_t c)
+{
+  ctx = (ctx & (TRE_DFA_CTX_NOTBOL | TRE_DFA_CTX_NOTEOL))
+	| tre_dfa_ctx_of(tnfa, c);
+  return tre_dfa_lookup(dfa, dfa->initial, dfa->num_initial, ctx);
+}
+
+/* Finds the first occurrence of the prefix in [p, end).  The first and the
+   last bytes of the prefix are compared at 16 positions at once, and the
+   rest only where both are found. */
+static const unsigned char *
+tre_dfa_find_prefix(const tre_dfa_t *dfa, const unsigned char *p,
+		    const unsigned char *end)
+{
+  const unsigned char *prefix = dfa->prefix;
+  size_t k = (size_t)dfa->prefix_len, mid = k > 2 ? k - 2 : 0;
+
+  if ((size_t)(end - p) < k)
+    return NULL;
+  end -= k - 1; /* last position the prefix can start at, plus one */
+
+#if defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+  for (; end - p >= 16; p += 16)
+    {
+      uint64_t mask;
+#if defined(__SSE2__)
+      __m128i first = _mm_set1_epi8((char)prefix[0]);
+      __m128i last = _mm_set1_epi8((char)prefix[k - 1]);
+      __m128i a = _mm_loadu_si128((const __m128i *)p);
+      __m128i b = _mm_loadu_si128((const __m128i *)(p + k - 1));
+      mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(
+	       _mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+#define TRE_DFA_MASK_BITS 1
+#else
+      uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(p), vdupq_n_u8(prefix[0])),
+			       vceqq_u8(vld1q_u8(p + k - 1),
+					vdupq_n_u8(prefix[k - 1])));
+      /* No movemask: narrowing shifts leave a nibble per byte instead. */
+      mask = vget_lane_u64(vreinterpret_u64_u8(
+	       vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+#define TRE_DFA_MASK_BITS 4
+#endif
+      while (mask)
+	{
+	  const unsigned char *q = p + __builtin_ctzll(mask) / TRE_DFA_MASK_BITS;
+	  if (memcmp(q + 1, prefix + 1, mid) == 0)
+	    return q;
+	  mask &= ~(((uint64_t)1 << TRE_DFA_MASK_BITS) - 1)
+		  << (__builtin_ctzll(mask) / TRE_DFA_MASK_BITS
+		      * TRE_DFA_MASK_BITS);
+	}
+    }
+#undef TRE_DFA_MASK_BITS
+#endif
+
+  for (; p < end; p++)
+    {
+      p = memchr(p, prefix[0], (size_t)(end - p));
+      if (p == NULL)
+	return NULL;
+      if (p[k - 1] == prefix[k - 1] && memcmp(p + 1, prefix + 1, mid) == 0)
+	return p;
+    }
+  return NULL;
+}
+
+/* The first byte of [p, end) that is not ASCII, or end. */
+static const unsigned char *
+tre_dfa_ascii_end(const unsigned char *p, const unsigned char *end)
+{
+  const uint64_t high = 0x8080808080808080ull;
+  uint64_t word;
+
+  for (; end - p >= 8; p += 8)
+    {
+      memcpy(&word, p, sizeof(word));
+      if (word & high)
+	break;
+    }
+  while (p < end && *p < 0x80)
+    p++;
+  return p;
+}
+
+#ifdef TRE_MULTIBYTE
+/* No match is possible any more, but the parallel matcher would still
+   report REG_ILLSEQ for an invalid multibyte string: check the rest of it. */
+static reg_errcode_t
+tre_dfa_check_mbs(const tre_tnfa_t *tnfa, const unsigned char *p,
+		  const unsigned char *end)
+{
+  mbstate_t mbstate;
+  wchar_t wc;
+  size_t w;
+
+  memset(&mbstate, '\0', sizeof(mbstate));
+  if (end == NULL)
+    end = p + strlen((const char *)p);
+  while ((p = tre_dfa_ascii_end(p, end)) < end)
+    {
+      w = tre_mbrtowc_l(&wc, (const char *)p, (size_t)(end - p), &mbstate,
+			tnfa->loc);
+      if (w == (size_t)-1 || w == (size_t)-2)
+	return REG_ILLSEQ;
+      p += w;
+    }
+  return REG_NOMATCH;
+}
+#endif /* TRE_MULTIBYTE */
+
+/* The literal string every match starts with: the characters of the single
+   TNFA state reached by the initial transitions, and of the single state
+   after it, and so on, as long as these states are literals without
+   assertions. */
+static void
+tre_dfa_find_literal_prefix(const tre_tnfa_t *tnfa, tre_dfa_t *dfa)
+{
+  tre_tnfa_transition_t *state, *trans;
+  tre_cint_t c;
+  int single_byte = TRE_MB_CUR_MAX_L(tnfa->loc) == 1;
+
+#ifdef __LIBC__
+  /* In UTF-8, bytes of ASCII characters are never part of another
+     character, so an ASCII prefix can be looked for byte by byte. */
+  dfa->prefix_mbs = !single_byte
+    && strcmp(tnfa->loc->__lc_ctype->__ctype_encoding, "UTF-8") == 0;
+#endif /* __LIBC__ */
+
+  if (tnfa->initial->state == NULL || tnfa->initial[1].state != NULL
+      || tnfa->initial->assertions != 0)
+    return;
+  state = tnfa->initial->state;
+  while (dfa->prefix_len < TRE_DFA_MAX_PREFIX && state != tnfa->final)
+    {
+      c = state->code_min;
+      if (state->state == NULL || c != state->code_max || c <= 0
+	  || c >= (single_byte ? 0x100 : 0x80))
+	return;
+      for (trans = state; trans->state; trans++)
+	if (trans->code_min != c || trans->code_max != c || trans->assertions)
+	  return;
+      dfa->prefix[dfa->prefix_len++] = (unsigned char)c;
+      if (state[1].state != NULL)
+	return;
+      state = state->state;
+    }
+}
+
+tre_dfa_t *
+tre_dfa_new(const tre_tnfa_t *tnfa)
+{
+  tre_dfa_t *dfa;
+  tre_tnfa_transition_t *trans;
+  unsigned int i;
+  int n;
+
+  if (tnfa->have_backrefs || tnfa->have_approx)
+    return NULL;
+
+  dfa = xcalloc(1, sizeof(*dfa));
+  if (dfa == NULL)
+    return NULL;
+  dfa->lock = OS_UNFAIR_LOCK_INIT;
+  dfa->states = xcalloc((size_t)tnfa->num_states, sizeof(*dfa->states));
+  dfa->reached = xcalloc((size_t)tnfa->num_states, sizeof(*dfa->reached));
+  dfa->reached_list = xmalloc(sizeof(*dfa->reached_list)
+			      * (size_t)tnfa->num_states);
+  for (n = 0, trans = tnfa->initial; trans->state; trans++)
+    n++;
+  /* Every state gets an item per transition to it, plus the initial ones. */
+  dfa->work = xmalloc(sizeof(*dfa->work) * (tnfa->num_transitions + 2 * n));
+  dfa->initial_start = xmalloc(sizeof(*dfa->initial_start) * (n + 1));
+  dfa->initial = xmalloc(sizeof(*dfa->initial) * (n + 1));
+  if (!dfa->states || !dfa->reached || !dfa->reached_list || !dfa->work
+      || !dfa->initial_start || !dfa->initial)
+    {
+      tre_dfa_free(dfa);
+      return NULL;
+    }
+
+  for (i = 0; i < tnfa->num_transitions; i++)
+    {
+      trans = &tnfa->transitions[i];
+      if (trans->state != NULL)
+	dfa->states[trans->state_id] = trans->state;
+    }
+  dfa->final_id = -1;
+  for (trans = tnfa->initial; trans->state; trans++)
+    dfa->states[trans->state_id] = trans->state;
+  for (n = 0; n < tnfa->num_states; n++)
+    if (dfa->states[n] == tnfa->final)
+      dfa->final_id = n;
+
+  for (trans = tnfa->initial; trans->state; trans++)
+    {
+      tre_dfa_item_t item = { trans->state_id,
+			      trans->assertions & TRE_DFA_CONTEXT_ASSERTIONS };
+      if (trans->state_id == dfa->final_id)
+	item.assertions |= TRE_DFA_EMPTY_MATCH;
+      dfa->initial_start[dfa->num_initial_start++] = item;
+      if (!(item.assertions & ASSERT_AT_BOL) || (tnfa->cflags & REG_NEWLINE))
+	dfa->initial[dfa->num_initial++] = item;
+    }
+  dfa->num_initial_start = tre_dfa_items_normalize(dfa->initial_start,
+						   dfa->num_initial_start);
+  dfa->num_initial = tre_dfa_items_normalize(dfa->initial, dfa->num_initial);
+
+  tre_dfa_find_literal_prefix(tnfa, dfa);
+  return dfa;
+}
+
+void
+tre_dfa_free(tre_dfa_t *dfa)
+{
+  if (dfa == NULL)
+    return;
+  tre_dfa_flush(dfa);
+  if (dfa->states)
+    xfree(dfa->states);
+  if (dfa->reached)
+    xfree(dfa->reached);
+  if (dfa->reached_list)
+    xfree(dfa->reached_list);
+  if (dfa->work)
+    xfree(dfa->work);
+  if (dfa->initial_start)
+    xfree(dfa->initial_start);
+  if (dfa->initial)
+    xfree(dfa->initial);
+  xfree(dfa);
+}
+
+/* Runs the DFA with dfa->lock held. */
+static reg_errcode_t
+tre_dfa_run(const tre_tnfa_t *tnfa, tre_dfa_t *dfa, const void *string,
+	    int len, tre_str_type_t type, int eflags)
+{
+  const unsigned char *str_byte = string, *end = NULL;
+#ifdef TRE_WCHAR
+  const wchar_t *str_wide = string;
+#ifdef TRE_MBSTATE
+  mbstate_t mbstate;
+#endif /* TRE_MBSTATE */
+#endif /* TRE_WCHAR */
+  tre_dfa_state_t *s, *next;
+  tre_cint_t c;
+  int pos = 0, counted_pos = 0, width, ctx;
+  int prefilter = dfa->prefix_len > 0
+    && (type == STR_BYTE || (type == STR_MBS && dfa->prefix_mbs));
+  unsigned int generation;
+
+#ifdef TRE_MBSTATE
+  memset(&mbstate, '\0', sizeof(mbstate));
+#endif /* TRE_MBSTATE */
+
+  if (len >= 0 && type != STR_WIDE)
+    end = str_byte + len;
+
+  ctx = TRE_DFA_CTX_START;
+  if (eflags & REG_NOTBOL)
+    ctx |= TRE_DFA_CTX_NOTBOL;
+  if (eflags & REG_NOTEOL)
+    ctx |= TRE_DFA_CTX_NOTEOL;
+  s = tre_dfa_lookup(dfa, dfa->initial_start, dfa->num_initial_start, ctx);
+  if (s == NULL)
+    return REG_ESPACE;
+
+  while (/*CONSTCOND*/1)
+    {
+      /* Fast path: bytes (ASCII in multibyte strings) with known next
+	 states.  The NUL character never has one. */
+      if (type != STR_WIDE)
+	{
+	  const unsigned char *p = str_byte;
+	  if (end != NULL)
+	    {
+	      if (type == STR_BYTE)
+		while (p < end && (next = s->next[*p]) && !TRE_DFA_TAGGED(next))
+		  {
+		    s = next;
+		    p++;
+		  }
+	      else
+		while (p < end && *p < 0x80 && (next = s->next[*p])
+		       && !TRE_DFA_TAGGED(next))
+		  {
+		    s = next;
+		    p++;
+		  }
+	    }
+	  else
+	    {
+	      if (type == STR_BYTE)
+		while ((next = s->next[*p]) && !TRE_DFA_TAGGED(next))
+		  {
+		    s = next;
+		    p++;
+		  }
+	      else
+		while (*p < 0x80 && (next = s->next[*p])
+		       && !TRE_DFA_TAGGED(next))
+		  {
+		    s = next;
+		    p++;
+		  }
+	    }
+	  pos += (int)(p - str_byte);
+	  str_byte = p;
+	}
+
+      /* Read the next character, as GET_NEXT_WCHAR() does. */
+      width = 1;
+      if (len >= 0 && pos >= len)
+	return tre_dfa_eos(tnfa, dfa, s) ? REG_OK : REG_NOMATCH;
+      if (type == STR_WIDE)
+	c = *str_wide;
+      else if (type == STR_BYTE || *str_byte < 0x80)
+	c = *str_byte;
+      else
+	{
+#ifdef TRE_MULTIBYTE
+	  wchar_t wc;
+	  size_t w = tre_mbrtowc_l(&wc, (const char *)str_byte,
+				   len >= 0 ? (size_t)(len - pos) : 32,
+				   &mbstate, tnfa->loc);
+	  if (w == (size_t)-1 || w == (size_t)-2)
+	    return REG_ILLSEQ;
+	  c = wc;
+	  if (w > 0)
+	    width = (int)w;
+#else /* !TRE_MULTIBYTE */
+	  c = *str_byte;
+#endif /* !TRE_MULTIBYTE */
+	}
+      if (c == L'\0' && len < 0)
+	return tre_dfa_eos(tnfa, dfa, s) ? REG_OK : REG_NOMATCH;
+
+      /* Take the transition, computing it if needed. */
+      if (c > 0 && c < TRE_DFA_CACHED_CHARS && s->next[c] != NULL)
+	next = s->next[c];
+      else
+	{
+	  size_t num_chars;
+	  dfa->num_chars += (size_t)(pos - counted_pos);
+	  counted_pos = pos;
+	  num_chars = dfa->num_chars;
+	  generation = dfa->generation;
+	  next = tre_dfa_step(tnfa, dfa, s, c);
+	  if (next == NULL)
+	    return REG_ESPACE;
+	  if (dfa->generation != generation)
+	    {
+	      /* The cache was emptied, `s' is gone.  Not worth it if it
+		 keeps happening. */
+	      if (num_chars < TRE_DFA_MIN_CHARS_PER_STATE
+			      * (TRE_DFA_CACHE_SIZE / sizeof(tre_dfa_state_t)))
+		{
+		  dfa->disabled = 1;
+		  return REG_ESPACE;
+		}
+	    }
+	  else if (c > 0 && c < TRE_DFA_CACHED_CHARS)
+	    s->next[c] = (dfa->prefix_len > 0 && !TRE_DFA_SPECIAL(next)
+			  && next->idle)
+			 ? TRE_DFA_TAG(next) : next;
+	}
+      if (next == TRE_DFA_MATCH)
+	return REG_OK;
+      if (next == TRE_DFA_MATCH_EMPTY)
+	{
+#ifdef TRE_MULTIBYTE
+	  /* The parallel matcher finds empty matches before taking the
+	     transitions on the character after them, and so reads one
+	     more character before stopping: it reports REG_ILLSEQ if
+	     that one is invalid. */
+	  const unsigned char *p = str_byte + width;
+	  if (type == STR_MBS && (len < 0 || pos + width < len) && *p >= 0x80)
+	    {
+	      wchar_t wc;
+	      size_t w = tre_mbrtowc_l(&wc, (const char *)p,
+				       len >= 0 ? (size_t)(len - pos - width)
+				       : 32, &mbstate, tnfa->loc);
+	      if (w == (size_t)-1 || w == (size_t)-2)
+		return REG_ILLSEQ;
+	    }
+#endif /* TRE_MULTIBYTE */
+	  return REG_OK;
+	}
+      if (next == TRE_DFA_DEAD)
+	{
+#ifdef TRE_MULTIBYTE
+	  if (type == STR_MBS)
+	    return tre_dfa_check_mbs(tnfa, str_byte + width, end);
+#endif /* TRE_MULTIBYTE */
+	  return REG_NOMATCH;
+	}
+      s = TRE_DFA_UNTAG(next);
+      pos += width;
+      if (type == STR_WIDE)
+	str_wide++;
+      else
+	str_byte += width;
+
+      /* No match under way: skip to where the next one can start.  Like
+	 the first character skipping of the parallel matcher, this stops
+	 at non-ASCII bytes in multibyte strings, which need decoding. */
+      if (prefilter && s->idle)
+	{
+	  const unsigned char *p, *stop;
+	  if (end == NULL)
+	    end = str_byte + strlen((const char *)str_byte);
+	  stop = type == STR_MBS ? tre_dfa_ascii_end(str_byte, end) : end;
+	  p = tre_dfa_find_prefix(dfa, str_byte, stop);
+	  if (p == NULL)
+	    {
+	      if (stop == end)
+		return REG_NOMATCH;
+	      p = stop;
+	    }
+	  if (p != str_byte)
+	    {
+	      s = tre_dfa_idle(tnfa, dfa, s->ctx, p[-1]);
+	      if (s == NULL)
+		return REG_ESPACE;
+	      pos += (int)(p - str_byte);
+	      str_byte = p;
+	    }
+	}
+    }
+}
+
+reg_errcode_t
+tre_tnfa_run_dfa(const tre_tnfa_t *tnfa, const void *string, int len,
+		 tre_str_type_t type, int eflags)
+{
+  tre_dfa_t *dfa = tnfa->dfa;
+  reg_errcode_t status;
+
+  DPRINT(("tre_tnfa_run_dfa, input type %d\n", type));
+
+  if (dfa == NULL || dfa->disabled || !os_unfair_lock_trylock(&dfa->lock))
+    return REG_ESPACE;
+  status = tre_dfa_run(tnfa, dfa, string, len, type, eflags);
+  os_unfair_lock_unlock(&dfa->lock);
+  return status;
+}
+
+/* EOF */
@@ -36,6 +36,7 @@ static char sccsid[] = "@(#)fvwrite.c	8.1 (Berkeley) 6/4/93";
 #include <sys/cdefs.h>
 __FBSDID("$FreeBSD: src/lib/libc/stdio/fvwrite.c,v 1.19 2009/11/25 04:21:42 wollman Exp $");
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -82,11 +83,11 @@ __sfvwrite(fp, uio)
 	}
 	if (fp->_flags & __SNBF) {
 		/*
-		 * Unbuffered: write up to BUFSIZ bytes at a time.
+		 * Unbuffered: write each iov in one go.
 		 */
 		do {
 			GETIOV(;);
-			w = _swrite(fp, p, MIN(len, BUFSIZ));
+			w = _swrite(fp, p, (int)MIN(len, INT_MAX));
 			if (w <= 0)
 				goto err;
 			p += w;
@@ -96,7 +97,8 @@ __sfvwrite(fp, uio)
 		/*
 		 * Fully buffered: fill partially full buffer, if any,
 		 * and then flush.  If there is no partial buffer, write
-		 * one _bf._size byte chunk directly (without copying).
+		 * as many _bf._size byte chunks as there are directly
+		 * (without copying).
 		 *
 		 * String output is a special case: write as many bytes
 		 * as fit, but pretend we wrote everything.  This makes
@@ -141,7 +143,7 @@ __sfvwrite(fp, uio)
 					goto err;
 			} else if (len >= (w = fp->_bf._size)) {
 				/* write directly */
-				w = _swrite(fp, p, w);
+				w = _swrite(fp, p, (int)(MIN(len, INT_MAX) / w * w));
 				if (w <= 0)
 					goto err;
 			} else {
@@ -180,7 +182,7 @@ __sfvwrite(fp, uio)
 				if (__fflush(fp))
 					goto err;
 			} else if (s >= (w = fp->_bf._size)) {
-				w = _swrite(fp, p, w);
+				w = _swrite(fp, p, s / w * w);
 				if (w <= 0)
 				 	goto err;
 			} else {
@@ -43,31 +43,17 @@ __FBSDID("$FreeBSD: src/lib/libc/stdlib/heapsort.c,v 1.6 2008/01/13 02:11:10 das
 #include <stddef.h>
 #include <stdlib.h>
 
+#include "sort_swap.h"
+
 /*
- * Swap two areas of size number of bytes.  Although qsort(3) permits random
- * blocks of memory to be sorted, sorting pointers is almost certainly the
- * common case (and, were it not, could easily be made so).  Regardless, it
- * isn't worth optimizing; the SWAP's get sped up by the cache, and pointer
- * arithmetic gets lost in the time required for comparison function calls.
+ * Swap two areas of size number of bytes.  Sorting pointers is by far the
+ * common case, so elements of 4, 8 and 16 bytes are moved whole rather than
+ * a byte at a time.
  */
-#define	SWAP(a, b, count, size, tmp) { \
-	count = size; \
-	do { \
-		tmp = *a; \
-		*a++ = *b; \
-		*b++ = tmp; \
-	} while (--count); \
-}
+#define	SWAP(a, b, size) _sort_swap(a, b, size)
 
 /* Copy one block of size size to another. */
-#define COPY(a, b, count, size, tmp1, tmp2) { \
-	count = size; \
-	tmp1 = a; \
-	tmp2 = b; \
-	do { \
-		*tmp1++ = *tmp2++; \
-	} while (--count); \
-}
+#define COPY(a, b, size) _sort_copy(a, b, size)
 
 /*
  * Build the list into a heap, where a heap is defined such that for
@@ -76,7 +62,7 @@ __FBSDID("$FreeBSD: src/lib/libc/stdlib/heapsort.c,v 1.6 2008/01/13 02:11:10 das
  * There two cases.  If j == nmemb, select largest of Ki and Kj.  If
  * j < nmemb, select largest of Ki, Kj and Kj+1.
  */
-#define CREATE(initval, nmemb, par_i, child_i, par, child, size, count, tmp) { \
+#define CREATE(initval, nmemb, par_i, child_i, par, child, size) { \
 	for (par_i = initval; (child_i = par_i * 2) <= nmemb; \
 	    par_i = child_i) { \
 		child = base + child_i * size; \
@@ -87,7 +73,7 @@ __FBSDID("$FreeBSD: src/lib/libc/stdlib/heapsort.c,v 1.6 2008/01/13 02:11:10 das
 		par = base + par_i * size; \
 		if (compar(child, par) <= 0) \
 			break; \
-		SWAP(par, child, count, size, tmp); \
+		SWAP(par, child, size); \
 	} \
 }
 
@@ -108,7 +94,7 @@ __FBSDID("$FreeBSD: src/lib/libc/stdlib/heapsort.c,v 1.6 2008/01/13 02:11:10 das
  *
  * XXX Don't break the #define SELECT line, below.  Reiser cpp gets upset.
  */
-#define SELECT(par_i, child_i, nmemb, par, child, size, k, count, tmp1, tmp2) { \
+#define SELECT(par_i, child_i, nmemb, par, child, size, k) { \
 	for (par_i = 1; (child_i = par_i * 2) <= nmemb; par_i = child_i) { \
 		child = base + child_i * size; \
 		if (child_i < nmemb && compar(child, child + size) < 0) { \
@@ -116,7 +102,7 @@ __FBSDID("$FreeBSD: src/lib/libc/stdlib/heapsort.c,v 1.6 2008/01/13 02:11:10 das
 			++child_i; \
 		} \
 		par = base + par_i * size; \
-		COPY(par, child, count, size, tmp1, tmp2); \
+		COPY(par, child, size); \
 	} \
 	for (;;) { \
 		child_i = par_i; \
@@ -124,10 +110,10 @@ __FBSDID("$FreeBSD: src/lib/libc/stdlib/heapsort.c,v 1.6 2008/01/13 02:11:10 das
 		child = base + child_i * size; \
 		par = base + par_i * size; \
 		if (child_i == 1 || compar(k, par) < 0) { \
-			COPY(child, k, count, size, tmp1, tmp2); \
+			COPY(child, k, size); \
 			break; \
 		} \
-		COPY(child, par, count, size, tmp1, tmp2); \
+		COPY(child, par, size); \
 	} \
 }
 
@@ -144,8 +130,7 @@ heapsort(vbase, nmemb, size, compar)
 	size_t nmemb, size;
 	int (*compar)(const void *, const void *);
 {
-	size_t cnt, i, j, l;
-	char tmp, *tmp1, *tmp2;
+	size_t i, j, l;
 	char *base, *k, *p, *t;
 
 	if (nmemb <= 1)
@@ -166,7 +151,7 @@ heapsort(vbase, nmemb, size, compar)
 	base = (char *)vbase - size;
 
 	for (l = nmemb / 2 + 1; --l;)
-		CREATE(l, nmemb, i, j, t, p, size, cnt, tmp);
+		CREATE(l, nmemb, i, j, t, p, size);
 
 	/*
 	 * For each element of the heap, save the largest element into its
@@ -174,10 +159,10 @@ heapsort(vbase, nmemb, size, compar)
 	 * heap.
 	 */
 	while (nmemb > 1) {
-		COPY(k, base + nmemb * size, cnt, size, tmp1, tmp2);
-		COPY(base + nmemb * size, base + size, cnt, size, tmp1, tmp2);
+		COPY(k, base + nmemb * size, size);
+		COPY(base + nmemb * size, base + size, size);
 		--nmemb;
-		SELECT(i, j, nmemb, t, p, size, k, cnt, tmp1, tmp2);
+		SELECT(i, j, nmemb, t, p, size, k);
 	}
 	free(k);
 	return (0);
@@ -35,330 +35,270 @@ static char sccsid[] = "@(#)qsort.c	8.1 (Berkeley) 6/4/93";
 __FBSDID("$FreeBSD: src/lib/libc/stdlib/qsort.c,v 1.15 2008/01/14 09:21:34 das Exp $");
 
 #include <stdlib.h>
-#include <pthread.h>
 #include <dispatch/dispatch.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
-#include <libkern/OSAtomic.h>
-#include <sys/mman.h>
 #include <errno.h>
-#include <os/lock.h>
+#include <sys/param.h>
 #define __APPLE_API_PRIVATE
 #include <machine/cpu_capabilities.h>
 
+#include "sort_swap.h"
+
+/*
+ * Parallel merge sort.
+ *
+ * The array is cut into chunks, which are sorted independently, and the
+ * sorted runs are then merged pairwise into a buffer as large as the array,
+ * back and forth, until a single run is left.
+ *
+ * There is no shared job list: every phase is one dispatch_apply over
+ * equally sized pieces of work, and dispatch_apply hands each worker thread
+ * its own range of them, stealing from the others' when it runs out. A merge
+ * pass is cut along the output rather than along the runs, each piece
+ * finding where its share of the two input runs starts by binary search, so
+ * that the last passes, which only merge a couple of very long runs, are as
+ * parallel as the first ones.
+ *
+ * psort() sorts its chunks with qsort(3). psort_stable() sorts them with
+ * insertion sort and merge passes local to the chunk instead, and since the
+ * merges take from the left run on ties, the whole sort is stable.
+ */
+
 #ifdef I_AM_PSORT_R
 typedef int		 cmp_t(void *, const void *, const void *);
+#define	CMP(s, x, y)	((s)->cmp((s)->thunk, (x), (y)))
 #else
 typedef int		 cmp_t(const void *, const void *);
+#define	CMP(s, x, y)	((s)->cmp((x), (y)))
 #endif
-#ifdef I_AM_PSORT_B
-static inline char	*med3(char *, char *, char *, cmp_t ^, void *) __attribute__((always_inline));
-#else
-static inline char	*med3(char *, char *, char *, cmp_t *, void *) __attribute__((always_inline));
-#endif
-static inline void	 swapfunc(char *, char *, int, int) __attribute__((always_inline));
-
-#define min(a, b)	(a) < (b) ? a : b
 
-#define NARGS			((PAGESIZE - offsetof(struct page, args)) / sizeof(union args))
-#define PAGESIZE		4096
-#define PARALLEL_MIN_SIZE	2000	/* determine heuristically */
-
-struct shared; /* forward reference */
-union args {
-    union args *next;
-    struct {
-	struct shared *shared;
-	void *a;
-	size_t n;
-	int depth_limit;
-    } /* anonymous */;
-};
-
-struct page {
-    struct page *next;
-    union args args[0];
-};
+/*
+ * Chunks are sorted by a single thread. They should be large enough for the
+ * sort to dwarf the cost of handing them to a worker and of the merge passes
+ * they add: with 8192 elements, a qsort of a chunk makes about 100000
+ * comparisons, which is a few hundred microseconds.
+ */
+#define PSORT_MIN_CHUNK		8192
+#define PARALLEL_MIN_SIZE	(2 * PSORT_MIN_CHUNK)
+/* Chunks per CPU, so that stealing can even out chunks of uneven cost */
+#define PSORT_CHUNKS_PER_CPU	4
+/* Runs sorted by insertion sort before merging, for psort_stable() */
+#define PSORT_STABLE_RUN	16
 
 struct shared {
-    char *who;
-    union args *freelist;
-    struct page *pagelist;
+	char *base;
+	char *buf;		/* as large as base */
+	size_t n;
+	size_t es;
+	size_t chunk;		/* elements per chunk, and per merge piece */
+	bool stable;
+	/* the merge pass being run */
+	const char *src;
+	char *dst;
+	size_t width;		/* length of the runs merged */
 #ifdef I_AM_PSORT_R
-    void *thunk;
+	void *thunk;
 #endif
 #ifdef I_AM_PSORT_B
-    cmp_t ^cmp;
+	cmp_t ^cmp;
 #else
-    cmp_t *cmp;
+	cmp_t *cmp;
 #endif
-    size_t es;
-    size_t turnoff;
-    dispatch_queue_t queue;
-    dispatch_group_t group;
-    os_unfair_lock sharedlock;
 };
 
-static union args *
-getargs(struct shared *shared)
+/*
+ * Number of elements of the left run l among the first k elements of the
+ * merge of l and r.
+ */
+static size_t
+corank(struct shared *s, const char *l, size_t nl, const char *r, size_t nr,
+		size_t k)
 {
-    union args *args;
-
-    os_unfair_lock_lock(&shared->sharedlock);
-    if(!shared->freelist) {
-	struct page *page;
-	union args *prev;
-	int i;
-	if((page = (struct page *)mmap(NULL, PAGESIZE, PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0)) == NULL)
-	    return NULL;
-	page->next = shared->pagelist;
-	shared->pagelist = page;
-	prev = NULL;
-	for(args = page->args, i = NARGS; i > 0; args++, i--) {
-	    args->next = prev;
-	    prev = args;
+	size_t es = s->es;
+	size_t lo = k > nr ? k - nr : 0, hi = MIN(k, nl);
+
+	while (lo < hi) {
+		size_t i = lo + (hi - lo) / 2;
+		if (CMP(s, l + i * es, r + (k - i - 1) * es) <= 0)
+			lo = i + 1;
+		else
+			hi = i;
 	}
-	shared->freelist = prev;
-    }
-    args = shared->freelist;
-    shared->freelist = args->next;
-    os_unfair_lock_unlock(&shared->sharedlock);
-    return args;
+	return lo;
 }
 
 static void
-returnargs(struct shared *shared, union args *args)
+merge(struct shared *s, const char *l, const char *le, const char *r,
+		const char *re, char *out)
 {
-    os_unfair_lock_lock(&shared->sharedlock);
-    args->next = shared->freelist;
-    shared->freelist = args;
-    os_unfair_lock_unlock(&shared->sharedlock);
+	size_t es = s->es;
+
+	/* Runs already in order, as when the input is (mostly) sorted */
+	if (l == le || r == re || CMP(s, le - es, r) <= 0)
+		goto tail;
+	while (l < le && r < re) {
+		if (CMP(s, l, r) <= 0) {
+			_sort_copy(out, l, es);
+			l += es;
+		} else {
+			_sort_copy(out, r, es);
+			r += es;
+		}
+		out += es;
+	}
+tail:
+	memcpy(out, l, (size_t)(le - l));
+	memcpy(out + (le - l), r, (size_t)(re - r));
 }
 
 /*
- * Qsort routine from Bentley & McIlroy's "Engineering a Sort Function".
+ * Merges the consecutive pairs of runs of src, of width elements each, into
+ * dst, writing elements [lo, hi) of dst only.
  */
-#define swapcode(TYPE, parmi, parmj, n) { 		\
-	long i = (n) / sizeof (TYPE); 			\
-	TYPE *pi = (TYPE *) (parmi); 		\
-	TYPE *pj = (TYPE *) (parmj); 		\
-	do { 						\
-		TYPE	t = *pi;		\
-		*pi++ = *pj;				\
-		*pj++ = t;				\
-        } while (--i > 0);				\
-}
-
-#define SWAPINIT(a, es) swaptype = ((char *)a - (char *)0) % sizeof(long) || \
-	es % sizeof(long) ? 2 : es == sizeof(long)? 0 : 1;
-
-static inline void
-swapfunc(a, b, n, swaptype)
-	char *a, *b;
-	int n, swaptype;
+static void
+merge_range(struct shared *s, const char *src, char *dst, size_t width,
+		size_t lo, size_t hi)
 {
-	if(swaptype <= 1)
-		swapcode(long, a, b, n)
-	else
-		swapcode(char, a, b, n)
-}
-
-#define swap(a, b)					\
-	if (swaptype == 0) {				\
-		long t = *(long *)(a);			\
-		*(long *)(a) = *(long *)(b);		\
-		*(long *)(b) = t;			\
-	} else						\
-		swapfunc(a, b, es, swaptype)
+	size_t es = s->es, n = s->n;
 
-#define vecswap(a, b, n) 	if ((n) > 0) swapfunc(a, b, n, swaptype)
+	for (size_t p = lo - lo % (2 * width); p < hi; p += 2 * width) {
+		size_t m = MIN(p + width, n), e = MIN(m + width, n);
+		size_t k0 = MAX(lo, p) - p, k1 = MIN(hi, e) - p;
+		const char *l = src + p * es, *r = src + m * es;
+		size_t i0 = corank(s, l, m - p, r, e - m, k0);
+		size_t i1 = corank(s, l, m - p, r, e - m, k1);
 
-#ifdef I_AM_PSORT_R
-#define	CMP(t, x, y) (cmp((t), (x), (y)))
-#else
-#define	CMP(t, x, y) (cmp((x), (y)))
-#endif
+		merge(s, l + i0 * es, l + i1 * es, r + (k0 - i0) * es,
+				r + (k1 - i1) * es, dst + (p + k0) * es);
+	}
+}
 
-static inline char *
-med3(char *a, char *b, char *c,
-#ifdef I_AM_PSORT_B
-cmp_t ^cmp,
-#else
-cmp_t *cmp,
-#endif
-void *thunk
-#ifndef I_AM_PSORT_R
-__unused
-#endif
-)
+/* Stable, tmp has room for one element */
+static void
+insertion_sort(struct shared *s, char *a, size_t n, char *tmp)
 {
-	return CMP(thunk, a, b) < 0 ?
-	       (CMP(thunk, b, c) < 0 ? b : (CMP(thunk, a, c) < 0 ? c : a ))
-              :(CMP(thunk, b, c) > 0 ? b : (CMP(thunk, a, c) < 0 ? a : c ));
+	size_t es = s->es;
+
+	for (char *x = a + es; x < a + n * es; x += es) {
+		char *p = x;
+		while (p > a && CMP(s, p - es, x) > 0)
+			p -= es;
+		if (p != x) {
+			_sort_copy(tmp, x, es);
+			memmove(p + es, p, (size_t)(x - p));
+			_sort_copy(p, tmp, es);
+		}
+	}
 }
 
-#ifdef __LP64__
-#define DEPTH(x)	(2 * (flsl((long)(x)) - 1))
-#else /* !__LP64__ */
-#define DEPTH(x)	(2 * (fls((int)(x)) - 1))
-#endif /* __LP64__ */
-
-#ifdef I_AM_PSORT_R
-int __heapsort_r(void *, size_t, size_t, void *, int (*)(void *, const void *, const void *));
-#endif
-
-static void _psort_parallel(void *x);
-
 static void
-_psort(void *a, size_t n, size_t es,
-#ifdef I_AM_PSORT_R
-void *thunk,
-#else
-#define thunk	NULL
-#endif
-#ifdef I_AM_PSORT_B
-cmp_t ^cmp,
-#else
-cmp_t *cmp,
-#endif
-int depth_limit, struct shared *shared)
+_psort_chunk(void *ctx, size_t i)
 {
-	char *pa, *pb, *pc, *pd, *pl, *pm, *pn;
-	size_t d, r;
-	int cmp_result;
-	int swaptype, swap_cnt;
+	struct shared *s = ctx;
+	size_t es = s->es, lo = i * s->chunk, hi = MIN(lo + s->chunk, s->n);
+	const char *src = s->base;
+	char *dst = s->buf;
 
-loop:
-	if (depth_limit-- <= 0) {
-#ifdef I_AM_PSORT_B
-		heapsort_b(a, n, es, cmp);
-#elif defined(I_AM_PSORT_R)
-		__heapsort_r(a, n, es, thunk, cmp);
+	if (!s->stable) {
+#ifdef I_AM_PSORT_R
+		qsort_r(s->base + lo * es, hi - lo, es, s->thunk, s->cmp);
+#elif defined(I_AM_PSORT_B)
+		qsort_b(s->base + lo * es, hi - lo, es, s->cmp);
 #else
-		heapsort(a, n, es, cmp);
+		qsort(s->base + lo * es, hi - lo, es, s->cmp);
 #endif
 		return;
 	}
-	SWAPINIT(a, es);
-	swap_cnt = 0;
-	if (n < 7) {
-		for (pm = (char *)a + es; pm < (char *)a + n * es; pm += es)
-			for (pl = pm; 
-			     pl > (char *)a && CMP(thunk, pl - es, pl) > 0;
-			     pl -= es)
-				swap(pl, pl - es);
-		return;
-	}
-	pm = (char *)a + (n / 2) * es;
-	if (n > 7) {
-		pl = a;
-		pn = (char *)a + (n - 1) * es;
-		if (n > 40) {
-			d = (n / 8) * es;
-			pl = med3(pl, pl + d, pl + 2 * d, cmp, thunk);
-			pm = med3(pm - d, pm, pm + d, cmp, thunk);
-			pn = med3(pn - 2 * d, pn - d, pn, cmp, thunk);
-		}
-		pm = med3(pl, pm, pn, cmp, thunk);
+
+	/* The chunk's part of the buffer is free, use it as scratch */
+	for (size_t r = lo; r < hi; r += PSORT_STABLE_RUN) {
+		insertion_sort(s, s->base + r * es, MIN(PSORT_STABLE_RUN, hi - r),
+				s->buf + lo * es);
 	}
-	swap(a, pm);
-	pa = pb = (char *)a + es;
-
-	pc = pd = (char *)a + (n - 1) * es;
-	for (;;) {
-		while (pb <= pc && (cmp_result = CMP(thunk, pb, a)) <= 0) {
-			if (cmp_result == 0) {
-				swap_cnt = 1;
-				swap(pa, pb);
-				pa += es;
-			}
-			pb += es;
-		}
-		while (pb <= pc && (cmp_result = CMP(thunk, pc, a)) >= 0) {
-			if (cmp_result == 0) {
-				swap_cnt = 1;
-				swap(pc, pd);
-				pd -= es;
-			}
-			pc -= es;
-		}
-		if (pb > pc)
-			break;
-		swap(pb, pc);
-		swap_cnt = 1;
-		pb += es;
-		pc -= es;
+	/* Every chunk makes the same number of passes, even the last one */
+	for (size_t w = PSORT_STABLE_RUN; w < s->chunk; w *= 2) {
+		merge_range(s, src, dst, w, lo, hi);
+		const char *t = src;
+		src = dst;
+		dst = (char *)t;
 	}
+}
 
-	pn = (char *)a + n * es;
-	r = min(pa - (char *)a, pb - pa);
-	vecswap(a, pb - r, r);
-	r = min(pd - pc, pn - pd - es);
-	vecswap(pb, pn - r, r);
-
-	if (swap_cnt == 0) {  /* Switch to insertion sort */
-		r = 1 + n / 4; /* n >= 7, so r >= 2 */
-		for (pm = (char *)a + es; pm < (char *)a + n * es; pm += es)
-			for (pl = pm; 
-			     pl > (char *)a && CMP(thunk, pl - es, pl) > 0;
-			     pl -= es) {
-				swap(pl, pl - es);
-				if (++swap_cnt > r) goto nevermind;
-			}
-		return;
-	}
+static void
+_psort_merge(void *ctx, size_t i)
+{
+	struct shared *s = ctx;
+	size_t lo = i * s->chunk, hi = MIN(lo + s->chunk, s->n);
 
-nevermind:
-	if ((r = pb - pa) > es) {
-		r /= es;
-		if (shared && r > shared->turnoff) {
-			union args *args = getargs(shared);
-
-			if (args == NULL)
-				LIBC_ABORT("%s: getargs: %s", shared->who, strerror(errno));
-			args->shared = shared;
-			args->a = a;
-			args->n = r;
-			args->depth_limit = depth_limit;
-			dispatch_group_async_f(shared->group, shared->queue, args,
-					_psort_parallel);
-		} else {
-#ifdef I_AM_PSORT_R
-			_psort(a, r, es, thunk, cmp, depth_limit, NULL);
-#else
-			_psort(a, r, es, cmp, depth_limit, NULL);
-#endif
-		}
-	}
-	if ((r = pd - pc) > es) {
-		/* Iterate rather than recurse to save stack space */
-		a = pn - r;
-		n = r / es;
-		goto loop;
-	}
-/*		psort(pn - r, r / es, es, cmp);*/
+	merge_range(s, s->src, s->dst, s->width, lo, hi);
 }
 
 static void
-_psort_parallel(void *x)
+_psort_copy(void *ctx, size_t i)
 {
-	union args *args = (union args *)x;
-	struct shared *shared = args->shared;
+	struct shared *s = ctx;
+	size_t lo = i * s->chunk, hi = MIN(lo + s->chunk, s->n);
 
-	_psort(args->a, args->n, shared->es,
-#ifdef I_AM_PSORT_R
-		shared->thunk,
-#endif
-		shared->cmp, args->depth_limit, shared);
-	returnargs(shared, args);
+	memcpy(s->base + lo * s->es, s->buf + lo * s->es, (hi - lo) * s->es);
 }
 
-/* fast, approximate integer square root */
-static size_t
-isqrt(size_t x)
+static void
+_psort_apply(struct shared *s, size_t count, void (*fn)(void *, size_t))
+{
+	if (count == 1) {
+		fn(s, 0);
+	} else {
+		dispatch_apply_f(count, DISPATCH_APPLY_AUTO, s, fn);
+	}
+}
+
+static int
+_psort_merge_sort(struct shared *s)
 {
-    size_t s = 1L << (flsl(x) / 2);
-    return (s + x / s) / 2;
+	size_t n = s->n, es = s->es, nchunks, want = n, passes = 0;
+	const char *src;
+	char *dst;
+
+	if (n > SIZE_MAX / es) {
+		errno = ENOMEM;
+		return -1;
+	}
+	if ((s->buf = malloc(n * es)) == NULL)
+		return -1;
+
+	if (n >= PARALLEL_MIN_SIZE && _NumCPUs() > 1) {
+		want = n / ((size_t)_NumCPUs() * PSORT_CHUNKS_PER_CPU);
+		want = MAX(want, PSORT_MIN_CHUNK);
+	}
+	/* Merge passes need chunks of a power of two times the stable runs */
+	for (s->chunk = PSORT_STABLE_RUN; s->chunk < want; s->chunk *= 2) {
+		if (s->stable)
+			passes++;
+	}
+	nchunks = (n - 1) / s->chunk + 1;
+	_psort_apply(s, nchunks, _psort_chunk);
+
+	src = s->base;
+	dst = s->buf;
+	if (passes % 2) {
+		src = s->buf;
+		dst = s->base;
+	}
+	for (s->width = s->chunk; s->width < n; s->width *= 2) {
+		s->src = src;
+		s->dst = dst;
+		_psort_apply(s, nchunks, _psort_merge);
+		src = dst;
+		dst = (char *)s->src;
+	}
+	if (src != s->base)
+		_psort_apply(s, nchunks, _psort_copy);
+
+	free(s->buf);
+	return 0;
 }
 
 void
@@ -370,55 +310,21 @@ psort_b(void *a, size_t n, size_t es, cmp_t ^cmp)
 psort(void *a, size_t n, size_t es, cmp_t *cmp)
 #endif
 {
-	if (n >= PARALLEL_MIN_SIZE && _NumCPUs() > 1) {
-		struct shared shared;
-		union args *args;
-
-		bzero(&shared, sizeof(shared));
-		shared.sharedlock = OS_UNFAIR_LOCK_INIT;
-		if ((args = getargs(&shared)) != NULL) {
-			struct page *p, *pp;
+	if (es != 0 && n >= PARALLEL_MIN_SIZE && _NumCPUs() > 1) {
+		struct shared s = {
+			.base = a,
+			.n = n,
+			.es = es,
+			.stable = false,
 #ifdef I_AM_PSORT_R
-			shared.who = "psort_r";
-			shared.thunk = thunk;
-#elif defined(I_AM_PSORT_B)
-			shared.who = "psort_b";
-#else
-			shared.who = "psort";
+			.thunk = thunk,
 #endif
-			shared.cmp = cmp;
-			shared.es = es;
-			shared.queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
-			shared.group = dispatch_group_create();
-			args->a = a;
-			args->n = n;
-			args->depth_limit = DEPTH(n);
-			args->shared = &shared;
-			/*
-			 * The turnoff value is the size of a partition that,
-			 * below which, we stop doing in parallel, and just do
-			 * in the current thread.  The value of sqrt(n) was
-			 * determined heuristically.  There is a smaller
-			 * dependence on the slowness of the comparison
-			 * function, and there might be a dependence on the
-			 * number of processors, but the algorithm has not been
-			 * determined.  Because the sensitivity to the turnoff
-			 * value is relatively low, we use a fast, approximate
-			 * integer square root routine that is good enough for
-			 * this purpose.
-			 */
-			shared.turnoff = isqrt(n);
-			_psort_parallel(args);
-
-			/* wait for queue to drain */
-			dispatch_group_wait(shared.group, DISPATCH_TIME_FOREVER);
-			dispatch_release(shared.group);
-			for(p = shared.pagelist; p; p = pp) {
-				pp = p->next;
-				munmap(p, PAGESIZE);
-			}
+			.cmp = cmp,
+		};
+
+		/* Without memory for the merges, sort in place below */
+		if (_psort_merge_sort(&s) == 0)
 			return;
-		}
 	}
 	/* Just call qsort */
 #ifdef I_AM_PSORT_R
@@ -429,3 +335,28 @@ psort(void *a, size_t n, size_t es, cmp_t *cmp)
 	qsort(a, n, es, cmp);
 #endif
 }
+
+int
+#ifdef I_AM_PSORT_R
+psort_stable_r(void *a, size_t n, size_t es, void *thunk, cmp_t *cmp)
+#elif defined(I_AM_PSORT_B)
+psort_stable_b(void *a, size_t n, size_t es, cmp_t ^cmp)
+#else
+psort_stable(void *a, size_t n, size_t es, cmp_t *cmp)
+#endif
+{
+	struct shared s = {
+		.base = a,
+		.n = n,
+		.es = es,
+		.stable = true,
+#ifdef I_AM_PSORT_R
+		.thunk = thunk,
+#endif
+		.cmp = cmp,
+	};
+
+	if (n < 2 || es == 0)
+		return 0;
+	return _psort_merge_sort(&s);
+}
@@ -33,279 +33,443 @@ static char sccsid[] = "@(#)qsort.c	8.1 (Berkeley) 6/4/93";
 #include <sys/cdefs.h>
 __FBSDID("$FreeBSD$");
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "sort_swap.h"
+
 #ifdef I_AM_QSORT_R
 typedef int		 cmp_t(void *, const void *, const void *);
+#define	CMP(t, x, y) (cmp((t), (x), (y)))
 #else
 typedef int		 cmp_t(const void *, const void *);
+#define	CMP(t, x, y) ((void)(t), cmp((x), (y)))
 #endif
-static inline char	*med3(char *, char *, char *, cmp_t *, void *);
-static inline void	 swapfunc(char *, char *, size_t, int, int);
 
+#define	LESS(x, y)	(CMP(thunk, (x), (y)) < 0)
 #define	MIN(a, b)	((a) < (b) ? a : b)
 
 /*
- * Qsort routine from Bentley & McIlroy's "Engineering a Sort Function".
+ * Pattern-defeating quicksort (Orson Peters, "Pattern-defeating Quicksort",
+ * 2021), with the block partitioning of BlockQuicksort (Edelkamp and Weiss,
+ * "BlockQuicksort: How Branch Mispredictions don't affect Quicksort", 2016).
+ *
+ * - Pivots are the median of 3 elements, or the median of 3 medians of 3 for
+ *   larger ranges.
+ * - Partitioning first records which elements of a block on either side are
+ *   on the wrong side, and then swaps them: the outcome of the comparisons
+ *   does not steer any branch.
+ * - A partition that moved nothing is checked for being sorted already with
+ *   an insertion sort that gives up after a few moves, which makes sorted,
+ *   reversed and mostly sorted inputs linear.
+ * - Unbalanced partitions shuffle a few elements to break the pattern that
+ *   caused them; after log2(n) of them, the range is heap sorted instead,
+ *   which bounds the worst case to O(n log n).
+ * - Ranges whose pivot equals the element before them only hold elements
+ *   equal to it and larger ones; the equal ones are put aside in one pass,
+ *   which makes inputs with few distinct values linear.
+ *
+ * Everything is inlined into one instance per element size, so that swaps of
+ * 4, 8 and 16 byte elements compile down to a few loads and stores.
  */
-#define	swapcode(TYPE, parmi, parmj, n) {		\
-	size_t i = (n) / sizeof (TYPE);			\
-	TYPE *pi = (TYPE *) (parmi);		\
-	TYPE *pj = (TYPE *) (parmj);		\
-	do { 						\
-		TYPE	t = *pi;		\
-		*pi++ = *pj;				\
-		*pj++ = t;				\
-	} while (--i > 0);				\
-}
 
-#define	SWAPINIT(TYPE, a, es) swaptype_ ## TYPE =	\
-	((char *)a - (char *)0) % sizeof(TYPE) ||	\
-	es % sizeof(TYPE) ? 2 : es == sizeof(TYPE) ? 0 : 1;
+#define	INSERTION_SORT_THRESHOLD	24
+#define	NINTHER_THRESHOLD		128
+#define	PARTIAL_INSERTION_SORT_LIMIT	8
+#define	BLOCK_SIZE			64
+
+#define	_SORT_AT(p, i)	((p) + (ptrdiff_t)(i) * (ptrdiff_t)es)
 
-static inline void
-swapfunc(char *a, char *b, size_t n, int swaptype_long, int swaptype_int)
+_SORT_INLINE void
+sort2(char *a, char *b, size_t es, void *thunk, cmp_t *cmp)
 {
-	if (swaptype_long <= 1)
-		swapcode(long, a, b, n)
-	else if (swaptype_int <= 1)
-		swapcode(int, a, b, n)
-	else
-		swapcode(char, a, b, n)
+	if (LESS(b, a))
+		_sort_swap(a, b, es);
 }
 
-#define	swap(a, b)					\
-	if (swaptype_long == 0) {			\
-		long t = *(long *)(a);			\
-		*(long *)(a) = *(long *)(b);		\
-		*(long *)(b) = t;			\
-	} else if (swaptype_int == 0) {			\
-		int t = *(int *)(a);			\
-		*(int *)(a) = *(int *)(b);		\
-		*(int *)(b) = t;			\
-	} else						\
-		swapfunc(a, b, es, swaptype_long, swaptype_int)
-
-#define	vecswap(a, b, n)				\
-	if ((n) > 0) swapfunc(a, b, n, swaptype_long, swaptype_int)
+_SORT_INLINE void
+sort3(char *a, char *b, char *c, size_t es, void *thunk, cmp_t *cmp)
+{
+	sort2(a, b, es, thunk, cmp);
+	sort2(b, c, es, thunk, cmp);
+	sort2(a, b, es, thunk, cmp);
+}
 
-#ifdef I_AM_QSORT_R
-#define	CMP(t, x, y) (cmp((t), (x), (y)))
-#else
-#define	CMP(t, x, y) (cmp((x), (y)))
-#endif
+/*
+ * Insertion sort of [begin, end).
+ *
+ * None of the scans here or in the partitions below count on another element
+ * to stop them, as a comparator that is not a consistent order (one that says
+ * a < b and b < a, say) would walk them off the array. Such a comparator
+ * leaves the array in some unspecified order, but qsort still returns and
+ * only touches the elements it was given.
+ */
+_SORT_INLINE void
+insertion_sort(char *begin, char *end, size_t es, void *thunk, cmp_t *cmp)
+{
+	for (char *cur = begin + es; cur < end; cur += es) {
+		for (char *sift = cur; sift > begin && LESS(sift, sift - es);
+		    sift -= es)
+			_sort_swap(sift - es, sift, es);
+	}
+}
 
 /*
- * Find the median of 3 elements
+ * Insertion sort of [begin, end) that gives up after moving elements
+ * PARTIAL_INSERTION_SORT_LIMIT places in total. Returns whether the range
+ * ended up sorted.
  */
-static inline char *
-med3(char *a, char *b, char *c, cmp_t *cmp, void *thunk
-#ifndef I_AM_QSORT_R
-__unused
-#endif
-)
+_SORT_INLINE bool
+partial_insertion_sort(char *begin, char *end, size_t es, void *thunk,
+    cmp_t *cmp)
 {
-	return CMP(thunk, a, b) < 0 ?
-	       (CMP(thunk, b, c) < 0 ? b : (CMP(thunk, a, c) < 0 ? c : a ))
-	      :(CMP(thunk, b, c) > 0 ? b : (CMP(thunk, a, c) < 0 ? a : c ));
+	size_t moves = 0;
+
+	for (char *cur = begin + es; cur < end; cur += es) {
+		char *sift = cur;
+		for (; sift > begin && LESS(sift, sift - es); sift -= es)
+			_sort_swap(sift - es, sift, es);
+		moves += (size_t)(cur - sift) / es;
+		if (moves > PARTIAL_INSERTION_SORT_LIMIT)
+			return false;
+	}
+	return true;
 }
 
-#ifdef __LP64__
-#define DEPTH(x)	(2 * (flsl((long)(x)) - 1))
-#else /* !__LP64__ */
-#define DEPTH(x)	(2 * (fls((int)(x)) - 1))
-#endif /* __LP64__ */
+_SORT_INLINE void
+sift_down(char *a, size_t i, size_t n, size_t es, void *thunk, cmp_t *cmp)
+{
+	for (;;) {
+		size_t child = 2 * i + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n &&
+		    LESS(_SORT_AT(a, child), _SORT_AT(a, child + 1)))
+			child++;
+		if (!LESS(_SORT_AT(a, i), _SORT_AT(a, child)))
+			break;
+		_sort_swap(_SORT_AT(a, i), _SORT_AT(a, child), es);
+		i = child;
+	}
+}
 
-#ifdef I_AM_QSORT_R
-int __heapsort_r(void *, size_t, size_t, void *, int (*)(void *, const void *, const void *));
-#endif
+/* In place, unlike heapsort(3), so that qsort cannot fail. */
+_SORT_INLINE void
+heap_sort(char *a, size_t n, size_t es, void *thunk, cmp_t *cmp)
+{
+	for (size_t i = n / 2; i-- > 0;)
+		sift_down(a, i, n, es, thunk, cmp);
+	for (size_t i = n; i-- > 1;) {
+		_sort_swap(a, _SORT_AT(a, i), es);
+		sift_down(a, 0, i, es, thunk, cmp);
+	}
+}
+
+_SORT_INLINE void
+swap_offsets(char *first, char *last, const unsigned char *offsets_l,
+    const unsigned char *offsets_r, size_t num, size_t es)
+{
+	for (size_t i = 0; i < num; i++)
+		_sort_swap(_SORT_AT(first, offsets_l[i]),
+		    _SORT_AT(last, -(ptrdiff_t)offsets_r[i]), es);
+}
 
 /*
- * Simple insertion sort routine.
+ * Partitions [begin, end) around the pivot at begin: smaller elements go to
+ * its left, the others to its right. Returns the final position of the
+ * pivot, and whether no element had to move.
  */
-static bool
-_isort(void *a, size_t n, size_t es, void *thunk, cmp_t *cmp, int swap_limit, int swaptype_long, int swaptype_int)
+_SORT_INLINE char *
+partition_right(char *begin, char *end, size_t es, bool *already_partitioned,
+    void *thunk, cmp_t *cmp)
 {
-	int swap_cnt = 0;
-	for (char *pm = (char *)a + es; pm < (char *)a + n * es; pm += es) {
-		for (char *pl = pm; pl > (char *)a && CMP(thunk, pl - es, pl) > 0;
-				pl -= es) {
-			swap(pl, pl - es);
-			if (swap_limit && ++swap_cnt > swap_limit) return false;
+	const char *pivot = begin;
+	char *first = begin, *last = end;
+
+	while ((first += es) < end && LESS(first, pivot))
+		;
+	while (first < last && !LESS(last -= es, pivot))
+		;
+
+	*already_partitioned = first >= last;
+	if (!*already_partitioned) {
+		unsigned char offsets_l[BLOCK_SIZE], offsets_r[BLOCK_SIZE];
+		size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0, num;
+		const size_t block = BLOCK_SIZE * es;
+		char *it;
+
+		_sort_swap(first, last, es);
+		first += es;
+
+		/*
+		 * [first, last) is left to partition. Record the offsets of the
+		 * elements that need to move in a block from either end, then
+		 * swap as many pairs as possible.
+		 */
+		while ((size_t)(last - first) > 2 * block) {
+			if (num_l == 0) {
+				start_l = 0;
+				it = first;
+				for (size_t i = 0; i < BLOCK_SIZE; i++, it += es) {
+					offsets_l[num_l] = (unsigned char)i;
+					num_l += !LESS(it, pivot);
+				}
+			}
+			if (num_r == 0) {
+				start_r = 0;
+				it = last;
+				for (size_t i = 0; i < BLOCK_SIZE;) {
+					offsets_r[num_r] = (unsigned char)++i;
+					num_r += LESS(it -= es, pivot);
+				}
+			}
+
+			num = MIN(num_l, num_r);
+			swap_offsets(first, last, offsets_l + start_l,
+			    offsets_r + start_r, num, es);
+			num_l -= num;
+			num_r -= num;
+			start_l += num;
+			start_r += num;
+			if (num_l == 0)
+				first += block;
+			if (num_r == 0)
+				last -= block;
+		}
+
+		/* Same with what remains, less than 2 blocks */
+		size_t l_size, r_size;
+		size_t unknown_left = (size_t)(last - first) / es -
+		    ((num_r || num_l) ? BLOCK_SIZE : 0);
+		if (num_r) {
+			l_size = unknown_left;
+			r_size = BLOCK_SIZE;
+		} else if (num_l) {
+			l_size = BLOCK_SIZE;
+			r_size = unknown_left;
+		} else {
+			l_size = unknown_left / 2;
+			r_size = unknown_left - l_size;
+		}
+
+		if (unknown_left && !num_l) {
+			start_l = 0;
+			it = first;
+			for (size_t i = 0; i < l_size; i++, it += es) {
+				offsets_l[num_l] = (unsigned char)i;
+				num_l += !LESS(it, pivot);
+			}
+		}
+		if (unknown_left && !num_r) {
+			start_r = 0;
+			it = last;
+			for (size_t i = 0; i < r_size;) {
+				offsets_r[num_r] = (unsigned char)++i;
+				num_r += LESS(it -= es, pivot);
+			}
+		}
+
+		num = MIN(num_l, num_r);
+		swap_offsets(first, last, offsets_l + start_l,
+		    offsets_r + start_r, num, es);
+		num_l -= num;
+		num_r -= num;
+		start_l += num;
+		start_r += num;
+		if (num_l == 0)
+			first += l_size * es;
+		if (num_r == 0)
+			last -= r_size * es;
+
+		/* One side has elements left to move, into the other one */
+		if (num_l) {
+			while (num_l--) {
+				char *l = _SORT_AT(first, offsets_l[start_l + num_l]);
+				last -= es;
+				if (l != last)
+					_sort_swap(l, last, es);
+			}
+			first = last;
+		}
+		if (num_r) {
+			while (num_r--) {
+				char *r = _SORT_AT(last,
+				    -(ptrdiff_t)offsets_r[start_r + num_r]);
+				if (r != first)
+					_sort_swap(r, first, es);
+				first += es;
+			}
 		}
 	}
-	return true;
+
+	char *pivot_pos = first - es;
+	if (pivot_pos != begin)
+		_sort_swap(begin, pivot_pos, es);
+	return pivot_pos;
 }
 
-#ifdef I_AM_QSORT_R
-static void
-_qsort(void *a, size_t n, size_t es, void *thunk, cmp_t *cmp, int depth_limit)
-#else
-#define	thunk NULL
-static void
-_qsort(void *a, size_t n, size_t es, cmp_t *cmp, int depth_limit)
-#endif
+/*
+ * Partitions [begin, end) around the pivot at begin, which no element of the
+ * range is smaller than: elements equal to the pivot go to its left, and the
+ * larger ones to its right. Returns the final position of the pivot.
+ */
+_SORT_INLINE char *
+partition_left(char *begin, char *end, size_t es, void *thunk, cmp_t *cmp)
 {
-	char *pa, *pb, *pc, *pd, *pl, *pm, *pn;
-	size_t d1, d2;
-	int cmp_result;
-	int swaptype_long, swaptype_int, swap_cnt;
+	const char *pivot = begin;
+	char *first = begin, *last = end;
 
-loop:
-	SWAPINIT(long, a, es);
-	SWAPINIT(int, a, es);
-	swap_cnt = 0;
+	while ((last -= es) > begin && LESS(pivot, last))
+		;
+	while (first < last && !LESS(pivot, first += es))
+		;
 
-	if (depth_limit-- <= 0) {
-		/*
-		 * We've hit our recursion limit, switch to heapsort
-		 */
-#ifdef I_AM_QSORT_R
-		__heapsort_r(a, n, es, thunk, cmp);
-#else
-		heapsort(a, n, es, cmp);
-#endif
-		return;
+	while (first < last) {
+		_sort_swap(first, last, es);
+		while ((last -= es) > begin && LESS(pivot, last))
+			;
+		while (first < last && !LESS(pivot, first += es))
+			;
 	}
 
-	if (n <= 7) {
-		/*
-		 * For sufficiently small inputs, we'll just insertion sort.
-		 *
-		 * Pass 0 as swap limit, since this must complete.
-		 */
-		_isort(a, n, es, thunk, cmp, 0, swaptype_long, swaptype_int);
+	if (last != begin)
+		_sort_swap(begin, last, es);
+	return last;
+}
+
+/* Swaps a few elements of a range left unbalanced by a bad pivot */
+_SORT_INLINE void
+break_patterns(char *begin, char *end, size_t size, size_t es)
+{
+	size_t q = size / 4;
+
+	if (size < INSERTION_SORT_THRESHOLD)
 		return;
+	_sort_swap(begin, _SORT_AT(begin, q), es);
+	_sort_swap(_SORT_AT(end, -1), _SORT_AT(end, -(ptrdiff_t)q), es);
+	if (size > NINTHER_THRESHOLD) {
+		_sort_swap(_SORT_AT(begin, 1), _SORT_AT(begin, q + 1), es);
+		_sort_swap(_SORT_AT(begin, 2), _SORT_AT(begin, q + 2), es);
+		_sort_swap(_SORT_AT(end, -2), _SORT_AT(end, -(ptrdiff_t)q - 1), es);
+		_sort_swap(_SORT_AT(end, -3), _SORT_AT(end, -(ptrdiff_t)q - 2), es);
 	}
+}
 
-	/*
-	 * Compute the pseudomedian.  Small arrays use 3 samples, large ones use 9.
-	 */
-	pl = a;
-	pm = (char *)a + (n / 2) * es;
-	pn = (char *)a + (n - 1) * es;
-	if (n > 40) {
-		size_t d = (n / 8) * es;
-
-		pl = med3(pl, pl + d, pl + 2 * d, cmp, thunk);
-		pm = med3(pm - d, pm, pm + d, cmp, thunk);
-		pn = med3(pn - 2 * d, pn - d, pn, cmp, thunk);
-	}
-	pm = med3(pl, pm, pn, cmp, thunk);
+struct sort_range {
+	char	*begin;
+	char	*end;
+	int	bad_allowed;
+	bool	leftmost;
+};
 
+_SORT_INLINE void
+_pdqsort(char *a, size_t n, size_t es, void *thunk, cmp_t *cmp)
+{
 	/*
-	 * Pull the median to the front, starting us with:
-	 *
-	 * +-+-------------+
-	 * |=|      ?      |
-	 * +-+-------------+
-	 * a pa,pb         pc,pd
+	 * The larger side of each partition waits on this stack while the
+	 * smaller one is sorted, so it never holds more than log2(n) ranges.
 	 */
-	swap(a, pm);
-	pa = pb = (char *)a + es;
-	pc = pd = (char *)a + (n - 1) * es;
+	struct sort_range stack[sizeof(size_t) * CHAR_BIT];
+	size_t depth = 0;
+	char *begin = a, *end = _SORT_AT(a, n);
+	int bad_allowed = flsl((long)n);
+	bool leftmost = true;
 
 	for (;;) {
-		/*
-		 * - Move b forward while it's less than the median
-		 * - Move c backwards while it's greater than the median
-		 * - When equal to the median, swap to the outside
-		 */
-		while (pb <= pc && (cmp_result = CMP(thunk, pb, a)) <= 0) {
-			if (cmp_result == 0) {
-				swap_cnt = 1;
-				swap(pa, pb);
-				pa += es;
-			}
-			pb += es;
-		}
-		while (pb <= pc && (cmp_result = CMP(thunk, pc, a)) >= 0) {
-			if (cmp_result == 0) {
-				swap_cnt = 1;
-				swap(pc, pd);
-				pd -= es;
+		size_t size = (size_t)(end - begin) / es;
+		bool done = false;
+
+		if (size < INSERTION_SORT_THRESHOLD) {
+			insertion_sort(begin, end, es, thunk, cmp);
+			done = true;
+		} else {
+			size_t s2 = size / 2;
+			char *mid = _SORT_AT(begin, s2);
+
+			if (size > NINTHER_THRESHOLD) {
+				sort3(begin, mid, _SORT_AT(end, -1), es, thunk, cmp);
+				sort3(_SORT_AT(begin, 1), _SORT_AT(mid, -1),
+				    _SORT_AT(end, -2), es, thunk, cmp);
+				sort3(_SORT_AT(begin, 2), _SORT_AT(mid, 1),
+				    _SORT_AT(end, -3), es, thunk, cmp);
+				sort3(_SORT_AT(mid, -1), mid, _SORT_AT(mid, 1), es,
+				    thunk, cmp);
+				_sort_swap(begin, mid, es);
+			} else {
+				sort3(mid, begin, _SORT_AT(end, -1), es, thunk, cmp);
 			}
-			pc -= es;
-		}
-		if (pb > pc)
-			break;
-		swap(pb, pc);
-		swap_cnt = 1;
-		pb += es;
-		pc -= es;
-	}
 
-	/*
-	 * Now we've got:
-	 *
-	 * +---+-----+-----+---+
-	 * | = |  <  |  >  | = |
-	 * +---+-----+-----+---+
-	 * a   pa  pc,pb   pd  pn
-	 *
-	 * So swap the '=' into the middle
-	 */
+			if (!leftmost && !LESS(begin - es, begin)) {
+				begin = partition_left(begin, end, es, thunk, cmp) + es;
+				continue;
+			}
 
-	pn = (char *)a + n * es;
-	d1 = MIN(pa - (char *)a, pb - pa);
-	vecswap(a, pb - d1, d1);
-	d1 = MIN(pd - pc, pn - pd - es);
-	vecswap(pb, pn - d1, d1);
+			bool already_partitioned;
+			char *pivot_pos = partition_right(begin, end, es,
+			    &already_partitioned, thunk, cmp);
+			size_t l_size = (size_t)(pivot_pos - begin) / es;
+			size_t r_size = size - l_size - 1;
 
-	/*
-	 * +-----+---+---+-----+
-	 * |  <  |   =   |  >  |
-	 * +-----+---+---+-----+
-	 * a                   pn
-	 */
+			if (l_size < size / 8 || r_size < size / 8) {
+				if (--bad_allowed == 0) {
+					heap_sort(begin, size, es, thunk, cmp);
+					done = true;
+				} else {
+					break_patterns(begin, pivot_pos, l_size, es);
+					break_patterns(pivot_pos + es, end, r_size, es);
+				}
+			} else if (already_partitioned &&
+			    partial_insertion_sort(begin, pivot_pos, es, thunk,
+			    cmp) &&
+			    partial_insertion_sort(pivot_pos + es, end, es, thunk,
+			    cmp)) {
+				done = true;
+			}
 
-	if (swap_cnt == 0) {  /* Switch to insertion sort */
-		int r = 1 + n / 4; /* n > 7, so r >= 2 */
-		if (!_isort(a, n, es, thunk, cmp, r, swaptype_long, swaptype_int)) {
-			goto nevermind;
+			if (!done) {
+				struct sort_range *r = &stack[depth++];
+				r->bad_allowed = bad_allowed;
+				if (l_size <= r_size) {
+					r->begin = pivot_pos + es;
+					r->end = end;
+					r->leftmost = false;
+					end = pivot_pos;
+				} else {
+					r->begin = begin;
+					r->end = pivot_pos;
+					r->leftmost = leftmost;
+					begin = pivot_pos + es;
+					leftmost = false;
+				}
+				continue;
+			}
 		}
-		return;
-	}
-nevermind:
 
-	d1 = pb - pa;
-	d2 = pd - pc;
-	if (d1 <= d2) {
-		/* Recurse on left partition, then iterate on right partition */
-		if (d1 > es) {
-#ifdef I_AM_QSORT_R
-			_qsort(a, d1 / es, es, thunk, cmp, depth_limit);
-#else
-			_qsort(a, d1 / es, es, cmp, depth_limit);
-#endif
-		}
-		if (d2 > es) {
-			/* Iterate rather than recurse to save stack space */
-			/* qsort(pn - d2, d2 / es, es, cmp); */
-			a = pn - d2;
-			n = d2 / es;
-			goto loop;
-		}
-	} else {
-		/* Recurse on right partition, then iterate on left partition */
-		if (d2 > es) {
-#ifdef I_AM_QSORT_R
-			_qsort(pn - d2, d2 / es, es, thunk, cmp, depth_limit);
-#else
-			_qsort(pn - d2, d2 / es, es, cmp, depth_limit);
-#endif
-		}
-		if (d1 > es) {
-			/* Iterate rather than recurse to save stack space */
-			/* qsort(a, d1 / es, es, cmp); */
-			n = d1 / es;
-			goto loop;
-		}
+		if (depth == 0)
+			return;
+		depth--;
+		begin = stack[depth].begin;
+		end = stack[depth].end;
+		bad_allowed = stack[depth].bad_allowed;
+		leftmost = stack[depth].leftmost;
 	}
 }
 
+#define	PDQSORT_INSTANCE(name, size)					\
+static __attribute__((__noinline__)) void				\
+name(char *a, size_t n, size_t es, void *thunk, cmp_t *cmp)		\
+{									\
+	(void)es;							\
+	_pdqsort(a, n, size, thunk, cmp);				\
+}
+
+PDQSORT_INSTANCE(_pdqsort_4, 4)
+PDQSORT_INSTANCE(_pdqsort_8, 8)
+PDQSORT_INSTANCE(_pdqsort_16, 16)
+PDQSORT_INSTANCE(_pdqsort_any, es)
+
 void
 #ifdef I_AM_QSORT_R
 qsort_r(void *a, size_t n, size_t es, void *thunk, cmp_t *cmp)
@@ -313,9 +477,25 @@ qsort_r(void *a, size_t n, size_t es, void *thunk, cmp_t *cmp)
 qsort(void *a, size_t n, size_t es, cmp_t *cmp)
 #endif
 {
-	_qsort(a, n, es,
-#ifdef I_AM_QSORT_R
-		thunk,
+#ifndef I_AM_QSORT_R
+	void *thunk = NULL;
 #endif
-		cmp, DEPTH(n));
+
+	if (n <= 1 || es == 0)
+		return;
+
+	switch (es) {
+	case 4:
+		_pdqsort_4(a, n, es, thunk, cmp);
+		break;
+	case 8:
+		_pdqsort_8(a, n, es, thunk, cmp);
+		break;
+	case 16:
+		_pdqsort_16(a, n, es, thunk, cmp);
+		break;
+	default:
+		_pdqsort_any(a, n, es, thunk, cmp);
+		break;
+	}
 }
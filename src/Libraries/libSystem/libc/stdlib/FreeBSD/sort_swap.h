@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+#ifndef _SORT_SWAP_H_
+#define _SORT_SWAP_H_
+
+/*
+ * Element moves shared by the sort routines.
+ *
+ * Elements of 4, 8 and 16 bytes (ints, pointers, pairs of them) are moved
+ * with single loads and stores, whatever their alignment. When es is a
+ * constant, as in the size specialized qsort instances, the dispatch on it
+ * disappears; otherwise it is a well predicted branch.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define _SORT_INLINE static inline __attribute__((__always_inline__))
+
+#define _SORT_SWAP_FIXED(a, b, n) do {	\
+	char _t[n];			\
+	memcpy(_t, (a), (n));		\
+	memcpy((a), (b), (n));		\
+	memcpy((b), _t, (n));		\
+} while (0)
+
+_SORT_INLINE void
+_sort_swap(char *a, char *b, size_t es)
+{
+	switch (es) {
+	case 4:
+		_SORT_SWAP_FIXED(a, b, 4);
+		return;
+	case 8:
+		_SORT_SWAP_FIXED(a, b, 8);
+		return;
+	case 16:
+		_SORT_SWAP_FIXED(a, b, 16);
+		return;
+	}
+	for (; es >= sizeof(uint64_t); es -= sizeof(uint64_t)) {
+		_SORT_SWAP_FIXED(a, b, sizeof(uint64_t));
+		a += sizeof(uint64_t);
+		b += sizeof(uint64_t);
+	}
+	for (; es; es--, a++, b++) {
+		char t = *a;
+		*a = *b;
+		*b = t;
+	}
+}
+
+_SORT_INLINE void
+_sort_copy(char *dst, const char *src, size_t es)
+{
+	switch (es) {
+	case 4:
+		memcpy(dst, src, 4);
+		return;
+	case 8:
+		memcpy(dst, src, 8);
+		return;
+	case 16:
+		memcpy(dst, src, 16);
+		return;
+	}
+	memcpy(dst, src, es);
+}
+
+#endif /* _SORT_SWAP_H_ */
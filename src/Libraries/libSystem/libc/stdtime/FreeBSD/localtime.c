@@ -28,14 +28,15 @@ __FBSDID("$FreeBSD: head/contrib/tzcode/stdtime/localtime.c 289027 2015-10-08 11
 #include <time.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <stdatomic.h>
+/* force ALL_STATE, local time states are published to lock-free readers */
+#ifndef ALL_STATE
+#define ALL_STATE
+#endif /* ALL_STATE */
 #ifdef NOTIFY_TZ
 //#define NOTIFY_TZ_DEBUG
 //#define NOTIFY_TZ_DEBUG_FILE	"/var/log/localtime.debug"
 //#define NOTIFY_TZ_LOG	"/var/log/localtime.log"
-/* force ALL_STATE if NOTIFY_TZ is set */
-#ifndef ALL_STATE
-#define ALL_STATE
-#endif /* ALL_STATE */
 #include <mach/mach_init.h>
 #include <notify.h>
 #include <alloca.h>
@@ -169,6 +170,14 @@ struct state {
 	char		chars[BIGGEST(BIGGEST(TZ_MAX_CHARS + 1, sizeof gmt),
 				(2 * (MY_TZNAME_MAX + 1)))];
 	struct lsinfo	lsis[TZ_MAX_LEAPS];
+	/* Local time states only, see lcl_load() */
+	int		lcl_set;	/* > 0 for TZ, < 0 for the wall clock */
+	unsigned	lcl_gen;	/* lcl_gen it was last loaded in */
+	char *		lcl_name;	/* TZ if lcl_set > 0 */
+	struct state *	lcl_next;	/* next in lcl_states */
+#ifdef NOTIFY_TZ
+	char		lcl_file[FILENAME_MAX + 1];	/* to monitor, or "" */
+#endif /* NOTIFY_TZ */
 };
 
 struct rule {
@@ -186,7 +195,7 @@ struct rule {
 #ifdef NOTIFY_TZ
 typedef struct {
 	int token;
-	int is_set;
+	_Atomic int is_set;	/* read without lcl_rwlock by lcl_update() */
 } notify_tz_t;
 
 #define NOTIFY_TZ_NAME		"com.apple.system.timezone"
@@ -297,7 +306,7 @@ static int		tzparse(const char * name, struct state * sp,
 				int lastditch);
 
 #ifdef ALL_STATE
-static struct state *	lclptr;
+static struct state * _Atomic	lclptr;
 static struct state *	gmtptr;
 #endif /* defined ALL_STATE */
 
@@ -308,16 +317,22 @@ static struct state	gmtmem;
 #define gmtptr		(&gmtmem)
 #endif /* State Farm */
 
-#ifndef TZ_STRLEN_MAX
-#define TZ_STRLEN_MAX 255
-#endif /* !defined TZ_STRLEN_MAX */
-
-static char		lcl_TZname[TZ_STRLEN_MAX + 1];
+/*
+** Every local time state loaded, newest first, and the generation of time
+** zone files they were loaded from; see lcl_load().  Past LCL_STATES_MAX of
+** them, other time zones are loaded into one of the two lcl_spares, which
+** are allocated once and never freed.
+*/
+#define LCL_STATES_MAX	16
+static struct state *	lcl_states;
+static int		lcl_nstates;
+static struct state * _Atomic	lcl_spares[2];
+static unsigned		lcl_gen;
 #ifdef NOTIFY_TZ
 #define lcl_is_set    (lcl_notify.is_set)
 #define gmt_is_set    (gmt_notify.is_set)
 #else /* ! NOTIFY_TZ */
-static int		lcl_is_set;
+static _Atomic int	lcl_is_set;
 #endif /* NOTIFY_TZ */
 static pthread_once_t	gmt_once = PTHREAD_ONCE_INIT;
 __private_extern__ pthread_rwlock_t	lcl_rwlock = PTHREAD_RWLOCK_INITIALIZER;
@@ -1553,76 +1568,248 @@ tzsetwall_check_default_file_timestamp(void)
 	}
 }
 
-static void
-tzsetwall_basic(int rdlocked)
+/*
+** localtime() and localtime_r() read lclptr without taking lcl_rwlock, so a
+** state is never changed or freed once it has been published there (tm_zone
+** in their results points into it anyway).  To change the local time zone,
+** lcl_update() takes lcl_rwlock for writing and publishes a new state, or one
+** loaded earlier for the same TZ.  mktime() holds lcl_rwlock for reading, so
+** that lclptr stays put through its several conversions.
+**
+** Reuse is what bounds the memory kept.  A change to the time zone files
+** (lcl_is_set going to 0) starts a new generation, after which the states of
+** the old one are loaded again before reuse, and only replaced when they
+** convert differently.
+**
+** At most LCL_STATES_MAX states (some 20KB each) are kept that way.  A
+** process going through more time zones than that gets the others loaded
+** into two more states, lcl_spares, in turn: a time zone is always loaded
+** into the spare that lclptr does not point to, so that no state is changed
+** while lclptr leads to it.  Spares are told apart by their address, and
+** only read with lcl_rwlock held, since the next time zone but one is loaded
+** over them; tm_zone in results for them (like tzname) changes then.
+*/
+
+/* Whether sp, read from lclptr, is one of lcl_spares */
+static int
+lcl_is_spare(const struct state * const sp)
 {
-#ifdef NOTIFY_TZ
-	if (bootstrap_port != MACH_PORT_NULL) {
-		notify_check_tz(&lcl_notify);
-	} else {
-		tzsetwall_check_default_file_timestamp();
-	}
-#else
-	tzsetwall_check_default_file_timestamp();
-#endif /* NOTIFY_TZ */
+	/* lcl_spares are set before lclptr is released to them */
+	return sp == atomic_load_explicit(&lcl_spares[0], memory_order_relaxed) ||
+	    sp == atomic_load_explicit(&lcl_spares[1], memory_order_relaxed);
+}
 
-	if (!rdlocked)
-		_RWLOCK_RDLOCK(&lcl_rwlock);
-	if (lcl_is_set < 0) {
-#ifdef NOTIFY_TZ_DEBUG
-		NOTIFY_TZ_PRINTF("tzsetwall_basic lcl_is_set < 0\n");
-#endif
-		if (!rdlocked)
-			_RWLOCK_UNLOCK(&lcl_rwlock);
-		return;
-	}
-#ifdef NOTIFY_TZ_DEBUG
-	NOTIFY_TZ_PRINTF("tzsetwall_basic not set\n");
-#endif
-	_RWLOCK_UNLOCK(&lcl_rwlock);
+/* Whether states a and b, both loaded, convert times the same way */
+static int
+lcl_same(const struct state * const a, const struct state * const b)
+{
+	return a->leapcnt == b->leapcnt && a->timecnt == b->timecnt &&
+	    a->typecnt == b->typecnt && a->charcnt == b->charcnt &&
+	    a->goback == b->goback && a->goahead == b->goahead &&
+	    memcmp(a->ats, b->ats, a->timecnt * sizeof a->ats[0]) == 0 &&
+	    memcmp(a->types, b->types, a->timecnt * sizeof a->types[0]) == 0 &&
+	    memcmp(a->ttis, b->ttis, a->typecnt * sizeof a->ttis[0]) == 0 &&
+	    memcmp(a->chars, b->chars, a->charcnt) == 0 &&
+	    memcmp(a->lsis, b->lsis, a->leapcnt * sizeof a->lsis[0]) == 0;
+}
 
-	_RWLOCK_WRLOCK(&lcl_rwlock);
-	lcl_is_set = -1;
+/* Whether sp is the local time state for TZ name, the wall clock if NULL */
+static int
+lcl_current(const struct state * const sp, const char * const name)
+{
+	int	is_set;
 
-#ifdef ALL_STATE
-	if (lclptr == NULL) {
-		lclptr = calloc(1, sizeof *lclptr);
-		if (lclptr == NULL) {
-			settzname();	/* all we can do */
-			_RWLOCK_UNLOCK(&lcl_rwlock);
-			if (rdlocked)
-				_RWLOCK_RDLOCK(&lcl_rwlock);
-			return;
-		}
-	}
-#endif /* defined ALL_STATE */
+	if (sp == NULL)
+		return FALSE;
+	is_set = atomic_load_explicit(&lcl_is_set, memory_order_relaxed);
+	if (name == NULL)
+		return is_set < 0 && sp->lcl_set < 0;
+	return is_set > 0 && sp->lcl_set > 0 &&
+	    strcmp(sp->lcl_name, name) == 0;
+}
+
+/* Load the time zone for TZ name, the wall clock if NULL, into a fresh sp */
+static void
+lcl_fill(struct state * const sp, const char * const name)
+{
+	if (name == NULL) {
 #ifdef NOTIFY_TZ
-	{
-		char		fullname[FILENAME_MAX + 1];
-		if (tzload((char *) NULL, lclptr, fullname, TRUE) != 0) {
+		if (tzload((char *) NULL, sp, sp->lcl_file, TRUE) != 0) {
 			// The load failed, so we need to reset the cached modified time
 			// of the timezone file
 			last_default_tzload_mtimespec = (const struct timespec){0};
 
 			/*
-			 * If fullname is empty (an error occurred) then
+			 * If lcl_file is empty (an error occurred) then
 			 * default to the UTC path
 			 */
-			gmtload(lclptr, *fullname ? NULL : fullname);
+			gmtload(sp, *sp->lcl_file ? NULL : sp->lcl_file);
+		}
+#else /* ! NOTIFY_TZ */
+		if (tzload((char *) NULL, sp, TRUE) != 0)
+			gmtload(sp);
+#endif /* NOTIFY_TZ */
+		return;
+	}
+	if (*name == '\0') {
+		/*
+		** User wants it fast rather than right.
+		*/
+		sp->leapcnt = 0;		/* so, we're off a little */
+		sp->timecnt = 0;
+		sp->typecnt = 0;
+		sp->ttis[0].tt_isdst = 0;
+		sp->ttis[0].tt_gmtoff = 0;
+		sp->ttis[0].tt_abbrind = 0;
+		(void) strcpy(sp->chars, gmt);
+	} else
+#ifdef NOTIFY_TZ
+	{
+		/*
+		 * If tzparse() succeeds, TZ is a time conversion
+		 * specification, so we don't need to register for
+		 * notifications.
+		 */
+		if (tzload(name, sp, sp->lcl_file, TRUE) != 0) {
+			if (name[0] != ':' && tzparse(name, sp, FALSE) == 0)
+				*sp->lcl_file = '\0';
+			else {
+				/*
+				 * If lcl_file is empty (an error occurred) then
+				 * default to the UTC path
+				 */
+				(void) gmtload(sp, *sp->lcl_file ? NULL : sp->lcl_file);
+			}
 		}
-		notify_register_tz(fullname, &lcl_notify);
 	}
 #else /* ! NOTIFY_TZ */
-	if (tzload((char *) NULL, lclptr, TRUE) != 0)
-		gmtload(lclptr);
+	if (tzload(name, sp, TRUE) != 0)
+		if (name[0] == ':' || tzparse(name, sp, FALSE) != 0)
+			(void) gmtload(sp);
+#endif /* NOTIFY_TZ */
+}
+
+/*
+** Make the time zone for TZ name, the wall clock if NULL, the local one.
+** Called with lcl_rwlock held for writing.
+*/
+static void
+lcl_load(const char * const name)
+{
+	struct state *	sp;
+	struct state *	old;
+	char *		name_copy = NULL;
+	int		set = (name == NULL) ? -1 : 1;
+	int		spare = -1;
+
+	if (lcl_is_set == 0)
+		++lcl_gen;
+	for (old = lcl_states; old != NULL; old = old->lcl_next)
+		if (old->lcl_set == set &&
+		    (name == NULL || strcmp(old->lcl_name, name) == 0) &&
+		    old->lcl_gen == lcl_gen)
+			break;
+	if ((sp = old) == NULL) {
+		if (lcl_nstates < LCL_STATES_MAX)
+			sp = (struct state *) calloc(1, sizeof *sp);
+		else {
+			/* the spare lclptr doesn't lead to */
+			spare = (lclptr == lcl_spares[0]);
+			if ((sp = lcl_spares[spare]) == NULL &&
+			    (sp = (struct state *) calloc(1,
+			    sizeof *sp)) != NULL)
+				lcl_spares[spare] = sp;
+		}
+		if (sp == NULL || (name != NULL &&
+		    (name_copy = strdup(name)) == NULL)) {
+			if (spare < 0)
+				free(sp);
+			settzname();	/* all we can do */
+			return;
+		}
+		if (spare >= 0) {
+			free(sp->lcl_name);
+			memset(sp, 0, sizeof *sp);
+		}
+		sp->lcl_name = name_copy;
+		sp->lcl_set = set;
+		sp->lcl_gen = lcl_gen;
+		lcl_fill(sp, name);
+		for (old = lcl_states; old != NULL; old = old->lcl_next)
+			if (old->lcl_set == set &&
+			    (name == NULL || strcmp(old->lcl_name, name) == 0) &&
+			    lcl_same(old, sp))
+				break;
+		if (old != NULL) {
+			/* only writers look at lcl_gen */
+			old->lcl_gen = lcl_gen;
+			if (spare < 0) {
+				free(sp->lcl_name);
+				free(sp);
+			}
+			sp = old;
+		} else if (spare < 0) {
+			sp->lcl_next = lcl_states;
+			lcl_states = sp;
+			lcl_nstates++;
+		}
+	}
+	atomic_store_explicit(&lclptr, sp, memory_order_release);
+	lcl_is_set = set;
+#ifdef NOTIFY_TZ
+	notify_register_tz(sp->lcl_file, &lcl_notify);
 #endif /* NOTIFY_TZ */
 	settzname();
-	_RWLOCK_UNLOCK(&lcl_rwlock);
+}
 
+static void
+lcl_update(const char * const name, int rdlocked)
+{
+	struct state *	sp;
+	int		current;
+
+	sp = atomic_load_explicit(&lclptr, memory_order_acquire);
+	if (rdlocked || sp == NULL || !lcl_is_spare(sp))
+		current = lcl_current(sp, name);
+	else {
+		_RWLOCK_RDLOCK(&lcl_rwlock);
+		current = lcl_current(lclptr, name);
+		_RWLOCK_UNLOCK(&lcl_rwlock);
+	}
+	if (current) {
+#ifdef NOTIFY_TZ_DEBUG
+		NOTIFY_TZ_PRINTF("lcl_update matched %s\n", name ? name : "wall");
+#endif
+		return;
+	}
+#ifdef NOTIFY_TZ_DEBUG
+	NOTIFY_TZ_PRINTF("lcl_update not set\n");
+#endif
+	if (rdlocked)
+		_RWLOCK_UNLOCK(&lcl_rwlock);
+	_RWLOCK_WRLOCK(&lcl_rwlock);
+	if (!lcl_current(lclptr, name))
+		lcl_load(name);
+	_RWLOCK_UNLOCK(&lcl_rwlock);
 	if (rdlocked)
 		_RWLOCK_RDLOCK(&lcl_rwlock);
 }
 
+static void
+tzsetwall_basic(int rdlocked)
+{
+#ifdef NOTIFY_TZ
+	if (bootstrap_port != MACH_PORT_NULL) {
+		notify_check_tz(&lcl_notify);
+	} else {
+		tzsetwall_check_default_file_timestamp();
+	}
+#else
+	tzsetwall_check_default_file_timestamp();
+#endif /* NOTIFY_TZ */
+	lcl_update(NULL, rdlocked);
+}
+
 void
 tzsetwall(void)
 {
@@ -1632,6 +1819,11 @@ tzsetwall(void)
 	tzsetwall_basic(0);
 }
 
+/*
+** Make sure lclptr is current, with lcl_rwlock held for reading if rdlocked.
+** Without the lock lclptr may change again right after; that's fine for
+** callers that load it once.
+*/
 __private_extern__ void
 tzset_basic(int rdlocked)
 {
@@ -1646,81 +1838,7 @@ tzset_basic(int rdlocked)
 #ifdef NOTIFY_TZ
 	notify_check_tz(&lcl_notify);
 #endif /* NOTIFY_TZ */
-	if (!rdlocked)
-		_RWLOCK_RDLOCK(&lcl_rwlock);
-	if (lcl_is_set > 0 && strcmp(lcl_TZname, name) == 0) {
-		if (!rdlocked)
-			_RWLOCK_UNLOCK(&lcl_rwlock);
-#ifdef NOTIFY_TZ_DEBUG
-		NOTIFY_TZ_PRINTF("tzset_basic matched %s\n", lcl_TZname);
-#endif
-		return;
-	}
-	_RWLOCK_UNLOCK(&lcl_rwlock);
-
-	_RWLOCK_WRLOCK(&lcl_rwlock);
-	lcl_is_set = strlen(name) < sizeof lcl_TZname;
-	if (lcl_is_set)
-		(void) strcpy(lcl_TZname, name);
-
-#ifdef ALL_STATE
-	if (lclptr == NULL) {
-		lclptr = (struct state *) calloc(1, sizeof *lclptr);
-		if (lclptr == NULL) {
-			settzname();	/* all we can do */
-			_RWLOCK_UNLOCK(&lcl_rwlock);
-			if (rdlocked)
-				_RWLOCK_RDLOCK(&lcl_rwlock);
-			return;
-		}
-	}
-#endif /* defined ALL_STATE */
-	if (*name == '\0') {
-		/*
-		** User wants it fast rather than right.
-		*/
-		lclptr->leapcnt = 0;		/* so, we're off a little */
-		lclptr->timecnt = 0;
-		lclptr->typecnt = 0;
-		lclptr->ttis[0].tt_isdst = 0;
-		lclptr->ttis[0].tt_gmtoff = 0;
-		lclptr->ttis[0].tt_abbrind = 0;
-		(void) strcpy(lclptr->chars, gmt);
-#ifdef NOTIFY_TZ
-		notify_register_tz(NULL, &lcl_notify);
-#endif /* NOTIFY_TZ */
-	} else
-#ifdef NOTIFY_TZ
-	{
-		char		fullname[FILENAME_MAX + 1];
-		/*
-		 * parsedOK indicates whether tzparse() was called and
-		 * succeeded.  This means that TZ is a time conversion
-		 * specification, so we don't need to register for
-		 * notifications.
-		 */
-		int		parsedOK = FALSE;
-		if (tzload(name, lclptr, fullname, TRUE) != 0) {
-			if (name[0] == ':' || !(parsedOK = tzparse(name, lclptr, FALSE) == 0)) {
-				/*
-				 * If fullname is empty (an error occurred) then
-				 * default to the UTC path
-				 */
-				(void) gmtload(lclptr, *fullname ? NULL : fullname);
-			}
-		}
-		notify_register_tz(parsedOK ? NULL : fullname, &lcl_notify);
-	}
-#else /* ! NOTIFY_TZ */
-	if (tzload(name, lclptr, TRUE) != 0)
-		if (name[0] == ':' || tzparse(name, lclptr, FALSE) != 0)
-			(void) gmtload(lclptr);
-#endif /* NOTIFY_TZ */
-	settzname();
-	_RWLOCK_UNLOCK(&lcl_rwlock);
-
-	if (rdlocked)
-		_RWLOCK_RDLOCK(&lcl_rwlock);
+	lcl_update(name, rdlocked);
 }
 
 void
@@ -1732,6 +1850,52 @@ tzset(void)
 	tzset_basic(0);
 }
 
+static void
+localtime_key_init(void)
+{
+
+	localtime_key = __LIBC_PTHREAD_KEY_LOCALTIME;
+	localtime_key_error = pthread_key_init_np(localtime_key, free);
+}
+
+/*
+** What localtime() keeps per thread: the struct tm it returns, and the last
+** transition interval [lt_lo, lt_hi) of lt_sp that localsub() found, with its
+** time type.  Times converted together tend to be close, so that most of the
+** time localsub() needn't search ats.  States are never freed, so lt_sp can't
+** come back as a different one; lcl_spares, which can, are not remembered.
+*/
+struct localtime_tsd {
+	struct tm		lt_tm;
+	const struct state *	lt_sp;
+	time_t			lt_lo;
+	time_t			lt_hi;
+	int			lt_type;
+};
+
+#define TIME_T_MAX	((time_t) (((uintmax_t) 1 << (TYPE_BIT(time_t) - 1)) - 1))
+#define TIME_T_MIN	(-TIME_T_MAX - 1)
+
+static struct localtime_tsd *
+localtime_tsd(void)
+{
+	static struct localtime_tsd	single;
+	struct localtime_tsd *		lt;
+
+	if (__isthreaded == 0)
+		return &single;
+	_pthread_once(&localtime_once, localtime_key_init);
+	if (localtime_key_error != 0)
+		return NULL;
+	lt = _pthread_getspecific(localtime_key);
+	if (lt == NULL) {
+		if ((lt = calloc(1, sizeof *lt)) == NULL)
+			return NULL;
+		_pthread_setspecific(localtime_key, lt);
+	}
+	return lt;
+}
+
 /*
 ** The easy way to behave "as if no library function calls" localtime
 ** is to not call it--so we drop its guts into "localsub", which can be
@@ -1743,14 +1907,15 @@ tzset(void)
 
 /*ARGSUSED*/
 #ifdef __LP64__
-__private_extern__ struct tm *
+static struct tm *
 #else /* !__LP64__ */
-__private_extern__ void
+static void
 #endif /* __LP64__ */
-localsub(const time_t *const timep, const long offset, struct tm *const tmp)
+lclsub(struct state *const sp, const time_t *const timep, const long offset,
+    struct tm *const tmp)
 {
-	struct state *		sp;
 	const struct ttinfo *	ttisp;
+	struct localtime_tsd *	lt;
 	int			i;
 #ifdef __LP64__
 	struct tm *		result;
@@ -1760,7 +1925,6 @@ localsub(const time_t *const timep, const long offset, struct tm *const tmp)
 #ifdef NOTIFY_TZ_DEBUG
 	NOTIFY_TZ_PRINTF("localsub called\n");
 #endif /* NOTIFY_TZ_DEBUG */
-	sp = lclptr;
 #ifdef ALL_STATE
 	if (sp == NULL) {
 #ifdef __LP64__
@@ -1802,11 +1966,11 @@ localsub(const time_t *const timep, const long offset, struct tm *const tmp)
 				newt > sp->ats[sp->timecnt - 1])
 #ifdef __LP64__
 					return NULL;	/* "cannot happen" */
-			result = localsub(&newt, offset, tmp);
+			result = lclsub(sp, &newt, offset, tmp);
 			if (result == tmp) {
 #else /* !__LP64__ */
 					return;
-			localsub(&newt, offset, tmp);
+			lclsub(sp, &newt, offset, tmp);
 			{
 #endif /* __LP64__ */
 				register time_t	newy;
@@ -1827,13 +1991,22 @@ localsub(const time_t *const timep, const long offset, struct tm *const tmp)
 			return;
 #endif /* __LP64__ */
 	}
-	if (sp->timecnt == 0 || t < sp->ats[0]) {
+	lt = lcl_is_spare(sp) ? NULL : localtime_tsd();
+	if (lt != NULL && lt->lt_sp == sp && t >= lt->lt_lo && t < lt->lt_hi)
+		i = lt->lt_type;
+	else if (sp->timecnt == 0 || t < sp->ats[0]) {
 		i = 0;
 		while (sp->ttis[i].tt_isdst)
 			if (++i >= sp->typecnt) {
 				i = 0;
 				break;
 			}
+		if (lt != NULL) {
+			lt->lt_sp = sp;
+			lt->lt_lo = TIME_T_MIN;
+			lt->lt_hi = sp->timecnt == 0 ? TIME_T_MAX : sp->ats[0];
+			lt->lt_type = i;
+		}
 	} else {
 		register int	lo = 1;
 		register int	hi = sp->timecnt;
@@ -1846,6 +2019,13 @@ localsub(const time_t *const timep, const long offset, struct tm *const tmp)
 			else	lo = mid + 1;
 		}
 		i = (int) sp->types[lo - 1];
+		if (lt != NULL) {
+			/* goahead times past the last transition went above */
+			lt->lt_sp = sp;
+			lt->lt_lo = sp->ats[lo - 1];
+			lt->lt_hi = lo < sp->timecnt ? sp->ats[lo] : TIME_T_MAX;
+			lt->lt_type = i;
+		}
 	}
 	ttisp = &sp->ttis[i];
 	/*
@@ -1871,47 +2051,81 @@ localsub(const time_t *const timep, const long offset, struct tm *const tmp)
 #endif /* __LP64__ */
 }
 
+/* With lcl_rwlock held for reading, see mktime() */
+#ifdef __LP64__
+__private_extern__ struct tm *
+#else /* !__LP64__ */
+__private_extern__ void
+#endif /* __LP64__ */
+localsub(const time_t *const timep, const long offset, struct tm *const tmp)
+{
+#ifdef __LP64__
+	return lclsub(lclptr, timep, offset, tmp);
+#else /* !__LP64__ */
+	lclsub(lclptr, timep, offset, tmp);
+#endif /* __LP64__ */
+}
+
+/* localsub() without lcl_rwlock, which only lcl_spares need */
+#ifdef __LP64__
+static struct tm *
+#else /* !__LP64__ */
 static void
-localtime_key_init(void)
+#endif /* __LP64__ */
+localsub_unlocked(const time_t *const timep, struct tm *const tmp)
 {
+	struct state *	sp;
+#ifdef __LP64__
+	struct tm *	result;
+#endif /* __LP64__ */
 
-	localtime_key = __LIBC_PTHREAD_KEY_LOCALTIME;
-	localtime_key_error = pthread_key_init_np(localtime_key, free);
+	sp = atomic_load_explicit(&lclptr, memory_order_acquire);
+	if (sp == NULL || !lcl_is_spare(sp)) {
+#ifdef __LP64__
+		return lclsub(sp, timep, 0L, tmp);
+#else /* !__LP64__ */
+		lclsub(sp, timep, 0L, tmp);
+		return;
+#endif /* __LP64__ */
+	}
+	_RWLOCK_RDLOCK(&lcl_rwlock);
+#ifdef __LP64__
+	result = lclsub(lclptr, timep, 0L, tmp);
+#else /* !__LP64__ */
+	lclsub(lclptr, timep, 0L, tmp);
+#endif /* __LP64__ */
+	_RWLOCK_UNLOCK(&lcl_rwlock);
+#ifdef __LP64__
+	return result;
+#endif /* __LP64__ */
 }
 
 struct tm *
 localtime(const time_t *const timep)
 {
+	struct localtime_tsd *lt;
 	struct tm *p_tm;
 
 	if (__isthreaded != 0) {
-		_pthread_once(&localtime_once, localtime_key_init);
-		if (localtime_key_error != 0) {
-			errno = localtime_key_error;
+		if ((lt = localtime_tsd()) == NULL) {
+			if (localtime_key_error != 0)
+				errno = localtime_key_error;
 			return(NULL);
 		}
-		p_tm = _pthread_getspecific(localtime_key);
-		if (p_tm == NULL) {
-			if ((p_tm = (struct tm *)malloc(sizeof(struct tm)))
-			    == NULL)
-				return(NULL);
-			_pthread_setspecific(localtime_key, p_tm);
-		}
-		_RWLOCK_RDLOCK(&lcl_rwlock);
-		tzset_basic(1);
+		p_tm = &lt->lt_tm;
+		tzset_basic(0);
 #ifdef __LP64__
-		p_tm = localsub(timep, 0L, p_tm);
+		p_tm = localsub_unlocked(timep, p_tm);
 #else /* !__LP64__ */
-		localsub(timep, 0L, p_tm);
+		localsub_unlocked(timep, p_tm);
 #endif /* __LP64__ */
-		_RWLOCK_UNLOCK(&lcl_rwlock);
 		return(p_tm);
 	} else {
 		tzset_basic(0);
 #ifdef __LP64__
-		return localsub(timep, 0L, &tm);
+		return localsub_unlocked(timep, &tm);
 #else /* !__LP64__ */
-		localsub(timep, 0L, &tm);
+		localsub_unlocked(timep, &tm);
 		return(&tm);
 #endif /* __LP64__ */
 	}
@@ -1924,14 +2138,12 @@ localtime(const time_t *const timep)
 struct tm *
 localtime_r(const time_t *const __restrict timep, struct tm * __restrict tmp)
 {
-	_RWLOCK_RDLOCK(&lcl_rwlock);
-	tzset_basic(1);
+	tzset_basic(0);
 #ifdef __LP64__
-	tmp = localsub(timep, 0L, tmp);
+	tmp = localsub_unlocked(timep, tmp);
 #else /* !__LP64__ */
-	localsub(timep, 0L, tmp);
+	localsub_unlocked(timep, tmp);
 #endif /* __LP64__ */
-	_RWLOCK_UNLOCK(&lcl_rwlock);
 	return tmp;
 }
 
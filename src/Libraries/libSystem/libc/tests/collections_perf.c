@@ -210,3 +210,126 @@ T_DECL(map_perf, "Test map performance for small hash maps",
 
 	T_PASS("Finished, output generated at: " PERF_OUTPUT_FILENAME);
 }
+
+#define GROUP_PERF_OUTPUT_FILENAME "/tmp/libcollection_group_perf_data.csv"
+#define GROUP_PERF_FIND_COUNT (1 << 22)
+#define GROUP_PERF_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static const uint32_t group_perf_map_sizes[] = {
+	1 << 10, 1 << 14, 1 << 18, 1 << 22, 1 << 24,
+};
+
+static const uint32_t group_perf_load_percents[] = { 25, 50, 75 };
+
+static double
+_ns_per_action(uint64_t start_mach_time, uint64_t end_mach_time,
+		uint64_t actions)
+{
+	return (double)(absoluteTimeFromMachTime(end_mach_time) -
+			absoluteTimeFromMachTime(start_mach_time)) / (double)actions;
+}
+
+// Fills a map of map_size slots up to load_percent, then looks up all of
+// its entries, and as many missing keys.
+static void
+_run_group_perf(FILE *output_file, uint32_t map_size, uint32_t load_percent,
+		uint32_t flags)
+{
+	const char *name = flags & OS_MAP_CONFIG_GROUP_PROBING ?
+			"group" : "linear";
+	uint64_t entries = (uint64_t)map_size * load_percent / 100;
+	uint64_t rounds = GROUP_PERF_FIND_COUNT / entries + 1;
+	os_map_config_t config = {
+		.name = name,
+		.initial_size = map_size,
+		.flags = flags,
+	};
+	os_map_64_t map;
+	uint64_t seq, missing_seq;
+	uintptr_t found = 0;
+
+	os_map_init(&map, &config);
+
+	seq = _seq_next(0);
+	uint64_t insert_start_mach_time = mach_absolute_time();
+	for (uint64_t i = 0; i < entries; i++) {
+		os_map_insert(&map, seq, (void *)_value_for_key(seq));
+		seq = _seq_next(seq);
+	}
+	uint64_t insert_end_mach_time = mach_absolute_time();
+	missing_seq = seq;
+
+	uint64_t find_start_mach_time = mach_absolute_time();
+	for (uint64_t r = 0; r < rounds; r++) {
+		seq = _seq_next(0);
+		for (uint64_t i = 0; i < entries; i++) {
+			found += (uintptr_t)os_map_find(&map, seq);
+			seq = _seq_next(seq);
+		}
+	}
+	uint64_t find_end_mach_time = mach_absolute_time();
+
+	uint64_t no_find_start_mach_time = mach_absolute_time();
+	for (uint64_t r = 0; r < rounds; r++) {
+		seq = missing_seq;
+		for (uint64_t i = 0; i < entries; i++) {
+			found += (uintptr_t)os_map_find(&map, seq);
+			seq = _seq_next(seq);
+		}
+	}
+	uint64_t no_find_end_mach_time = mach_absolute_time();
+
+	double insert_time = _ns_per_action(insert_start_mach_time,
+			insert_end_mach_time, entries);
+	double find_time = _ns_per_action(find_start_mach_time,
+			find_end_mach_time, entries * rounds);
+	double no_find_time = _ns_per_action(no_find_start_mach_time,
+			no_find_end_mach_time, entries * rounds);
+
+	T_QUIET; T_ASSERT_EQ(os_map_count(&map), (size_t)entries, NULL);
+	T_QUIET; T_ASSERT_NE(found, (uintptr_t)0, NULL);
+	T_LOG("DATA: %s %u slots %u%% full: insert %.1f ns, find %.1f ns, "
+	      "no-find %.1f ns", name, map_size, load_percent, insert_time,
+	      find_time, no_find_time);
+	fprintf(output_file, "%u,%u,%s,%.1f,%.1f,%.1f\n", map_size,
+		load_percent, name, insert_time, find_time, no_find_time);
+
+	os_map_destroy(&map);
+}
+
+T_DECL(map_perf_group_probing,
+		"Compare linear and group probing map performance, for maps of "
+		"1K to 16M slots",
+		T_META("owner", "Core Darwin Daemons & Tools"),
+		T_META_CHECK_LEAKS(false),
+		T_META_ASROOT(true))
+{
+#if !(TARGET_OS_IOS | TARGET_OS_OSX)
+	T_PASS("Map_perf_group_probing doesn't run on this platform");
+	return;
+#endif
+
+	int output_fd = creat(GROUP_PERF_OUTPUT_FILENAME, S_IWUSR);
+	assert(output_fd);
+	FILE *output_file = fdopen(output_fd, "w");
+	assert(output_file);
+
+	fprintf(output_file, "MAP_SIZE,LOAD_PERCENT,IMPLEMENTATION,"
+		"INSERT_TIME,FIND_TIME,FIND_MISSING_TIME\n");
+
+	for (size_t i = 0; i < GROUP_PERF_COUNT(group_perf_map_sizes); i++) {
+		for (size_t j = 0; j < GROUP_PERF_COUNT(group_perf_load_percents);
+		     j++) {
+			_run_group_perf(output_file, group_perf_map_sizes[i],
+					group_perf_load_percents[j], 0);
+			_run_group_perf(output_file, group_perf_map_sizes[i],
+					group_perf_load_percents[j],
+					OS_MAP_CONFIG_GROUP_PROBING);
+		}
+	}
+
+	fclose(output_file);
+	close(output_fd);
+
+	T_PASS("Finished, output generated at: " GROUP_PERF_OUTPUT_FILENAME);
+}
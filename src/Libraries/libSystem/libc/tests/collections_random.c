@@ -60,14 +60,14 @@ static uint32_t random_32_not_in_array(uint32_t *array, int size) {
 	return candidate;
 }
 
-#define RUN_MAP_RANDOM(MAP, KEY_CONV) 						\
+#define RUN_MAP_RANDOM(MAP, KEY_CONV, CONFIG)					\
 {										\
 	T_LOG("Start run map for " #MAP);					\
 										\
 	uint32_t keys[RANDOM_COUNT];						\
 	void *vals[RANDOM_COUNT];						\
 										\
-	os_map_init(&MAP, NULL);						\
+	os_map_init(&MAP, CONFIG);						\
 										\
 	/* Insert random values for sequential keys to the map */		\
 	for (int i = 0; i < RANDOM_COUNT; i++) {				\
@@ -166,7 +166,7 @@ T_DECL(map_random_64,
 {
 	os_map_64_t random_64_map;
 
-	RUN_MAP_RANDOM(random_64_map, key_conv_32_to_64);
+	RUN_MAP_RANDOM(random_64_map, key_conv_32_to_64, NULL);
 }
 
 T_DECL(map_random_32,
@@ -175,7 +175,7 @@ T_DECL(map_random_32,
 {
 	os_map_32_t random_32_map;
 
-	RUN_MAP_RANDOM(random_32_map, key_conv_32_to_32);
+	RUN_MAP_RANDOM(random_32_map, key_conv_32_to_32, NULL);
 
 }
 
@@ -187,7 +187,40 @@ T_DECL(map_random_string,
 
 	os_map_str_t random_s_map;
 
-	RUN_MAP_RANDOM(random_s_map, key_conv_32_to_string);
+	RUN_MAP_RANDOM(random_s_map, key_conv_32_to_string, NULL);
 
 }
 
+static os_map_config_t group_probing_config = {
+	.name = "group probing",
+	.flags = OS_MAP_CONFIG_GROUP_PROBING,
+};
+
+T_DECL(map_random_64_group_probing,
+       "Make sure 64 bit group probing map works for a bunch of random entries",
+	T_META("owner", "Core Darwin Daemons & Tools"))
+{
+	os_map_64_t random_64_map;
+
+	RUN_MAP_RANDOM(random_64_map, key_conv_32_to_64, &group_probing_config);
+}
+
+T_DECL(map_random_32_group_probing,
+       "Make sure 32 bit group probing map works for a bunch of random entries",
+	T_META("owner", "Core Darwin Daemons & Tools"))
+{
+	os_map_32_t random_32_map;
+
+	RUN_MAP_RANDOM(random_32_map, key_conv_32_to_32, &group_probing_config);
+}
+
+T_DECL(map_random_string_group_probing,
+       "Make sure string group probing map works for a bunch of random entries",
+	T_META("owner", "Core Darwin Daemons & Tools"),
+	T_META_CHECK_LEAKS(false))
+{
+	os_map_str_t random_s_map;
+
+	RUN_MAP_RANDOM(random_s_map, key_conv_32_to_string,
+		       &group_probing_config);
+}
@@ -0,0 +1,279 @@
+/*
+ * Tests for the buffer pools of dbopen(): the mpool clock cache under the
+ * btree in read-write mode, and the mappings used by read-only btree and
+ * hash tables when DB_MMAP_READS is set.
+ */
+
+#include <sys/types.h>
+#include <db.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <darwintest.h>
+#include <darwintest_utils.h>
+
+static void
+make_key(char *buf, size_t size, unsigned i)
+{
+	snprintf(buf, size, "key%012u", (i * 2654435761u) % 100000000u);
+}
+
+static void
+make_data(char *buf, size_t size, unsigned i)
+{
+	snprintf(buf, size, "data-%u-%0*d", i, (int)(i % 60), 0);
+}
+
+// Every seventh key is deleted after the table is filled
+static void
+fill(const char *path, DBTYPE type, const void *info, unsigned n)
+{
+	char k[32], d[128];
+	DBT key, data;
+	DB *db;
+
+	unlink(path);
+	db = dbopen(path, O_RDWR | O_CREAT | O_TRUNC, 0644, type, info);
+	T_QUIET; T_ASSERT_NOTNULL(db, "dbopen(%s)", path);
+	for (unsigned i = 0; i < n; i++) {
+		make_key(k, sizeof(k), i);
+		make_data(d, sizeof(d), i);
+		key.data = k;
+		key.size = strlen(k);
+		data.data = d;
+		data.size = strlen(d);
+		T_QUIET; T_ASSERT_EQ(db->put(db, &key, &data, 0), 0, "put %u", i);
+	}
+	for (unsigned i = 0; i < n; i += 7) {
+		make_key(k, sizeof(k), i);
+		key.data = k;
+		key.size = strlen(k);
+		T_QUIET; T_ASSERT_EQ(db->del(db, &key, 0), 0, "del %u", i);
+	}
+	T_QUIET; T_ASSERT_EQ(db->close(db), 0, "close");
+}
+
+static void
+check_gets(DB *db, unsigned n)
+{
+	char k[32], d[128];
+	DBT key, data;
+	int failed = 0;
+
+	for (unsigned j = 0; j < n; j++) {
+		unsigned i = (j * 40503u) % n;
+		int r;
+
+		make_key(k, sizeof(k), i);
+		key.data = k;
+		key.size = strlen(k);
+		r = db->get(db, &key, &data, 0);
+		if (i % 7 == 0) {
+			if (r != 1 && failed++ < 10) {
+				T_FAIL("deleted key %u: get returned %d", i, r);
+			}
+			continue;
+		}
+		make_data(d, sizeof(d), i);
+		if ((r != 0 || data.size != strlen(d) ||
+				memcmp(data.data, d, data.size) != 0) && failed++ < 10) {
+			T_FAIL("key %u: get returned %d", i, r);
+		}
+	}
+	T_EXPECT_EQ(failed, 0, "get finds every key and no deleted one");
+}
+
+static void
+check_seq(DB *db, DBTYPE type, unsigned n)
+{
+	char last[32] = "";
+	DBT key, data;
+	unsigned count = 0;
+	int r, unordered = 0;
+
+	for (r = db->seq(db, &key, &data, R_FIRST); r == 0;
+			r = db->seq(db, &key, &data, R_NEXT)) {
+		if (type == DB_BTREE) {
+			if (key.size >= sizeof(last) ||
+					memcmp(last, key.data, key.size) >= 0) {
+				unordered++;
+			}
+			memcpy(last, key.data, key.size);
+			last[key.size] = '\0';
+		}
+		count++;
+	}
+	T_EXPECT_EQ(r, 1, "seq reaches the end");
+	T_EXPECT_EQ(unordered, 0, "seq returns keys in order");
+	T_EXPECT_EQ(count, n - (n + 6) / 7, "seq returns every key");
+}
+
+static void
+check_table(DBTYPE type, const char *name)
+{
+	const unsigned n = 200000;
+	BTREEINFO btinfo = { .cachesize = 1 << 20 };
+	HASHINFO hinfo = { .cachesize = 1 << 20 };
+	const void *info = type == DB_BTREE ? (void *)&btinfo : (void *)&hinfo;
+	char path[PATH_MAX], k[] = "key", d[] = "data";
+	DBT key = { k, sizeof(k) }, data = { d, sizeof(d) };
+	DB *db;
+
+	snprintf(path, sizeof(path), "%s/%s", dt_tmpdir(), name);
+	fill(path, type, info, n);
+
+	// A cache much smaller than the file, so pages get evicted
+	db = dbopen(path, O_RDWR, 0, type, info);
+	T_ASSERT_NOTNULL(db, "dbopen(O_RDWR)");
+	check_gets(db, n);
+	check_seq(db, type, n);
+	T_EXPECT_EQ(db->close(db), 0, "close");
+
+	// Read-only, first with pread() and then mapped
+	for (int map = 0; map <= 1; map++) {
+		if (map) {
+			T_ASSERT_POSIX_SUCCESS(setenv("DB_MMAP_READS", "1", 1),
+					"setenv(DB_MMAP_READS)");
+		}
+		db = dbopen(path, O_RDONLY, 0, type, info);
+		T_ASSERT_NOTNULL(db, "dbopen(O_RDONLY)");
+		check_gets(db, n);
+		check_seq(db, type, n);
+		T_EXPECT_EQ(db->put(db, &key, &data, 0), -1,
+				"put fails when read-only");
+		T_EXPECT_EQ(db->close(db), 0, "close");
+	}
+	T_ASSERT_POSIX_SUCCESS(unsetenv("DB_MMAP_READS"), "unsetenv(DB_MMAP_READS)");
+	unlink(path);
+}
+
+T_DECL(db_btree, "btree tables through the mpool cache and mapped read-only",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	check_table(DB_BTREE, "db_btree.db");
+}
+
+T_DECL(db_hash, "hash tables through the buffer pool and mapped read-only",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	check_table(DB_HASH, "db_hash.db");
+}
+
+// Without DB_MMAP_READS, a read-only tree that is truncated under us fails
+// its reads instead of faulting, and the cache survives the failures
+T_DECL(db_btree_truncated, "read-only btree truncated while open",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const unsigned n = 50000;
+	BTREEINFO info = { .cachesize = 64 << 10 };
+	char path[PATH_MAX], k[32];
+	DBT key, data;
+	DB *db;
+	int errors = 0;
+
+	snprintf(path, sizeof(path), "%s/%s", dt_tmpdir(), "db_truncated.db");
+	fill(path, DB_BTREE, &info, n);
+	db = dbopen(path, O_RDONLY, 0, DB_BTREE, &info);
+	T_ASSERT_NOTNULL(db, "dbopen(O_RDONLY)");
+	T_ASSERT_POSIX_SUCCESS(truncate(path, 0), "truncate(%s)", path);
+	for (unsigned i = 1; i < n; i += 3) {
+		make_key(k, sizeof(k), i);
+		key.data = k;
+		key.size = strlen(k);
+		if (db->get(db, &key, &data, 0) == -1) {
+			errors++;
+		}
+	}
+	T_EXPECT_GT(errors, 0, "gets of pages no longer in the file fail");
+	T_EXPECT_EQ(db->close(db), 0, "close");
+	unlink(path);
+}
+
+// Opposite byte order: read-only trees still go through the page filters
+T_DECL(db_btree_swapped, "btree tables in the other byte order",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const unsigned n = 50000;
+	BTREEINFO info = {
+		.cachesize = 1 << 20,
+		.lorder = BYTE_ORDER == LITTLE_ENDIAN ? BIG_ENDIAN : LITTLE_ENDIAN,
+	};
+	char path[PATH_MAX];
+	DB *db;
+
+	snprintf(path, sizeof(path), "%s/%s", dt_tmpdir(), "db_swapped.db");
+	fill(path, DB_BTREE, &info, n);
+	db = dbopen(path, O_RDONLY, 0, DB_BTREE, &info);
+	T_ASSERT_NOTNULL(db, "dbopen(O_RDONLY)");
+	check_gets(db, n);
+	check_seq(db, DB_BTREE, n);
+	T_EXPECT_EQ(db->close(db), 0, "close");
+	unlink(path);
+}
+
+static void
+time_table(const char *path, DBTYPE type, int flags, const void *info,
+		unsigned n, const char *what)
+{
+	char k[32], name[128];
+	DBT key, data;
+	DB *db;
+	unsigned count = 0;
+	uint64_t ns;
+
+	db = dbopen(path, flags, 0, type, info);
+	T_QUIET; T_ASSERT_NOTNULL(db, "dbopen(%s)", path);
+
+	snprintf(name, sizeof(name), "%s get", what);
+	dt_timer_start(name);
+	for (unsigned j = 0; j < n; j++) {
+		make_key(k, sizeof(k), (j * 40503u) % n);
+		key.data = k;
+		key.size = strlen(k);
+		(void)db->get(db, &key, &data, 0);
+	}
+	ns = dt_timer_stop(name);
+	T_LOG("%s: %.0f ns per key", name, (double)ns / n);
+
+	snprintf(name, sizeof(name), "%s seq", what);
+	dt_timer_start(name);
+	for (int r = db->seq(db, &key, &data, R_FIRST); r == 0;
+			r = db->seq(db, &key, &data, R_NEXT)) {
+		count++;
+	}
+	ns = dt_timer_stop(name);
+	T_LOG("%s: %.0f ns per key", name, (double)ns / count);
+	db->close(db);
+}
+
+T_DECL(db_perf, "get and seq throughput on a large btree",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const unsigned n = 2000000;
+	BTREEINFO small = { .cachesize = 1 << 20 };
+	BTREEINFO large = { .cachesize = 256 << 20 };
+	HASHINFO hinfo = { .cachesize = 1 << 20 };
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s", dt_tmpdir(), "db_perf.db");
+	fill(path, DB_BTREE, &large, n);
+	time_table(path, DB_BTREE, O_RDWR, &small, n, "btree, 1MB cache");
+	time_table(path, DB_BTREE, O_RDWR, &large, n, "btree, 256MB cache");
+	time_table(path, DB_BTREE, O_RDONLY, &small, n, "btree, read-only");
+	T_ASSERT_POSIX_SUCCESS(setenv("DB_MMAP_READS", "1", 1), "setenv");
+	time_table(path, DB_BTREE, O_RDONLY, &small, n, "btree, mapped");
+	T_ASSERT_POSIX_SUCCESS(unsetenv("DB_MMAP_READS"), "unsetenv");
+
+	// Hash tables run out of overflow pages sooner with the default bucket
+	fill(path, DB_HASH, &hinfo, n / 2);
+	time_table(path, DB_HASH, O_RDWR, &hinfo, n / 2, "hash");
+	time_table(path, DB_HASH, O_RDONLY, &hinfo, n / 2, "hash, read-only");
+	T_ASSERT_POSIX_SUCCESS(setenv("DB_MMAP_READS", "1", 1), "setenv");
+	time_table(path, DB_HASH, O_RDONLY, &hinfo, n / 2, "hash, mapped");
+	T_ASSERT_POSIX_SUCCESS(unsetenv("DB_MMAP_READS"), "unsetenv");
+	unlink(path);
+	T_PASS("done");
+}
@@ -0,0 +1,236 @@
+/*
+ * FTS_PARALLEL reads directories ahead on other threads, but has to return
+ * the same nodes in the same order as a walk without it.  The walks here log
+ * every node they see and compare the logs.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fts.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <darwintest.h>
+#include <darwintest_utils.h>
+
+static int
+compare_names(const FTSENT **a, const FTSENT **b)
+{
+	return strcmp((*a)->fts_name, (*b)->fts_name);
+}
+
+static void
+make_file(const char *path, size_t size)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	T_QUIET; T_ASSERT_POSIX_SUCCESS(fd, "open(%s)", path);
+	T_QUIET; T_ASSERT_POSIX_SUCCESS(ftruncate(fd, (off_t)size), NULL);
+	close(fd);
+}
+
+/*
+ * A tree depth levels deep with width subdirectories and files regular files
+ * in each directory, plus symbolic links to the parent and to nowhere.
+ */
+static void
+make_tree(const char *path, int width, int depth, int files)
+{
+	char sub[PATH_MAX];
+
+	T_QUIET; T_ASSERT_POSIX_SUCCESS(mkdir(path, 0755), "mkdir(%s)", path);
+	for (int i = 0; i < files; i++) {
+		snprintf(sub, sizeof(sub), "%s/file%d", path, i);
+		make_file(sub, (size_t)(i * 37));
+	}
+	snprintf(sub, sizeof(sub), "%s/dangling", path);
+	T_QUIET; T_ASSERT_POSIX_SUCCESS(symlink("nowhere", sub), NULL);
+	if (depth == 0) {
+		snprintf(sub, sizeof(sub), "%s/empty", path);
+		T_QUIET; T_ASSERT_POSIX_SUCCESS(mkdir(sub, 0755), NULL);
+		return;
+	}
+	snprintf(sub, sizeof(sub), "%s/up", path);
+	T_QUIET; T_ASSERT_POSIX_SUCCESS(symlink("..", sub), NULL);
+	for (int i = 0; i < width; i++) {
+		snprintf(sub, sizeof(sub), "%s/dir%d", path, i);
+		make_tree(sub, width, depth - 1, files);
+	}
+}
+
+static void
+remove_tree(const char *path)
+{
+	char *paths[] = { (char *)path, NULL };
+	FTSENT *p;
+	FTS *fts;
+
+	fts = fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR, NULL);
+	T_QUIET; T_ASSERT_NOTNULL(fts, NULL);
+	while ((p = fts_read(fts)) != NULL) {
+		if (p->fts_info == FTS_DP)
+			rmdir(p->fts_path);
+		else if (p->fts_info != FTS_D)
+			unlink(p->fts_path);
+	}
+	fts_close(fts);
+}
+
+#define	SKIP_SOME	0x1	/* fts_set(FTS_SKIP) on every fifth directory */
+#define	CHILDREN	0x2	/* fts_children() on every third directory */
+
+/* The log of a walk, as a string to free */
+static char *
+walk(const char *root, int options, bool sorted, int actions)
+{
+	char *paths[] = { (char *)root, NULL }, *log = NULL;
+	size_t len = 0;
+	FILE *out = open_memstream(&log, &len);
+	unsigned dirs = 0;
+	FTSENT *p, *c;
+	FTS *fts;
+
+	T_QUIET; T_ASSERT_NOTNULL(out, NULL);
+	fts = fts_open(paths, options, sorted ? compare_names : NULL);
+	T_QUIET; T_ASSERT_NOTNULL(fts, "fts_open(0x%x)", options);
+	while ((p = fts_read(fts)) != NULL) {
+		fprintf(out, "%d %d %d %s", p->fts_info, p->fts_level,
+				p->fts_errno, p->fts_path);
+		if (!(options & (FTS_NOSTAT | FTS_NOSTAT_TYPE)) &&
+				p->fts_info != FTS_NS) {
+			fprintf(out, " %llu %llo %lld",
+					(unsigned long long)p->fts_statp->st_ino,
+					(unsigned long long)p->fts_statp->st_mode,
+					(long long)p->fts_statp->st_size);
+		}
+		fputc('\n', out);
+		if (p->fts_info != FTS_D)
+			continue;
+		dirs++;
+		if ((actions & SKIP_SOME) && dirs % 5 == 4) {
+			fts_set(fts, p, FTS_SKIP);
+		} else if ((actions & CHILDREN) && dirs % 3 == 2) {
+			for (c = fts_children(fts, 0); c != NULL; c = c->fts_link)
+				fprintf(out, "  %s\n", c->fts_name);
+		}
+	}
+	T_QUIET; T_EXPECT_EQ(errno, 0, "fts_read() ends without an error");
+	T_QUIET; T_EXPECT_EQ(fts_close(fts), 0, NULL);
+	fclose(out);
+	return log;
+}
+
+static void
+compare_walks(const char *root, int options, bool sorted, int actions,
+		const char *what)
+{
+	char *serial = walk(root, options, sorted, actions);
+	char *parallel = walk(root, options | FTS_PARALLEL, sorted, actions);
+	size_t lines = 0;
+
+	for (const char *s = serial; *s; s++)
+		lines += *s == '\n';
+	T_EXPECT_EQ_STR(parallel, serial, "%s: %zu nodes, same as serial", what,
+			lines);
+	free(serial);
+	free(parallel);
+}
+
+T_DECL(fts_parallel, "FTS_PARALLEL walks return the same nodes in the same order",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	char root[PATH_MAX];
+
+	snprintf(root, sizeof(root), "%s/fts_parallel.%d", dt_tmpdir(), getpid());
+	make_tree(root, 6, 3, 20);
+
+	compare_walks(root, FTS_PHYSICAL, true, 0, "physical");
+	compare_walks(root, FTS_PHYSICAL, false, 0, "physical, directory order");
+	compare_walks(root, FTS_PHYSICAL | FTS_NOSTAT, true, 0, "nostat");
+	compare_walks(root, FTS_PHYSICAL | FTS_NOSTAT_TYPE, true, 0,
+			"nostat_type");
+	compare_walks(root, FTS_PHYSICAL | FTS_SEEDOT, true, 0, "seedot");
+	compare_walks(root, FTS_PHYSICAL | FTS_XDEV, true, 0, "xdev");
+	compare_walks(root, FTS_LOGICAL, true, 0, "logical");
+	compare_walks(root, FTS_LOGICAL | FTS_NOSTAT, true, 0, "logical, nostat");
+	compare_walks(root, FTS_PHYSICAL, true, SKIP_SOME, "skipping");
+	compare_walks(root, FTS_PHYSICAL, true, CHILDREN, "fts_children");
+	compare_walks(root, FTS_PHYSICAL | FTS_NOSTAT, true, SKIP_SOME | CHILDREN,
+			"nostat, skipping, fts_children");
+
+	remove_tree(root);
+}
+
+T_DECL(fts_parallel_close, "fts_close() in the middle of an FTS_PARALLEL walk",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	char root[PATH_MAX], *paths[] = { root, NULL };
+	FTSENT *p;
+	FTS *fts;
+
+	snprintf(root, sizeof(root), "%s/fts_parallel_close.%d", dt_tmpdir(),
+			getpid());
+	make_tree(root, 8, 2, 50);
+	for (int stop = 1; stop < 2000; stop *= 3) {
+		int n = 0;
+
+		fts = fts_open(paths, FTS_PHYSICAL | FTS_PARALLEL, compare_names);
+		T_QUIET; T_ASSERT_NOTNULL(fts, NULL);
+		while (n++ < stop && (p = fts_read(fts)) != NULL)
+			continue;
+		T_QUIET; T_EXPECT_EQ(fts_close(fts), 0, NULL);
+	}
+	T_PASS("closed after 1 to 2000 nodes");
+	remove_tree(root);
+}
+
+static void
+time_walk(const char *root, int options, const char *what)
+{
+	char *paths[] = { (char *)root, NULL };
+	unsigned long nodes = 0;
+	uint64_t ns;
+	FTS *fts;
+
+	dt_timer_start(what);
+	fts = fts_open(paths, options, compare_names);
+	T_QUIET; T_ASSERT_NOTNULL(fts, NULL);
+	while (fts_read(fts) != NULL)
+		nodes++;
+	fts_close(fts);
+	ns = dt_timer_stop(what);
+	T_LOG("%s: %lu nodes, %.0f ns per node", what, nodes, (double)ns / nodes);
+}
+
+// FTS_PERF_PATH walks an existing tree instead of a generated one
+T_DECL(fts_parallel_perf, "fts_read() throughput with and without FTS_PARALLEL",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const char *path = getenv("FTS_PERF_PATH");
+	char root[PATH_MAX];
+
+	if (path == NULL) {
+		snprintf(root, sizeof(root), "%s/fts_parallel_perf.%d",
+				dt_tmpdir(), getpid());
+		make_tree(root, 10, 3, 40);
+		path = root;
+	}
+
+	/* Twice each, so that both runs find the tree in the cache */
+	for (int i = 0; i < 2; i++) {
+		time_walk(path, FTS_PHYSICAL, "physical");
+		time_walk(path, FTS_PHYSICAL | FTS_PARALLEL, "physical, parallel");
+		time_walk(path, FTS_PHYSICAL | FTS_NOSTAT, "nostat");
+		time_walk(path, FTS_PHYSICAL | FTS_NOSTAT | FTS_PARALLEL,
+				"nostat, parallel");
+	}
+	if (path == root)
+		remove_tree(root);
+	T_PASS("done");
+}
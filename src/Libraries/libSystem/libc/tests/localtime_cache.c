@@ -0,0 +1,263 @@
+/*
+ * localtime_r() reads the local time zone without a lock and remembers the
+ * last transition interval per thread.  These check that conversions stay
+ * right across changes of TZ, from many threads at once, and time them.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <darwintest.h>
+#include <darwintest_utils.h>
+
+static const struct {
+	const char *tz;
+	int hour;
+	int mday;
+	const char *zone;
+} known[] = {
+	// 1700000000 is 2023-11-14 22:13:20 UTC
+	{ "America/New_York", 17, 14, "EST" },
+	{ "Europe/London", 22, 14, "GMT" },
+	{ "Asia/Tokyo", 7, 15, "JST" },
+	{ "Australia/Sydney", 9, 15, "AEDT" },
+	{ "UTC", 22, 14, "UTC" },
+	{ "EST5EDT", 17, 14, "EST" },
+	{ "JST-9", 7, 15, "JST" },
+};
+
+static void
+set_tz(const char *tz)
+{
+	T_QUIET; T_ASSERT_POSIX_SUCCESS(setenv("TZ", tz, 1), NULL);
+	tzset();
+}
+
+T_DECL(localtime_tz_switch, "localtime_r() follows changes of TZ",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const size_t n = sizeof(known) / sizeof(known[0]);
+	int failed = 0;
+
+	for (int round = 0; round < 1000; round++) {
+		size_t k = (size_t)arc4random_uniform((uint32_t)n);
+		time_t t = 1700000000;
+		struct tm tm, copy;
+
+		set_tz(known[k].tz);
+		// Sometimes near the time first, so the interval is remembered
+		if (round & 1) {
+			time_t near = t - 60;
+
+			localtime_r(&near, &tm);
+		}
+		T_QUIET; T_ASSERT_NOTNULL(localtime_r(&t, &tm), NULL);
+		if ((tm.tm_hour != known[k].hour || tm.tm_mday != known[k].mday ||
+				strcmp(tm.tm_zone, known[k].zone) != 0) && failed++ < 10) {
+			T_FAIL("%s: %02d:%02d on the %d, %s", known[k].tz, tm.tm_hour,
+					tm.tm_min, tm.tm_mday, tm.tm_zone);
+		}
+		copy = tm;
+		copy.tm_isdst = -1;
+		if (mktime(&copy) != t && failed++ < 10) {
+			T_FAIL("%s: mktime() does not give the time back", known[k].tz);
+		}
+	}
+	T_EXPECT_EQ(failed, 0, "localtime_r() and mktime() after 1000 changes of TZ");
+	unsetenv("TZ");
+	tzset();
+}
+
+// Only so many time zones are kept for lock-free readers, the others are
+// loaded again every time: both must convert right
+T_DECL(localtime_many_zones, "localtime_r() through more time zones than are kept",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	int failed = 0;
+
+	for (int round = 0; round < 3; round++) {
+		for (int k = 0; k < 100; k++) {
+			char tz[32], zone[4] = "Z??";
+			long gmtoff = (k % 24 - 11) * 3600L + (k % 60) * 60L;
+			time_t t = 1700000000;
+			struct tm tm;
+
+			zone[1] = (char)('A' + k / 26);
+			zone[2] = (char)('A' + k % 26);
+			snprintf(tz, sizeof(tz), "%s%s%ld:%02d", zone, gmtoff < 0 ? "+" : "-",
+					labs(gmtoff) / 3600, (int)(labs(gmtoff) / 60 % 60));
+			set_tz(tz);
+			T_QUIET; T_ASSERT_NOTNULL(localtime_r(&t, &tm), NULL);
+			if ((tm.tm_gmtoff != gmtoff || strcmp(tm.tm_zone, zone) != 0) &&
+					failed++ < 10) {
+				T_FAIL("%s: offset %ld, %s", tz, tm.tm_gmtoff, tm.tm_zone);
+			}
+		}
+	}
+	T_EXPECT_EQ(failed, 0, "localtime_r() in 100 time zones, 3 times over");
+	unsetenv("TZ");
+	tzset();
+}
+
+// Past the kept time zones, states are loaded again while other threads
+// convert: they must never see one half loaded
+static atomic_bool stop_many_zones;
+
+static long
+many_zones_gmtoff(int k)
+{
+	return (k % 24 - 11) * 3600L + (k % 60) * 60L;
+}
+
+static void
+many_zones_set(int k)
+{
+	char tz[32];
+	long gmtoff = many_zones_gmtoff(k);
+
+	snprintf(tz, sizeof(tz), "Z%c%c%s%ld:%02d", 'A' + k / 26, 'A' + k % 26,
+			gmtoff < 0 ? "+" : "-", labs(gmtoff) / 3600,
+			(int)(labs(gmtoff) / 60 % 60));
+	set_tz(tz);
+}
+
+static void *
+convert_many_zones(void *arg)
+{
+	uintptr_t bad = 0;
+	time_t t = 1700000000;
+	struct tm tm;
+
+	(void)arg;
+	while (!stop_many_zones) {
+		int k;
+
+		localtime_r(&t, &tm);
+		for (k = 0; k < 100 && tm.tm_gmtoff != many_zones_gmtoff(k); k++) {
+		}
+		if (k == 100) {
+			bad++;
+		}
+	}
+	return (void *)bad;
+}
+
+T_DECL(localtime_many_zones_threads,
+		"localtime_r() from many threads while TZ goes through many zones",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	pthread_t threads[4];
+	uintptr_t bad = 0;
+	void *result;
+
+	many_zones_set(0);
+	for (uintptr_t i = 0; i < 4; i++) {
+		T_QUIET; T_ASSERT_POSIX_ZERO(pthread_create(&threads[i], NULL,
+				convert_many_zones, (void *)i), NULL);
+	}
+	for (int i = 0; i < 2000; i++) {
+		many_zones_set(i % 100);
+	}
+	stop_many_zones = true;
+	for (int i = 0; i < 4; i++) {
+		T_QUIET; T_ASSERT_POSIX_ZERO(pthread_join(threads[i], &result), NULL);
+		bad += (uintptr_t)result;
+	}
+	T_EXPECT_EQ(bad, (uintptr_t)0, "no conversion with a half loaded zone");
+	unsetenv("TZ");
+	tzset();
+}
+
+#define THREAD_TIMES	20000
+
+static time_t base;
+static struct tm expected[THREAD_TIMES];
+static volatile bool stop;
+
+static void *
+convert(void *arg)
+{
+	uintptr_t bad = 0;
+	struct tm tm;
+
+	for (int round = 0; round < 20; round++) {
+		for (int i = 0; i < THREAD_TIMES; i++) {
+			// Every hour for two years, half of them out of order
+			int j = (round + (uintptr_t)arg) & 1 ?
+					(int)arc4random_uniform(THREAD_TIMES) : i;
+			time_t t = base + (time_t)j * 3600;
+
+			localtime_r(&t, &tm);
+			if (tm.tm_hour != expected[j].tm_hour ||
+					tm.tm_isdst != expected[j].tm_isdst ||
+					tm.tm_gmtoff != expected[j].tm_gmtoff) {
+				bad++;
+			}
+		}
+	}
+	return (void *)bad;
+}
+
+T_DECL(localtime_threads, "localtime_r() from many threads while tzset() runs",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	pthread_t threads[8];
+	uintptr_t bad = 0;
+	void *result;
+
+	set_tz("America/Los_Angeles");
+	base = 1700000000;
+	for (int i = 0; i < THREAD_TIMES; i++) {
+		time_t t = base + (time_t)i * 3600;
+
+		localtime_r(&t, &expected[i]);
+	}
+	for (uintptr_t i = 0; i < 8; i++) {
+		T_QUIET; T_ASSERT_POSIX_ZERO(pthread_create(&threads[i], NULL,
+				convert, (void *)i), NULL);
+	}
+	for (int i = 0; i < 1000; i++) {
+		tzset();
+	}
+	for (int i = 0; i < 8; i++) {
+		T_QUIET; T_ASSERT_POSIX_ZERO(pthread_join(threads[i], &result), NULL);
+		bad += (uintptr_t)result;
+	}
+	T_EXPECT_EQ(bad, (uintptr_t)0, "8 threads agree with one");
+	unsetenv("TZ");
+	tzset();
+}
+
+static void
+time_conversions(const char *what, bool sequential)
+{
+	const int n = 2000000;
+	time_t t = 1700000000;
+	struct tm tm;
+	uint64_t ns;
+
+	dt_timer_start(what);
+	for (int i = 0; i < n; i++) {
+		t = sequential ? t + 1 : 1700000000 + (time_t)arc4random_uniform(1 << 30);
+		localtime_r(&t, &tm);
+	}
+	ns = dt_timer_stop(what);
+	T_LOG("%s: %.1f ns per call", what, (double)ns / n);
+}
+
+T_DECL(localtime_perf, "localtime_r() throughput",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	set_tz("America/New_York");
+	time_conversions("localtime_r, consecutive seconds", true);
+	time_conversions("localtime_r, random times", false);
+	unsetenv("TZ");
+	tzset();
+	time_conversions("localtime_r, wall clock", true);
+	T_PASS("done");
+}
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
@@ -69,3 +70,48 @@ T_DECL(psort, "psort(3)")
 	T_EXPECT_LE((double)pwt/qwt, 1.2, "psort/qsort wall time");
 	T_EXPECT_LE((double)qut/put, 1.2, "qsort/psort user time");
 }
+
+struct pair {
+	uint32_t key;
+	uint32_t index;
+};
+
+static int
+compare_pair_keys(const void *a, const void *b)
+{
+	const struct pair *x = a, *y = b;
+	return x->key < y->key ? -1 : x->key > y->key ? 1 : 0;
+}
+
+T_DECL(psort_stable, "psort_stable(3)")
+{
+	/* Around the chunk and parallel cutoffs, and well above them */
+	const size_t sizes[] = { 0, 1, 2, 15, 16, 17, 1000, 16383, 16384, 16385,
+			100000, 1000003 };
+	/* Few distinct keys, so that most elements have equal peers */
+	const uint32_t keys[] = { 2, 100, UINT32_MAX };
+
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+			size_t nel = sizes[s];
+			struct pair *buf = malloc(nel * sizeof(*buf) + 1);
+
+			for (size_t i = 0; i < nel; i++) {
+				buf[i].key = arc4random_uniform(keys[k]);
+				buf[i].index = (uint32_t)i;
+			}
+			T_QUIET; T_ASSERT_POSIX_SUCCESS(psort_stable(buf, nel, sizeof(*buf),
+					compare_pair_keys), NULL);
+			for (size_t i = 1; i < nel; i++) {
+				if (buf[i - 1].key > buf[i].key ||
+						(buf[i - 1].key == buf[i].key &&
+						buf[i - 1].index > buf[i].index)) {
+					T_ASSERT_FAIL("nel %zu, keys %u: out of order at %zu",
+							nel, keys[k], i);
+				}
+			}
+			free(buf);
+		}
+	}
+	T_PASS("psort_stable");
+}
@@ -52,3 +52,71 @@ T_DECL(qsort_random, "qsort random test", T_META_CHECK_LEAKS(NO))
         }
     }
 }
+
+/*
+ * Comparators that are not a consistent order leave the array in no
+ * particular order, but qsort must still return without touching anything
+ * outside of it.
+ */
+#define GUARD 64
+
+static int
+cmp_less_or_equal(const void *aa, const void *bb)
+{
+    return *(const int *)aa <= *(const int *)bb ? -1 : 1;
+}
+
+static int
+cmp_always_less(const void *aa __unused, const void *bb __unused)
+{
+    return -1;
+}
+
+static int
+cmp_always_greater(const void *aa __unused, const void *bb __unused)
+{
+    return 1;
+}
+
+T_DECL(qsort_inconsistent_comparator,
+        "qsort stays within the array with inconsistent comparators",
+        T_META_CHECK_LEAKS(NO))
+{
+    static int (*const cmps[])(const void *, const void *) = {
+        cmp_less_or_equal, cmp_always_less, cmp_always_greater,
+    };
+    static const size_t counts[] = { 2, 23, 24, 25, 129, 1000, 100000 };
+    int *buf = malloc((100000 + 2 * GUARD) * sizeof(int));
+    T_QUIET; T_ASSERT_NOTNULL(buf, NULL);
+
+    for (size_t c = 0; c < sizeof(cmps) / sizeof(cmps[0]); c++) {
+        for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+            size_t n = counts[k];
+            int *arr = buf + GUARD;
+
+            for (size_t i = 0; i < GUARD; i++) {
+                buf[i] = -1;
+                arr[n + i] = -1;
+            }
+            for (size_t i = 0; i < n; i++) {
+                arr[i] = (k % 2) ? 7 : (int)(i % 13);
+            }
+
+            qsort(arr, n, sizeof(int), cmps[c]);
+
+            for (size_t i = 0; i < GUARD; i++) {
+                T_QUIET; T_ASSERT_EQ(buf[i], -1, "comparator %zu, %zu elements: "
+                        "element %zu before the array", c, n, GUARD - i);
+                T_QUIET; T_ASSERT_EQ(arr[n + i], -1, "comparator %zu, %zu elements: "
+                        "element %zu after the array", c, n, i);
+            }
+            for (size_t i = 0; i < n; i++) {
+                T_QUIET; T_ASSERT_GE(arr[i], 0, "comparator %zu, %zu elements: "
+                        "element from outside the array at %zu", c, n, i);
+            }
+        }
+    }
+
+    free(buf);
+    T_PASS("qsort stayed within the array");
+}
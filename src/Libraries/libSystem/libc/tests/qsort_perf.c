@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <darwintest.h>
 #include <darwintest_utils.h>
 
@@ -167,6 +168,123 @@ T_DECL(qsort_perf, "qsort perf test", T_META_CHECK_LEAKS(NO))
     T_PASS("All tests completed successfully.");
 }
 
+// ----- distributions, by element size -----
+
+#define dist_nelm 1000000
+
+enum { DIST_RANDOM, DIST_SORTED, DIST_REVERSE, DIST_ORGAN_PIPE, DIST_FEW_UNIQUE,
+    DIST_COUNT };
+
+static const char *dist_names[DIST_COUNT] = {
+    "random", "sorted", "reverse", "organ-pipe", "few-unique",
+};
+
+static uint64_t
+dist_value(int dist, size_t i)
+{
+    switch (dist) {
+    case DIST_RANDOM:
+        return ((uint64_t)random() << 31) ^ (uint64_t)random();
+    case DIST_SORTED:
+        return i;
+    case DIST_REVERSE:
+        return dist_nelm - i;
+    case DIST_ORGAN_PIPE:
+        return i < dist_nelm / 2 ? i : dist_nelm - i;
+    default:
+        return (uint64_t)random() % 16;
+    }
+}
+
+static int
+cmp_u32(const void *aa, const void *bb)
+{
+    uint32_t a = *(const uint32_t *)aa, b = *(const uint32_t *)bb;
+    return (a > b) - (a < b);
+}
+
+// Elements of 16 bytes are ordered by their first 8 bytes
+static int
+cmp_u64(const void *aa, const void *bb)
+{
+    uint64_t a = *(const uint64_t *)aa, b = *(const uint64_t *)bb;
+    return (a > b) - (a < b);
+}
+
+static void
+check_sorted(const char *what, char *arr, size_t es,
+        int (*cmp)(const void *, const void *))
+{
+    for (size_t i = 1; i < dist_nelm; i++) {
+        if (cmp(arr + (i - 1) * es, arr + i * es) > 0) {
+            T_ASSERT_FAIL("%s: element %zu out of order", what, i);
+        }
+    }
+}
+
+T_DECL(qsort_perf_distributions,
+        "qsort perf test for 4, 8 and 16 byte elements in several orders",
+        T_META_CHECK_LEAKS(NO))
+{
+    static const size_t sizes[] = { 4, 8, 16 };
+    char *save = malloc(dist_nelm * 16);
+    char *arr = malloc(dist_nelm * 16);
+    char label[64];
+    T_QUIET; T_ASSERT_NOTNULL(save, NULL);
+    T_QUIET; T_ASSERT_NOTNULL(arr, NULL);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t es = sizes[s];
+        int (*cmp)(const void *, const void *) = es == 4 ? cmp_u32 : cmp_u64;
+
+        for (int dist = 0; dist < DIST_COUNT; dist++) {
+            memset(save, 0, dist_nelm * es);
+            for (size_t i = 0; i < dist_nelm; i++) {
+                uint64_t v = dist_value(dist, i);
+                if (es == 4) {
+                    uint32_t v32 = (uint32_t)v;
+                    memcpy(save + i * es, &v32, sizeof(v32));
+                } else {
+                    memcpy(save + i * es, &v, sizeof(v));
+                }
+            }
+
+            bcopy(save, arr, dist_nelm * es);
+            snprintf(label, sizeof(label), "%s %zu bytes (qsort)",
+                    dist_names[dist], es);
+            dt_timer_start(label);
+            qsort(arr, dist_nelm, es, cmp);
+            uint64_t qsort_time = dt_timer_stop(label);
+            check_sorted(label, arr, es, cmp);
+
+            bcopy(save, arr, dist_nelm * es);
+            snprintf(label, sizeof(label), "%s %zu bytes (Bentley)",
+                    dist_names[dist], es);
+            dt_timer_start(label);
+            qsort1(arr, dist_nelm, es, cmp);
+            uint64_t bentley_time = dt_timer_stop(label);
+            check_sorted(label, arr, es, cmp);
+
+            bcopy(save, arr, dist_nelm * es);
+            snprintf(label, sizeof(label), "%s %zu bytes (heapsort)",
+                    dist_names[dist], es);
+            dt_timer_start(label);
+            heapsort(arr, dist_nelm, es, cmp);
+            uint64_t heapsort_time = dt_timer_stop(label);
+            check_sorted(label, arr, es, cmp);
+
+            T_LOG("%s %zu bytes: qsort %lld ms, Bentley %lld ms, "
+                    "heapsort %lld ms", dist_names[dist], es,
+                    qsort_time / NSEC_PER_MSEC, bentley_time / NSEC_PER_MSEC,
+                    heapsort_time / NSEC_PER_MSEC);
+        }
+    }
+
+    free(save);
+    free(arr);
+    T_PASS("All tests completed successfully.");
+}
+
 /* qsort1 -- qsort interface implemented by faster quicksort */
 
 #define SWAPINIT(a, es) swaptype =                            \
@@ -0,0 +1,236 @@
+/*
+ * Tests for the lazy DFA engine of the TRE regex library.
+ *
+ * regexec() only takes the DFA when no submatch is asked for, so asking for
+ * one match runs the same pattern through the parallel matcher: both must
+ * always agree on whether there is a match. REG_BACKTRACKING_MATCHER is a
+ * third opinion on short strings.
+ */
+
+#include <locale.h>
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <darwintest.h>
+#include <darwintest_utils.h>
+
+static const char *patterns[] = {
+	"a", "abc", "a|b|c", "(ab|cd)+e", "a*b*c*", "(a|b)*abb", "x?y?z?",
+	"^ab", "ab$", "^$", "^a*$", "^(a|b)c$", "[0-9]+ms", "[^ab]+",
+	"[[:alpha:]]+[[:space:]]", "[[:upper:]][[:lower:]]*", "a.c", ".*",
+	"\\<ab", "ab\\>", "\\<\\>", "\\bab\\b", "\\Bb\\B", "a\\b", "^\\<a",
+	"(a|b){2,4}c", "a{3}", "(^|x)a", "a($|x)", "ERROR [0-9]+", "é+",
+};
+
+static const char *strings[] = {
+	"", "a", "b", "abc", "xabcx", "ab cd", "abb abb", "cdcdabe", "aab",
+	"123ms", "ms 12 ms", "ab\nab", "\nab\n", "a\nc", "aaa", "aaaa", "xay",
+	"Hello world", "hello World", "__ab__", "ab_ab", " a b ", "xa", "ax",
+	"ERROR 42", "error 42", "ccc", "abab c", "é", "aéé", "éa",
+};
+
+static const struct {
+	int cflags;
+	int eflags;
+} flags[] = {
+	{ REG_EXTENDED, 0 },
+	{ REG_EXTENDED | REG_ICASE, 0 },
+	{ REG_EXTENDED | REG_NEWLINE, 0 },
+	{ REG_EXTENDED, REG_NOTBOL },
+	{ REG_EXTENDED, REG_NOTEOL },
+	{ REG_EXTENDED | REG_NEWLINE, REG_NOTBOL | REG_NOTEOL },
+	{ REG_EXTENDED | REG_ENHANCED, 0 },
+};
+
+#define NPATTERNS (sizeof(patterns) / sizeof(patterns[0]))
+#define NSTRINGS (sizeof(strings) / sizeof(strings[0]))
+#define NFLAGS (sizeof(flags) / sizeof(flags[0]))
+
+static void
+check_agreement(void)
+{
+	regex_t re, nosub, bt;
+	regmatch_t pmatch[1];
+	int dfa, parallel, sub, backtrack;
+
+	for (size_t p = 0; p < NPATTERNS; p++) {
+		for (size_t f = 0; f < NFLAGS; f++) {
+			int cflags = flags[f].cflags, eflags = flags[f].eflags;
+
+			if (regcomp(&re, patterns[p], cflags) != 0) continue;
+			T_QUIET; T_ASSERT_EQ(regcomp(&nosub, patterns[p],
+					cflags | REG_NOSUB), 0, "regcomp(REG_NOSUB)");
+			T_QUIET; T_ASSERT_EQ(regcomp(&bt, patterns[p],
+					cflags | REG_BACKTRACKING_MATCHER), 0,
+					"regcomp(REG_BACKTRACKING_MATCHER)");
+			for (size_t s = 0; s < NSTRINGS; s++) {
+				dfa = regexec(&re, strings[s], 0, NULL, eflags);
+				parallel = regexec(&re, strings[s], 1, pmatch, eflags);
+				sub = regexec(&nosub, strings[s], 1, pmatch, eflags);
+				backtrack = regexec(&bt, strings[s], 1, pmatch, eflags);
+				if (dfa != parallel || dfa != sub || dfa != backtrack) {
+					T_FAIL("/%s/ flags %#x/%#x on \"%s\": dfa %d, nosub %d, "
+							"parallel %d, backtracking %d", patterns[p],
+							cflags, eflags, strings[s], dfa, sub, parallel,
+							backtrack);
+				}
+			}
+			regfree(&re);
+			regfree(&nosub);
+			regfree(&bt);
+		}
+	}
+}
+
+T_DECL(regex_dfa_agreement, "regexec() gives the same answer with and without the DFA",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	check_agreement();
+	T_ASSERT_NOTNULL(setlocale(LC_ALL, "en_US.UTF-8"), "UTF-8 locale");
+	check_agreement();
+	setlocale(LC_ALL, "C");
+	T_PASS("DFA and NFA matchers agree");
+}
+
+// In a multibyte locale, the parallel matcher reports REG_ILLSEQ when it
+// decodes an invalid sequence before it stops: the character after the end
+// of the match (two after an empty one), or anywhere when there is none.
+// With nmatch == 0 the DFA must stop at the same place. Asking for a
+// submatch does not help here, the parallel matcher then looks for the
+// longest match and reads further.
+T_DECL(regex_dfa_illseq, "regexec() with invalid UTF-8 reports REG_ILLSEQ as without the DFA",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	static const struct {
+		const char *pattern;
+		const char *string;
+		int expected;
+	} cases[] = {
+		{ "a", "\xff", REG_ILLSEQ },
+		{ "a", "a\xff", REG_ILLSEQ },
+		{ "a", "ab\xff" "c", 0 },
+		{ "a", "ab\xc3", 0 },
+		{ "ab", "ab\xff" "c", REG_ILLSEQ },
+		{ "a*", "\xff", REG_ILLSEQ },
+		{ "a*", "b\xff", REG_ILLSEQ },
+		{ "a*", "aa\xff", 0 },
+		{ "A?", "a\xff", REG_ILLSEQ },
+		{ "A?", "\n\xff" "A", REG_ILLSEQ },
+		{ "(A)?", "\xc3", REG_ILLSEQ },
+		{ "(A)?", "ab\xff" "c", 0 },
+		{ "$", "ab\xff" "c", REG_ILLSEQ },
+		{ "x", "ab\xc3", REG_ILLSEQ },
+		{ "é", "é\xff", REG_ILLSEQ },
+	};
+	regex_t re;
+
+	T_ASSERT_NOTNULL(setlocale(LC_ALL, "en_US.UTF-8"), "UTF-8 locale");
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		T_QUIET; T_ASSERT_EQ(regcomp(&re, cases[i].pattern, REG_EXTENDED), 0,
+				"regcomp(%s)", cases[i].pattern);
+		T_EXPECT_EQ(regexec(&re, cases[i].string, 0, NULL, 0),
+				cases[i].expected, "/%s/ on case %zu", cases[i].pattern, i);
+		regfree(&re);
+	}
+	setlocale(LC_ALL, "C");
+}
+
+// Every position may end up in a different state: the state cache fills up,
+// gets flushed, and the DFA eventually gives the search back to the NFA
+T_DECL(regex_dfa_cache_thrash, "regexec() on a pattern with an exponential DFA",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const size_t len = 1 << 20;
+	char *buf = malloc(len + 2);
+	regex_t re;
+	regmatch_t pmatch[1];
+
+	T_ASSERT_NOTNULL(buf, NULL);
+	for (size_t i = 0; i < len; i++) {
+		buf[i] = (arc4random() & 1) ? 'a' : 'b';
+	}
+	buf[len] = '\0';
+	T_ASSERT_EQ(regcomp(&re, "(a|b)*a(a|b){14}c", REG_EXTENDED), 0, NULL);
+	T_EXPECT_EQ(regexec(&re, buf, 0, NULL, 0), REG_NOMATCH, "dfa");
+	T_EXPECT_EQ(regexec(&re, buf, 0, NULL, 0), REG_NOMATCH, "dfa, again");
+
+	// A match at the very end, after the cache has been thrashed
+	memcpy(buf + len - 16, "aabababababababc", 16);
+	T_EXPECT_EQ(regexec(&re, buf, 0, NULL, 0), 0, "dfa");
+	T_EXPECT_EQ(regexec(&re, buf, 1, pmatch, 0), 0, "parallel");
+	regfree(&re);
+	free(buf);
+}
+
+// A log like buffer, with the interesting line at the very end
+static char *
+make_log(size_t len)
+{
+	static const char *lines[] = {
+		"2020-07-14 10:00:01 INFO [1234] request served in 12ms\n",
+		"2020-07-14 10:00:02 DEBUG [1235] cache hit for key user:42\n",
+		"2020-07-14 10:00:03 WARN [1236] slow query took 350ms elapsed\n",
+		"2020-07-14 10:00:04 INFO [1237] connection from 10.0.0.1 closed\n",
+	};
+	static const char last[] = "2020-07-14 10:00:05 ERROR [1238] timeout\n";
+	char *buf = malloc(len + 1);
+	size_t off = 0, n;
+
+	T_QUIET; T_ASSERT_NOTNULL(buf, NULL);
+	for (unsigned i = 0; off + 128 < len; i++) {
+		n = strlen(lines[i % 4]);
+		memcpy(buf + off, lines[i % 4], n);
+		off += n;
+	}
+	memcpy(buf + off, last, sizeof(last));
+	return buf;
+}
+
+static void
+time_regexec(const char *pattern, int cflags, const char *buf, size_t len)
+{
+	regex_t re, bt;
+	regmatch_t pmatch[1];
+	uint64_t ns;
+	char name[128];
+
+	T_QUIET; T_ASSERT_EQ(regcomp(&re, pattern, cflags), 0, "%s", pattern);
+	T_QUIET; T_ASSERT_EQ(regcomp(&bt, pattern,
+			cflags | REG_BACKTRACKING_MATCHER), 0, "%s", pattern);
+
+	snprintf(name, sizeof(name), "/%s/ dfa", pattern);
+	dt_timer_start(name);
+	T_QUIET; T_EXPECT_EQ(regexec(&re, buf, 0, NULL, 0), 0, NULL);
+	ns = dt_timer_stop(name);
+	T_LOG("%s: %.1f MB/s", name, (double)len * 1000 / ns);
+
+	snprintf(name, sizeof(name), "/%s/ parallel", pattern);
+	dt_timer_start(name);
+	T_QUIET; T_EXPECT_EQ(regexec(&re, buf, 1, pmatch, 0), 0, NULL);
+	ns = dt_timer_stop(name);
+	T_LOG("%s: %.1f MB/s", name, (double)len * 1000 / ns);
+
+	snprintf(name, sizeof(name), "/%s/ backtracking", pattern);
+	dt_timer_start(name);
+	T_QUIET; T_EXPECT_EQ(regexec(&bt, buf, 1, pmatch, 0), 0, NULL);
+	ns = dt_timer_stop(name);
+	T_LOG("%s: %.1f MB/s", name, (double)len * 1000 / ns);
+
+	regfree(&re);
+	regfree(&bt);
+}
+
+T_DECL(regex_dfa_perf, "regexec() throughput of the DFA, parallel and backtracking matchers",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const size_t len = 4 << 20;
+	char *buf = make_log(len);
+	size_t n = strlen(buf);
+
+	time_regexec("ERROR \\[[0-9]+\\] timeout", REG_EXTENDED, buf, n);
+	time_regexec("[0-9]+\\] timeout", REG_EXTENDED, buf, n);
+	time_regexec("^2020-07-14 10:00:05", REG_EXTENDED | REG_NEWLINE, buf, n);
+	time_regexec("(ERROR|FATAL|PANIC) \\[", REG_EXTENDED, buf, n);
+	free(buf);
+}
@@ -0,0 +1,186 @@
+/*
+ * Bulk transfers through stdio: large fwrite() calls go to the write
+ * function in whole buffers at once, large fread() calls read straight into
+ * the caller's memory, and line reading throughput.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <darwintest.h>
+#include <darwintest_utils.h>
+
+struct sink {
+	char *data;
+	size_t len;
+	size_t cap;
+	int writes;
+	int largest;
+};
+
+static int
+sink_write(void *cookie, const char *buf, int n)
+{
+	struct sink *s = cookie;
+
+	if (s->len + (size_t)n > s->cap) {
+		s->cap = (s->len + (size_t)n) * 2;
+		s->data = realloc(s->data, s->cap);
+		T_QUIET; T_ASSERT_NOTNULL(s->data, NULL);
+	}
+	memcpy(s->data + s->len, buf, (size_t)n);
+	s->len += (size_t)n;
+	s->writes++;
+	if (n > s->largest) {
+		s->largest = n;
+	}
+	return n;
+}
+
+static void
+check_writes(int mode, const char *name)
+{
+	const size_t bufsize = 4096, len = (1 << 20) + 123;
+	struct sink s = { 0 };
+	char *src = malloc(len);
+	FILE *fp;
+
+	T_QUIET; T_ASSERT_NOTNULL(src, NULL);
+	for (size_t i = 0; i < len; i++) {
+		src[i] = (i % 61 == 60) ? '\n' : (char)('a' + i % 26);
+	}
+	fp = funopen(&s, NULL, sink_write, NULL, NULL);
+	T_QUIET; T_ASSERT_NOTNULL(fp, NULL);
+	T_QUIET; T_ASSERT_EQ(setvbuf(fp, NULL, mode, bufsize), 0, NULL);
+
+	// A small write leaves a partial buffer, which is filled first
+	T_EXPECT_EQ(fwrite(src, 1, 10, fp), (size_t)10, "%s: small fwrite", name);
+	T_EXPECT_EQ(fwrite(src + 10, 1, len - 10, fp), len - 10,
+			"%s: large fwrite", name);
+	T_EXPECT_EQ(fclose(fp), 0, NULL);
+
+	T_EXPECT_EQ(s.len, len, "%s: all bytes written", name);
+	T_EXPECT_EQ(memcmp(s.data, src, len), 0, "%s: in order", name);
+	T_LOG("%s: %d writes, largest %d bytes", name, s.writes, s.largest);
+	if (mode != _IOLBF) {
+		T_EXPECT_LE(s.writes, 4, "%s: large writes are not split up", name);
+	}
+	free(s.data);
+	free(src);
+}
+
+T_DECL(stdio_bulk_fwrite, "large fwrite() calls bypass the buffer in one write",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	check_writes(_IOFBF, "fully buffered");
+	check_writes(_IOLBF, "line buffered");
+	check_writes(_IONBF, "unbuffered");
+}
+
+T_DECL(stdio_bulk_fread, "large fread() calls after small ones",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const size_t len = (3 << 20) + 4321;
+	char *src = malloc(len), *dst = malloc(len), path[PATH_MAX];
+	size_t off = 0, n;
+	FILE *fp;
+
+	T_QUIET; T_ASSERT_NOTNULL(src, NULL);
+	T_QUIET; T_ASSERT_NOTNULL(dst, NULL);
+	arc4random_buf(src, len);
+	snprintf(path, sizeof(path), "%s/stdio_bulk_fread", dt_tmpdir());
+	fp = fopen(path, "w+");
+	T_ASSERT_NOTNULL(fp, "fopen(%s)", path);
+	T_ASSERT_EQ(fwrite(src, 1, len, fp), len, NULL);
+	rewind(fp);
+
+	// Alternate reads smaller and larger than the buffer
+	for (int i = 0; off < len; i++) {
+		n = (i & 1) ? 1 + arc4random_uniform(1 << 20) : 1 + arc4random_uniform(100);
+		if (n > len - off) {
+			n = len - off;
+		}
+		T_QUIET; T_ASSERT_EQ(fread(dst + off, 1, n, fp), n, NULL);
+		off += n;
+	}
+	T_EXPECT_EQ(fread(dst, 1, 1, fp), (size_t)0, "EOF");
+	T_EXPECT_TRUE(feof(fp), NULL);
+	T_EXPECT_EQ(memcmp(src, dst, len), 0, "fread returns the file");
+	fclose(fp);
+	unlink(path);
+	free(src);
+	free(dst);
+}
+
+// STDIO_PERF_MB sets the size of the file, 512MB by default
+T_DECL(stdio_lines_perf, "line reading throughput of getline(), fgets() and fread()",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const char *env = getenv("STDIO_PERF_MB");
+	size_t mb = env ? strtoul(env, NULL, 10) : 512, size = mb << 20, total;
+	char path[PATH_MAX], chunk[1 << 16], line[4096], *buf = NULL;
+	size_t cap = 0, lines = 0, expected = 0;
+	ssize_t r;
+	uint64_t ns;
+	FILE *fp;
+
+	// Records of 20 to 120 bytes, as in a log or CSV file
+	snprintf(path, sizeof(path), "%s/stdio_lines", dt_tmpdir());
+	fp = fopen(path, "w");
+	T_ASSERT_NOTNULL(fp, "fopen(%s)", path);
+	for (total = 0; total < size; total += sizeof(chunk)) {
+		for (size_t i = 0; i < sizeof(chunk); i++) {
+			chunk[i] = (char)('a' + arc4random_uniform(26));
+		}
+		for (size_t i = 20 + arc4random_uniform(100); i < sizeof(chunk) - 1;
+				i += 20 + arc4random_uniform(100)) {
+			chunk[i] = '\n';
+			expected++;
+		}
+		chunk[sizeof(chunk) - 1] = '\n';
+		expected++;
+		T_QUIET; T_ASSERT_EQ(fwrite(chunk, 1, sizeof(chunk), fp),
+				sizeof(chunk), NULL);
+	}
+	T_ASSERT_EQ(fclose(fp), 0, "wrote %zu MB, %zu lines", mb, expected);
+
+	fp = fopen(path, "r");
+	T_ASSERT_NOTNULL(fp, NULL);
+	dt_timer_start("getline");
+	while ((r = getline(&buf, &cap, fp)) > 0) {
+		lines++;
+	}
+	ns = dt_timer_stop("getline");
+	T_EXPECT_EQ(lines, expected, "getline() line count");
+	T_LOG("getline: %.1f MB/s, %.1f ns per line", (double)size * 1000 / ns,
+			(double)ns / lines);
+
+	rewind(fp);
+	lines = 0;
+	dt_timer_start("fgets");
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lines++;
+	}
+	ns = dt_timer_stop("fgets");
+	T_EXPECT_EQ(lines, expected, "fgets() line count");
+	T_LOG("fgets: %.1f MB/s, %.1f ns per line", (double)size * 1000 / ns,
+			(double)ns / lines);
+
+	rewind(fp);
+	lines = 0;
+	dt_timer_start("fread");
+	while ((total = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+		for (char *p = chunk; (p = memchr(p, '\n', total - (size_t)(p - chunk))) != NULL; p++) {
+			lines++;
+		}
+	}
+	ns = dt_timer_stop("fread");
+	T_EXPECT_EQ(lines, expected, "fread() line count");
+	T_LOG("fread + memchr: %.1f MB/s", (double)size * 1000 / ns);
+
+	fclose(fp);
+	free(buf);
+	unlink(path);
+}
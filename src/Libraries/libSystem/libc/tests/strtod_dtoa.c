@@ -0,0 +1,299 @@
+/*
+ * Tests for the fast paths of dtoa() and strtod() in gdtoa.
+ *
+ * Both only handle the inputs whose result they can prove and hand the rest
+ * back to the big integer code, so the references here are computed without
+ * either of them: integer arithmetic for the decimal expansion of integral
+ * doubles, and round trips for everything else.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <darwintest.h>
+#include <darwintest_utils.h>
+
+extern char *__dtoa(double, int, int, int *, int *, char **);
+extern void __freedtoa(char *);
+
+static double
+random_double(void)
+{
+	uint64_t bits;
+	double d;
+
+	do {
+		bits = ((uint64_t)arc4random() << 32 | arc4random()) & ~(1ULL << 63);
+		memcpy(&d, &bits, sizeof(d));
+	} while (!isfinite(d) || d == 0);
+	return d;
+}
+
+static uint64_t
+bits_of(double d)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+static const struct {
+	const char *fmt;
+	double d;
+	const char *expected;
+} known[] = {
+	{ "%.17g", 0.1, "0.10000000000000001" },
+	{ "%.20f", 0.1, "0.10000000000000000555" },
+	{ "%.17g", 1e23, "9.9999999999999992e+22" },
+	{ "%.3e", 5e-324, "4.941e-324" },
+	{ "%.17g", 2.2250738585072014e-308, "2.2250738585072014e-308" },
+	{ "%.17g", 1.7976931348623157e308, "1.7976931348623157e+308" },
+	{ "%.0f", 0.5, "0" },
+	{ "%.0f", 1.5, "2" },
+	{ "%.0f", 2.5, "2" },
+	{ "%.1f", 0.25, "0.2" },
+	{ "%.1f", 0.35, "0.3" },
+	{ "%.2e", 1.125, "1.12e+00" },
+	{ "%.2e", 1.375, "1.38e+00" },
+	{ "%g", 100000, "100000" },
+	{ "%g", 1e6, "1e+06" },
+	{ "%g", 0.0001, "0.0001" },
+	{ "%.3f", 1e-10, "0.000" },
+	{ "%.0e", 9.5, "1e+01" },
+	{ "%f", 9007199254740993.0, "9007199254740992.000000" },
+};
+
+T_DECL(printf_float_known, "printf() of doubles with known expansions",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	char buf[64];
+
+	for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+		snprintf(buf, sizeof(buf), known[i].fmt, known[i].d);
+		T_EXPECT_EQ_STR(buf, known[i].expected, "%s of %a", known[i].fmt,
+				known[i].d);
+	}
+}
+
+// The expansion of an integral double rounded to prec significant digits,
+// ties to even, in the format of "%.*e"
+static void
+integer_e(uint64_t n, int prec, char *buf, size_t size)
+{
+	char digits[24];
+	int len = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)n);
+	int exp = len - 1;
+
+	if (prec < len) {
+		uint64_t p10 = 1, q, r;
+
+		for (int i = prec; i < len; i++) {
+			p10 *= 10;
+		}
+		q = n / p10;
+		r = n % p10;
+		if (r > p10 / 2 || (r == p10 / 2 && (q & 1))) {
+			q++;
+		}
+		len = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)q);
+		if (len > prec) {
+			digits[--len] = '\0';
+			exp++;
+		}
+	}
+	while (len < prec) {
+		digits[len++] = '0';
+	}
+	digits[len] = '\0';
+	snprintf(buf, size, "%c%s%se%+03d", digits[0], prec > 1 ? "." : "",
+			digits + 1, exp);
+}
+
+T_DECL(printf_float_integers, "printf(\"%.*e\") of integral doubles against integer arithmetic",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	char buf[64], expected[64];
+	int failed = 0;
+
+	for (int i = 0; i < 200000; i++) {
+		uint64_t n = ((uint64_t)arc4random() << 32 | arc4random()) >>
+				arc4random_uniform(64);
+		double d;
+		int prec = 1 + (int)arc4random_uniform(20);
+
+		// Halfway cases at the last printed digit
+		if (i & 1) {
+			n = n / 10 * 10 + 5;
+		}
+		d = (double)n;
+		if (d >= 0x1p64) {
+			continue;
+		}
+		n = (uint64_t)d;
+		snprintf(buf, sizeof(buf), "%.*e", prec - 1, d);
+		integer_e(n, prec, expected, sizeof(expected));
+		if (strcmp(buf, expected) != 0 && failed++ < 10) {
+			T_FAIL("%%.%de of %llu: \"%s\", expected \"%s\"", prec - 1,
+					(unsigned long long)n, buf, expected);
+		}
+	}
+	T_EXPECT_EQ(failed, 0, "printf() rounds integral doubles correctly");
+}
+
+T_DECL(dtoa_shortest, "dtoa() mode 0 gives the shortest digits that round trip",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	char buf[64], *digits, *end;
+	int decpt, sign, failed = 0;
+
+	for (int i = 0; i < 200000; i++) {
+		double d = random_double();
+		int ndigits, prec;
+
+		if (i & 1) {
+			d = (double)arc4random_uniform(1000000) / 1000;
+		} else if (i % 4 == 2) {
+			d = ldexp(1.0, (int)arc4random_uniform(2098) - 1074);
+		}
+		if (d == 0) {
+			continue;
+		}
+		digits = __dtoa(d, 0, 0, &decpt, &sign, &end);
+		ndigits = (int)(end - digits);
+		snprintf(buf, sizeof(buf), "0.%se%d", digits, decpt);
+		__freedtoa(digits);
+
+		// The shortest "%.*e" that round trips
+		for (prec = 1; prec < 17; prec++) {
+			char shortest[64];
+
+			snprintf(shortest, sizeof(shortest), "%.*e", prec - 1, d);
+			if (strtod(shortest, NULL) == d) {
+				break;
+			}
+		}
+		if ((strtod(buf, NULL) != d || ndigits > prec) && failed++ < 10) {
+			T_FAIL("dtoa(%a) = %s, %d digits, %d needed", d, buf, ndigits,
+					prec);
+		}
+	}
+	T_EXPECT_EQ(failed, 0, "dtoa() mode 0 is shortest and round trips");
+}
+
+T_DECL(strtod_round_trip, "strtod() of printed doubles gives them back",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	char buf[64], *end;
+	int failed = 0;
+
+	for (int i = 0; i < 200000; i++) {
+		double d = random_double(), r;
+
+		snprintf(buf, sizeof(buf), "%.17g", d);
+		r = strtod(buf, &end);
+		if ((bits_of(r) != bits_of(d) || *end != '\0') && failed++ < 10) {
+			T_FAIL("strtod(\"%s\") = %a, expected %a", buf, r, d);
+		}
+		snprintf(buf, sizeof(buf), "%.*e", 17 + (int)arc4random_uniform(20), d);
+		r = strtod(buf, NULL);
+		if (bits_of(r) != bits_of(d) && failed++ < 10) {
+			T_FAIL("strtod(\"%s\") = %a, expected %a", buf, r, d);
+		}
+	}
+	T_EXPECT_EQ(failed, 0, "strtod() round trips");
+}
+
+// Between 2^53 and 2^54 doubles are even integers, so the odd ones are exact
+// ties: they round to even, and any nonzero digit after them rounds them up
+T_DECL(strtod_ties, "strtod() of halfway cases",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	char buf[128];
+	int failed = 0;
+
+	for (int i = 0; i < 100000; i++) {
+		uint64_t n = (1ULL << 53) | ((uint64_t)arc4random() << 21 |
+				arc4random_uniform(1 << 21)) | 1;
+		uint64_t even = (n & 2) ? n + 1 : n - 1;
+		uint64_t above = n + 1;
+		int zeros = (int)arc4random_uniform(40);
+		double r;
+
+		snprintf(buf, sizeof(buf), "%llu", (unsigned long long)n);
+		r = strtod(buf, NULL);
+		if (r != (double)even && failed++ < 10) {
+			T_FAIL("strtod(\"%s\") = %.17g, expected %llu", buf, r,
+					(unsigned long long)even);
+		}
+		snprintf(buf, sizeof(buf), "%llu.%0*d1", (unsigned long long)n,
+				zeros, 0);
+		r = strtod(buf, NULL);
+		if (r != (double)above && failed++ < 10) {
+			T_FAIL("strtod(\"%s\") = %.17g, expected %llu", buf, r,
+					(unsigned long long)above);
+		}
+		snprintf(buf, sizeof(buf), "%llue-%d", (unsigned long long)n * 10, 1);
+		r = strtod(buf, NULL);
+		if (r != (double)even && failed++ < 10) {
+			T_FAIL("strtod(\"%s\") = %.17g, expected %llu", buf, r,
+					(unsigned long long)even);
+		}
+	}
+	T_EXPECT_EQ(failed, 0, "strtod() rounds ties to even");
+}
+
+T_DECL(strtod_dtoa_perf, "printf() and strtod() of doubles",
+		T_META("owner", "Core Darwin Daemons & Tools"), T_META_CHECK_LEAKS(false))
+{
+	const int n = 1000000;
+	double *values = malloc((size_t)n * sizeof(double));
+	char (*strings)[32] = malloc((size_t)n * sizeof(*strings));
+	char buf[64];
+	volatile double sum = 0;
+	uint64_t ns;
+
+	T_ASSERT_NOTNULL(values, NULL);
+	T_ASSERT_NOTNULL(strings, NULL);
+	for (int i = 0; i < n; i++) {
+		values[i] = random_double();
+		snprintf(strings[i], sizeof(strings[i]), "%.17g", values[i]);
+	}
+
+	dt_timer_start("printf %.17g");
+	for (int i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "%.17g", values[i]);
+	}
+	ns = dt_timer_stop("printf %.17g");
+	T_LOG("printf %%.17g: %.1f ns per double", (double)ns / n);
+
+	dt_timer_start("printf %g");
+	for (int i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "%g", values[i]);
+	}
+	ns = dt_timer_stop("printf %g");
+	T_LOG("printf %%g: %.1f ns per double", (double)ns / n);
+
+	dt_timer_start("dtoa shortest");
+	for (int i = 0; i < n; i++) {
+		int decpt, sign;
+		char *end;
+
+		__freedtoa(__dtoa(values[i], 0, 0, &decpt, &sign, &end));
+	}
+	ns = dt_timer_stop("dtoa shortest");
+	T_LOG("dtoa mode 0: %.1f ns per double", (double)ns / n);
+
+	dt_timer_start("strtod");
+	for (int i = 0; i < n; i++) {
+		sum += strtod(strings[i], NULL);
+	}
+	ns = dt_timer_stop("strtod");
+	T_LOG("strtod of %%.17g: %.1f ns per double", (double)ns / n);
+
+	free(values);
+	free(strings);
+	T_PASS("done");
+}
@@ -437,6 +437,85 @@ void
 dispatch_async_enforce_qos_class_f(dispatch_queue_t queue,
 		void *_Nullable context, dispatch_function_t work);
 
+/*!
+ * @typedef dispatch_queue_trace_histogram_s
+ *
+ * @abstract
+ * Distribution of durations recorded by the queue tracer.
+ *
+ * @field dqth_count
+ * The number of durations recorded.
+ *
+ * @field dqth_total_ns
+ * The sum of the durations recorded, in nanoseconds.
+ *
+ * @field dqth_buckets
+ * Bucket 0 counts durations under 2ns, bucket i the durations in
+ * [2^i, 2^(i+1)) nanoseconds.
+ */
+#define DISPATCH_QUEUE_TRACE_HISTOGRAM_BUCKETS 64
+typedef struct dispatch_queue_trace_histogram_s {
+	uint64_t dqth_count;
+	uint64_t dqth_total_ns;
+	uint64_t dqth_buckets[DISPATCH_QUEUE_TRACE_HISTOGRAM_BUCKETS];
+} dispatch_queue_trace_histogram_s;
+
+/*!
+ * @function dispatch_queue_trace_get_histograms
+ *
+ * @abstract
+ * Returns how long work items waited in a queue and ran once dequeued.
+ *
+ * @discussion
+ * Only available when the process was started with the
+ * LIBDISPATCH_QUEUE_TRACE environment variable set, on platforms without
+ * introspection support. Every thread records the enqueue, dequeue, invoke
+ * start and invoke end of work items in a ring buffer of its own; the
+ * histograms are computed from the events still present in these buffers,
+ * i.e. they describe recent activity.
+ *
+ * Wait times are measured from enqueue to dequeue, run times from invoke
+ * start to invoke end, for functions and blocks submitted to the queue.
+ *
+ * @param queue
+ * The queue to report on.
+ *
+ * @param wait
+ * Filled with the wait time distribution. May be NULL.
+ *
+ * @param run
+ * Filled with the run time distribution. May be NULL.
+ *
+ * @result
+ * false if tracing is not enabled, in which case the histograms are zeroed.
+ */
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NOTHROW
+bool
+dispatch_queue_trace_get_histograms(dispatch_queue_t queue,
+		dispatch_queue_trace_histogram_s *_Nullable wait,
+		dispatch_queue_trace_histogram_s *_Nullable run);
+
+/*!
+ * @function dispatch_queue_trace_write
+ *
+ * @abstract
+ * Writes the events recorded by the queue tracer in the Chrome trace event
+ * format, which Perfetto and chrome://tracing can load.
+ *
+ * @discussion
+ * When LIBDISPATCH_QUEUE_TRACE is set to a path, the trace is also written
+ * there when the process exits.
+ *
+ * @param path
+ * The file to create or overwrite.
+ *
+ * @result
+ * 0 on success, ENOTSUP if tracing is not enabled, or an errno value.
+ */
+DISPATCH_EXPORT DISPATCH_NONNULL1 DISPATCH_NOTHROW
+int
+dispatch_queue_trace_write(const char *path);
+
 #ifdef __ANDROID__
 /*!
  * @function _dispatch_install_thread_detach_callback
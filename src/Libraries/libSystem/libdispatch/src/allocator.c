@@ -26,6 +26,12 @@
 #ifndef VM_MEMORY_LIBDISPATCH
 #define VM_MEMORY_LIBDISPATCH 74
 #endif
+#if !HAVE_MACH && !defined(VM_MAKE_TAG)
+#define VM_MAKE_TAG(tag) (-1) // the fd argument of an anonymous mmap(2)
+#endif
+#if defined(__linux__) && !defined(MADV_FREE)
+#define MADV_FREE MADV_DONTNEED
+#endif
 
 // _dispatch_main_heap is is the first heap in the linked list, where searches
 // always begin.
@@ -43,12 +49,27 @@
 // in alloc_continuation_from_heap or _magazine when derefing the magazine ptr.
 DISPATCH_GLOBAL(dispatch_heap_t _dispatch_main_heap);
 
+// Index of the magazine of the current CPU in a heap
+DISPATCH_ALWAYS_INLINE
+static unsigned int
+magazine_index(void)
+{
+	unsigned int cpu = _dispatch_cpu_number();
+#if defined(__linux__)
+	// CPU numbers can be sparse (offlined CPUs, restricted cpusets)
+	if (unlikely(cpu >= NUM_CPU)) {
+		cpu %= NUM_CPU;
+	}
+#endif
+	return cpu;
+}
+
 DISPATCH_ALWAYS_INLINE
 static void
 set_last_found_page(bitmap_t *val)
 {
 	dispatch_assert(_dispatch_main_heap);
-	unsigned int cpu = _dispatch_cpu_number();
+	unsigned int cpu = magazine_index();
 	_dispatch_main_heap[cpu].header.last_found_page = val;
 }
 
@@ -57,7 +78,7 @@ static bitmap_t *
 last_found_page(void)
 {
 	dispatch_assert(_dispatch_main_heap);
-	unsigned int cpu = _dispatch_cpu_number();
+	unsigned int cpu = magazine_index();
 	return _dispatch_main_heap[cpu].header.last_found_page;
 }
 
@@ -387,9 +408,9 @@ _dispatch_alloc_try_create_heap(dispatch_heap_t *heap_ptr)
 #if DISPATCH_DEBUG
 	// Double-check our math.
 	dispatch_assert(aligned_region % DISPATCH_ALLOCATOR_PAGE_SIZE == 0);
-	dispatch_assert(aligned_region % vm_kernel_page_size == 0);
+	dispatch_assert(aligned_region % (uintptr_t)getpagesize() == 0);
 	dispatch_assert(aligned_region_end % DISPATCH_ALLOCATOR_PAGE_SIZE == 0);
-	dispatch_assert(aligned_region_end % vm_kernel_page_size == 0);
+	dispatch_assert(aligned_region_end % (uintptr_t)getpagesize() == 0);
 	dispatch_assert(aligned_region_end > aligned_region);
 	dispatch_assert(top_slop_len % DISPATCH_ALLOCATOR_PAGE_SIZE == 0);
 	dispatch_assert(bottom_slop_len % DISPATCH_ALLOCATOR_PAGE_SIZE == 0);
@@ -435,7 +456,7 @@ _dispatch_alloc_continuation_from_heap(dispatch_heap_t heap)
 {
 	dispatch_continuation_t cont;
 
-	unsigned int cpu_number = _dispatch_cpu_number();
+	unsigned int cpu_number = magazine_index();
 #ifdef DISPATCH_DEBUG
 	dispatch_assert(cpu_number < NUM_CPU);
 #endif
@@ -648,6 +669,7 @@ _dispatch_alloc_init(void)
 }
 #endif // DISPATCH_CONTINUATION_MALLOC || DISPATCH_DEBUG
 
+#if TARGET_OS_MAC
 kern_return_t
 _dispatch_allocator_enumerate(task_t remote_task,
 		const struct dispatch_allocator_layout_s *remote_dal,
@@ -679,6 +701,7 @@ _dispatch_allocator_enumerate(task_t remote_task,
 
 	return KERN_SUCCESS;
 }
+#endif // TARGET_OS_MAC
 
 #endif // DISPATCH_ALLOCATOR
 
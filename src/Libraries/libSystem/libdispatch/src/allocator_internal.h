@@ -30,6 +30,8 @@
 #ifndef DISPATCH_ALLOCATOR
 #if TARGET_OS_MAC && (defined(__LP64__) || TARGET_OS_IPHONE)
 #define DISPATCH_ALLOCATOR 1
+#elif defined(__linux__) && defined(__LP64__)
+#define DISPATCH_ALLOCATOR 1
 #endif
 #endif
 
@@ -47,7 +49,9 @@
 #endif
 
 #ifndef DISPATCH_CONTINUATION_MALLOC
-#if DISPATCH_USE_NANOZONE || !DISPATCH_ALLOCATOR
+// On Linux, keep malloc-backed continuations around so that
+// LIBDISPATCH_CONTINUATION_ALLOCATOR=0 can switch back to them.
+#if DISPATCH_USE_NANOZONE || !DISPATCH_ALLOCATOR || defined(__linux__)
 #define DISPATCH_CONTINUATION_MALLOC 1
 #endif
 #endif
@@ -78,6 +82,17 @@
 #define PACK_FIRST_PAGE_WITH_CONTINUATIONS 0
 #endif
 
+#if defined(__linux__) && !defined(PAGE_MAX_SIZE)
+// There is no compile time page size on Linux: use the largest base page
+// size of the architecture, so that allocator pages are always made of
+// whole kernel pages when they get madvise()d.
+#if defined(__x86_64__) || defined(__i386__)
+#define PAGE_MAX_SIZE 4096u
+#else
+#define PAGE_MAX_SIZE 65536u
+#endif
+#define PAGE_MAX_MASK (PAGE_MAX_SIZE - 1u)
+#endif
 #ifndef PAGE_MAX_SIZE
 #define PAGE_MAX_SIZE PAGE_SIZE
 #endif
@@ -90,6 +105,9 @@
 
 #if TARGET_OS_IPHONE
 #define PAGES_PER_MAGAZINE 64
+#elif defined(__linux__)
+// 2MB magazines whatever the page size, so the maps fit in the first page
+#define PAGES_PER_MAGAZINE ((2u << 20) / DISPATCH_ALLOCATOR_PAGE_SIZE)
 #else
 #define PAGES_PER_MAGAZINE 512
 #endif
@@ -282,10 +300,12 @@ struct dispatch_magazine_s {
 #endif
 
 
+#if TARGET_OS_MAC
 kern_return_t _dispatch_allocator_enumerate(task_t remote_task,
 			const struct dispatch_allocator_layout_s *remote_allocator_layout,
 			vm_address_t zone_address, memory_reader_t reader,
 			void (^recorder)(vm_address_t, void *, size_t , bool *stop));
+#endif
 
 #endif // DISPATCH_ALLOCATOR
 
@@ -26,15 +26,198 @@ static char const * const _dispatch_apply_key = "apply";
 #define DISPATCH_APPLY_INVOKE_REDIRECT 0x1
 #define DISPATCH_APPLY_INVOKE_WAIT     0x2
 
+#pragma mark -
+#pragma mark dispatch_apply_ranges
+
+// The iterations are split in one contiguous range per thread. Each thread
+// takes chunks from the front of its range, a quarter of what is left every
+// time, and when it runs dry steals the back half of another range, trying
+// the next slots first. Fine-grained loops touch shared cache lines once per
+// chunk instead of once per iteration, and threads mostly walk adjacent
+// indices, which keeps the data they touch apart.
+
+#define DISPATCH_APPLY_RANGES_MAX_ITERATIONS UINT32_MAX
+#define DISPATCH_APPLY_CHUNK_DIVISOR 4u
+
+typedef struct dispatch_apply_range_s {
+	uint64_t volatile dar_bounds; // begin in low, end in high 32 bits
+} DISPATCH_CACHELINE_ALIGN *dispatch_apply_range_t;
+
+typedef struct dispatch_apply_ranges_s {
+	int32_t dar_count;
+	struct dispatch_apply_range_s dar_slots[];
+} *dispatch_apply_ranges_t;
+
+DISPATCH_STATIC_GLOBAL(bool _dispatch_apply_ranges_enabled);
+DISPATCH_STATIC_GLOBAL(dispatch_once_t _dispatch_apply_ranges_pred);
+
+static void
+_dispatch_apply_ranges_init(void *context DISPATCH_UNUSED)
+{
+	_dispatch_apply_ranges_enabled =
+			_dispatch_getenv_bool("LIBDISPATCH_APPLY_RANGES", true);
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline uint64_t
+_dispatch_apply_range_make(size_t begin, size_t end)
+{
+	return ((uint64_t)end << 32) | (uint64_t)begin;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline size_t
+_dispatch_apply_range_begin(uint64_t bounds)
+{
+	return (size_t)(uint32_t)bounds;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline size_t
+_dispatch_apply_range_end(uint64_t bounds)
+{
+	return (size_t)(bounds >> 32);
+}
+
+static dispatch_apply_ranges_t
+_dispatch_apply_ranges_create(size_t iterations, int32_t thr_cnt)
+{
+	dispatch_apply_ranges_t dars;
+	size_t size = sizeof(*dars) + (size_t)thr_cnt * sizeof(dars->dar_slots[0]);
+
+	if (iterations > DISPATCH_APPLY_RANGES_MAX_ITERATIONS) {
+		return NULL;
+	}
+	dispatch_once_f(&_dispatch_apply_ranges_pred, NULL,
+			_dispatch_apply_ranges_init);
+	if (!_dispatch_apply_ranges_enabled) {
+		return NULL;
+	}
+#if defined(_WIN32)
+	dars = _aligned_malloc(size, DISPATCH_CACHELINE_SIZE);
+	if (!dars) {
+		return NULL;
+	}
+#else
+	if (posix_memalign((void **)&dars, DISPATCH_CACHELINE_SIZE, size)) {
+		// the shared index still works
+		return NULL;
+	}
+#endif
+	dars->dar_count = thr_cnt;
+	for (int32_t i = 0; i < thr_cnt; i++) {
+		uint64_t b = (uint64_t)iterations * (uint64_t)i / (uint64_t)thr_cnt;
+		uint64_t e = (uint64_t)iterations * (uint64_t)(i + 1) /
+				(uint64_t)thr_cnt;
+		dars->dar_slots[i].dar_bounds =
+				_dispatch_apply_range_make((size_t)b, (size_t)e);
+	}
+	return dars;
+}
+
+static void
+_dispatch_apply_ranges_dispose(dispatch_apply_ranges_t dars)
+{
+#if defined(_WIN32)
+	_aligned_free(dars);
+#else
+	free(dars);
+#endif
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_apply_range_take(dispatch_apply_range_t dar, size_t *idx,
+		size_t *end)
+{
+	uint64_t old_bounds, new_bounds;
+	size_t b, e, chunk;
+
+	os_atomic_rmw_loop(&dar->dar_bounds, old_bounds, new_bounds, relaxed, {
+		b = _dispatch_apply_range_begin(old_bounds);
+		e = _dispatch_apply_range_end(old_bounds);
+		if (unlikely(b >= e)) {
+			os_atomic_rmw_loop_give_up(return false);
+		}
+		chunk = (e - b + DISPATCH_APPLY_CHUNK_DIVISOR - 1) /
+				DISPATCH_APPLY_CHUNK_DIVISOR;
+		new_bounds = _dispatch_apply_range_make(b + chunk, e);
+	});
+	*idx = b;
+	*end = b + chunk;
+	return true;
+}
+
+DISPATCH_NOINLINE
+static bool
+_dispatch_apply_range_steal(dispatch_apply_range_t victim,
+		dispatch_apply_range_t dar)
+{
+	uint64_t old_bounds, new_bounds;
+	size_t b, e, mid;
+
+	os_atomic_rmw_loop(&victim->dar_bounds, old_bounds, new_bounds, relaxed, {
+		b = _dispatch_apply_range_begin(old_bounds);
+		e = _dispatch_apply_range_end(old_bounds);
+		if (b >= e) {
+			os_atomic_rmw_loop_give_up(return false);
+		}
+		mid = b + (e - b) / 2;
+		new_bounds = _dispatch_apply_range_make(b, mid);
+	});
+	// Our own range is empty, thieves leave it alone until this store
+	os_atomic_store(&dar->dar_bounds, _dispatch_apply_range_make(mid, e),
+			relaxed);
+	return true;
+}
+
+// Next chunk [idx, end) for the thread owning slot, false once all ranges
+// have been handed out.
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_apply_ranges_next(dispatch_apply_ranges_t dars, int32_t slot,
+		size_t *idx, size_t *end)
+{
+	dispatch_apply_range_t dar = &dars->dar_slots[slot];
+	int32_t i;
+
+	while (!_dispatch_apply_range_take(dar, idx, end)) {
+		for (i = 1; i < dars->dar_count; i++) {
+			int32_t victim = (slot + i) % dars->dar_count;
+			if (_dispatch_apply_range_steal(&dars->dar_slots[victim], dar)) {
+				break;
+			}
+		}
+		if (i == dars->dar_count) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#pragma mark -
+#pragma mark dispatch_apply
+
 DISPATCH_ALWAYS_INLINE
 static inline void
 _dispatch_apply_invoke2(dispatch_apply_t da, long invoke_flags)
 {
 	size_t const iter = da->da_iterations;
-	size_t idx, done = 0;
-
-	idx = os_atomic_inc_orig2o(da, da_index, acquire);
-	if (unlikely(idx >= iter)) goto out;
+	dispatch_apply_ranges_t const dars = da->da_ranges;
+	size_t idx, end, done = 0;
+	int32_t slot = 0;
+
+	if (dars) {
+		slot = (int32_t)os_atomic_inc_orig2o(da, da_index, relaxed);
+		if (unlikely(!_dispatch_apply_ranges_next(dars, slot, &idx, &end))) {
+			goto out;
+		}
+		os_atomic_thread_fence(acquire);
+	} else {
+		idx = os_atomic_inc_orig2o(da, da_index, acquire);
+		if (unlikely(idx >= iter)) goto out;
+		end = idx + 1;
+	}
 
 	// da_dc is only safe to access once the 'index lock' has been acquired
 	dispatch_apply_function_t const func = (void *)da->da_dc->dc_func;
@@ -64,7 +247,16 @@ _dispatch_apply_invoke2(dispatch_apply_t da, long invoke_flags)
 			_dispatch_client_callout2(da_ctxt, idx, func);
 			_dispatch_perfmon_workitem_inc();
 			done++;
-			idx = os_atomic_inc_orig2o(da, da_index, relaxed);
+			if (likely(++idx < end)) {
+				// rest of the chunk
+			} else if (dars) {
+				if (!_dispatch_apply_ranges_next(dars, slot, &idx, &end)) {
+					idx = iter;
+				}
+			} else {
+				idx = os_atomic_inc_orig2o(da, da_index, relaxed);
+				end = idx + 1;
+			}
 		});
 	} while (likely(idx < iter));
 
@@ -86,6 +278,9 @@ out:
 		_dispatch_thread_event_destroy(&da->da_event);
 	}
 	if (os_atomic_dec2o(da, da_thr_cnt, release) == 0) {
+		if (dars) {
+			_dispatch_apply_ranges_dispose(dars);
+		}
 #if DISPATCH_INTROSPECTION
 		_dispatch_continuation_free(da->da_dc);
 #endif
@@ -166,6 +361,8 @@ _dispatch_apply_f(dispatch_queue_global_t dq, dispatch_apply_t da,
 	int32_t continuation_cnt = da->da_thr_cnt - 1;
 
 	dispatch_assert(continuation_cnt);
+	da->da_ranges = _dispatch_apply_ranges_create(da->da_iterations,
+			da->da_thr_cnt);
 
 	for (i = 0; i < continuation_cnt; i++) {
 		dispatch_continuation_t next = _dispatch_continuation_alloc();
@@ -340,6 +537,7 @@ dispatch_apply_f(size_t iterations, dispatch_queue_t _dq, void *ctxt,
 	da->da_dc = &dc;
 #endif
 	da->da_flags = 0;
+	da->da_ranges = NULL;
 
 	if (unlikely(dq->dq_width == 1 || thr_cnt <= 1)) {
 		return dispatch_sync_f(dq, da, _dispatch_apply_serial);
@@ -757,6 +757,323 @@ _dispatch_timer_heap_update(dispatch_timer_heap_t dth,
 	_dispatch_timer_heap_resift(dth, dt, dt->dt_heap_entry[DTH_DEADLINE_ID]);
 }
 
+#if DISPATCH_USE_TIMER_WHEEL
+#pragma mark timer wheel
+/*
+ * With LIBDISPATCH_TIMER_WHEEL=1, timers with leeway that are due more than a
+ * level 0 slot from now are not kept in the heap but in a hierarchical timing
+ * wheel attached to it, where arming, re-arming and cancelling them is O(1).
+ * This matters for the many-timeouts pattern where most timers are pushed
+ * back long before they would fire.
+ *
+ * Level L has DTW_SLOTS slots covering 2^(DTW_LEVEL0_SHIFT + L * DTW_LEVEL_BITS)
+ * clock units each. A timer is linked in the lowest level where its target
+ * falls within the DTW_SLOTS - 1 slots following the current one. When the
+ * wheel time reaches the start of a slot, its timers cascade to a lower level,
+ * or to the heap when they are due within a level 0 slot.
+ *
+ * Since slots start before any of their timers' targets and the wheel time
+ * runs one level 0 slot ahead of the clock, timers always reach the heap
+ * before they are due: the heap still decides exactly when they fire and how
+ * they coalesce. The wheel only asks the event loop to wake up somewhere in
+ * the level 0 slot that precedes its next non-empty slot.
+ *
+ * Timers in the wheel have both their dt_heap_entry set to DTH_WHEEL_ID, and
+ * are linked in their slot by dt_wheel_next/dt_wheel_prev.
+ */
+#define DTW_LEVEL_BITS   6u
+#define DTW_SLOTS        (1u << DTW_LEVEL_BITS)
+#define DTW_SLOT_MASK    (DTW_SLOTS - 1)
+#define DTW_LEVELS       5u
+#define DTW_LEVEL0_SHIFT 24u // ~16.8ms for nanosecond clocks
+#define DTW_HORIZON      (1ull << DTW_LEVEL0_SHIFT)
+#define DTW_SHIFT(level) (DTW_LEVEL0_SHIFT + (level) * DTW_LEVEL_BITS)
+
+typedef struct dispatch_timer_wheel_s {
+	uint64_t dtw_now;  // wheel time, DTW_HORIZON ahead of the clock
+	uint64_t dtw_next; // lower bound for the start of the next busy slot
+	uint32_t dtw_count;
+	uint64_t dtw_busy[DTW_LEVELS]; // bitmaps of non-empty slots
+	dispatch_timer_source_refs_t dtw_slots[DTW_LEVELS][DTW_SLOTS];
+} *dispatch_timer_wheel_t;
+
+DISPATCH_STATIC_GLOBAL(bool _dispatch_timer_wheel_enabled);
+DISPATCH_STATIC_GLOBAL(dispatch_once_t _dispatch_timer_wheel_pred);
+
+static void
+_dispatch_timer_wheel_init(void *context DISPATCH_UNUSED)
+{
+	_dispatch_timer_wheel_enabled =
+			_dispatch_getenv_bool("LIBDISPATCH_TIMER_WHEEL", false);
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline bool
+_dispatch_timer_in_wheel(dispatch_timer_source_refs_t dt)
+{
+	return dt->dt_heap_entry[DTH_TARGET_ID] == DTH_WHEEL_ID;
+}
+
+// Level of the wheel dt belongs to, or -1 if it belongs to the heap
+DISPATCH_ALWAYS_INLINE
+static inline int
+_dispatch_timer_wheel_level(dispatch_timer_wheel_t dtw,
+		dispatch_timer_source_refs_t dt)
+{
+	uint64_t target = dt->dt_timer.target;
+	for (uint32_t level = 0; level < DTW_LEVELS; level++) {
+		uint64_t t = target >> DTW_SHIFT(level);
+		uint64_t n = dtw->dtw_now >> DTW_SHIFT(level);
+		if (t <= n) {
+			// only possible for level 0: due within the current slot
+			return -1;
+		}
+		if (t - n < DTW_SLOTS) {
+			return (int)level;
+		}
+	}
+	// too far in the future, rare enough to leave to the heap
+	return -1;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_timer_wheel_link(dispatch_timer_heap_t dth,
+		dispatch_timer_source_refs_t dt, uint32_t level)
+{
+	dispatch_timer_wheel_t dtw = dth->dth_wheel;
+	uint64_t abs_slot = dt->dt_timer.target >> DTW_SHIFT(level);
+	uint32_t slot = (uint32_t)abs_slot & DTW_SLOT_MASK;
+	dispatch_timer_source_refs_t *head = &dtw->dtw_slots[level][slot];
+
+	if ((dt->dt_wheel_next = *head)) {
+		(*head)->dt_wheel_prev = &dt->dt_wheel_next;
+	}
+	dt->dt_wheel_prev = head;
+	*head = dt;
+	dtw->dtw_busy[level] |= 1ull << slot;
+	dtw->dtw_count++;
+	dt->dt_heap_entry[DTH_TARGET_ID] = DTH_WHEEL_ID;
+	dt->dt_heap_entry[DTH_DEADLINE_ID] = level * DTW_SLOTS + slot;
+
+	uint64_t slot_start = abs_slot << DTW_SHIFT(level);
+	if (slot_start < dtw->dtw_next) {
+		dtw->dtw_next = slot_start;
+		dth->dth_needs_program = true;
+	}
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_timer_wheel_unlink(dispatch_timer_heap_t dth,
+		dispatch_timer_source_refs_t dt)
+{
+	dispatch_timer_wheel_t dtw = dth->dth_wheel;
+	uint32_t idx = dt->dt_heap_entry[DTH_DEADLINE_ID];
+	uint32_t level = idx / DTW_SLOTS, slot = idx % DTW_SLOTS;
+
+	DISPATCH_TIMER_ASSERT(level, <, DTW_LEVELS, "wheel level");
+	if ((*dt->dt_wheel_prev = dt->dt_wheel_next)) {
+		dt->dt_wheel_next->dt_wheel_prev = dt->dt_wheel_prev;
+	} else if (!dtw->dtw_slots[level][slot]) {
+		dtw->dtw_busy[level] &= ~(1ull << slot);
+	}
+	dt->dt_wheel_next = NULL;
+	dt->dt_wheel_prev = NULL;
+	dtw->dtw_count--;
+	// dtw_next is left alone: it is only a lower bound, and is recomputed
+	// by the next advance
+	dt->dt_heap_entry[DTH_TARGET_ID] = DTH_INVALID_ID;
+	dt->dt_heap_entry[DTH_DEADLINE_ID] = DTH_INVALID_ID;
+}
+
+// Level of the wheel dt should be linked to, or -1 if it goes to the heap
+static int
+_dispatch_timer_wheel_should_link(dispatch_timer_heap_t dth, uint32_t tidx,
+		dispatch_timer_source_refs_t dt)
+{
+	dispatch_once_f(&_dispatch_timer_wheel_pred, NULL,
+			_dispatch_timer_wheel_init);
+	if (!_dispatch_timer_wheel_enabled) {
+		return -1;
+	}
+	// Strict timers and timers without leeway are left to the heap, and so
+	// are wall clock timers as the wall clock can move backwards.
+	if ((dt->du_timer_flags & DISPATCH_TIMER_STRICT) ||
+			dt->dt_timer.deadline <= dt->dt_timer.target ||
+			DISPATCH_TIMER_CLOCK(tidx) == DISPATCH_CLOCK_WALL) {
+		return -1;
+	}
+
+	dispatch_timer_wheel_t dtw = dth->dth_wheel;
+	if (unlikely(!dtw)) {
+		dtw = _dispatch_calloc(1, sizeof(struct dispatch_timer_wheel_s));
+		dtw->dtw_now = _dispatch_time_now(DISPATCH_TIMER_CLOCK(tidx)) +
+				DTW_HORIZON;
+		dtw->dtw_next = UINT64_MAX;
+		dth->dth_wheel = dtw;
+	}
+	return _dispatch_timer_wheel_level(dtw, dt);
+}
+
+static bool
+_dispatch_timer_wheel_insert(dispatch_timer_heap_t dth, uint32_t tidx,
+		dispatch_timer_source_refs_t dt)
+{
+	int level = _dispatch_timer_wheel_should_link(dth, tidx, dt);
+	if (level < 0) {
+		return false;
+	}
+
+	dispatch_qos_t qos = MAX(_dispatch_priority_qos(dt->du_priority),
+			_dispatch_priority_fallback_qos(dt->du_priority));
+	if (dth->dth_max_qos < qos) {
+		dth->dth_max_qos = (uint8_t)qos;
+		dth->dth_needs_program = true;
+	}
+	_dispatch_timer_wheel_link(dth, dt, (uint32_t)level);
+	return true;
+}
+
+// Returns false if the timer is in the heap and should be updated there
+static bool
+_dispatch_timer_wheel_update(dispatch_timer_heap_t dth, uint32_t tidx,
+		dispatch_timer_source_refs_t dt)
+{
+	if (_dispatch_timer_in_wheel(dt)) {
+		_dispatch_timer_wheel_unlink(dth, dt);
+		int level = _dispatch_timer_wheel_should_link(dth, tidx, dt);
+		if (level < 0) {
+			_dispatch_timer_heap_insert(dth, dt);
+		} else {
+			_dispatch_timer_wheel_link(dth, dt, (uint32_t)level);
+		}
+		return true;
+	}
+
+	int level = _dispatch_timer_wheel_should_link(dth, tidx, dt);
+	if (level < 0) {
+		return false;
+	}
+	_dispatch_timer_heap_remove(dth, dt);
+	_dispatch_timer_wheel_link(dth, dt, (uint32_t)level);
+	return true;
+}
+
+static void
+_dispatch_timer_wheel_compute_next(dispatch_timer_wheel_t dtw)
+{
+	uint64_t next = UINT64_MAX;
+
+	for (uint32_t level = 0; level < DTW_LEVELS; level++) {
+		uint64_t busy = dtw->dtw_busy[level];
+		if (!busy) continue;
+
+		// first busy slot after the current one, in wheel order
+		uint64_t base = (dtw->dtw_now >> DTW_SHIFT(level)) + 1;
+		uint32_t rot = (uint32_t)base & DTW_SLOT_MASK;
+		if (rot) busy = (busy >> rot) | (busy << (DTW_SLOTS - rot));
+		uint64_t start = (base + (uint64_t)__builtin_ctzll(busy)) <<
+				DTW_SHIFT(level);
+		if (start < next) next = start;
+	}
+	dtw->dtw_next = next;
+}
+
+/*
+ * Moves the wheel time to now + DTW_HORIZON, and cascades the timers of all
+ * the slots that started in between.
+ */
+static void
+_dispatch_timer_wheel_advance(dispatch_timer_heap_t dth, uint64_t now)
+{
+	dispatch_timer_wheel_t dtw = dth->dth_wheel;
+	uint64_t old_now = dtw->dtw_now, new_now = now + DTW_HORIZON;
+
+	if (new_now <= old_now) {
+		return;
+	}
+	dtw->dtw_now = new_now;
+	if (new_now < dtw->dtw_next) {
+		// no slot can have started
+		return;
+	}
+
+	// Lower levels go first, so that cascaded timers never land in a slot
+	// that is yet to be processed.
+	for (uint32_t level = 0; level < DTW_LEVELS; level++) {
+		uint64_t old_slot = old_now >> DTW_SHIFT(level);
+		uint64_t new_slot = new_now >> DTW_SHIFT(level);
+		if (old_slot == new_slot) {
+			// higher levels can't have moved either
+			break;
+		}
+
+		uint64_t due;
+		if (new_slot - old_slot >= DTW_SLOTS) {
+			due = ~0ull;
+		} else {
+			uint32_t n = (uint32_t)(new_slot - old_slot);
+			uint32_t rot = (uint32_t)(old_slot + 1) & DTW_SLOT_MASK;
+			due = (1ull << n) - 1;
+			if (rot) due = (due << rot) | (due >> (DTW_SLOTS - rot));
+		}
+
+		uint64_t pending = dtw->dtw_busy[level] & due;
+		while (pending) {
+			uint32_t slot = (uint32_t)__builtin_ctzll(pending);
+			pending &= pending - 1;
+
+			dispatch_timer_source_refs_t dt = dtw->dtw_slots[level][slot];
+			dtw->dtw_slots[level][slot] = NULL;
+			dtw->dtw_busy[level] &= ~(1ull << slot);
+			while (dt) {
+				dispatch_timer_source_refs_t next = dt->dt_wheel_next;
+				dt->dt_wheel_next = NULL;
+				dt->dt_wheel_prev = NULL;
+				dtw->dtw_count--;
+				dt->dt_heap_entry[DTH_TARGET_ID] = DTH_INVALID_ID;
+				dt->dt_heap_entry[DTH_DEADLINE_ID] = DTH_INVALID_ID;
+
+				int to = _dispatch_timer_wheel_level(dtw, dt);
+				if (to < 0) {
+					_dispatch_timer_heap_insert(dth, dt);
+				} else {
+					DISPATCH_TIMER_ASSERT(to, <, (int)level, "cascade");
+					_dispatch_timer_wheel_link(dth, dt, (uint32_t)to);
+				}
+				dt = next;
+			}
+		}
+	}
+	_dispatch_timer_wheel_compute_next(dtw);
+	dth->dth_needs_program = true;
+}
+
+/*
+ * Folds the wake-up the wheel needs into the delay computed from the heap.
+ */
+static void
+_dispatch_timer_wheel_merge_delay(dispatch_timer_heap_t dth, uint32_t tidx,
+		dispatch_clock_now_cache_t nows, dispatch_timer_delay_s *rc)
+{
+	dispatch_timer_wheel_t dtw = dth->dth_wheel;
+	if (!dtw || !dtw->dtw_count) {
+		return;
+	}
+
+	uint64_t now = _dispatch_time_now_cached(DISPATCH_TIMER_CLOCK(tidx), nows);
+	uint64_t deadline = dtw->dtw_next;
+	uint64_t target = deadline - MIN(deadline, DTW_HORIZON);
+	uint64_t delay = target > now ? target - now : 0;
+	uint64_t end = deadline > now ? deadline - now : 0;
+
+	uint64_t rc_end = rc->delay + rc->leeway; // both are <= INT64_MAX
+	rc->delay = MIN(rc->delay, delay);
+	rc->leeway = MIN(MIN(rc_end, end) - rc->delay, INT64_MAX);
+}
+#endif // DISPATCH_USE_TIMER_WHEEL
+
 #pragma mark timer unote
 
 #define _dispatch_timer_du_debug(what, du) \
@@ -789,6 +1106,11 @@ _dispatch_timer_unote_disarm(dispatch_timer_source_refs_t dt,
 	uint32_t tidx = dt->du_ident;
 
 	dispatch_assert(_dispatch_unote_armed(dt));
+#if DISPATCH_USE_TIMER_WHEEL
+	if (_dispatch_timer_in_wheel(dt)) {
+		_dispatch_timer_wheel_unlink(&dth[tidx], dt);
+	} else
+#endif
 	_dispatch_timer_heap_remove(&dth[tidx], dt);
 	_dispatch_timers_heap_dirty(dth, tidx);
 	_dispatch_unote_state_clear_bit(dt, DU_STATE_ARMED);
@@ -801,10 +1123,16 @@ _dispatch_timer_unote_arm(dispatch_timer_source_refs_t dt,
 {
 	if (_dispatch_unote_armed(dt)) {
 		DISPATCH_TIMER_ASSERT(dt->du_ident, ==, tidx, "tidx");
+#if DISPATCH_USE_TIMER_WHEEL
+		if (!_dispatch_timer_wheel_update(&dth[tidx], tidx, dt))
+#endif
 		_dispatch_timer_heap_update(&dth[tidx], dt);
 		_dispatch_timer_du_debug("updated", dt);
 	} else {
 		dt->du_ident = tidx;
+#if DISPATCH_USE_TIMER_WHEEL
+		if (!_dispatch_timer_wheel_insert(&dth[tidx], tidx, dt))
+#endif
 		_dispatch_timer_heap_insert(&dth[tidx], dt);
 		_dispatch_unote_state_set_bit(dt, DU_STATE_ARMED);
 		_dispatch_timer_du_debug("armed", dt);
@@ -1039,6 +1367,13 @@ _dispatch_timers_run(dispatch_timer_heap_t dth, uint32_t tidx,
 	dispatch_timer_source_refs_t dr;
 	uint64_t pending, now;
 
+#if DISPATCH_USE_TIMER_WHEEL
+	if (dth[tidx].dth_wheel) {
+		now = _dispatch_time_now_cached(DISPATCH_TIMER_CLOCK(tidx), nows);
+		_dispatch_timer_wheel_advance(&dth[tidx], now);
+	}
+#endif
+
 	while ((dr = dth[tidx].dth_min[DTH_TARGET_ID])) {
 		DISPATCH_TIMER_ASSERT(dr->du_ident, ==, tidx, "tidx");
 		DISPATCH_TIMER_ASSERT(dr->dt_timer.target, !=, 0, "missing target");
@@ -1131,6 +1466,9 @@ _dispatch_timers_get_delay(dispatch_timer_heap_t dth, uint32_t tidx,
 
 	if (!dth[tidx].dth_min[DTH_TARGET_ID]) {
 		rc.delay = rc.leeway = INT64_MAX;
+#if DISPATCH_USE_TIMER_WHEEL
+		_dispatch_timer_wheel_merge_delay(&dth[tidx], tidx, nows, &rc);
+#endif
 		return rc;
 	}
 
@@ -1170,6 +1508,9 @@ _dispatch_timers_get_delay(dispatch_timer_heap_t dth, uint32_t tidx,
 
 	rc.delay = MIN(target - now, INT64_MAX);
 	rc.leeway = MIN(deadline - target, INT64_MAX);
+#if DISPATCH_USE_TIMER_WHEEL
+	_dispatch_timer_wheel_merge_delay(&dth[tidx], tidx, nows, &rc);
+#endif
 	return rc;
 }
 
@@ -79,6 +79,12 @@
 #define EV_VANISHED 0x0200
 #endif
 
+// Timing wheel for far away timers with leeway, see event.c. When built in,
+// it is enabled at runtime with LIBDISPATCH_TIMER_WHEEL=1.
+#ifndef DISPATCH_USE_TIMER_WHEEL
+#define DISPATCH_USE_TIMER_WHEEL 1
+#endif
+
 #if DISPATCH_EVENT_BACKEND_KEVENT
 #	if defined(EV_UDATA_SPECIFIC) && EV_UDATA_SPECIFIC
 #		define DISPATCH_HAVE_DIRECT_KNOTES 1
@@ -45,18 +45,31 @@ enum {
 };
 
 typedef struct dispatch_muxnote_s {
-	LIST_ENTRY(dispatch_muxnote_s) dmn_list;
+	LIST_ENTRY(dispatch_muxnote_s) dmn_pending_link;
 	LIST_HEAD(, dispatch_unote_linkage_s) dmn_readers_head;
 	LIST_HEAD(, dispatch_unote_linkage_s) dmn_writers_head;
 	int       dmn_fd;
 	uint32_t  dmn_ident;
 	uint32_t  dmn_events;
+	// events last handed to epoll_ctl(), 0 once a oneshot event disabled it
+	uint32_t  dmn_kernel_events;
 	uint16_t  dmn_disarmed_events;
 	int8_t    dmn_filter;
 	bool      dmn_skip_outq_ioctl : 1;
 	bool      dmn_skip_inq_ioctl : 1;
+	bool      dmn_pending : 1;
 } *dispatch_muxnote_t;
 
+// Open addressing (linear probing) table of muxnotes keyed by ident and
+// filter, resized to stay between 1/8 and 3/4 full.
+typedef struct dispatch_muxnote_table_s {
+	dispatch_muxnote_t *dmt_slots;
+	uint32_t  dmt_mask;
+	uint32_t  dmt_count;
+} dispatch_muxnote_table_s;
+
+#define DISPATCH_MUXNOTE_TABLE_MIN_SIZE DSL_HASH_SIZE
+
 typedef struct dispatch_epoll_timeout_s {
 	int       det_fd;
 	uint16_t  det_ident;
@@ -69,8 +82,11 @@ static int _dispatch_epfd, _dispatch_eventfd;
 static dispatch_once_t epoll_init_pred;
 static void _dispatch_epoll_init(void *);
 
-static LIST_HEAD(dispatch_muxnote_bucket_s, dispatch_muxnote_s)
-_dispatch_sources[DSL_HASH_SIZE];
+static dispatch_muxnote_table_s _dispatch_muxnotes;
+
+// Muxnotes whose armed events changed since they were last handed to
+// epoll_ctl(), applied at the start of the next _dispatch_event_loop_drain()
+static LIST_HEAD(, dispatch_muxnote_s) _dispatch_muxnotes_pending;
 
 #define DISPATCH_EPOLL_TIMEOUT_INITIALIZER(clock) \
 	[DISPATCH_CLOCK_##clock] = { \
@@ -93,30 +109,112 @@ _dispatch_muxnote_armed_events(dispatch_muxnote_t dmn)
 }
 
 DISPATCH_ALWAYS_INLINE
-static inline struct dispatch_muxnote_bucket_s *
-_dispatch_muxnote_bucket(uint32_t ident)
+static inline uint32_t
+_dispatch_muxnote_hash(uint32_t ident, int8_t filter)
 {
-	return &_dispatch_sources[DSL_HASH(ident)];
+	uint32_t h = (ident ^ ((uint32_t)(uint8_t)filter << 24)) * 0x9e3779b1u;
+	return h ^ (h >> 16);
 }
-#define _dispatch_unote_muxnote_bucket(du) \
-	_dispatch_muxnote_bucket(du._du->du_ident)
 
 DISPATCH_ALWAYS_INLINE
 static inline dispatch_muxnote_t
-_dispatch_muxnote_find(struct dispatch_muxnote_bucket_s *dmb,
-		uint32_t ident, int8_t filter)
+_dispatch_muxnote_find(uint32_t ident, int8_t filter)
 {
+	dispatch_muxnote_table_s *dmt = &_dispatch_muxnotes;
 	dispatch_muxnote_t dmn;
+
+	if (unlikely(!dmt->dmt_slots)) return NULL;
 	if (filter == EVFILT_WRITE) filter = EVFILT_READ;
-	LIST_FOREACH(dmn, dmb, dmn_list) {
+	uint32_t i = _dispatch_muxnote_hash(ident, filter) & dmt->dmt_mask;
+	while ((dmn = dmt->dmt_slots[i])) {
 		if (dmn->dmn_ident == ident && dmn->dmn_filter == filter) {
 			break;
 		}
+		i = (i + 1) & dmt->dmt_mask;
 	}
 	return dmn;
 }
-#define _dispatch_unote_muxnote_find(dmb, du) \
-		_dispatch_muxnote_find(dmb, du._du->du_ident, du._du->du_filter)
+#define _dispatch_unote_muxnote_find(du) \
+		_dispatch_muxnote_find(du._du->du_ident, du._du->du_filter)
+
+static void
+_dispatch_muxnote_table_place(dispatch_muxnote_t *slots, uint32_t mask,
+		dispatch_muxnote_t dmn)
+{
+	uint32_t i = _dispatch_muxnote_hash(dmn->dmn_ident, dmn->dmn_filter) & mask;
+	while (slots[i]) {
+		i = (i + 1) & mask;
+	}
+	slots[i] = dmn;
+}
+
+static void
+_dispatch_muxnote_table_resize(uint32_t size)
+{
+	dispatch_muxnote_table_s *dmt = &_dispatch_muxnotes;
+	dispatch_muxnote_t *slots = _dispatch_calloc(size, sizeof(*slots));
+
+	if (dmt->dmt_slots) {
+		for (uint32_t i = 0; i <= dmt->dmt_mask; i++) {
+			if (dmt->dmt_slots[i]) {
+				_dispatch_muxnote_table_place(slots, size - 1,
+						dmt->dmt_slots[i]);
+			}
+		}
+		free(dmt->dmt_slots);
+	}
+	dmt->dmt_slots = slots;
+	dmt->dmt_mask = size - 1;
+}
+
+static void
+_dispatch_muxnote_insert(dispatch_muxnote_t dmn)
+{
+	dispatch_muxnote_table_s *dmt = &_dispatch_muxnotes;
+
+	if (unlikely(!dmt->dmt_slots)) {
+		_dispatch_muxnote_table_resize(DISPATCH_MUXNOTE_TABLE_MIN_SIZE);
+	} else if (unlikely((dmt->dmt_count + 1) * 4 > (dmt->dmt_mask + 1) * 3)) {
+		_dispatch_muxnote_table_resize((dmt->dmt_mask + 1) * 2);
+	}
+	_dispatch_muxnote_table_place(dmt->dmt_slots, dmt->dmt_mask, dmn);
+	dmt->dmt_count++;
+}
+
+static void
+_dispatch_muxnote_remove(dispatch_muxnote_t dmn)
+{
+	dispatch_muxnote_table_s *dmt = &_dispatch_muxnotes;
+	dispatch_muxnote_t *slots = dmt->dmt_slots;
+	uint32_t mask = dmt->dmt_mask;
+	uint32_t i = _dispatch_muxnote_hash(dmn->dmn_ident, dmn->dmn_filter) & mask;
+
+	while (slots[i] != dmn) {
+		dispatch_assert(slots[i]);
+		i = (i + 1) & mask;
+	}
+
+	// backward shift deletion: pull up the entries of the cluster that
+	// could live in the hole so that lookups never need tombstones
+	for (uint32_t j = i;;) {
+		slots[i] = NULL;
+		for (;;) {
+			j = (j + 1) & mask;
+			if (!slots[j]) goto done;
+			uint32_t home = _dispatch_muxnote_hash(slots[j]->dmn_ident,
+					slots[j]->dmn_filter) & mask;
+			if (((j - home) & mask) >= ((j - i) & mask)) break;
+		}
+		slots[i] = slots[j];
+		i = j;
+	}
+done:
+	dmt->dmt_count--;
+	if (unlikely(dmt->dmt_mask + 1 > DISPATCH_MUXNOTE_TABLE_MIN_SIZE &&
+			dmt->dmt_count * 8 < dmt->dmt_mask + 1)) {
+		_dispatch_muxnote_table_resize((dmt->dmt_mask + 1) / 2);
+	}
+}
 
 static void
 _dispatch_muxnote_dispose(dispatch_muxnote_t dmn)
@@ -223,7 +321,49 @@ _dispatch_epoll_update(dispatch_muxnote_t dmn, uint32_t events, int op)
 		.events = events,
 		.data = { .ptr = dmn },
 	};
-	return epoll_ctl(_dispatch_epfd, op, dmn->dmn_fd, &ev);
+	int rc = epoll_ctl(_dispatch_epfd, op, dmn->dmn_fd, &ev);
+	if (rc == 0) dmn->dmn_kernel_events = events;
+	return rc;
+}
+
+// Re-arming is deferred to the next _dispatch_event_loop_drain() so that
+// the merge of an event, the resume of its sources and unregistrations that
+// happen in between cost a single EPOLL_CTL_MOD per descriptor.
+//
+// All of these happen on the manager thread, which is also the only thread
+// that calls epoll_wait(), so nothing can observe the stale kernel state.
+static void
+_dispatch_epoll_update_deferred(dispatch_muxnote_t dmn)
+{
+	if (!dmn->dmn_pending) {
+		dmn->dmn_pending = true;
+		LIST_INSERT_HEAD(&_dispatch_muxnotes_pending, dmn, dmn_pending_link);
+	}
+}
+
+static void
+_dispatch_epoll_update_cancel(dispatch_muxnote_t dmn)
+{
+	if (dmn->dmn_pending) {
+		dmn->dmn_pending = false;
+		LIST_REMOVE(dmn, dmn_pending_link);
+	}
+}
+
+static void
+_dispatch_epoll_update_flush(void)
+{
+	dispatch_muxnote_t dmn;
+
+	while ((dmn = LIST_FIRST(&_dispatch_muxnotes_pending))) {
+		LIST_REMOVE(dmn, dmn_pending_link);
+		dmn->dmn_pending = false;
+
+		uint32_t events = _dispatch_muxnote_armed_events(dmn);
+		if (events != dmn->dmn_kernel_events) {
+			_dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD);
+		}
+	}
 }
 
 DISPATCH_ALWAYS_INLINE
@@ -255,14 +395,12 @@ _dispatch_unote_required_events(dispatch_unote_t du)
 bool
 _dispatch_unote_register_muxed(dispatch_unote_t du)
 {
-	struct dispatch_muxnote_bucket_s *dmb;
 	dispatch_muxnote_t dmn;
 	uint32_t events;
 
 	events = _dispatch_unote_required_events(du);
 
-	dmb = _dispatch_unote_muxnote_bucket(du);
-	dmn = _dispatch_unote_muxnote_find(dmb, du);
+	dmn = _dispatch_unote_muxnote_find(du);
 	if (dmn) {
 		if (events & ~_dispatch_muxnote_armed_events(dmn)) {
 			events |= _dispatch_muxnote_armed_events(dmn);
@@ -280,7 +418,7 @@ _dispatch_unote_register_muxed(dispatch_unote_t du)
 				_dispatch_muxnote_dispose(dmn);
 				dmn = NULL;
 			} else {
-				LIST_INSERT_HEAD(dmb, dmn, dmn_list);
+				_dispatch_muxnote_insert(dmn);
 			}
 		}
 	}
@@ -307,8 +445,7 @@ _dispatch_unote_resume_muxed(dispatch_unote_t du)
 
 	if (events & dmn->dmn_disarmed_events) {
 		dmn->dmn_disarmed_events &= ~events;
-		events = _dispatch_muxnote_armed_events(dmn);
-		_dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD);
+		_dispatch_epoll_update_deferred(dmn);
 	}
 }
 
@@ -341,12 +478,12 @@ _dispatch_unote_unregister_muxed(dispatch_unote_t du)
 	if (events & (EPOLLIN | EPOLLOUT)) {
 		if (events != _dispatch_muxnote_armed_events(dmn)) {
 			dmn->dmn_events = events;
-			events = _dispatch_muxnote_armed_events(dmn);
-			_dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD);
+			_dispatch_epoll_update_deferred(dmn);
 		}
 	} else {
 		epoll_ctl(_dispatch_epfd, EPOLL_CTL_DEL, dmn->dmn_fd, NULL);
-		LIST_REMOVE(dmn, dmn_list);
+		_dispatch_epoll_update_cancel(dmn);
+		_dispatch_muxnote_remove(dmn);
 		_dispatch_muxnote_dispose(dmn);
 	}
 	_dispatch_unote_state_set(du, DU_STATE_UNREGISTERED);
@@ -570,6 +707,9 @@ _dispatch_event_merge_fd(dispatch_muxnote_t dmn, uint32_t events)
 	uintptr_t data;
 
 	dmn->dmn_disarmed_events |= (events & (EPOLLIN | EPOLLOUT));
+	if (dmn->dmn_events & EPOLLONESHOT) {
+		dmn->dmn_kernel_events = 0;
+	}
 
 	if (events & EPOLLIN) {
 		data = _dispatch_get_buffer_size(dmn, false);
@@ -608,11 +748,11 @@ _dispatch_event_merge_fd(dispatch_muxnote_t dmn, uint32_t events)
 			_dispatch_event_merge_hangup(du);
 		}
 		epoll_ctl(_dispatch_epfd, EPOLL_CTL_DEL, dmn->dmn_fd, NULL);
+		dmn->dmn_kernel_events = 0;
 		return;
 	}
 
-	events = _dispatch_muxnote_armed_events(dmn);
-	if (events) _dispatch_epoll_update(dmn, events, EPOLL_CTL_MOD);
+	_dispatch_epoll_update_deferred(dmn);
 }
 
 DISPATCH_NOINLINE
@@ -623,6 +763,8 @@ _dispatch_event_loop_drain(uint32_t flags)
 	int i, r;
 	int timeout = (flags & KEVENT_FLAG_IMMEDIATE) ? 0 : -1;
 
+	_dispatch_epoll_update_flush();
+
 retry:
 	r = epoll_wait(_dispatch_epfd, ev, countof(ev), timeout);
 	if (unlikely(r == -1)) {
@@ -198,6 +198,7 @@ typedef struct dispatch_timer_delay_s {
 } dispatch_timer_delay_s;
 
 #define DTH_INVALID_ID  (~0u)
+#define DTH_WHEEL_ID    (~1u)
 #define DTH_TARGET_ID   0u
 #define DTH_DEADLINE_ID 1u
 #define DTH_ID_COUNT    2u
@@ -223,6 +224,10 @@ typedef struct dispatch_timer_source_refs_s {
 	struct dispatch_timer_source_s dt_timer;
 	struct dispatch_timer_config_s *dt_pending_config;
 	uint32_t dt_heap_entry[DTH_ID_COUNT];
+#if DISPATCH_USE_TIMER_WHEEL
+	struct dispatch_timer_source_refs_s *dt_wheel_next;
+	struct dispatch_timer_source_refs_s **dt_wheel_prev;
+#endif
 } *dispatch_timer_source_refs_t;
 
 typedef struct dispatch_timer_heap_s {
@@ -236,6 +241,9 @@ typedef struct dispatch_timer_heap_s {
 	uint8_t dth_needs_program : 1;
 	dispatch_timer_source_refs_t dth_min[DTH_ID_COUNT];
 	void **dth_heap;
+#if DISPATCH_USE_TIMER_WHEEL
+	struct dispatch_timer_wheel_s *dth_wheel; // lazily allocated
+#endif
 } *dispatch_timer_heap_t;
 
 #if HAVE_MACH
@@ -29,20 +29,65 @@
  *
  * The dynamic monitoring could be implemented using either
  *   (a) low-frequency user-level approximation of the number of runnable
- *       worker threads via reading the /proc file system
+ *       worker threads
  *   (b) a Linux kernel extension that hooks the process change handler
  *       to accurately track the number of runnable normal worker threads
- * This file provides an implementation of option (a).
+ * This file provides an implementation of option (a): a worker is counted
+ * as runnable when it is draining and its thread CPU clock advanced by a
+ * meaningful fraction of the last monitoring interval.
  *
  * Using either form of monitoring, if (i) there appears to be
  * work available in the monitored pthread root queue, (ii) the
  * number of runnable workers is below the target size for the pool,
  * and (iii) the total number of worker threads is below an upper limit,
  * then an additional worker thread will be added to the pool.
+ *
+ * With DISPATCH_USE_WORKQ_STEALING, each monitored worker also owns a small
+ * run queue. Items a worker pushes onto the root queue it is draining go to
+ * its own run queue rather than to the shared root queue list, and workers
+ * that run out of work steal from the run queues of their peers. A sleeping
+ * worker is only woken for a local push when no peer is already looking for
+ * work. A worker about to wait in dispatch_sync(), dispatch_group_wait() or
+ * dispatch_semaphore_wait() first moves its run queue to the shared list, as
+ * it often waits for those very items; other run queues are only flushed by
+ * the monitor, once their owner stopped making progress.
  */
 
 #pragma mark static data for monitoring subsystem
 
+#if HAVE_DISPATCH_WORKQ_MONITORING
+#define WORKQ_RUN_QUEUE_SIZE 256u // must be a power of two
+#define WORKQ_GLOBAL_CHECK_INTERVAL 61u
+
+/*
+ * Per-worker state. Slots are allocated on first use and never freed, so a
+ * thief may safely look at the run queue of a worker that is going away.
+ */
+typedef struct dispatch_workq_worker_s {
+	/*
+	 * Bounded FIFO run queue. Only the owner pushes, at the tail; the owner
+	 * and thieves pop at the head with a compare-and-swap.
+	 */
+	uint32_t dww_head;
+	uint32_t dww_tail;
+	struct dispatch_object_s *dww_items[WORKQ_RUN_QUEUE_SIZE];
+
+	dispatch_queue_global_t dww_dq;
+	uint32_t dww_pops; // owner only
+	uint32_t dww_rand; // owner only, victim selection
+	uint64_t dww_progress; // written by the owner, read by the monitor
+	bool dww_busy;
+	bool dww_registered;
+
+	/* Monitor only */
+	clockid_t dww_clock;
+	uint64_t dww_cputime;
+	uint64_t dww_progress_seen;
+} dispatch_workq_worker_s;
+
+static _Thread_local dispatch_workq_worker_t _dispatch_workq_worker_self;
+#endif // HAVE_DISPATCH_WORKQ_MONITORING
+
 /*
  * State for the user-level monitoring of a workqueue.
  */
@@ -56,14 +101,27 @@ typedef struct dispatch_workq_monitor_s {
 	/* The desired number of runnable worker threads */
 	int32_t target_runnable;
 
+#if DISPATCH_USE_WORKQ_STEALING
+	/* Workers currently looking for work to steal */
+	uint32_t num_searching;
+
+	/* A sleeping worker has been asked to come and steal */
+	bool wake_pending;
+#endif
+
 	/*
 	 * Tracking of registered workers; all accesses must hold lock.
-	 * Invariant: registered_tids[0]...registered_tids[num_registered_tids-1]
-	 *   contain the dispatch_tids of the worker threads we are monitoring.
+	 * Invariant: workers[0]...workers[num_workers-1] are the slots that
+	 *   have ever been used; registered ones have dww_registered set.
+	 *   num_workers is also read without the lock when stealing.
 	 */
-	dispatch_unfair_lock_s registered_tid_lock;
-	dispatch_tid *registered_tids;
-	int num_registered_tids;
+	dispatch_unfair_lock_s registered_lock;
+	dispatch_workq_worker_t *workers;
+	int num_workers;
+	int num_registered;
+
+	/* Time of the previous runnable count */
+	uint64_t last_sample;
 } dispatch_workq_monitor_s, *dispatch_workq_monitor_t;
 
 #if HAVE_DISPATCH_WORKQ_MONITORING
@@ -78,23 +136,52 @@ static dispatch_workq_monitor_s _dispatch_workq_monitors[DISPATCH_QOS_NBUCKETS];
 static void _dispatch_workq_init_once(void *context DISPATCH_UNUSED);
 static dispatch_once_t _dispatch_workq_init_once_pred;
 
-void
-_dispatch_workq_worker_register(dispatch_queue_global_t root_q)
-{
-	dispatch_once_f(&_dispatch_workq_init_once_pred, NULL, &_dispatch_workq_init_once);
-
 #if HAVE_DISPATCH_WORKQ_MONITORING
+static dispatch_workq_monitor_t
+_dispatch_workq_monitor_for_queue(dispatch_queue_global_t root_q)
+{
 	dispatch_qos_t qos = _dispatch_priority_qos(root_q->dq_priority);
 	if (qos == 0) qos = DISPATCH_QOS_DEFAULT;
 	int bucket = DISPATCH_QOS_BUCKET(qos);
 	dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[bucket];
 	dispatch_assert(mon->dq == root_q);
-	dispatch_tid tid = _dispatch_tid_self();
-	_dispatch_unfair_lock_lock(&mon->registered_tid_lock);
-	dispatch_assert(mon->num_registered_tids < WORKQ_MAX_TRACKED_TIDS-1);
-	int worker_id = mon->num_registered_tids++;
-	mon->registered_tids[worker_id] = tid;
-	_dispatch_unfair_lock_unlock(&mon->registered_tid_lock);
+	return mon;
+}
+#endif // HAVE_DISPATCH_WORKQ_MONITORING
+
+void
+_dispatch_workq_worker_register(dispatch_queue_global_t root_q)
+{
+	dispatch_once_f(&_dispatch_workq_init_once_pred, NULL, &_dispatch_workq_init_once);
+
+#if HAVE_DISPATCH_WORKQ_MONITORING
+	dispatch_workq_monitor_t mon = _dispatch_workq_monitor_for_queue(root_q);
+	dispatch_workq_worker_t dww = NULL;
+	_dispatch_unfair_lock_lock(&mon->registered_lock);
+	dispatch_assert(mon->num_registered < WORKQ_MAX_TRACKED_TIDS-1);
+	for (int i = 0; i < mon->num_workers; i++) {
+		if (!mon->workers[i]->dww_registered) {
+			dww = mon->workers[i];
+			break;
+		}
+	}
+	if (!dww) {
+		dww = _dispatch_calloc(1, sizeof(dispatch_workq_worker_s));
+		dww->dww_dq = root_q;
+		mon->workers[mon->num_workers] = dww;
+		// Publish the slot to thieves only once it is initialized
+		os_atomic_store(&mon->num_workers, mon->num_workers + 1, release);
+	}
+	mon->num_registered++;
+	dww->dww_registered = true;
+	dww->dww_rand = (uint32_t)_dispatch_tid_self() | 1;
+	if (pthread_getcpuclockid(pthread_self(), &dww->dww_clock)) {
+		dww->dww_clock = (clockid_t)-1;
+	}
+	dww->dww_cputime = 0;
+	dww->dww_progress_seen = dww->dww_progress;
+	_dispatch_unfair_lock_unlock(&mon->registered_lock);
+	_dispatch_workq_worker_self = dww;
 #else
 	(void)root_q;
 #endif // HAVE_DISPATCH_WORKQ_MONITORING
@@ -104,86 +191,301 @@ void
 _dispatch_workq_worker_unregister(dispatch_queue_global_t root_q)
 {
 #if HAVE_DISPATCH_WORKQ_MONITORING
-	dispatch_qos_t qos = _dispatch_priority_qos(root_q->dq_priority);
-	if (qos == 0) qos = DISPATCH_QOS_DEFAULT;
-	int bucket = DISPATCH_QOS_BUCKET(qos);
-	dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[bucket];
-	dispatch_assert(mon->dq == root_q);
-	dispatch_tid tid = _dispatch_tid_self();
-	_dispatch_unfair_lock_lock(&mon->registered_tid_lock);
-	for (int i = 0; i < mon->num_registered_tids; i++) {
-		if (mon->registered_tids[i] == tid) {
-			int last = mon->num_registered_tids - 1;
-			mon->registered_tids[i] = mon->registered_tids[last];
-			mon->registered_tids[last] = 0;
-			mon->num_registered_tids--;
-			break;
-		}
-	}
-	_dispatch_unfair_lock_unlock(&mon->registered_tid_lock);
+	dispatch_workq_monitor_t mon = _dispatch_workq_monitor_for_queue(root_q);
+	dispatch_workq_worker_t dww = _dispatch_workq_worker_self;
+	dispatch_assert(dww && dww->dww_dq == root_q);
+	// Drained by _dispatch_workq_worker_drain_end()
+	dispatch_assert(dww->dww_head == dww->dww_tail);
+	_dispatch_workq_worker_self = NULL;
+	_dispatch_unfair_lock_lock(&mon->registered_lock);
+	dww->dww_registered = false;
+	mon->num_registered--;
+	_dispatch_unfair_lock_unlock(&mon->registered_lock);
 #else
 	(void)root_q;
 #endif // HAVE_DISPATCH_WORKQ_MONITORING
 }
 
+#if DISPATCH_USE_WORKQ_STEALING
+#pragma mark Worker run queues
+
+/*
+ * Pops the item at the head of dww's run queue; safe from any thread.
+ */
+static struct dispatch_object_s *
+_dispatch_workq_run_queue_pop(dispatch_workq_worker_t dww)
+{
+	uint32_t head = os_atomic_load(&dww->dww_head, acquire);
+	for (;;) {
+		uint32_t tail = os_atomic_load(&dww->dww_tail, acquire);
+		if (head == tail) {
+			return NULL;
+		}
+		struct dispatch_object_s *dou;
+		dou = os_atomic_load(&dww->dww_items[head % WORKQ_RUN_QUEUE_SIZE],
+				relaxed);
+		if (os_atomic_cmpxchgv(&dww->dww_head, head, head + 1, &head,
+				release)) {
+			return dou;
+		}
+	}
+}
+
+/*
+ * Moves everything left in dww's run queue to the shared root queue list.
+ */
+static void
+_dispatch_workq_run_queue_flush(dispatch_workq_worker_t dww)
+{
+	struct dispatch_object_s *dou;
+	while ((dou = _dispatch_workq_run_queue_pop(dww))) {
+		_dispatch_root_queue_push_inline(dww->dww_dq, dou, dou, 1);
+	}
+}
+
+dispatch_workq_worker_t
+_dispatch_workq_worker_current(dispatch_queue_global_t root_q)
+{
+	dispatch_workq_worker_t dww = _dispatch_workq_worker_self;
+	if (dww && dww->dww_dq == root_q) {
+		return dww;
+	}
+	return NULL;
+}
+
+void
+_dispatch_workq_worker_drain_start(dispatch_workq_worker_t dww)
+{
+	dispatch_workq_monitor_t mon = _dispatch_workq_monitor_for_queue(dww->dww_dq);
+	os_atomic_store(&mon->wake_pending, false, relaxed);
+	os_atomic_store(&dww->dww_busy, true, relaxed);
+}
+
+void
+_dispatch_workq_worker_drain_end(dispatch_workq_worker_t dww)
+{
+	// The drain can stop early (e.g. narrowing) with items still queued
+	// locally, which must stay visible while this thread sleeps
+	_dispatch_workq_run_queue_flush(dww);
+	os_atomic_store(&dww->dww_busy, false, relaxed);
+}
+
+bool
+_dispatch_workq_worker_push(dispatch_queue_global_t root_q,
+		struct dispatch_object_s *dou)
+{
+	dispatch_workq_worker_t dww = _dispatch_workq_worker_self;
+	if (!dww || dww->dww_dq != root_q || !dww->dww_busy) {
+		return false;
+	}
+	uint32_t tail = dww->dww_tail;
+	uint32_t head = os_atomic_load(&dww->dww_head, acquire);
+	if (tail - head >= WORKQ_RUN_QUEUE_SIZE) {
+		// Full: overflow onto the shared list
+		return false;
+	}
+	os_atomic_store(&dww->dww_items[tail % WORKQ_RUN_QUEUE_SIZE], dou,
+			relaxed);
+	os_atomic_store(&dww->dww_tail, tail + 1, release);
+	return true;
+}
+
+bool
+_dispatch_workq_worker_should_check_global(dispatch_workq_worker_t dww)
+{
+	// Keeps a worker that keeps feeding its own run queue from starving
+	// the shared list
+	return ++dww->dww_pops % WORKQ_GLOBAL_CHECK_INTERVAL == 0;
+}
+
+struct dispatch_object_s *
+_dispatch_workq_worker_pop(dispatch_workq_worker_t dww)
+{
+	struct dispatch_object_s *dou = _dispatch_workq_run_queue_pop(dww);
+	if (dou) {
+		os_atomic_store(&dww->dww_progress, dww->dww_progress + 1, relaxed);
+	}
+	return dou;
+}
+
+/*
+ * Takes half of victim's run queue into dww's (empty) run queue, and
+ * returns one of the stolen items.
+ */
+static struct dispatch_object_s *
+_dispatch_workq_run_queue_grab(dispatch_workq_worker_t dww,
+		dispatch_workq_worker_t victim)
+{
+	uint32_t tail = dww->dww_tail;
+	uint32_t vhead = os_atomic_load(&victim->dww_head, acquire);
+	uint32_t n;
+	for (;;) {
+		uint32_t vtail = os_atomic_load(&victim->dww_tail, acquire);
+		n = vtail - vhead;
+		n -= n / 2;
+		if (n == 0) {
+			return NULL;
+		}
+		if (n > WORKQ_RUN_QUEUE_SIZE / 2) {
+			// head and tail were read inconsistently, try again
+			vhead = os_atomic_load(&victim->dww_head, acquire);
+			continue;
+		}
+		for (uint32_t i = 0; i < n; i++) {
+			struct dispatch_object_s *dou = os_atomic_load(
+					&victim->dww_items[(vhead + i) % WORKQ_RUN_QUEUE_SIZE],
+					relaxed);
+			os_atomic_store(&dww->dww_items[(tail + i) % WORKQ_RUN_QUEUE_SIZE],
+					dou, relaxed);
+		}
+		if (os_atomic_cmpxchgv(&victim->dww_head, vhead, vhead + n, &vhead,
+				release)) {
+			break;
+		}
+	}
+	n--;
+	struct dispatch_object_s *dou = dww->dww_items[(tail + n) %
+			WORKQ_RUN_QUEUE_SIZE];
+	if (n) {
+		os_atomic_store(&dww->dww_tail, tail + n, release);
+	}
+	return dou;
+}
+
+struct dispatch_object_s *
+_dispatch_workq_worker_steal(dispatch_workq_worker_t dww)
+{
+	dispatch_workq_monitor_t mon = _dispatch_workq_monitor_for_queue(dww->dww_dq);
+	int num_workers = os_atomic_load(&mon->num_workers, acquire);
+	struct dispatch_object_s *dou = NULL;
+
+	if (num_workers < 2) {
+		return NULL;
+	}
+	os_atomic_inc(&mon->num_searching, relaxed);
+	os_atomic_store(&mon->wake_pending, false, relaxed);
+	// xorshift32, to spread thieves over victims
+	uint32_t r = dww->dww_rand;
+	r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+	dww->dww_rand = r;
+	for (int i = 0; i < num_workers && !dou; i++) {
+		dispatch_workq_worker_t victim = mon->workers[(r + (uint32_t)i) %
+				(uint32_t)num_workers];
+		if (victim != dww) {
+			dou = _dispatch_workq_run_queue_grab(dww, victim);
+		}
+	}
+	os_atomic_dec(&mon->num_searching, relaxed);
+	if (dou) {
+		os_atomic_store(&dww->dww_progress, dww->dww_progress + 1, relaxed);
+	}
+	return dou;
+}
+
+void
+_dispatch_workq_worker_will_block(void)
+{
+	dispatch_workq_worker_t dww = _dispatch_workq_worker_self;
+	if (dww && os_atomic_load(&dww->dww_busy, relaxed)) {
+		// Sleeping workers are not woken to steal, but are for items
+		// pushed on an empty shared list
+		_dispatch_workq_run_queue_flush(dww);
+	}
+}
+
+bool
+_dispatch_workq_should_wake(dispatch_queue_global_t root_q)
+{
+	dispatch_workq_monitor_t mon = _dispatch_workq_monitor_for_queue(root_q);
+	// A worker already looking for work will find the new item; otherwise
+	// wake a single sleeper, unless one was asked already and has not
+	// started yet
+	if (os_atomic_load(&mon->num_searching, relaxed)) {
+		return false;
+	}
+	return !os_atomic_xchg(&mon->wake_pending, true, relaxed);
+}
+#endif // DISPATCH_USE_WORKQ_STEALING
 
 #if HAVE_DISPATCH_WORKQ_MONITORING
 #if defined(__linux__)
 /*
- * For each pid that is a registered worker, read /proc/[pid]/stat
- * to get a count of the number of them that are actually runnable.
- * See the proc(5) man page for the format of the contents of /proc/[pid]/stat
+ * Count the registered workers that are actually runnable. A worker that is
+ * draining counts as runnable when its thread CPU clock advanced by at least
+ * 1/(2 * WORKQ_OVERSUBSCRIBE_FACTOR) of the time since the last count; one
+ * that used less than that was mostly blocked. This costs one clock_gettime
+ * per worker instead of opening and parsing /proc/[tid]/stat.
+ *
+ * Items stuck in the run queue of a worker that made no progress since the
+ * last count are moved to the shared list, where other workers can get them.
  */
 static void
 _dispatch_workq_count_runnable_workers(dispatch_workq_monitor_t mon)
 {
-	char path[128];
-	char buf[4096];
 	int running_count = 0;
+	uint64_t now = _dispatch_uptime();
+	uint64_t elapsed = mon->last_sample ? now - mon->last_sample : 0;
+	uint64_t runnable_cputime = elapsed / (2 * WORKQ_OVERSUBSCRIBE_FACTOR);
+	mon->last_sample = now;
 
-	_dispatch_unfair_lock_lock(&mon->registered_tid_lock);
+	_dispatch_unfair_lock_lock(&mon->registered_lock);
 
-	for (int i = 0; i < mon->num_registered_tids; i++) {
-		dispatch_tid tid = mon->registered_tids[i];
-		int fd;
-		ssize_t bytes_read = -1;
+	for (int i = 0; i < mon->num_workers; i++) {
+		dispatch_workq_worker_t dww = mon->workers[i];
+		if (!dww->dww_registered) {
+			continue;
+		}
 
-		int r = snprintf(path, sizeof(path), "/proc/%d/stat", tid);
-		dispatch_assert(r > 0 && r < (int)sizeof(path));
+		uint64_t cputime = 0;
+		struct timespec ts;
+		if (dww->dww_clock != (clockid_t)-1 &&
+				clock_gettime(dww->dww_clock, &ts) == 0) {
+			cputime = _dispatch_timespec_to_nano(ts);
+		}
+		uint64_t delta = cputime - dww->dww_cputime;
+		dww->dww_cputime = cputime;
 
-		fd = open(path, O_RDONLY | O_NONBLOCK);
-		if (unlikely(fd == -1)) {
-			DISPATCH_CLIENT_CRASH(tid,
-					"workq: registered worker exited prematurely");
-		} else {
-			bytes_read = read(fd, buf, sizeof(buf)-1);
-			(void)close(fd);
+		if (os_atomic_load(&dww->dww_busy, relaxed) &&
+				(!elapsed || delta >= runnable_cputime)) {
+			running_count++;
 		}
 
-		if (bytes_read > 0) {
-			buf[bytes_read] = '\0';
-			char state;
-			if (sscanf(buf, "%*d %*s %c", &state) == 1) {
-				// _dispatch_debug("workq: Worker %d, state %c\n", tid, state);
-				if (state == 'R') {
-					running_count++;
-				}
-			} else {
-				_dispatch_debug("workq: sscanf of state failed for %d", tid);
-			}
-		} else {
-			_dispatch_debug("workq: Failed to read %s", path);
+#if DISPATCH_USE_WORKQ_STEALING
+		uint64_t progress = os_atomic_load(&dww->dww_progress, relaxed);
+		if (progress == dww->dww_progress_seen) {
+			_dispatch_workq_run_queue_flush(dww);
 		}
+		dww->dww_progress_seen = progress;
+#endif
 	}
 
 	mon->num_runnable = running_count;
 
-	_dispatch_unfair_lock_unlock(&mon->registered_tid_lock);
+	_dispatch_unfair_lock_unlock(&mon->registered_lock);
 }
 #else
 #error must define _dispatch_workq_count_runnable_workers
 #endif
 
+static bool
+_dispatch_workq_monitor_probe(dispatch_workq_monitor_t mon)
+{
+	if (_dispatch_queue_class_probe(mon->dq)) {
+		return true;
+	}
+#if DISPATCH_USE_WORKQ_STEALING
+	int num_workers = os_atomic_load(&mon->num_workers, acquire);
+	for (int i = 0; i < num_workers; i++) {
+		dispatch_workq_worker_t dww = mon->workers[i];
+		if (os_atomic_load(&dww->dww_head, relaxed) !=
+				os_atomic_load(&dww->dww_tail, relaxed)) {
+			return true;
+		}
+	}
+#endif
+	return false;
+}
+
 #define foreach_qos_bucket_reverse(name) \
 		for (name = DISPATCH_QOS_BUCKET(DISPATCH_QOS_MAX); \
 				name >= DISPATCH_QOS_BUCKET(DISPATCH_QOS_MAINTENANCE); name--)
@@ -197,8 +499,9 @@ _dispatch_workq_monitor_pools(void *context DISPATCH_UNUSED)
 		dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[i];
 		dispatch_queue_global_t dq = mon->dq;
 
-		if (!_dispatch_queue_class_probe(dq)) {
+		if (!_dispatch_workq_monitor_probe(mon)) {
 			_dispatch_debug("workq: %s is empty.", dq->dq_label);
+			mon->last_sample = 0;
 			continue;
 		}
 
@@ -244,8 +547,9 @@ _dispatch_workq_init_once(void *context DISPATCH_UNUSED)
 	foreach_qos_bucket_reverse(i) {
 		dispatch_workq_monitor_t mon = &_dispatch_workq_monitors[i];
 		mon->dq = _dispatch_get_root_queue(DISPATCH_QOS_FOR_BUCKET(i), false);
-		void *buf = _dispatch_calloc(WORKQ_MAX_TRACKED_TIDS, sizeof(dispatch_tid));
-		mon->registered_tids = buf;
+		void *buf = _dispatch_calloc(WORKQ_MAX_TRACKED_TIDS,
+				sizeof(dispatch_workq_worker_t));
+		mon->workers = buf;
 		mon->target_runnable = target_runnable;
 	}
 
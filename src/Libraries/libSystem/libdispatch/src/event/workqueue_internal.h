@@ -36,5 +36,32 @@ void _dispatch_workq_worker_unregister(dispatch_queue_global_t root_q);
 #define HAVE_DISPATCH_WORKQ_MONITORING 0
 #endif
 
+#ifndef DISPATCH_USE_WORKQ_STEALING
+#define DISPATCH_USE_WORKQ_STEALING HAVE_DISPATCH_WORKQ_MONITORING
+#endif
+
+#if DISPATCH_USE_WORKQ_STEALING && !HAVE_DISPATCH_WORKQ_MONITORING
+#error DISPATCH_USE_WORKQ_STEALING requires HAVE_DISPATCH_WORKQ_MONITORING
+#endif
+
+typedef struct dispatch_workq_worker_s *dispatch_workq_worker_t;
+
+#if DISPATCH_USE_WORKQ_STEALING
+
+dispatch_workq_worker_t _dispatch_workq_worker_current(
+		dispatch_queue_global_t root_q);
+void _dispatch_workq_worker_drain_start(dispatch_workq_worker_t dww);
+void _dispatch_workq_worker_drain_end(dispatch_workq_worker_t dww);
+bool _dispatch_workq_worker_push(dispatch_queue_global_t root_q,
+		struct dispatch_object_s *dou);
+bool _dispatch_workq_worker_should_check_global(dispatch_workq_worker_t dww);
+struct dispatch_object_s *_dispatch_workq_worker_pop(
+		dispatch_workq_worker_t dww);
+struct dispatch_object_s *_dispatch_workq_worker_steal(
+		dispatch_workq_worker_t dww);
+bool _dispatch_workq_should_wake(dispatch_queue_global_t root_q);
+void _dispatch_workq_worker_will_block(void);
+#endif // DISPATCH_USE_WORKQ_STEALING
+
 #endif /* __DISPATCH_WORKQUEUE_INTERNAL__ */
 
@@ -2562,12 +2562,14 @@ _dispatch_continuation_invoke_inline(dispatch_object_t dou,
 		} else {
 			dc1 = NULL;
 		}
+		_dispatch_trace_item_invoke_start(dqu, dou);
 		if (unlikely(dc_flags & DC_FLAG_GROUP_ASYNC)) {
 			_dispatch_continuation_with_group_invoke(dc);
 		} else {
 			_dispatch_client_callout(dc->dc_ctxt, dc->dc_func);
 			_dispatch_trace_item_complete(dc);
 		}
+		_dispatch_trace_item_invoke_end(dqu, dou);
 		if (unlikely(dc1)) {
 			_dispatch_continuation_free_to_cache_limit(dc1);
 		}
@@ -332,6 +332,9 @@ upcast(dispatch_object_t dou)
 #if USE_POSIX_SEM
 #include <semaphore.h>
 #endif
+#if defined(__linux__)
+#include <sched.h>
+#endif
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -859,6 +862,21 @@ extern bool _dispatch_memory_warn;
 #endif
 #endif // HAVE_SYS_GUARDED_H
 
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#ifndef DISPATCH_USE_IO_URING
+#define DISPATCH_USE_IO_URING 1
+#endif
+#endif // __linux__ && __has_include(<linux/io_uring.h>)
+
+// Without introspection builds (e.g. on Linux) queue activity can still be
+// recorded in process, opt-in at runtime: see queue_trace.c
+#if DISPATCH_USE_THREAD_LOCAL_STORAGE && !DISPATCH_INTROSPECTION && \
+		!DISPATCH_USE_DTRACE_INTROSPECTION
+#ifndef DISPATCH_USE_QUEUE_TRACE
+#define DISPATCH_USE_QUEUE_TRACE 1
+#endif
+#endif
+
 
 #if DISPATCH_USE_DTRACE || DISPATCH_USE_DTRACE_INTROSPECTION
 typedef struct dispatch_trace_timer_params_s {
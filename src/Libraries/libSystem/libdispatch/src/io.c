@@ -25,6 +25,16 @@
 #define F_RDADVISE F_RDAHEAD
 #endif
 
+#if DISPATCH_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+
+#if DISPATCH_IO_USE_WRITEV
+#include <sys/uio.h>
+#endif
+
 #ifndef DISPATCH_IO_DEBUG
 #define DISPATCH_IO_DEBUG DISPATCH_DEBUG
 #endif
@@ -93,9 +103,25 @@ static void _dispatch_stream_queue_handler(void *ctx);
 static void _dispatch_stream_handler(void *ctx);
 static void _dispatch_disk_handler(void *ctx);
 static void _dispatch_disk_perform(void *ctxt);
+static void _dispatch_disk_perform_complete(dispatch_disk_t disk,
+		dispatch_operation_t op, int result);
+#if DISPATCH_USE_IO_URING
+static bool _dispatch_io_uring_available(void);
+static void _dispatch_disk_uring_handler(dispatch_disk_t disk);
+#endif
 static void _dispatch_operation_advise(dispatch_operation_t op,
 		size_t chunk_size);
+static int _dispatch_operation_prepare(dispatch_operation_t op);
+#if DISPATCH_IO_USE_MMAP_READS
+static bool _dispatch_operation_map(dispatch_operation_t op);
+static void _dispatch_io_unmap(void *buf, size_t siz);
+#endif
+#if DISPATCH_IO_USE_WRITEV
+static ssize_t _dispatch_operation_writev(dispatch_operation_t op, off_t off);
+#endif
 static int _dispatch_operation_perform(dispatch_operation_t op);
+static int _dispatch_operation_performed(dispatch_operation_t op,
+		ssize_t processed, int err);
 static void _dispatch_operation_deliver_data(dispatch_operation_t op,
 		dispatch_op_flags_t flags);
 
@@ -192,6 +218,11 @@ _dispatch_io_queues_init(void *context DISPATCH_UNUSED)
 			"com.apple.libdispatch-io.fd_lockq", NULL);
 	_dispatch_io_devs_lockq = dispatch_queue_create(
 			"com.apple.libdispatch-io.dev_lockq", NULL);
+#if DISPATCH_IO_USE_MMAP_READS
+	if (_dispatch_getenv_bool("LIBDISPATCH_IO_MMAP_READS", false)) {
+		dispatch_io_defaults.map_reads = true;
+	}
+#endif
 }
 
 #pragma mark -
@@ -202,11 +233,12 @@ enum {
 	DISPATCH_IOCNTL_LOW_WATER_CHUNKS,
 	DISPATCH_IOCNTL_INITIAL_DELIVERY,
 	DISPATCH_IOCNTL_MAX_PENDING_IO_REQS,
+	DISPATCH_IOCNTL_MAP_READS,
 };
 
 extern struct dispatch_io_defaults_s {
 	size_t chunk_size, low_water_chunks, max_pending_io_reqs;
-	bool initial_delivery;
+	bool initial_delivery, map_reads;
 } dispatch_io_defaults;
 
 DISPATCH_GLOBAL_INIT(struct dispatch_io_defaults_s dispatch_io_defaults, {
@@ -235,6 +267,9 @@ _dispatch_iocntl(uint32_t param, uint64_t value)
 	case DISPATCH_IOCNTL_MAX_PENDING_IO_REQS:
 		_dispatch_iocntl_set_default(max_pending_io_reqs, value);
 		break;
+	case DISPATCH_IOCNTL_MAP_READS:
+		_dispatch_iocntl_set_default(map_reads, value);
+		break;
 	}
 }
 
@@ -1136,6 +1171,11 @@ _dispatch_operation_dispose(dispatch_operation_t op,
 #if defined(_WIN32)
 		_aligned_free(op->buf);
 #else
+#if DISPATCH_IO_USE_MMAP_READS
+		if (op->mapped) {
+			_dispatch_io_unmap(op->buf, op->buf_siz);
+		} else
+#endif
 		free(op->buf);
 #endif
 	}
@@ -1981,6 +2021,10 @@ _dispatch_disk_cleanup_specified_operations(dispatch_disk_t disk,
 	dispatch_operation_t op, tmp;
 	TAILQ_FOREACH_SAFE(op, &disk->operations, operation_list, tmp) {
 		if (inactive_only && op->active) continue;
+#if DISPATCH_USE_IO_URING
+		// Completed once its I/O finishes, see _dispatch_disk_uring_complete
+		if (op->in_flight) continue;
+#endif
 		if (!channel || op->channel == channel) {
 			_dispatch_op_debug("cleanup: disk %p", op, disk);
 			_dispatch_disk_complete_operation(disk, op);
@@ -2143,6 +2187,11 @@ _dispatch_disk_handler(void *ctx)
 	if (disk->io_active) {
 		return;
 	}
+#if DISPATCH_USE_IO_URING
+	if (_dispatch_io_uring_available()) {
+		return _dispatch_disk_uring_handler(disk);
+	}
+#endif
 	_dispatch_disk_debug("disk handler", disk);
 	dispatch_operation_t op;
 	size_t i = disk->free_idx, j = disk->req_idx;
@@ -2226,41 +2275,421 @@ _dispatch_disk_perform(void *ctxt)
 	disk->req_idx = (disk->req_idx + 1) % disk->advise_list_depth;
 	_dispatch_op_debug("async perform completion: disk %p", op, disk);
 	dispatch_async(disk->pick_queue, ^{
-		_dispatch_op_debug("perform completion", op);
-		switch (result) {
-		case DISPATCH_OP_DELIVER:
-			_dispatch_operation_deliver_data(op, DOP_DEFAULT);
-			break;
-		case DISPATCH_OP_COMPLETE:
-			_dispatch_disk_complete_operation(disk, op);
-			break;
-		case DISPATCH_OP_DELIVER_AND_COMPLETE:
-			_dispatch_operation_deliver_data(op, DOP_DELIVER | DOP_NO_EMPTY);
-			_dispatch_disk_complete_operation(disk, op);
-			break;
-		case DISPATCH_OP_ERR:
-			_dispatch_disk_cleanup_operations(disk, op->channel);
-			break;
-		case DISPATCH_OP_FD_ERR:
-			_dispatch_disk_cleanup_operations(disk, NULL);
-			break;
+		_dispatch_disk_perform_complete(disk, op, result);
+	});
+}
+
+static void
+_dispatch_disk_perform_complete(dispatch_disk_t disk, dispatch_operation_t op,
+		int result)
+{
+	// On pick queue
+	_dispatch_op_debug("perform completion", op);
+	switch (result) {
+	case DISPATCH_OP_DELIVER:
+		_dispatch_operation_deliver_data(op, DOP_DEFAULT);
+		break;
+	case DISPATCH_OP_COMPLETE:
+		_dispatch_disk_complete_operation(disk, op);
+		break;
+	case DISPATCH_OP_DELIVER_AND_COMPLETE:
+		_dispatch_operation_deliver_data(op, DOP_DELIVER | DOP_NO_EMPTY);
+		_dispatch_disk_complete_operation(disk, op);
+		break;
+	case DISPATCH_OP_ERR:
+		_dispatch_disk_cleanup_operations(disk, op->channel);
+		break;
+	case DISPATCH_OP_FD_ERR:
+		_dispatch_disk_cleanup_operations(disk, NULL);
+		break;
+	default:
+		dispatch_assert(result);
+		break;
+	}
+	_dispatch_op_debug("deactivate: disk %p", op, disk);
+	op->active = false;
+	disk->io_active = false;
+	_dispatch_disk_handler(disk);
+	// Balancing the retain in _dispatch_disk_handler. Note that op must be
+	// released at the very end, since it might hold the last reference to
+	// the disk
+	_dispatch_op_debug("release -> %d (disk perform complete)", op,
+			op->do_ref_cnt);
+	_dispatch_release(op);
+}
+
+#if DISPATCH_USE_IO_URING
+#pragma mark -
+#pragma mark dispatch_io_uring
+
+// On Linux, disk operations are submitted to a process-wide io_uring rather
+// than performed with blocking pread/pwrite on a worker thread each. Every
+// active operation of a disk has one chunk in flight, and completions are
+// reaped by a read source on the ring's eventfd, so the number of threads
+// involved does not grow with the queue depth.
+//
+// Buffer sizing is shared with _dispatch_operation_perform, and results go
+// through _dispatch_operation_performed and _dispatch_disk_perform_complete,
+// so delivery honors the channel's high and low water marks exactly as the
+// synchronous path does.
+
+#define DIO_URING_ENTRIES		256u
+#define DIO_URING_MAX_IO_SIZE	0x7ffff000u // MAX_RW_COUNT
+#define DIO_URING_RETRY_DELAY	NSEC_PER_MSEC
+
+static struct dispatch_io_uring_s {
+	int fd, eventfd;
+	dispatch_unfair_lock_s lock;
+	uint32_t sq_mask, sq_entries, cq_mask, cq_entries;
+	uint32_t *sq_head, *sq_tail, *sq_array, *cq_head, *cq_tail;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *rings;
+	size_t rings_size;
+	uint32_t in_flight; // queued, completion not yet reaped
+	bool retry_armed; // a retry of the submission is scheduled
+	dispatch_queue_t cq_queue;
+	dispatch_source_t cq_source;
+} _dispatch_io_uring = {
+	.fd = -1,
+	.eventfd = -1,
+};
+DISPATCH_STATIC_GLOBAL(dispatch_once_t _dispatch_io_uring_pred);
+
+static void _dispatch_io_uring_reap(void *ctxt);
+static void _dispatch_io_uring_retry(void *ctxt);
+
+static void
+_dispatch_io_uring_init(void *context DISPATCH_UNUSED)
+{
+	struct dispatch_io_uring_s *ring = &_dispatch_io_uring;
+	struct io_uring_params p;
+	int fd, efd = -1;
+
+	memset(&p, 0, sizeof(p));
+	if (!_dispatch_getenv_bool("LIBDISPATCH_IO_URING", true)) {
+		return;
+	}
+	// Fails with ENOSYS on old kernels and EPERM under some seccomp
+	// profiles, disk operations then use worker threads as before
+	fd = (int)syscall(__NR_io_uring_setup, DIO_URING_ENTRIES, &p);
+	if (fd < 0) {
+		return;
+	}
+	// IORING_OP_READ/WRITE and offset -1 for DISPATCH_IO_STREAM operations
+	// arrived with IORING_FEAT_RW_CUR_POS
+	const uint32_t features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+			IORING_FEAT_RW_CUR_POS;
+	if ((p.features & features) != features) {
+		goto out_close;
+	}
+	size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->rings_size = MAX(sq_size, cq_size);
+	ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (ring->rings == MAP_FAILED) {
+		goto out_close;
+	}
+	ring->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+			IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		goto out_unmap_rings;
+	}
+	efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (efd < 0) {
+		goto out_unmap_sqes;
+	}
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD,
+			&efd, 1) < 0) {
+		goto out_close_eventfd;
+	}
+
+	char *rings = ring->rings;
+	ring->sq_head = (uint32_t *)(rings + p.sq_off.head);
+	ring->sq_tail = (uint32_t *)(rings + p.sq_off.tail);
+	ring->sq_array = (uint32_t *)(rings + p.sq_off.array);
+	ring->sq_mask = *(uint32_t *)(rings + p.sq_off.ring_mask);
+	ring->sq_entries = p.sq_entries;
+	ring->cq_head = (uint32_t *)(rings + p.cq_off.head);
+	ring->cq_tail = (uint32_t *)(rings + p.cq_off.tail);
+	ring->cqes = (struct io_uring_cqe *)(rings + p.cq_off.cqes);
+	ring->cq_mask = *(uint32_t *)(rings + p.cq_off.ring_mask);
+	ring->cq_entries = p.cq_entries;
+	ring->eventfd = efd;
+
+	ring->cq_queue = dispatch_queue_create(
+			"com.apple.libdispatch-io.uringq", NULL);
+	ring->cq_source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ,
+			(uintptr_t)efd, 0, ring->cq_queue);
+	dispatch_set_context(ring->cq_source, ring);
+	dispatch_source_set_event_handler_f(ring->cq_source,
+			_dispatch_io_uring_reap);
+	dispatch_activate(ring->cq_source);
+	ring->fd = fd;
+	return;
+
+out_close_eventfd:
+	close(efd);
+out_unmap_sqes:
+	munmap(ring->sqes, p.sq_entries * sizeof(struct io_uring_sqe));
+out_unmap_rings:
+	munmap(ring->rings, ring->rings_size);
+out_close:
+	close(fd);
+}
+
+static bool
+_dispatch_io_uring_available(void)
+{
+	dispatch_once_f(&_dispatch_io_uring_pred, NULL, _dispatch_io_uring_init);
+	return _dispatch_io_uring.fd != -1;
+}
+
+static void
+_dispatch_io_uring_enter(struct dispatch_io_uring_s *ring)
+{
+	// Called with the ring lock held
+	uint32_t pending = *ring->sq_tail - os_atomic_load(ring->sq_head, acquire);
+	while (pending) {
+		long rc = syscall(__NR_io_uring_enter, ring->fd, pending, 0, 0,
+				NULL, 0);
+		if (rc > 0) {
+			pending -= (uint32_t)rc;
+			continue;
+		}
+		switch (rc ? errno : EAGAIN) {
+		case EINTR:
+			continue;
+		case EAGAIN:
+		case EBUSY:
+			// Left in the SQ ring, submitted again after the next reap.
+			// Without any submitted I/O there is no completion coming
+			// to trigger that, so try again a little later instead.
+			if (os_atomic_load(&ring->in_flight, relaxed) == pending &&
+					!ring->retry_armed) {
+				ring->retry_armed = true;
+				dispatch_after_f(dispatch_time(DISPATCH_TIME_NOW,
+						DIO_URING_RETRY_DELAY), ring->cq_queue, ring,
+						_dispatch_io_uring_retry);
+			}
+			return;
 		default:
-			dispatch_assert(result);
+			DISPATCH_INTERNAL_CRASH(errno, "io_uring_enter() failed");
+		}
+	}
+}
+
+static void
+_dispatch_io_uring_retry(void *ctxt)
+{
+	// On ring completion queue
+	struct dispatch_io_uring_s *ring = ctxt;
+	_dispatch_unfair_lock_lock(&ring->lock);
+	ring->retry_armed = false;
+	_dispatch_io_uring_enter(ring);
+	_dispatch_unfair_lock_unlock(&ring->lock);
+}
+
+static bool
+_dispatch_io_uring_queue(struct dispatch_io_uring_s *ring,
+		dispatch_operation_t op)
+{
+	// Called with the ring lock held
+	if (!op->buf) {
+		// Gathered from several regions, see _dispatch_operation_writev()
+		return false;
+	}
+#if DISPATCH_IO_USE_MMAP_READS
+	if (op->mapped) {
+		// Nothing to read, see _dispatch_operation_map()
+		return false;
+	}
+#endif
+	uint32_t tail = *ring->sq_tail;
+	if (tail - os_atomic_load(ring->sq_head, acquire) >= ring->sq_entries ||
+			os_atomic_load(&ring->in_flight, relaxed) >= ring->cq_entries) {
+		return false;
+	}
+	uint32_t idx = tail & ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+	size_t len = op->buf_siz - op->buf_len;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = op->direction == DOP_DIR_READ ? IORING_OP_READ :
+			IORING_OP_WRITE;
+	sqe->fd = op->fd_entry->fd;
+	sqe->addr = (uintptr_t)op->buf + op->buf_len;
+	sqe->len = (uint32_t)MIN(len, DIO_URING_MAX_IO_SIZE);
+	if (op->params.type == DISPATCH_IO_RANDOM) {
+		sqe->off = (uint64_t)op->offset + op->total;
+	} else {
+		sqe->off = (uint64_t)-1; // current file position, like read/write
+	}
+	sqe->user_data = (uintptr_t)op;
+	ring->sq_array[idx] = idx;
+	os_atomic_store(ring->sq_tail, tail + 1, release);
+	os_atomic_inc(&ring->in_flight, relaxed);
+	return true;
+}
+
+static void
+_dispatch_disk_uring_performed(dispatch_disk_t disk, dispatch_operation_t op,
+		int result)
+{
+	// On pick queue
+	size_t i;
+	for (i = 0; i < disk->advise_list_depth; i++) {
+		if (disk->advise_list[i] == op) {
+			disk->advise_list[i] = NULL;
 			break;
 		}
-		_dispatch_op_debug("deactivate: disk %p", op, disk);
-		op->active = false;
-		disk->io_active = false;
-		_dispatch_disk_handler(disk);
-		// Balancing the retain in _dispatch_disk_handler. Note that op must be
-		// released at the very end, since it might hold the last reference to
-		// the disk
-		_dispatch_op_debug("release -> %d (disk perform complete)", op,
-				op->do_ref_cnt);
-		_dispatch_release(op);
+	}
+	op->in_flight = false;
+	_dispatch_disk_perform_complete(disk, op, result);
+}
+
+static void
+_dispatch_disk_uring_perform_sync(dispatch_disk_t disk, dispatch_operation_t op)
+{
+	// Fallback for when the ring is full or the chunk has no single buffer
+	_dispatch_op_debug("async perform: disk %p", op, disk);
+	dispatch_async(op->do_targetq, ^{
+		int result = _dispatch_operation_perform(op);
+		dispatch_async(disk->pick_queue, ^{
+			_dispatch_disk_uring_performed(disk, op, result);
+		});
 	});
 }
 
+static void
+_dispatch_disk_uring_submit(dispatch_disk_t disk)
+{
+	// On pick queue
+	struct dispatch_io_uring_s *ring = &_dispatch_io_uring;
+	dispatch_operation_t op;
+	bool queued = false;
+	size_t i;
+
+	_dispatch_unfair_lock_lock(&ring->lock);
+	for (i = 0; i < disk->advise_list_depth; i++) {
+		op = disk->advise_list[i];
+		if (!op || op->in_flight) {
+			continue;
+		}
+		op->in_flight = true;
+		if (_dispatch_io_uring_queue(ring, op)) {
+			_dispatch_op_debug("uring submit: disk %p", op, disk);
+			queued = true;
+		} else {
+			_dispatch_disk_uring_perform_sync(disk, op);
+		}
+	}
+	if (queued) {
+		_dispatch_io_uring_enter(ring);
+	}
+	_dispatch_unfair_lock_unlock(&ring->lock);
+}
+
+static void
+_dispatch_disk_uring_complete(dispatch_operation_t op, int res)
+{
+	// On pick queue
+	dispatch_disk_t disk = op->fd_entry->disk;
+	_dispatch_op_debug("uring completion: res %d", op, res);
+	if (res == -EINTR || res == -EAGAIN) {
+		op->in_flight = false;
+		return _dispatch_disk_uring_submit(disk);
+	}
+	int result;
+	if (res < 0) {
+		result = _dispatch_operation_performed(op, -1, -res);
+	} else {
+		result = _dispatch_operation_performed(op, res, 0);
+	}
+	_dispatch_disk_uring_performed(disk, op, result);
+}
+
+static void
+_dispatch_io_uring_reap(void *ctxt)
+{
+	// On ring completion queue
+	struct dispatch_io_uring_s *ring = ctxt;
+	eventfd_t value;
+	(void)eventfd_read(ring->eventfd, &value);
+
+	uint32_t head = *ring->cq_head;
+	uint32_t tail = os_atomic_load(ring->cq_tail, acquire);
+	uint32_t reaped = tail - head;
+	for (; head != tail; head++) {
+		struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+		dispatch_operation_t op = (dispatch_operation_t)(uintptr_t)
+				cqe->user_data;
+		int res = cqe->res;
+		dispatch_async(op->fd_entry->disk->pick_queue, ^{
+			_dispatch_disk_uring_complete(op, res);
+		});
+	}
+	os_atomic_store(ring->cq_head, head, release);
+	if (reaped) {
+		os_atomic_sub(&ring->in_flight, reaped, relaxed);
+		_dispatch_unfair_lock_lock(&ring->lock);
+		_dispatch_io_uring_enter(ring);
+		_dispatch_unfair_lock_unlock(&ring->lock);
+	}
+}
+
+static void
+_dispatch_disk_uring_handler(dispatch_disk_t disk)
+{
+	// On pick queue
+	_dispatch_disk_debug("disk uring handler", disk);
+	dispatch_operation_t op;
+	size_t i = 0;
+	while (i < disk->advise_list_depth) {
+		if (disk->advise_list[i]) {
+			i++;
+			continue;
+		}
+		if (!(op = _dispatch_disk_pick_next_operation(disk))) {
+			// No more operations to get
+			break;
+		}
+		int err = _dispatch_io_get_error(op, NULL, true);
+		if (err) {
+			op->err = err;
+			_dispatch_disk_complete_operation(disk, op);
+			continue;
+		}
+		_dispatch_retain(op);
+		_dispatch_op_debug("retain -> %d", op, op->do_ref_cnt + 1);
+		disk->advise_list[i] = op;
+		op->active = true;
+		_dispatch_op_debug("activate: disk %p", op, disk);
+		_dispatch_object_debug(op, "%s", __func__);
+		// For performance analysis
+		if (!op->total && dispatch_io_defaults.initial_delivery) {
+			// Empty delivery to signal the start of the operation
+			_dispatch_op_debug("initial delivery", op);
+			_dispatch_operation_deliver_data(op, DOP_DELIVER);
+		}
+		// Sizes the buffer for this chunk and opens the fd if needed
+		err = _dispatch_operation_prepare(op);
+		if (err) {
+			int result = _dispatch_operation_performed(op, -1, err);
+			op->in_flight = true;
+			dispatch_async(disk->pick_queue, ^{
+				_dispatch_disk_uring_performed(disk, op, result);
+			});
+		}
+		i++;
+	}
+	// Everything activated above goes to the kernel in a single submission
+	_dispatch_disk_uring_submit(disk);
+}
+#endif // DISPATCH_USE_IO_URING
+
 #pragma mark -
 #pragma mark dispatch_operation_perform
 
@@ -2323,15 +2752,20 @@ _dispatch_operation_advise(dispatch_operation_t op, size_t chunk_size)
 }
 
 static int
-_dispatch_operation_perform(dispatch_operation_t op)
+_dispatch_operation_prepare(dispatch_operation_t op)
 {
-	_dispatch_op_debug("perform", op);
 	int err = _dispatch_io_get_error(op, NULL, true);
 	if (err) {
-		goto error;
+		return err;
 	}
 	_dispatch_object_debug(op, "%s", __func__);
-	if (!op->buf) {
+	if (op->fd_entry->fd == -1) {
+		err = _dispatch_fd_entry_open(op->fd_entry, op->channel);
+		if (err) {
+			return err;
+		}
+	}
+	if (!op->buf && !op->buf_data) {
 		size_t max_buf_siz = op->params.high;
 		size_t chunk_siz = dispatch_io_defaults.chunk_size;
 		if (op->direction == DOP_DIR_READ) {
@@ -2353,6 +2787,12 @@ _dispatch_operation_perform(dispatch_operation_t op)
 			} else {
 				op->buf_siz = max_buf_siz;
 			}
+#if DISPATCH_IO_USE_MMAP_READS
+			if (_dispatch_operation_map(op)) {
+				_dispatch_op_debug("file mapped", op);
+				return 0;
+			}
+#endif
 #if defined(_WIN32)
 			static bool bQueried = false;
 			static SYSTEM_INFO siInfo;
@@ -2364,7 +2804,7 @@ _dispatch_operation_perform(dispatch_operation_t op)
 #else
 			err = posix_memalign(&op->buf, (size_t)PAGE_SIZE, op->buf_siz);
 			if (err != 0) {
-				goto error;
+				return err;
 			}
 #endif
 			_dispatch_op_debug("buffer allocated", op);
@@ -2375,6 +2815,7 @@ _dispatch_operation_perform(dispatch_operation_t op)
 				chunk_siz = max_buf_siz;
 			}
 			op->buf_siz = 0;
+			__block size_t regions = 0;
 			dispatch_data_apply(op->data,
 					^(dispatch_data_t region DISPATCH_UNUSED,
 					size_t offset DISPATCH_UNUSED,
@@ -2382,6 +2823,7 @@ _dispatch_operation_perform(dispatch_operation_t op)
 				size_t siz = op->buf_siz + len;
 				if (!op->buf_siz || siz <= chunk_siz) {
 					op->buf_siz = siz;
+					regions++;
 				}
 				return (bool)(siz < chunk_siz);
 			});
@@ -2390,19 +2832,109 @@ _dispatch_operation_perform(dispatch_operation_t op)
 			}
 			dispatch_data_t d;
 			d = dispatch_data_create_subrange(op->data, 0, op->buf_siz);
+#if DISPATCH_IO_USE_WRITEV
+			if (regions > 1) {
+				// Written from the regions in place, without flattening them
+				op->buf_data = d;
+				_dispatch_op_debug("buffer gathered", op);
+				return 0;
+			}
+#else
+			(void)regions;
+#endif
 			op->buf_data = dispatch_data_create_map(d, (const void**)&op->buf,
 					NULL);
 			_dispatch_io_data_release(d);
 			_dispatch_op_debug("buffer mapped", op);
 		}
 	}
-	if (op->fd_entry->fd == -1) {
-		err = _dispatch_fd_entry_open(op->fd_entry, op->channel);
-		if (err) {
-			goto error;
+	return 0;
+}
+
+#if DISPATCH_IO_USE_MMAP_READS
+static bool
+_dispatch_operation_map(dispatch_operation_t op)
+{
+	// Large reads of regular files map the range instead of copying it into
+	// a buffer, the pages are faulted in by whoever consumes the data.
+	// Opt-in: a file truncated by someone else raises SIGBUS on access.
+	if (!dispatch_io_defaults.map_reads || !op->fd_entry->disk ||
+			op->params.type != DISPATCH_IO_RANDOM ||
+			op->buf_siz < DIO_MIN_MAP_READ_SIZE) {
+		return false;
+	}
+	struct stat st;
+	off_t off = (off_t)((size_t)op->offset + op->total);
+	if (fstat(op->fd_entry->fd, &st) == -1 || st.st_size <= off) {
+		// EOF is reported by pread()
+		return false;
+	}
+	size_t siz = op->buf_siz;
+	if ((uint64_t)(st.st_size - off) < siz) {
+		siz = (size_t)(st.st_size - off);
+		if (siz < DIO_MIN_MAP_READ_SIZE) {
+			return false;
 		}
 	}
-	void *buf = op->buf + op->buf_len;
+	size_t delta = (size_t)off & (PAGE_SIZE - 1);
+	void *map = mmap(NULL, delta + siz, PROT_READ, MAP_PRIVATE,
+			op->fd_entry->fd, off - (off_t)delta);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	(void)madvise(map, delta + siz, MADV_WILLNEED);
+	op->buf = (char *)map + delta;
+	op->buf_siz = siz;
+	op->mapped = true;
+	return true;
+}
+
+static void
+_dispatch_io_unmap(void *buf, size_t siz)
+{
+	size_t delta = (uintptr_t)buf & (PAGE_SIZE - 1);
+	(void)dispatch_assume_zero(munmap((char *)buf - delta, delta + siz));
+}
+#endif // DISPATCH_IO_USE_MMAP_READS
+
+#if DISPATCH_IO_USE_WRITEV
+static ssize_t
+_dispatch_operation_writev(dispatch_operation_t op, off_t off)
+{
+	// Hands the unwritten regions of the buffer data to a single syscall,
+	// the remainder (if any) goes with the next one
+	struct iovec iovs[DIO_MAX_IOVECS], *iov = iovs;
+	__block int iovcnt = 0;
+	__block size_t skip = op->buf_len;
+	dispatch_data_apply(op->buf_data,
+			^(dispatch_data_t region DISPATCH_UNUSED,
+			size_t offset DISPATCH_UNUSED, const void* buf, size_t len) {
+		if (skip >= len) {
+			skip -= len;
+			return (bool)true;
+		}
+		iov[iovcnt].iov_base = (void *)((uintptr_t)buf + skip);
+		iov[iovcnt].iov_len = len - skip;
+		skip = 0;
+		return (bool)(++iovcnt < DIO_MAX_IOVECS);
+	});
+	if (op->params.type == DISPATCH_IO_RANDOM) {
+		return pwritev(op->fd_entry->fd, iov, iovcnt, off);
+	}
+	return writev(op->fd_entry->fd, iov, iovcnt);
+}
+#endif // DISPATCH_IO_USE_WRITEV
+
+static int
+_dispatch_operation_perform(dispatch_operation_t op)
+{
+	_dispatch_op_debug("perform", op);
+	int err = _dispatch_operation_prepare(op);
+	if (err) {
+		goto error;
+	}
+	// Gathered writes have no contiguous buffer, see _dispatch_operation_writev()
+	void *buf = op->buf ? op->buf + op->buf_len : NULL;
 	size_t len = op->buf_siz - op->buf_len;
 #if defined(_WIN32)
 	assert(len <= UINT_MAX && "overflow for read/write");
@@ -2416,6 +2948,17 @@ _dispatch_operation_perform(dispatch_operation_t op)
 	ssize_t processed = -1;
 #endif
 syscall:
+#if DISPATCH_IO_USE_MMAP_READS
+	if (op->mapped) {
+		// Already in place, see _dispatch_operation_map()
+		processed = (ssize_t)len;
+	} else
+#endif
+#if DISPATCH_IO_USE_WRITEV
+	if (op->direction == DOP_DIR_WRITE && !op->buf) {
+		processed = _dispatch_operation_writev(op, off);
+	} else
+#endif
 	if (op->direction == DOP_DIR_READ) {
 		if (op->params.type == DISPATCH_IO_STREAM) {
 #if defined(_WIN32)
@@ -2563,6 +3106,18 @@ syscall:
 		}
 		goto error;
 	}
+	return _dispatch_operation_performed(op, processed, 0);
+error:
+	return _dispatch_operation_performed(op, -1, err);
+}
+
+static int
+_dispatch_operation_performed(dispatch_operation_t op, ssize_t processed,
+		int err)
+{
+	if (processed == -1) {
+		goto error;
+	}
 	// EOF is indicated by two handler invocations
 	if (processed == 0) {
 		_dispatch_op_debug("performed: EOF", op);
@@ -2638,6 +3193,14 @@ _dispatch_operation_deliver_data(dispatch_operation_t op,
 			data = dispatch_data_create(buf, op->buf_len, NULL,
 					^{ _aligned_free(buf); });
 #else
+#if DISPATCH_IO_USE_MMAP_READS
+			if (op->mapped) {
+				size_t siz = op->buf_siz;
+				data = dispatch_data_create(buf, op->buf_len, NULL,
+						^{ _dispatch_io_unmap(buf, siz); });
+				op->mapped = false;
+			} else
+#endif
 			data = dispatch_data_create(buf, op->buf_len, NULL,
 					DISPATCH_DATA_DESTRUCTOR_FREE);
 #endif
@@ -47,6 +47,33 @@
 #define DIO_DEFAULT_LOW_WATER_CHUNKS	  1u // default low-water mark
 #define DIO_MAX_PENDING_IO_REQS			  6u // Pending I/O read advises
 
+#ifndef DISPATCH_IO_USE_WRITEV
+#if defined(_WIN32)
+#define DISPATCH_IO_USE_WRITEV 0
+#else
+#define DISPATCH_IO_USE_WRITEV 1
+#endif
+#endif // DISPATCH_IO_USE_WRITEV
+
+#if DISPATCH_IO_USE_WRITEV
+// Regions per writev(); the iovecs are on the worker thread's stack
+#if defined(IOV_MAX) && IOV_MAX < 32
+#define DIO_MAX_IOVECS					IOV_MAX
+#else
+#define DIO_MAX_IOVECS					32
+#endif
+#endif // DISPATCH_IO_USE_WRITEV
+
+#ifndef DISPATCH_IO_USE_MMAP_READS
+#if defined(_WIN32)
+#define DISPATCH_IO_USE_MMAP_READS 0
+#else
+#define DISPATCH_IO_USE_MMAP_READS 1
+#endif
+#endif // DISPATCH_IO_USE_MMAP_READS
+
+#define DIO_MIN_MAP_READ_SIZE	(128u * 1024) // smaller reads use pread()
+
 typedef unsigned int dispatch_op_direction_t;
 enum {
 	DOP_DIR_READ = 0,
@@ -157,6 +184,12 @@ struct dispatch_operation_s {
 	dispatch_fd_entry_t fd_entry;
 	dispatch_source_t timer;
 	bool active;
+#if DISPATCH_IO_USE_MMAP_READS
+	bool mapped; // buf is a read-only mapping of the file
+#endif
+#if DISPATCH_USE_IO_URING
+	bool in_flight; // chunk I/O submitted, not yet completed
+#endif
 	off_t advise_offset;
 	void* buf;
 	dispatch_op_flags_t flags;
@@ -1647,6 +1647,10 @@ __DISPATCH_WAIT_FOR_QUEUE__(dispatch_sync_context_t dsc, dispatch_queue_t dq)
 	}
 	dx_push(dq, dsc, _dispatch_qos_from_pp(dsc->dc_priority));
 	_dispatch_trace_runtime_event(sync_wait, dq, 0);
+#if DISPATCH_USE_WORKQ_STEALING
+	// The queue may just have been pushed on this worker's run queue
+	_dispatch_workq_worker_will_block();
+#endif
 	if (dsc->dc_data == DISPATCH_WLH_ANON) {
 		_dispatch_thread_event_wait(&dsc->dsc_event); // acquire
 	} else if (!dsc->dsc_wlh_self_wakeup) {
@@ -4241,6 +4245,9 @@ _dispatch_workloop_dispose(dispatch_workloop_t dwl, bool *allow_free)
 	if (dwl->dwl_timer_heap) {
 		for (size_t i = 0; i < DISPATCH_TIMER_WLH_COUNT; i++) {
 			dispatch_assert(dwl->dwl_timer_heap[i].dth_count == 0);
+#if DISPATCH_USE_TIMER_WHEEL
+			free(dwl->dwl_timer_heap[i].dth_wheel);
+#endif
 		}
 		free(dwl->dwl_timer_heap);
 		dwl->dwl_timer_heap = NULL;
@@ -6568,6 +6575,32 @@ out:
 	return head;
 }
 
+#if DISPATCH_USE_WORKQ_STEALING
+DISPATCH_ALWAYS_INLINE
+static inline struct dispatch_object_s *
+_dispatch_root_queue_drain_next(dispatch_queue_global_t dq,
+		dispatch_workq_worker_t dww)
+{
+	struct dispatch_object_s *item;
+
+	if (!dww) {
+		return _dispatch_root_queue_drain_one(dq);
+	}
+	if (unlikely(_dispatch_workq_worker_should_check_global(dww))) {
+		if ((item = _dispatch_root_queue_drain_one(dq))) {
+			return item;
+		}
+	}
+	if (likely(item = _dispatch_workq_worker_pop(dww))) {
+		return item;
+	}
+	if ((item = _dispatch_root_queue_drain_one(dq))) {
+		return item;
+	}
+	return _dispatch_workq_worker_steal(dww);
+}
+#endif // DISPATCH_USE_WORKQ_STEALING
+
 #if DISPATCH_USE_KEVENT_WORKQUEUE
 static void
 _dispatch_root_queue_drain_deferred_wlh(dispatch_deferred_items_t ddi
@@ -6726,7 +6759,13 @@ _dispatch_root_queue_drain(dispatch_queue_global_t dq,
 #endif // DISPATCH_COCOA_COMPAT
 	_dispatch_queue_drain_init_narrowing_check_deadline(&dic, pri);
 	_dispatch_perfmon_start();
+#if DISPATCH_USE_WORKQ_STEALING
+	dispatch_workq_worker_t dww = _dispatch_workq_worker_current(dq);
+	if (dww) _dispatch_workq_worker_drain_start(dww);
+	while (likely(item = _dispatch_root_queue_drain_next(dq, dww))) {
+#else
 	while (likely(item = _dispatch_root_queue_drain_one(dq))) {
+#endif
 		if (reset) _dispatch_wqthread_override_reset();
 		_dispatch_continuation_pop_inline(item, &dic, flags, dq);
 		reset = _dispatch_reset_basepri_override();
@@ -6734,6 +6773,9 @@ _dispatch_root_queue_drain(dispatch_queue_global_t dq,
 			break;
 		}
 	}
+#if DISPATCH_USE_WORKQ_STEALING
+	if (dww) _dispatch_workq_worker_drain_end(dww);
+#endif
 
 	// overcommit or not. worker thread
 	if (pri & DISPATCH_PRIORITY_FLAG_OVERCOMMIT) {
@@ -6940,6 +6982,16 @@ _dispatch_root_queue_push(dispatch_queue_global_t rq, dispatch_object_t dou,
 	}
 #else
 	(void)qos;
+#endif
+#if DISPATCH_USE_WORKQ_STEALING
+	if (_dispatch_workq_worker_push(rq, dou._do)) {
+		// Pushed on the run queue of the current worker, which will get to
+		// it; only bring in help if nobody is already looking for work
+		if (_dispatch_workq_should_wake(rq)) {
+			_dispatch_root_queue_poke_slow(rq, 1, 0);
+		}
+		return;
+	}
 #endif
 	_dispatch_root_queue_push_inline(rq, dou, dou, 1);
 }
@@ -7935,6 +7987,7 @@ libdispatch_init(void)
 	_os_object_init();
 	_voucher_init();
 	_dispatch_introspection_init();
+	_dispatch_queue_trace_init();
 }
 
 #if DISPATCH_USE_THREAD_LOCAL_STORAGE
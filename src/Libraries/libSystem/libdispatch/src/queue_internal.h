@@ -1183,6 +1183,7 @@ struct dispatch_apply_s {
 	dispatch_thread_event_s da_event;
 	dispatch_invoke_flags_t da_flags;
 	int32_t da_thr_cnt;
+	struct dispatch_apply_ranges_s *da_ranges;
 };
 dispatch_static_assert(offsetof(struct dispatch_continuation_s, dc_flags) ==
 		offsetof(struct dispatch_apply_s, da_dc),
@@ -0,0 +1,570 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * In-process queue tracer, for builds without introspection or kdebug.
+ *
+ * Started with LIBDISPATCH_QUEUE_TRACE=<path> in the environment. Every
+ * thread then records the enqueue, dequeue, invoke start and invoke end of
+ * work items in a ring buffer of its own, which only that thread writes to.
+ * Readers copy the rings and discard what the owners overwrote meanwhile.
+ *
+ * At exit (or on dispatch_queue_trace_write()) the rings are written as a
+ * Chrome trace event file; dispatch_queue_trace_get_histograms() computes
+ * wait and run time distributions for a queue out of the same events.
+ */
+
+#include "internal.h"
+
+#if DISPATCH_USE_QUEUE_TRACE
+
+#pragma mark -
+#pragma mark dispatch_queue_trace_ring
+
+#define DQT_RING_SIZE		8192u // events per thread, must be a power of two
+#define DQT_LABELS			64u   // must be a power of two
+#define DQT_LABEL_SIZE		48u
+#define DQT_MAX_NESTING		64u
+
+typedef struct dispatch_queue_trace_event_s {
+	uint64_t dqte_time;
+	uintptr_t dqte_item;
+	unsigned long dqte_queue; // serial number
+	uint32_t dqte_kind;
+} dispatch_queue_trace_event_s, *dispatch_queue_trace_event_t;
+
+typedef struct dispatch_queue_trace_ring_s {
+	struct dispatch_queue_trace_ring_s *dqtr_next;
+	uint64_t volatile dqtr_head; // number of events ever recorded
+	dispatch_tid dqtr_tid;
+	// labels of the queues seen by this thread, by serial number
+	struct {
+		unsigned long volatile dqtl_queue;
+		char dqtl_label[DQT_LABEL_SIZE];
+	} dqtr_labels[DQT_LABELS];
+	dispatch_queue_trace_event_s dqtr_events[DQT_RING_SIZE];
+} *dispatch_queue_trace_ring_t;
+
+DISPATCH_GLOBAL(bool _dispatch_queue_trace_enabled);
+DISPATCH_STATIC_GLOBAL(char *_dispatch_queue_trace_path);
+DISPATCH_STATIC_GLOBAL(dispatch_queue_trace_ring_t _dispatch_queue_trace_rings);
+
+static _Thread_local dispatch_queue_trace_ring_t _dispatch_queue_trace_self;
+
+DISPATCH_NOINLINE
+static dispatch_queue_trace_ring_t
+_dispatch_queue_trace_ring_create(void)
+{
+	dispatch_queue_trace_ring_t dqtr, head;
+
+	// Never freed: the events of exited threads are still dumped
+	dqtr = calloc(1, sizeof(struct dispatch_queue_trace_ring_s));
+	if (!dqtr) {
+		return NULL;
+	}
+	dqtr->dqtr_tid = _dispatch_tid_self();
+	os_atomic_rmw_loop(&_dispatch_queue_trace_rings, head, dqtr, release, {
+		dqtr->dqtr_next = head;
+	});
+	_dispatch_queue_trace_self = dqtr;
+	return dqtr;
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_queue_trace_label(dispatch_queue_trace_ring_t dqtr,
+		dispatch_queue_t dq)
+{
+	unsigned long serialnum = dq->dq_serialnum;
+	__typeof__(dqtr->dqtr_labels[0]) *dqtl;
+
+	dqtl = &dqtr->dqtr_labels[serialnum & (DQT_LABELS - 1)];
+	if (likely(os_atomic_load(&dqtl->dqtl_queue, relaxed) == serialnum)) {
+		return;
+	}
+	// Labels may be freed with their queue, keep a copy for the dump
+	os_atomic_store(&dqtl->dqtl_queue, 0, relaxed);
+	os_atomic_thread_fence(release);
+	strncpy(dqtl->dqtl_label, dq->dq_label ?: "", DQT_LABEL_SIZE - 1);
+	os_atomic_store(&dqtl->dqtl_queue, serialnum, release);
+}
+
+void
+_dispatch_queue_trace_record(uint32_t kind, dispatch_queue_t dq,
+		struct dispatch_object_s *dou)
+{
+	dispatch_queue_trace_ring_t dqtr = _dispatch_queue_trace_self;
+	dispatch_queue_trace_event_t dqte;
+	uint64_t head;
+
+	if (unlikely(!dqtr) && !(dqtr = _dispatch_queue_trace_ring_create())) {
+		return;
+	}
+	if (dq) {
+		_dispatch_queue_trace_label(dqtr, dq);
+	}
+	head = dqtr->dqtr_head;
+	dqte = &dqtr->dqtr_events[head & (DQT_RING_SIZE - 1)];
+	dqte->dqte_time = _dispatch_uptime();
+	dqte->dqte_item = (uintptr_t)dou;
+	dqte->dqte_queue = dq ? dq->dq_serialnum : 0;
+	dqte->dqte_kind = kind;
+	os_atomic_store2o(dqtr, dqtr_head, head + 1, release);
+}
+
+#pragma mark -
+#pragma mark dispatch_queue_trace_snapshot
+
+typedef struct dispatch_queue_trace_sample_s {
+	dispatch_queue_trace_event_s dqts_event;
+	dispatch_tid dqts_tid;
+	bool dqts_has_wait; // dequeue matched with its enqueue
+	uint64_t dqts_wait;
+} dispatch_queue_trace_sample_s, *dispatch_queue_trace_sample_t;
+
+typedef struct dispatch_queue_trace_snapshot_s {
+	size_t dqts_count;
+	dispatch_queue_trace_sample_t dqts_samples; // grouped by thread, in order
+} dispatch_queue_trace_snapshot_s, *dispatch_queue_trace_snapshot_t;
+
+static size_t
+_dispatch_queue_trace_ring_copy(dispatch_queue_trace_ring_t dqtr,
+		dispatch_queue_trace_sample_t dqts)
+{
+	uint64_t head, first, valid, i;
+
+	head = os_atomic_load2o(dqtr, dqtr_head, acquire);
+	first = head > DQT_RING_SIZE ? head - DQT_RING_SIZE : 0;
+	for (i = first; i < head; i++) {
+		dqts[i - first].dqts_event = dqtr->dqtr_events[i & (DQT_RING_SIZE - 1)];
+		dqts[i - first].dqts_tid = dqtr->dqtr_tid;
+		dqts[i - first].dqts_has_wait = false;
+	}
+	// The owner may have overwritten the oldest events while we copied
+	os_atomic_thread_fence(acquire);
+	valid = os_atomic_load2o(dqtr, dqtr_head, relaxed);
+	valid = valid >= DQT_RING_SIZE ? valid - DQT_RING_SIZE + 1 : 0;
+	if (valid <= first) {
+		return (size_t)(head - first);
+	}
+	if (valid >= head) {
+		return 0;
+	}
+	memmove(dqts, dqts + (valid - first), (size_t)(head - valid) *
+			sizeof(dispatch_queue_trace_sample_s));
+	return (size_t)(head - valid);
+}
+
+static int
+_dispatch_queue_trace_sample_cmp(const void *a, const void *b)
+{
+	const dispatch_queue_trace_event_s *ea, *eb;
+	ea = &(*(dispatch_queue_trace_sample_t const *)a)->dqts_event;
+	eb = &(*(dispatch_queue_trace_sample_t const *)b)->dqts_event;
+
+	if (ea->dqte_queue != eb->dqte_queue) {
+		return ea->dqte_queue < eb->dqte_queue ? -1 : 1;
+	}
+	if (ea->dqte_item != eb->dqte_item) {
+		return ea->dqte_item < eb->dqte_item ? -1 : 1;
+	}
+	if (ea->dqte_time != eb->dqte_time) {
+		return ea->dqte_time < eb->dqte_time ? -1 : 1;
+	}
+	// an enqueue and its dequeue in the same tick
+	return ea->dqte_kind < eb->dqte_kind ? -1 : ea->dqte_kind > eb->dqte_kind;
+}
+
+// Pairs every dequeue with the last enqueue of the same item on the same
+// queue before it. Item addresses are reused, and enqueues can have been
+// overwritten, so anything else is left unmatched.
+static void
+_dispatch_queue_trace_match_waits(dispatch_queue_trace_snapshot_t snap)
+{
+	dispatch_queue_trace_sample_t *order, enq = NULL;
+	size_t i, n = 0;
+
+	order = malloc(snap->dqts_count * sizeof(*order));
+	if (!order) {
+		return;
+	}
+	for (i = 0; i < snap->dqts_count; i++) {
+		uint32_t kind = snap->dqts_samples[i].dqts_event.dqte_kind;
+		if (kind == DISPATCH_QUEUE_TRACE_ENQUEUE ||
+				kind == DISPATCH_QUEUE_TRACE_DEQUEUE) {
+			order[n++] = &snap->dqts_samples[i];
+		}
+	}
+	qsort(order, n, sizeof(*order), _dispatch_queue_trace_sample_cmp);
+	for (i = 0; i < n; i++) {
+		dispatch_queue_trace_event_t dqte = &order[i]->dqts_event;
+		if (enq && (enq->dqts_event.dqte_queue != dqte->dqte_queue ||
+				enq->dqts_event.dqte_item != dqte->dqte_item)) {
+			enq = NULL;
+		}
+		if (dqte->dqte_kind == DISPATCH_QUEUE_TRACE_ENQUEUE) {
+			enq = order[i];
+		} else if (enq) {
+			order[i]->dqts_has_wait = true;
+			order[i]->dqts_wait = dqte->dqte_time - enq->dqts_event.dqte_time;
+			enq = NULL;
+		}
+	}
+	free(order);
+}
+
+static bool
+_dispatch_queue_trace_snapshot(dispatch_queue_trace_snapshot_t snap)
+{
+	dispatch_queue_trace_ring_t dqtr, rings;
+	size_t count = 0;
+
+	rings = os_atomic_load(&_dispatch_queue_trace_rings, acquire);
+	for (dqtr = rings; dqtr; dqtr = dqtr->dqtr_next) {
+		count += DQT_RING_SIZE;
+	}
+	snap->dqts_count = 0;
+	snap->dqts_samples = malloc(MAX(count, 1) *
+			sizeof(dispatch_queue_trace_sample_s));
+	if (!snap->dqts_samples) {
+		return false;
+	}
+	for (dqtr = rings; dqtr; dqtr = dqtr->dqtr_next) {
+		snap->dqts_count += _dispatch_queue_trace_ring_copy(dqtr,
+				snap->dqts_samples + snap->dqts_count);
+	}
+	_dispatch_queue_trace_match_waits(snap);
+	return true;
+}
+
+typedef void (*dispatch_queue_trace_slice_f)(void *ctxt,
+		dispatch_queue_trace_sample_t start, dispatch_queue_trace_sample_t end,
+		dispatch_queue_trace_sample_t dequeue);
+
+// Calls fn for every invoke start / invoke end pair, with the dequeue that
+// preceded the invoke on the same thread, if any
+static void
+_dispatch_queue_trace_slices(dispatch_queue_trace_snapshot_t snap,
+		void *ctxt, dispatch_queue_trace_slice_f fn)
+{
+	dispatch_queue_trace_sample_t stack[DQT_MAX_NESTING], deq = NULL;
+	size_t i, depth = 0;
+
+	for (i = 0; i < snap->dqts_count; i++) {
+		dispatch_queue_trace_sample_t dqts = &snap->dqts_samples[i];
+		if (i && dqts->dqts_tid != snap->dqts_samples[i - 1].dqts_tid) {
+			depth = 0;
+			deq = NULL;
+		}
+		switch (dqts->dqts_event.dqte_kind) {
+		case DISPATCH_QUEUE_TRACE_DEQUEUE:
+			deq = dqts;
+			break;
+		case DISPATCH_QUEUE_TRACE_INVOKE_START:
+			if (depth < DQT_MAX_NESTING) {
+				stack[depth++] = dqts;
+			}
+			break;
+		case DISPATCH_QUEUE_TRACE_INVOKE_END:
+			while (depth && stack[depth - 1]->dqts_event.dqte_item !=
+					dqts->dqts_event.dqte_item) {
+				depth--;
+			}
+			if (depth) {
+				dispatch_queue_trace_sample_t start = stack[--depth];
+				if (deq && deq->dqts_event.dqte_item !=
+						start->dqts_event.dqte_item) {
+					deq = NULL;
+				}
+				fn(ctxt, start, dqts, deq);
+			}
+			deq = NULL;
+			break;
+		}
+	}
+}
+
+#pragma mark -
+#pragma mark dispatch_queue_trace_get_histograms
+
+typedef struct dispatch_queue_trace_histograms_s {
+	unsigned long dqth_queue;
+	dispatch_queue_trace_histogram_s *dqth_run;
+} dispatch_queue_trace_histograms_s;
+
+static void
+_dispatch_queue_trace_histogram_add(dispatch_queue_trace_histogram_s *h,
+		uint64_t ns)
+{
+	h->dqth_count++;
+	h->dqth_total_ns += ns;
+	h->dqth_buckets[ns ? 63 - __builtin_clzll(ns) : 0]++;
+}
+
+static void
+_dispatch_queue_trace_histogram_slice(void *ctxt,
+		dispatch_queue_trace_sample_t start, dispatch_queue_trace_sample_t end,
+		dispatch_queue_trace_sample_t dequeue DISPATCH_UNUSED)
+{
+	dispatch_queue_trace_histograms_s *dqth = ctxt;
+	if (start->dqts_event.dqte_queue == dqth->dqth_queue) {
+		_dispatch_queue_trace_histogram_add(dqth->dqth_run,
+				_dispatch_time_mach2nano(end->dqts_event.dqte_time -
+				start->dqts_event.dqte_time));
+	}
+}
+
+bool
+dispatch_queue_trace_get_histograms(dispatch_queue_t dq,
+		dispatch_queue_trace_histogram_s *wait,
+		dispatch_queue_trace_histogram_s *run)
+{
+	dispatch_queue_trace_snapshot_s snap;
+	size_t i;
+
+	if (wait) memset(wait, 0, sizeof(*wait));
+	if (run) memset(run, 0, sizeof(*run));
+	if (!_dispatch_queue_trace_enabled || !_dispatch_queue_trace_snapshot(&snap)) {
+		return false;
+	}
+	if (wait) {
+		for (i = 0; i < snap.dqts_count; i++) {
+			dispatch_queue_trace_sample_t dqts = &snap.dqts_samples[i];
+			if (dqts->dqts_has_wait &&
+					dqts->dqts_event.dqte_queue == dq->dq_serialnum) {
+				_dispatch_queue_trace_histogram_add(wait,
+						_dispatch_time_mach2nano(dqts->dqts_wait));
+			}
+		}
+	}
+	if (run) {
+		dispatch_queue_trace_histograms_s dqth = {
+			.dqth_queue = dq->dq_serialnum,
+			.dqth_run = run,
+		};
+		_dispatch_queue_trace_slices(&snap, &dqth,
+				_dispatch_queue_trace_histogram_slice);
+	}
+	free(snap.dqts_samples);
+	return true;
+}
+
+#pragma mark -
+#pragma mark dispatch_queue_trace_write
+
+typedef struct dispatch_queue_trace_writer_s {
+	FILE *dqtw_file;
+	int dqtw_pid;
+	bool dqtw_first;
+} dispatch_queue_trace_writer_s, *dispatch_queue_trace_writer_t;
+
+static void
+_dispatch_queue_trace_write_label(FILE *f, unsigned long serialnum)
+{
+	dispatch_queue_trace_ring_t dqtr;
+	char label[DQT_LABEL_SIZE];
+	const char *s;
+
+	dqtr = os_atomic_load(&_dispatch_queue_trace_rings, acquire);
+	for (; dqtr; dqtr = dqtr->dqtr_next) {
+		__typeof__(dqtr->dqtr_labels[0]) *dqtl;
+		dqtl = &dqtr->dqtr_labels[serialnum & (DQT_LABELS - 1)];
+		if (os_atomic_load(&dqtl->dqtl_queue, acquire) != serialnum) {
+			continue;
+		}
+		memcpy(label, dqtl->dqtl_label, sizeof(label));
+		label[DQT_LABEL_SIZE - 1] = '\0';
+		os_atomic_thread_fence(acquire);
+		if (os_atomic_load(&dqtl->dqtl_queue, relaxed) == serialnum &&
+				label[0]) {
+			break;
+		}
+	}
+	if (!dqtr) {
+		fprintf(f, "\"queue #%lu\"", serialnum);
+		return;
+	}
+	fputc('"', f);
+	for (s = label; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			fprintf(f, "\\%c", *s);
+		} else if ((unsigned char)*s < 0x20) {
+			fprintf(f, "\\u%04x", (unsigned char)*s);
+		} else {
+			fputc(*s, f);
+		}
+	}
+	fputc('"', f);
+}
+
+static void
+_dispatch_queue_trace_write_header(dispatch_queue_trace_writer_t dqtw,
+		const char *ph, dispatch_queue_trace_sample_t dqts)
+{
+	uint64_t ns = _dispatch_time_mach2nano(dqts->dqts_event.dqte_time);
+
+	fprintf(dqtw->dqtw_file, "%s{\"ph\":\"%s\",\"cat\":\"dispatch\","
+			"\"pid\":%d,\"tid\":%llu,\"ts\":%llu.%03llu,",
+			dqtw->dqtw_first ? "" : ",\n", ph, dqtw->dqtw_pid,
+			(unsigned long long)dqts->dqts_tid,
+			(unsigned long long)(ns / 1000), (unsigned long long)(ns % 1000));
+	dqtw->dqtw_first = false;
+}
+
+static void
+_dispatch_queue_trace_write_slice(void *ctxt,
+		dispatch_queue_trace_sample_t start, dispatch_queue_trace_sample_t end,
+		dispatch_queue_trace_sample_t dequeue)
+{
+	dispatch_queue_trace_writer_t dqtw = ctxt;
+	FILE *f = dqtw->dqtw_file;
+	uint64_t dur = _dispatch_time_mach2nano(end->dqts_event.dqte_time -
+			start->dqts_event.dqte_time);
+
+	_dispatch_queue_trace_write_header(dqtw, "X", start);
+	fprintf(f, "\"dur\":%llu.%03llu,\"name\":",
+			(unsigned long long)(dur / 1000), (unsigned long long)(dur % 1000));
+	_dispatch_queue_trace_write_label(f, start->dqts_event.dqte_queue);
+	fprintf(f, ",\"args\":{\"item\":\"%#lx\"",
+			(unsigned long)start->dqts_event.dqte_item);
+	if (dequeue && dequeue->dqts_has_wait) {
+		uint64_t wait = _dispatch_time_mach2nano(dequeue->dqts_wait);
+		fprintf(f, ",\"wait_us\":%llu.%03llu", (unsigned long long)(wait / 1000),
+				(unsigned long long)(wait % 1000));
+	}
+	fputs("}}", f);
+}
+
+int
+dispatch_queue_trace_write(const char *path)
+{
+	dispatch_queue_trace_snapshot_s snap;
+	dispatch_queue_trace_writer_s dqtw;
+	size_t i;
+	int err = 0;
+
+	if (!_dispatch_queue_trace_enabled) {
+		return ENOTSUP;
+	}
+	if (!_dispatch_queue_trace_snapshot(&snap)) {
+		return ENOMEM;
+	}
+	dqtw.dqtw_file = fopen(path, "w");
+	if (!dqtw.dqtw_file) {
+		err = errno;
+		free(snap.dqts_samples);
+		return err;
+	}
+	dqtw.dqtw_pid = (int)getpid();
+	dqtw.dqtw_first = true;
+
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", dqtw.dqtw_file);
+	// Enqueues are flows that end where the item is dequeued, the invoke
+	// that follows is a slice named after the queue
+	for (i = 0; i < snap.dqts_count; i++) {
+		dispatch_queue_trace_sample_t dqts = &snap.dqts_samples[i];
+		switch (dqts->dqts_event.dqte_kind) {
+		case DISPATCH_QUEUE_TRACE_ENQUEUE:
+			_dispatch_queue_trace_write_header(&dqtw, "i", dqts);
+			fputs("\"s\":\"t\",\"name\":\"enqueue\",\"args\":{\"queue\":",
+					dqtw.dqtw_file);
+			_dispatch_queue_trace_write_label(dqtw.dqtw_file,
+					dqts->dqts_event.dqte_queue);
+			fputs("}}", dqtw.dqtw_file);
+			_dispatch_queue_trace_write_header(&dqtw, "s", dqts);
+			fprintf(dqtw.dqtw_file, "\"name\":\"wait\",\"id\":\"%#lx\"}",
+					(unsigned long)dqts->dqts_event.dqte_item);
+			break;
+		case DISPATCH_QUEUE_TRACE_DEQUEUE:
+			_dispatch_queue_trace_write_header(&dqtw, "f", dqts);
+			fprintf(dqtw.dqtw_file, "\"bp\":\"e\",\"name\":\"wait\","
+					"\"id\":\"%#lx\"}",
+					(unsigned long)dqts->dqts_event.dqte_item);
+			break;
+		}
+	}
+	_dispatch_queue_trace_slices(&snap, &dqtw,
+			_dispatch_queue_trace_write_slice);
+	fputs("\n]}\n", dqtw.dqtw_file);
+
+	if (ferror(dqtw.dqtw_file)) {
+		err = EIO;
+	}
+	if (fclose(dqtw.dqtw_file)) {
+		err = err ?: errno;
+	}
+	free(snap.dqts_samples);
+	return err;
+}
+
+static void
+_dispatch_queue_trace_atexit(void)
+{
+	int err = dispatch_queue_trace_write(_dispatch_queue_trace_path);
+	if (err) {
+		_dispatch_log("libdispatch: could not write queue trace to %s: %s",
+				_dispatch_queue_trace_path, strerror(err));
+	}
+}
+
+void
+_dispatch_queue_trace_init(void)
+{
+	const char *path = getenv("LIBDISPATCH_QUEUE_TRACE");
+	if (!path || !*path) {
+		return;
+	}
+	_dispatch_queue_trace_path = strdup(path);
+	if (!_dispatch_queue_trace_path) {
+		return;
+	}
+	_dispatch_queue_trace_enabled = true;
+	(void)dispatch_assume_zero(atexit(_dispatch_queue_trace_atexit));
+}
+
+#else // DISPATCH_USE_QUEUE_TRACE
+
+bool
+dispatch_queue_trace_get_histograms(dispatch_queue_t dq DISPATCH_UNUSED,
+		dispatch_queue_trace_histogram_s *wait,
+		dispatch_queue_trace_histogram_s *run)
+{
+	if (wait) memset(wait, 0, sizeof(*wait));
+	if (run) memset(run, 0, sizeof(*run));
+	return false;
+}
+
+int
+dispatch_queue_trace_write(const char *path DISPATCH_UNUSED)
+{
+	return ENOTSUP;
+}
+
+#endif // DISPATCH_USE_QUEUE_TRACE
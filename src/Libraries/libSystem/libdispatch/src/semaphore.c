@@ -111,6 +111,9 @@ _dispatch_semaphore_wait_slow(dispatch_semaphore_t dsema,
 	long orig;
 
 	_dispatch_sema4_create(&dsema->dsema_sema, _DSEMA4_POLICY_FIFO);
+#if DISPATCH_USE_WORKQ_STEALING
+	if (timeout != DISPATCH_TIME_NOW) _dispatch_workq_worker_will_block();
+#endif
 	switch (timeout) {
 	default:
 		if (!_dispatch_sema4_timedwait(&dsema->dsema_sema, timeout)) {
@@ -210,6 +213,9 @@ static intptr_t
 _dispatch_group_wait_slow(dispatch_group_t dg, uint32_t gen,
 		dispatch_time_t timeout)
 {
+#if DISPATCH_USE_WORKQ_STEALING
+	_dispatch_workq_worker_will_block();
+#endif
 	for (;;) {
 		int rc = _dispatch_wait_on_address(&dg->dg_gen, gen, timeout, 0);
 		if (likely(gen != os_atomic_load2o(dg, dg_gen, acquire))) {
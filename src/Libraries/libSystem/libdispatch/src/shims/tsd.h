@@ -352,6 +352,10 @@ _dispatch_cpu_number(void)
 {
 #if __has_include(<os/tsd.h>)
 	return _os_cpu_number();
+#elif defined(__linux__)
+	// vDSO backed, no syscall
+	int cpu = sched_getcpu();
+	return likely(cpu >= 0) ? (unsigned int)cpu : 0;
 #elif defined(__x86_64__) || defined(__i386__)
 	struct { uintptr_t p1, p2; } p;
 	__asm__("sidt %[p]" : [p] "=&m" (p));
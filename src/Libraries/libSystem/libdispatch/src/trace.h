@@ -29,6 +29,43 @@
 
 #if DISPATCH_PURE_C
 
+#if DISPATCH_USE_QUEUE_TRACE
+/* Implemented in queue_trace.c */
+#define DISPATCH_QUEUE_TRACE_ENQUEUE		1u
+#define DISPATCH_QUEUE_TRACE_DEQUEUE		2u
+#define DISPATCH_QUEUE_TRACE_INVOKE_START	3u
+#define DISPATCH_QUEUE_TRACE_INVOKE_END		4u
+
+extern bool _dispatch_queue_trace_enabled;
+
+void _dispatch_queue_trace_init(void);
+
+void
+_dispatch_queue_trace_record(uint32_t kind, dispatch_queue_t dq,
+		struct dispatch_object_s *dou);
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_queue_trace(uint32_t kind, dispatch_queue_class_t dqu,
+		dispatch_object_t dou)
+{
+	if (unlikely(_dispatch_queue_trace_enabled)) {
+		_dispatch_queue_trace_record(kind, dqu._dq, dou._do);
+	}
+}
+
+#define _dispatch_trace_item_invoke_start(dqu, dou) \
+		_dispatch_queue_trace(DISPATCH_QUEUE_TRACE_INVOKE_START, dqu, dou)
+#define _dispatch_trace_item_invoke_end(dqu, dou) \
+		_dispatch_queue_trace(DISPATCH_QUEUE_TRACE_INVOKE_END, dqu, dou)
+#else
+#define _dispatch_queue_trace_init()
+#define _dispatch_trace_item_invoke_start(dqu, dou) \
+		do { (void)(dqu); (void)(dou); } while(0)
+#define _dispatch_trace_item_invoke_end(dqu, dou) \
+		do { (void)(dqu); (void)(dou); } while(0)
+#endif // DISPATCH_USE_QUEUE_TRACE
+
 #if DISPATCH_USE_DTRACE_INTROSPECTION
 #define _dispatch_trace_callout(_c, _f, _dcc) do { \
 		if (unlikely(DISPATCH_CALLOUT_ENTRY_ENABLED() || \
@@ -366,12 +403,32 @@ _dispatch_trace_source_callout_entry_internal(dispatch_source_t ds, long kind,
 		new_state) \
 		do { (void)(ask0); (void)(ask1); (void)(old_state); \
 			(void)(new_state); } while (0)
+#if DISPATCH_USE_QUEUE_TRACE
+#define _dispatch_trace_item_push(dq, dou) \
+		_dispatch_queue_trace(DISPATCH_QUEUE_TRACE_ENQUEUE, dq, dou)
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_trace_item_push_list(dispatch_queue_global_t dq,
+		dispatch_object_t _head, dispatch_object_t _tail)
+{
+	if (unlikely(_dispatch_queue_trace_enabled)) {
+		struct dispatch_object_s *dou = _head._do;
+		do {
+			_dispatch_queue_trace_record(DISPATCH_QUEUE_TRACE_ENQUEUE,
+					dq->_as_dq, dou);
+		} while (dou != _tail._do && (dou = dou->do_next));
+	}
+}
+#define _dispatch_trace_item_pop(dq, dou) \
+		_dispatch_queue_trace(DISPATCH_QUEUE_TRACE_DEQUEUE, dq, dou)
+#else
 #define _dispatch_trace_item_push(dq, dou) \
 		do { (void)(dq); (void)(dou); } while(0)
 #define _dispatch_trace_item_push_list(dq, head, tail) \
 		do { (void)(dq); (void)(head); (void)tail; } while(0)
 #define _dispatch_trace_item_pop(dq, dou) \
 		do { (void)(dq); (void)(dou); } while(0)
+#endif // DISPATCH_USE_QUEUE_TRACE
 #define _dispatch_trace_item_complete(dou) ((void)0)
 #define _dispatch_trace_item_sync_push_pop(dq, ctxt, func, flags) \
 		do { (void)(dq); (void)(ctxt); (void)(func); (void)(flags); } while(0)
@@ -227,6 +227,516 @@ _dispatch_transform_swap_from_host(uint16_t x, int32_t byteOrder)
 	return OSSwapHostToBigInt16(x);
 }
 
+#pragma mark -
+#pragma mark vector kernels
+
+// Bulk kernels for the transforms below. Each one converts the longest
+// prefix of its input it can handle without a special case (whitespace,
+// padding, invalid or non-ASCII characters, region boundaries) and returns
+// how much input it consumed; the scalar loops deal with the rest one
+// character at a time, so the output is the same with or without them.
+//
+// base64 has SSSE3 and AVX2 variants picked at runtime on x86 and a NEON
+// one on arm64; LIBDISPATCH_TRANSFORM_SIMD=0 forces the portable ones.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DISPATCH_TRANSFORM_USE_SSE 1
+#include <immintrin.h>
+#if defined(__APPLE__)
+#include <System/i386/cpu_capabilities.h>
+#endif
+#define DISPATCH_TRANSFORM_TARGET(t) __attribute__((__target__(t)))
+#elif defined(__aarch64__) || defined(__arm64__)
+#define DISPATCH_TRANSFORM_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef size_t (*dispatch_transform_kernel_t)(const uint8_t *src, size_t len,
+		uint8_t *dst);
+
+static size_t _dispatch_transform_base64_encode_scalar(const uint8_t *src,
+		size_t len, uint8_t *dst);
+static size_t _dispatch_transform_base64_decode_scalar(const uint8_t *src,
+		size_t len, uint8_t *dst);
+
+static dispatch_once_t _dispatch_transform_kernels_pred;
+static dispatch_transform_kernel_t _dispatch_transform_base64_encode_kernel =
+		_dispatch_transform_base64_encode_scalar;
+static dispatch_transform_kernel_t _dispatch_transform_base64_decode_kernel =
+		_dispatch_transform_base64_decode_scalar;
+
+// Reversed base64 alphabet, 0xff for anything else
+static uint8_t _dispatch_transform_base64_values[256];
+
+static size_t
+_dispatch_transform_base64_encode_scalar(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	size_t i;
+
+	for (i = 0; i + 3 <= len; i += 3) {
+		uint32_t x = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 |
+				src[i + 2];
+		*dst++ = base64_encode_table[(x >> 18) & 0x3f];
+		*dst++ = base64_encode_table[(x >> 12) & 0x3f];
+		*dst++ = base64_encode_table[(x >> 6) & 0x3f];
+		*dst++ = base64_encode_table[x & 0x3f];
+	}
+	return i;
+}
+
+static size_t
+_dispatch_transform_base64_decode_scalar(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	const uint8_t *values = _dispatch_transform_base64_values;
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		uint32_t a = values[src[i]], b = values[src[i + 1]];
+		uint32_t c = values[src[i + 2]], d = values[src[i + 3]];
+		if ((a | b | c | d) > 0x3f) {
+			break;
+		}
+		uint32_t x = a << 18 | b << 12 | c << 6 | d;
+		*dst++ = (uint8_t)(x >> 16);
+		*dst++ = (uint8_t)(x >> 8);
+		*dst++ = (uint8_t)x;
+	}
+	return i;
+}
+
+#if DISPATCH_TRANSFORM_USE_SSE
+// Split 3 byte groups of a 12 byte shuffled input into 16 6-bit indices
+// and map them to the base64 alphabet without table lookups.
+DISPATCH_ALWAYS_INLINE DISPATCH_TRANSFORM_TARGET("ssse3")
+static inline __m128i
+_dispatch_transform_base64_encode_sse(__m128i in)
+{
+	in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+			7, 6, 8, 7, 10, 9, 11, 10));
+	__m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	__m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	__m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	__m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	__m128i indices = _mm_or_si128(t1, t3);
+
+	__m128i offset = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	__m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+	offset = _mm_or_si128(offset, _mm_and_si128(upper, _mm_set1_epi8(13)));
+	offset = _mm_shuffle_epi8(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0), offset);
+	return _mm_add_epi8(indices, offset);
+}
+
+// Maps 16 base64 characters to their 6-bit values, or returns false if any
+// of them is outside of the alphabet.
+DISPATCH_ALWAYS_INLINE DISPATCH_TRANSFORM_TARGET("ssse3")
+static inline bool
+_dispatch_transform_base64_decode_sse(__m128i in, __m128i *out)
+{
+	__m128i hi = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+	__m128i lo = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+	__m128i lo_class = _mm_shuffle_epi8(_mm_setr_epi8(0x15, 0x11, 0x11,
+			0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b,
+			0x1b, 0x1b, 0x1a), lo);
+	__m128i hi_class = _mm_shuffle_epi8(_mm_setr_epi8(0x10, 0x10, 0x01,
+			0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x10), hi);
+	__m128i invalid = _mm_cmpeq_epi8(_mm_and_si128(lo_class, hi_class),
+			_mm_setzero_si128());
+	if (_mm_movemask_epi8(invalid) != 0xffff) {
+		return false;
+	}
+
+	__m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+	__m128i roll = _mm_shuffle_epi8(_mm_setr_epi8(0, 16, 19, 4, -65, -65,
+			-71, -71, 0, 0, 0, 0, 0, 0, 0, 0), _mm_add_epi8(slash, hi));
+	__m128i values = _mm_add_epi8(in, roll);
+
+	// pack 4 6-bit values into 3 bytes per 32-bit lane, big endian
+	values = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+	values = _mm_madd_epi16(values, _mm_set1_epi32(0x00011000));
+	*out = _mm_shuffle_epi8(values, _mm_setr_epi8(2, 1, 0, 6, 5, 4,
+			10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	return true;
+}
+
+DISPATCH_TRANSFORM_TARGET("ssse3")
+static size_t
+_dispatch_transform_base64_encode_ssse3(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	size_t i;
+
+	// 12 bytes are encoded per 16 byte load
+	for (i = 0; i + 16 <= len; i += 12, dst += 16) {
+		__m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)dst,
+				_dispatch_transform_base64_encode_sse(in));
+	}
+	return i + _dispatch_transform_base64_encode_scalar(src + i, len - i, dst);
+}
+
+DISPATCH_TRANSFORM_TARGET("ssse3")
+static size_t
+_dispatch_transform_base64_decode_ssse3(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16, dst += 12) {
+		__m128i out, in = _mm_loadu_si128((const __m128i *)(src + i));
+		if (!_dispatch_transform_base64_decode_sse(in, &out)) {
+			break;
+		}
+		_mm_storel_epi64((__m128i *)dst, out);
+		uint32_t tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+		memcpy(dst + 8, &tail, sizeof(tail));
+	}
+	return i + _dispatch_transform_base64_decode_scalar(src + i, len - i, dst);
+}
+
+DISPATCH_TRANSFORM_TARGET("avx2")
+static size_t
+_dispatch_transform_base64_encode_avx2(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	const __m256i shuf = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+			7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4,
+			7, 6, 8, 7, 10, 9, 11, 10);
+	size_t i;
+
+	// 24 bytes are encoded per pair of 16 byte loads
+	for (i = 0; i + 28 <= len; i += 24, dst += 32) {
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_loadu_si128((const __m128i *)(src + i))),
+				_mm_loadu_si128((const __m128i *)(src + i + 12)), 1);
+		in = _mm256_shuffle_epi8(in, shuf);
+		__m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+		__m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		__m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+		__m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		__m256i indices = _mm256_or_si256(t1, t3);
+
+		__m256i offset = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		offset = _mm256_or_si256(offset,
+				_mm256_and_si256(upper, _mm256_set1_epi8(13)));
+		offset = _mm256_shuffle_epi8(_mm256_setr_epi8('a' - 26, '0' - 52,
+				'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+				'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+				'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+				'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+				'/' - 63, 'A', 0, 0), offset);
+		_mm256_storeu_si256((__m256i *)dst, _mm256_add_epi8(indices, offset));
+	}
+	return i + _dispatch_transform_base64_encode_ssse3(src + i, len - i, dst);
+}
+
+DISPATCH_TRANSFORM_TARGET("avx2")
+static size_t
+_dispatch_transform_base64_decode_avx2(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	const __m256i lo_lut = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13,
+			0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i hi_lut = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04,
+			0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i roll_lut = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71,
+			-71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4, -65, -65, -71, -71,
+			0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i shuf = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+			14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8,
+			14, 13, 12, -1, -1, -1, -1);
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32, dst += 24) {
+		__m256i in = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi32(in, 4),
+				_mm256_set1_epi8(0x0f));
+		__m256i lo = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+		__m256i category = _mm256_and_si256(_mm256_shuffle_epi8(lo_lut, lo),
+				_mm256_shuffle_epi8(hi_lut, hi));
+		if (!_mm256_testz_si256(category, category)) {
+			break;
+		}
+
+		__m256i slash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+		__m256i values = _mm256_add_epi8(in, _mm256_shuffle_epi8(roll_lut,
+				_mm256_add_epi8(slash, hi)));
+		values = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+		values = _mm256_madd_epi16(values, _mm256_set1_epi32(0x00011000));
+		values = _mm256_shuffle_epi8(values, shuf);
+		values = _mm256_permutevar8x32_epi32(values,
+				_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(values));
+		_mm_storel_epi64((__m128i *)(dst + 16),
+				_mm256_extracti128_si256(values, 1));
+	}
+	return i + _dispatch_transform_base64_decode_ssse3(src + i, len - i, dst);
+}
+#endif // DISPATCH_TRANSFORM_USE_SSE
+
+#if DISPATCH_TRANSFORM_USE_NEON
+static size_t
+_dispatch_transform_base64_encode_neon(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	const uint8x16x4_t table = vld1q_u8_x4(base64_encode_table);
+	const uint8x16_t mask = vdupq_n_u8(0x3f);
+	size_t i;
+
+	for (i = 0; i + 48 <= len; i += 48, dst += 64) {
+		uint8x16x3_t in = vld3q_u8(src + i);
+		uint8x16x4_t out;
+		out.val[0] = vshrq_n_u8(in.val[0], 2);
+		out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+				vshrq_n_u8(in.val[1], 4)), mask);
+		out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+				vshrq_n_u8(in.val[2], 6)), mask);
+		out.val[3] = vandq_u8(in.val[2], mask);
+		for (int j = 0; j < 4; j++) {
+			out.val[j] = vqtbl4q_u8(table, out.val[j]);
+		}
+		vst4q_u8(dst, out);
+	}
+	return i + _dispatch_transform_base64_encode_scalar(src + i, len - i, dst);
+}
+
+static size_t
+_dispatch_transform_base64_decode_neon(const uint8_t *src, size_t len,
+		uint8_t *dst)
+{
+	const uint8_t *values = _dispatch_transform_base64_values;
+	const uint8x16x4_t lo_table = vld1q_u8_x4(values);
+	const uint8x16x4_t hi_table = vld1q_u8_x4(values + 64);
+	const uint8x16_t sixty_four = vdupq_n_u8(64);
+	size_t i;
+
+	for (i = 0; i + 64 <= len; i += 64, dst += 48) {
+		uint8x16x4_t in = vld4q_u8(src + i);
+		uint8x16_t invalid = vdupq_n_u8(0);
+		for (int j = 0; j < 4; j++) {
+			uint8x16_t c = in.val[j];
+			uint8x16_t v = vqtbx4q_u8(vqtbl4q_u8(lo_table, c), hi_table,
+					vsubq_u8(c, sixty_four));
+			// bytes >= 128 miss both tables and would decode as 'A'
+			invalid = vorrq_u8(invalid, vorrq_u8(v, vandq_u8(c,
+					vdupq_n_u8(0x80))));
+			in.val[j] = v;
+		}
+		if (vmaxvq_u8(invalid) > 0x3f) {
+			break;
+		}
+		uint8x16x3_t out;
+		out.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2),
+				vshrq_n_u8(in.val[1], 4));
+		out.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4),
+				vshrq_n_u8(in.val[2], 2));
+		out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+		vst3q_u8(dst, out);
+	}
+	return i + _dispatch_transform_base64_decode_scalar(src + i, len - i, dst);
+}
+#endif // DISPATCH_TRANSFORM_USE_NEON
+
+static void
+_dispatch_transform_kernels_init(void *context DISPATCH_UNUSED)
+{
+	memset(_dispatch_transform_base64_values, 0xff,
+			sizeof(_dispatch_transform_base64_values));
+	for (uint8_t i = 0; i < 64; i++) {
+		_dispatch_transform_base64_values[base64_encode_table[i]] = i;
+	}
+
+	if (!_dispatch_getenv_bool("LIBDISPATCH_TRANSFORM_SIMD", true)) {
+		return;
+	}
+#if DISPATCH_TRANSFORM_USE_SSE
+#if defined(__APPLE__)
+	uint64_t caps = _get_cpu_capabilities();
+	bool has_ssse3 = (caps & kHasSupplementalSSE3);
+	bool has_avx2 = (caps & kHasAVX2_0);
+#else
+	__builtin_cpu_init();
+	bool has_ssse3 = __builtin_cpu_supports("ssse3");
+	bool has_avx2 = __builtin_cpu_supports("avx2");
+#endif
+	if (has_avx2) {
+		_dispatch_transform_base64_encode_kernel =
+				_dispatch_transform_base64_encode_avx2;
+		_dispatch_transform_base64_decode_kernel =
+				_dispatch_transform_base64_decode_avx2;
+	} else if (has_ssse3) {
+		_dispatch_transform_base64_encode_kernel =
+				_dispatch_transform_base64_encode_ssse3;
+		_dispatch_transform_base64_decode_kernel =
+				_dispatch_transform_base64_decode_ssse3;
+	}
+#elif DISPATCH_TRANSFORM_USE_NEON
+	_dispatch_transform_base64_encode_kernel =
+			_dispatch_transform_base64_encode_neon;
+	_dispatch_transform_base64_decode_kernel =
+			_dispatch_transform_base64_decode_neon;
+#endif
+}
+
+DISPATCH_ALWAYS_INLINE
+static inline void
+_dispatch_transform_kernels_ensure(void)
+{
+	dispatch_once_f(&_dispatch_transform_kernels_pred, NULL,
+			_dispatch_transform_kernels_init);
+}
+
+// Encodes 5 byte groups into 8 characters of the given base32 alphabet
+static size_t
+_dispatch_transform_base32_encode_groups(const uint8_t *src, size_t len,
+		uint8_t *dst, const unsigned char *table)
+{
+	size_t i;
+
+	for (i = 0; i + 5 <= len; i += 5, dst += 8) {
+		uint64_t x = (uint64_t)src[i] << 32 | (uint64_t)src[i + 1] << 24 |
+				(uint64_t)src[i + 2] << 16 | (uint64_t)src[i + 3] << 8 |
+				src[i + 4];
+		for (int j = 0; j < 8; j++) {
+			dst[j] = table[(x >> (35 - 5 * j)) & 0x1f];
+		}
+	}
+	return i;
+}
+
+// Decodes groups of 8 base32 characters that need none of the special cases
+// of the scalar loop into 5 bytes each
+static size_t
+_dispatch_transform_base32_decode_groups(const uint8_t *src, size_t len,
+		uint8_t *dst, const signed char *table, ssize_t table_size)
+{
+	size_t i;
+
+	for (i = 0; i + 8 <= len; i += 8, dst += 5) {
+		uint64_t x = 0;
+		for (size_t j = 0; j < 8; j++) {
+			ssize_t index = src[i + j];
+			if (index >= table_size || table[index] < 0) {
+				return i;
+			}
+			x = (x << 5) | (uint64_t)table[index];
+		}
+		dst[0] = (uint8_t)(x >> 32);
+		dst[1] = (uint8_t)(x >> 24);
+		dst[2] = (uint8_t)(x >> 16);
+		dst[3] = (uint8_t)(x >> 8);
+		dst[4] = (uint8_t)x;
+	}
+	return i;
+}
+
+// Widens the leading run of ASCII bytes to UTF-16 code units, byte swapped
+// if needed
+static size_t
+_dispatch_transform_utf8_ascii_to_utf16(const uint8_t *src, size_t len,
+		uint16_t *dst, bool swap)
+{
+	size_t i = 0;
+
+#if DISPATCH_TRANSFORM_USE_SSE && defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= len; i += 16) {
+		__m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+		if (_mm_movemask_epi8(in)) {
+			break;
+		}
+		__m128i lo = _mm_unpacklo_epi8(in, zero);
+		__m128i hi = _mm_unpackhi_epi8(in, zero);
+		if (swap) {
+			lo = _mm_slli_epi16(lo, 8);
+			hi = _mm_slli_epi16(hi, 8);
+		}
+		_mm_storeu_si128((__m128i *)(dst + i), lo);
+		_mm_storeu_si128((__m128i *)(dst + i + 8), hi);
+	}
+#elif DISPATCH_TRANSFORM_USE_NEON
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t in = vld1q_u8(src + i);
+		if (vmaxvq_u8(in) >= 0x80) {
+			break;
+		}
+		uint16x8_t lo = vmovl_u8(vget_low_u8(in));
+		uint16x8_t hi = vmovl_u8(vget_high_u8(in));
+		if (swap) {
+			lo = vshlq_n_u16(lo, 8);
+			hi = vshlq_n_u16(hi, 8);
+		}
+		vst1q_u16(dst + i, lo);
+		vst1q_u16(dst + i + 8, hi);
+	}
+#endif
+	for (; i < len && src[i] < 0x80; i++) {
+		dst[i] = swap ? (uint16_t)(src[i] << 8) : src[i];
+	}
+	return i;
+}
+
+// Narrows the leading run of UTF-16 code units below 0x80 to ASCII bytes,
+// the source can be misaligned
+static size_t
+_dispatch_transform_utf16_ascii_to_utf8(const uint16_t *src, size_t len,
+		uint8_t *dst, bool swap)
+{
+	const uint8_t *bytes = (const uint8_t *)src;
+	size_t i = 0;
+
+#if DISPATCH_TRANSFORM_USE_SSE && defined(__SSE2__)
+	const __m128i non_ascii = swap ? _mm_set1_epi16((short)0x80ff) :
+			_mm_set1_epi16((short)0xff80);
+	for (; i + 16 <= len; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(bytes + 2 * i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(bytes + 2 * i + 16));
+		__m128i test = _mm_and_si128(_mm_or_si128(a, b), non_ascii);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(test, _mm_setzero_si128())) !=
+				0xffff) {
+			break;
+		}
+		if (swap) {
+			a = _mm_srli_epi16(a, 8);
+			b = _mm_srli_epi16(b, 8);
+		}
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+	}
+#elif DISPATCH_TRANSFORM_USE_NEON
+	for (; i + 16 <= len; i += 16) {
+		uint16x8_t a = vreinterpretq_u16_u8(vld1q_u8(bytes + 2 * i));
+		uint16x8_t b = vreinterpretq_u16_u8(vld1q_u8(bytes + 2 * i + 16));
+		if (swap) {
+			a = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(a)));
+			b = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(b)));
+		}
+		if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80) {
+			break;
+		}
+		vst1q_u8(dst + i, vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+	}
+#endif
+	for (; i < len; i++) {
+		uint16_t ch;
+		memcpy(&ch, bytes + 2 * i, sizeof(ch));
+		if (swap) ch = (uint16_t)(ch << 8 | ch >> 8);
+		if (ch >= 0x80) {
+			break;
+		}
+		dst[i] = (uint8_t)ch;
+	}
+	return i;
+}
+
 #pragma mark -
 #pragma mark UTF-8
 
@@ -294,6 +804,7 @@ static dispatch_data_t
 _dispatch_transform_to_utf16(dispatch_data_t data, int32_t byteOrder)
 {
 	__block size_t skip = 0;
+	bool swap = (_dispatch_transform_swap_from_host(1, byteOrder) != 1);
 
 	__block dispatch_transform_buffer_s buffer = {
 		.data = dispatch_data_empty,
@@ -333,6 +844,21 @@ _dispatch_transform_to_utf16(dispatch_data_t data, int32_t byteOrder)
 			uint8_t byte_size = _dispatch_transform_utf8_length(*src);
 			size_t next;
 
+			if (byte_size == 1) {
+				if (os_mul_overflow(size - i, sizeof(uint16_t), &next)) {
+					return (bool)false;
+				}
+				if (!_dispatch_transform_buffer_new(&buffer, next, 0)) {
+					return (bool)false;
+				}
+				size_t n = _dispatch_transform_utf8_ascii_to_utf16(src,
+						size - i, buffer.ptr.u16, swap);
+				buffer.ptr.u16 += n;
+				src += n;
+				i += n;
+				continue;
+			}
+
 			if (byte_size == 0) {
 				return (bool)false;
 			} else if (byte_size + i > size) {
@@ -403,6 +929,7 @@ static dispatch_data_t
 _dispatch_transform_from_utf16(dispatch_data_t data, int32_t byteOrder)
 {
 	__block size_t skip = 0;
+	bool swap = (_dispatch_transform_swap_to_host(1, byteOrder) != 1);
 
 	__block dispatch_transform_buffer_s buffer = {
 		.data = dispatch_data_empty,
@@ -444,6 +971,22 @@ _dispatch_transform_from_utf16(dispatch_data_t data, int32_t byteOrder)
 			uint16_t ch;
 			size_t next;
 
+			// Runs of ASCII past the BOM, within this region
+			if (i < size / 2 && (offset > 0 || i > 0) &&
+					_dispatch_transform_swap_to_host(src[i], byteOrder) < 0x80) {
+				size_t n = size / 2 - i;
+				if (!_dispatch_transform_buffer_new(&buffer, n, 0)) {
+					return (bool)false;
+				}
+				n = _dispatch_transform_utf16_ascii_to_utf8(src + i, n,
+						buffer.ptr.u8, swap);
+				buffer.ptr.u8 += n;
+				i += n;
+				if (i >= max) {
+					break;
+				}
+			}
+
 			if ((i == (max - 1)) && (max > (size / 2))) {
 				// Last byte of an odd sized range
 				const void *p;
@@ -611,6 +1154,17 @@ _dispatch_transform_from_base32_with_table(dispatch_data_t data,
 		const uint8_t *bytes = buffer;
 
 		for (i = 0; i < size; i++) {
+			if ((count & 0x7) == 0) {
+				size_t n = _dispatch_transform_base32_decode_groups(bytes + i,
+						size - i, ptr, table, table_size);
+				ptr += n / 8 * 5;
+				i += n;
+				count += n;
+				if (i == size) {
+					break;
+				}
+			}
+
 			if (bytes[i] == '\n' || bytes[i] == '\t' || bytes[i] == ' ') {
 				continue;
 			}
@@ -709,8 +1263,20 @@ _dispatch_transform_to_base32_with_table(dispatch_data_t data, const unsigned ch
 		size_t i;
 
 		for (i = 0; i < size; i++, count++) {
-			uint8_t curr = bytes[i], last = 0;
+			uint8_t curr, last = 0;
+
+			if ((count % 5) == 0) {
+				size_t n = _dispatch_transform_base32_encode_groups(bytes + i,
+						size - i, ptr, table);
+				ptr += n / 5 * 8;
+				i += n;
+				count += n;
+				if (i == size) {
+					break;
+				}
+			}
 
+			curr = bytes[i];
 			if ((count % 5) != 0) {
 				if (i == 0) {
 					const void *p;
@@ -841,6 +1407,8 @@ _dispatch_transform_from_base64(dispatch_data_t data)
 
 	__block dispatch_data_t rv = dispatch_data_empty;
 
+	_dispatch_transform_kernels_ensure();
+
 	bool success = dispatch_data_apply(data, ^(
 			DISPATCH_UNUSED dispatch_data_t region,
 			DISPATCH_UNUSED size_t offset, const void *buffer, size_t size) {
@@ -855,6 +1423,17 @@ _dispatch_transform_from_base64(dispatch_data_t data)
 		const uint8_t *bytes = buffer;
 
 		for (i = 0; i < size; i++) {
+			if ((count & 0x3) == 0) {
+				size_t n = _dispatch_transform_base64_decode_kernel(bytes + i,
+						size - i, ptr);
+				ptr += n / 4 * 3;
+				i += n;
+				count += n;
+				if (i == size) {
+					break;
+				}
+			}
+
 			if (bytes[i] == '\n' || bytes[i] == '\t' || bytes[i] == ' ') {
 				continue;
 			}
@@ -931,6 +1510,8 @@ _dispatch_transform_to_base64(dispatch_data_t data)
 
 	__block uint8_t *ptr = dest;
 
+	_dispatch_transform_kernels_ensure();
+
 	/*
 	 * 3 8-bit bytes:	xxxxxxxx yyyyyyyy zzzzzzzz
 	 * 4 6-bit chunks:	aaaaaabb bbbbcccc ccdddddd
@@ -943,8 +1524,20 @@ _dispatch_transform_to_base64(dispatch_data_t data)
 		size_t i;
 
 		for (i = 0; i < size; i++, count++) {
-			uint8_t curr = bytes[i], last = 0;
+			uint8_t curr, last = 0;
+
+			if ((count % 3) == 0) {
+				size_t n = _dispatch_transform_base64_encode_kernel(bytes + i,
+						size - i, ptr);
+				ptr += n / 3 * 4;
+				i += n;
+				count += n;
+				if (i == size) {
+					break;
+				}
+			}
 
+			curr = bytes[i];
 			if ((count % 3) != 0) {
 				if (i == 0) {
 					const void *p;
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * dispatch_apply(DISPATCH_APPLY_AUTO) scaling for per-iteration costs from
+ * 10ns to 100us, with the shared iteration index and with per-thread ranges.
+ *
+ *   cc -O2 -o dispatch_apply_bench dispatch_apply_bench.c -ldispatch
+ *   ./dispatch_apply_bench [-w work per apply in ms] [-i iterations]
+ *
+ * Each configuration runs in a child process with LIBDISPATCH_APPLY_RANGES
+ * set to 0 (shared index) or 1 (ranges), as the choice is made once per
+ * process. Pass -c to run a single configuration in the current environment
+ * instead.
+ *
+ * Every apply performs the same amount of busy work, split in as many
+ * iterations as the per-iteration cost allows. The speedup is relative to
+ * running the same iterations in a plain loop on one thread.
+ */
+
+#include <dispatch/dispatch.h>
+#include <errno.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static uint64_t work_ns = 200 * NSEC_PER_MSEC;
+static int iterations = 5;
+
+static uint64_t spins_per_us;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void
+spin(uint64_t n)
+{
+	for (volatile uint64_t i = 0; i < n; i++) {
+	}
+}
+
+static void
+calibrate(void)
+{
+	uint64_t n = 1 << 20, ns;
+	do {
+		n *= 2;
+		uint64_t start = now_ns();
+		spin(n);
+		ns = now_ns() - start;
+	} while (ns < 50 * NSEC_PER_MSEC);
+	spins_per_us = n * 1000 / ns;
+}
+
+static void
+iteration(void *ctxt, size_t idx)
+{
+	(void)idx;
+	spin((uint64_t)(uintptr_t)ctxt);
+}
+
+static void
+bench(uint64_t cost_ns)
+{
+	uint64_t spins = spins_per_us * cost_ns / 1000;
+	size_t count = (size_t)(work_ns / cost_ns);
+	uint64_t serial = UINT64_MAX, best = UINT64_MAX;
+
+	if (!spins) spins = 1;
+	for (int i = 0; i < iterations; i++) {
+		uint64_t start = now_ns();
+		for (size_t j = 0; j < count; j++) {
+			iteration((void *)(uintptr_t)spins, j);
+		}
+		uint64_t ns = now_ns() - start;
+		if (ns < serial) serial = ns;
+	}
+	for (int i = 0; i < iterations; i++) {
+		uint64_t start = now_ns();
+		dispatch_apply_f(count, DISPATCH_APPLY_AUTO, (void *)(uintptr_t)spins,
+				iteration);
+		uint64_t ns = now_ns() - start;
+		if (ns < best) best = ns;
+	}
+	printf("  %8.2f us/iteration %10zu iterations %9.2f ms %6.2fx\n",
+			(double)cost_ns / 1e3, count, (double)best / 1e6,
+			(double)serial / (double)best);
+}
+
+static void
+run_benchmarks(void)
+{
+	static const uint64_t costs[] = {
+		10, 30, 100, 300, 1000, 3000, 10000, 30000, 100000,
+	};
+
+	calibrate();
+	for (size_t i = 0; i < sizeof(costs) / sizeof(costs[0]); i++) {
+		bench(costs[i]);
+	}
+}
+
+static int
+run_child(char *self, const char *ranges, char **argv)
+{
+	char var[64];
+	size_t n = 0;
+	while (environ[n]) n++;
+
+	char **env = calloc(n + 2, sizeof(char *));
+	size_t j = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (strncmp(environ[i], "LIBDISPATCH_APPLY_RANGES=", 25)) {
+			env[j++] = environ[i];
+		}
+	}
+	snprintf(var, sizeof(var), "LIBDISPATCH_APPLY_RANGES=%s", ranges);
+	env[j++] = var;
+	env[j] = NULL;
+
+	pid_t pid;
+	int status, r = posix_spawn(&pid, self, NULL, NULL, argv, env);
+	free(env);
+	if (r) {
+		fprintf(stderr, "posix_spawn(%s): %s\n", self, strerror(r));
+		return -1;
+	}
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-c] [-w work per apply in ms] "
+			"[-i iterations]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool child = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "cw:i:")) != -1) {
+		switch (ch) {
+		case 'c':
+			child = true;
+			break;
+		case 'w':
+			work_ns = strtoull(optarg, NULL, 0) * NSEC_PER_MSEC;
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (work_ns == 0 || iterations <= 0) usage(argv[0]);
+
+	if (child) {
+		run_benchmarks();
+		return 0;
+	}
+
+	char wbuf[32], ibuf[32];
+	snprintf(wbuf, sizeof(wbuf), "%llu",
+			(unsigned long long)(work_ns / NSEC_PER_MSEC));
+	snprintf(ibuf, sizeof(ibuf), "%d", iterations);
+	char *child_argv[] = { argv[0], "-c", "-w", wbuf, "-i", ibuf, NULL };
+	char *self = argv[0];
+#if defined(__linux__)
+	self = "/proc/self/exe";
+#endif
+
+	printf("%llu ms of work per apply, best of %d\n",
+			(unsigned long long)(work_ns / NSEC_PER_MSEC), iterations);
+	printf("shared index (LIBDISPATCH_APPLY_RANGES=0)\n");
+	fflush(stdout);
+	if (run_child(self, "0", child_argv)) return 1;
+	printf("per-thread ranges (LIBDISPATCH_APPLY_RANGES=1)\n");
+	fflush(stdout);
+	if (run_child(self, "1", child_argv)) return 1;
+	return 0;
+}
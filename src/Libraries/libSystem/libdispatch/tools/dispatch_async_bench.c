@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * dispatch_async() throughput, with malloc backed and allocator backed
+ * continuations.
+ *
+ *   cc -O2 -o dispatch_async_bench dispatch_async_bench.c -ldispatch -lpthread
+ *   ./dispatch_async_bench [-n asyncs per thread] [-t producer threads]
+ *
+ * Each configuration runs in a child process with
+ * LIBDISPATCH_CONTINUATION_ALLOCATOR set to 0 (malloc) or 1 (allocator), as
+ * the choice is made once per process. Pass -c to run a single configuration
+ * in the current environment instead.
+ *
+ * Continuations are allocated by the producer threads and freed by the
+ * worker threads that run them, so most of them miss the per-thread
+ * continuation caches and go to the heap.
+ */
+
+#include <dispatch/dispatch.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static long asyncs = 2000000;
+static int producers = 4;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void
+nop(void *ctxt)
+{
+	(void)ctxt;
+}
+
+static void
+report(const char *name, long count, uint64_t ns)
+{
+	printf("  %-28s %8.2f Masync/s  %6.1f ns/async\n", name,
+			(double)count * 1e3 / (double)ns, (double)ns / (double)count);
+}
+
+// One thread, one serial queue: allocation and free mostly on two threads
+static void
+bench_serial(void)
+{
+	dispatch_queue_t q = dispatch_queue_create("bench.serial", NULL);
+	uint64_t start = now_ns();
+	for (long i = 0; i < asyncs; i++) {
+		dispatch_async_f(q, NULL, nop);
+	}
+	dispatch_sync_f(q, NULL, nop);
+	report("serial queue", asyncs, now_ns() - start);
+	dispatch_release(q);
+}
+
+struct producer_s {
+	pthread_t thread;
+	dispatch_queue_t queue;
+	dispatch_group_t group;
+};
+
+static void *
+producer(void *arg)
+{
+	struct producer_s *p = arg;
+	for (long i = 0; i < asyncs; i++) {
+		dispatch_group_async_f(p->group, p->queue, NULL, nop);
+	}
+	return NULL;
+}
+
+static void
+bench_producers(const char *name, bool shared_queue)
+{
+	struct producer_s *ps = calloc((size_t)producers, sizeof(*ps));
+	dispatch_group_t group = dispatch_group_create();
+	dispatch_queue_t global = dispatch_get_global_queue(
+			DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+	for (int i = 0; i < producers; i++) {
+		ps[i].group = group;
+		ps[i].queue = shared_queue ? global :
+				dispatch_queue_create("bench.producer", NULL);
+	}
+	uint64_t start = now_ns();
+	for (int i = 0; i < producers; i++) {
+		pthread_create(&ps[i].thread, NULL, producer, &ps[i]);
+	}
+	for (int i = 0; i < producers; i++) {
+		pthread_join(ps[i].thread, NULL);
+	}
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	report(name, asyncs * producers, now_ns() - start);
+
+	for (int i = 0; i < producers; i++) {
+		if (!shared_queue) dispatch_release(ps[i].queue);
+	}
+	dispatch_release(group);
+	free(ps);
+}
+
+static void
+run_benchmarks(void)
+{
+	bench_serial();
+	bench_producers("producers -> global queue", true);
+	bench_producers("producers -> serial queues", false);
+}
+
+static int
+run_child(char *self, const char *allocator, char **argv)
+{
+	char var[64];
+	size_t n = 0;
+	while (environ[n]) n++;
+
+	char **env = calloc(n + 2, sizeof(char *));
+	size_t j = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (strncmp(environ[i], "LIBDISPATCH_CONTINUATION_ALLOCATOR=", 35)) {
+			env[j++] = environ[i];
+		}
+	}
+	snprintf(var, sizeof(var), "LIBDISPATCH_CONTINUATION_ALLOCATOR=%s",
+			allocator);
+	env[j++] = var;
+	env[j] = NULL;
+
+	pid_t pid;
+	int status, r = posix_spawn(&pid, self, NULL, NULL, argv, env);
+	free(env);
+	if (r) {
+		fprintf(stderr, "posix_spawn(%s): %s\n", self, strerror(r));
+		return -1;
+	}
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-c] [-n asyncs per thread] "
+			"[-t producer threads]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool child = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "cn:t:")) != -1) {
+		switch (ch) {
+		case 'c':
+			child = true;
+			break;
+		case 'n':
+			asyncs = strtol(optarg, NULL, 0);
+			break;
+		case 't':
+			producers = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (asyncs <= 0 || producers <= 0) usage(argv[0]);
+
+	if (child) {
+		run_benchmarks();
+		return 0;
+	}
+
+	char nbuf[32], tbuf[32];
+	snprintf(nbuf, sizeof(nbuf), "%ld", asyncs);
+	snprintf(tbuf, sizeof(tbuf), "%d", producers);
+	char *child_argv[] = { argv[0], "-c", "-n", nbuf, "-t", tbuf, NULL };
+	char *self = argv[0];
+#if defined(__linux__)
+	self = "/proc/self/exe";
+#endif
+
+	printf("%ld asyncs per thread, %d producer threads\n", asyncs, producers);
+	printf("malloc continuations (LIBDISPATCH_CONTINUATION_ALLOCATOR=0)\n");
+	fflush(stdout);
+	if (run_child(self, "0", child_argv)) return 1;
+	printf("allocator continuations (LIBDISPATCH_CONTINUATION_ALLOCATOR=1)\n");
+	fflush(stdout);
+	if (run_child(self, "1", child_argv)) return 1;
+	return 0;
+}
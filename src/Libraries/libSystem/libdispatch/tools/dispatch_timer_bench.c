@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * Cost of keeping many armed timer sources, with the timer heap and with the
+ * timing wheel: the connection-timeout pattern, where every timer is pushed
+ * back several times and few of them ever fire.
+ *
+ *   cc -O2 -o dispatch_timer_bench dispatch_timer_bench.c -ldispatch
+ *   ./dispatch_timer_bench [-n timers] [-r re-arm rounds]
+ *
+ * Each configuration runs in a child process with LIBDISPATCH_TIMER_WHEEL
+ * set to 0 (heap) or 1 (wheel). Pass -c to run a single configuration in the
+ * current environment instead.
+ *
+ * For each phase (arm, re-arm rounds, cancel) this reports the wall time
+ * until the manager thread caught up, measured with a sentinel timer armed
+ * last, and the CPU time the whole process used meanwhile.
+ */
+
+#include <dispatch/dispatch.h>
+#include <errno.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static long ntimers = 1000000;
+static int rounds = 5;
+
+static dispatch_queue_t queue;
+static dispatch_source_t *timers;
+static volatile long fired;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t
+cpu_ns(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ((uint64_t)ru.ru_utime.tv_sec + (uint64_t)ru.ru_stime.tv_sec) *
+			1000000000ull + ((uint64_t)ru.ru_utime.tv_usec +
+			(uint64_t)ru.ru_stime.tv_usec) * 1000ull;
+}
+
+static uint64_t
+rand_ns(uint64_t min, uint64_t span)
+{
+	static uint64_t x = 88172645463325252ull;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return min + x % span;
+}
+
+static void
+timer_fired(void *ctxt)
+{
+	(void)ctxt;
+	fired++;
+}
+
+struct sentinel_s {
+	dispatch_source_t ds;
+	dispatch_semaphore_t sema;
+};
+
+static void
+sentinel_handler(void *ctxt)
+{
+	struct sentinel_s *s = ctxt;
+	dispatch_source_cancel(s->ds);
+	dispatch_semaphore_signal(s->sema);
+}
+
+// Waits until the timers configured before have been processed: sources
+// targeting the same serial queue are registered in order, so once a timer
+// armed last with a 1ms delay fires, the others have been (re)armed.
+static void
+wait_for_manager(void)
+{
+	struct sentinel_s s;
+	s.sema = dispatch_semaphore_create(0);
+	s.ds = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0,
+			DISPATCH_TIMER_STRICT, queue);
+	dispatch_set_context(s.ds, &s);
+	dispatch_source_set_event_handler_f(s.ds, sentinel_handler);
+	dispatch_source_set_timer(s.ds,
+			dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_MSEC),
+			DISPATCH_TIME_FOREVER, 0);
+	dispatch_activate(s.ds);
+	dispatch_semaphore_wait(s.sema, DISPATCH_TIME_FOREVER);
+	dispatch_release(s.ds);
+	dispatch_release(s.sema);
+}
+
+static void
+report(const char *phase, long count, uint64_t wall, uint64_t cpu)
+{
+	printf("  %-12s %8.1f ms wall %8.1f ms cpu %7.1f ns cpu/timer\n", phase,
+			(double)wall / 1e6, (double)cpu / 1e6,
+			(double)cpu / (double)count);
+}
+
+// Timeouts between 30s and 90s in the future with 10% leeway, so that none
+// fire during the run.
+static void
+set_timeout(dispatch_source_t ds)
+{
+	uint64_t delay = rand_ns(30 * NSEC_PER_SEC, 60 * NSEC_PER_SEC);
+	dispatch_source_set_timer(ds, dispatch_time(DISPATCH_TIME_NOW,
+			(int64_t)delay), DISPATCH_TIME_FOREVER, delay / 10);
+}
+
+static void
+run_benchmarks(void)
+{
+	uint64_t wall, cpu;
+
+	queue = dispatch_queue_create("bench.timers", NULL);
+	timers = calloc((size_t)ntimers, sizeof(dispatch_source_t));
+	for (long i = 0; i < ntimers; i++) {
+		timers[i] = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0,
+				queue);
+		dispatch_source_set_event_handler_f(timers[i], timer_fired);
+	}
+
+	wall = now_ns();
+	cpu = cpu_ns();
+	for (long i = 0; i < ntimers; i++) {
+		set_timeout(timers[i]);
+		dispatch_activate(timers[i]);
+	}
+	wait_for_manager();
+	report("arm", ntimers, now_ns() - wall, cpu_ns() - cpu);
+
+	for (int r = 0; r < rounds; r++) {
+		char name[32];
+		snprintf(name, sizeof(name), "re-arm #%d", r + 1);
+		wall = now_ns();
+		cpu = cpu_ns();
+		for (long i = 0; i < ntimers; i++) {
+			set_timeout(timers[i]);
+		}
+		wait_for_manager();
+		report(name, ntimers, now_ns() - wall, cpu_ns() - cpu);
+	}
+
+	wall = now_ns();
+	cpu = cpu_ns();
+	for (long i = 0; i < ntimers; i++) {
+		dispatch_source_cancel(timers[i]);
+	}
+	wait_for_manager();
+	report("cancel", ntimers, now_ns() - wall, cpu_ns() - cpu);
+
+	if (fired) {
+		printf("  warning: %ld timers fired\n", fired);
+	}
+	for (long i = 0; i < ntimers; i++) {
+		dispatch_release(timers[i]);
+	}
+	free(timers);
+	dispatch_release(queue);
+}
+
+static int
+run_child(char *self, const char *wheel, char **argv)
+{
+	char var[64];
+	size_t n = 0;
+	while (environ[n]) n++;
+
+	char **env = calloc(n + 2, sizeof(char *));
+	size_t j = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (strncmp(environ[i], "LIBDISPATCH_TIMER_WHEEL=", 24)) {
+			env[j++] = environ[i];
+		}
+	}
+	snprintf(var, sizeof(var), "LIBDISPATCH_TIMER_WHEEL=%s", wheel);
+	env[j++] = var;
+	env[j] = NULL;
+
+	pid_t pid;
+	int status, r = posix_spawn(&pid, self, NULL, NULL, argv, env);
+	free(env);
+	if (r) {
+		fprintf(stderr, "posix_spawn(%s): %s\n", self, strerror(r));
+		return -1;
+	}
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-c] [-n timers] [-r re-arm rounds]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool child = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "cn:r:")) != -1) {
+		switch (ch) {
+		case 'c':
+			child = true;
+			break;
+		case 'n':
+			ntimers = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (ntimers <= 0 || rounds < 0) usage(argv[0]);
+
+	if (child) {
+		run_benchmarks();
+		return 0;
+	}
+
+	char nbuf[32], rbuf[32];
+	snprintf(nbuf, sizeof(nbuf), "%ld", ntimers);
+	snprintf(rbuf, sizeof(rbuf), "%d", rounds);
+	char *child_argv[] = { argv[0], "-c", "-n", nbuf, "-r", rbuf, NULL };
+	char *self = argv[0];
+#if defined(__linux__)
+	self = "/proc/self/exe";
+#endif
+
+	printf("%ld timers, %d re-arm rounds\n", ntimers, rounds);
+	printf("timer heap (LIBDISPATCH_TIMER_WHEEL=0)\n");
+	fflush(stdout);
+	if (run_child(self, "0", child_argv)) return 1;
+	printf("timing wheel (LIBDISPATCH_TIMER_WHEEL=1)\n");
+	fflush(stdout);
+	if (run_child(self, "1", child_argv)) return 1;
+	return 0;
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * dispatch_data_create_with_transform() throughput for every transform,
+ * with the vector kernels and with the portable ones.
+ *
+ *   cc -O2 -o dispatch_transform_bench dispatch_transform_bench.c -ldispatch
+ *   ./dispatch_transform_bench [-s size in KiB] [-r regions] [-i iterations]
+ *
+ * Each configuration runs in a child process with LIBDISPATCH_TRANSFORM_SIMD
+ * set to 0 (portable) or 1 (vector kernels when the CPU has them), as the
+ * choice is made once per process. Pass -c to run a single configuration in
+ * the current environment instead.
+ *
+ * Inputs are split in as many regions, to also exercise the region boundary
+ * handling. The outputs of both configurations are checksummed so that they
+ * can be compared.
+ */
+
+#include <dispatch/dispatch.h>
+#include <dispatch/data_private.h>
+#include <errno.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static size_t size = 16 << 20;
+static int regions = 4;
+static int iterations = 10;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Splits the bytes in regions of roughly the same size
+static dispatch_data_t
+make_data(const uint8_t *bytes, size_t len)
+{
+	dispatch_data_t data = dispatch_data_empty;
+	size_t chunk = len / (size_t)regions + 1;
+
+	for (size_t off = 0; off < len; off += chunk) {
+		size_t n = len - off < chunk ? len - off : chunk;
+		void *copy = malloc(n);
+		memcpy(copy, bytes + off, n);
+		dispatch_data_t region = dispatch_data_create(copy, n, NULL,
+				DISPATCH_DATA_DESTRUCTOR_FREE);
+		dispatch_data_t concat = dispatch_data_create_concat(data, region);
+		dispatch_release(region);
+		dispatch_release(data);
+		data = concat;
+	}
+	return data;
+}
+
+static bool
+checksum_region(void *ctxt, dispatch_data_t region, size_t offset,
+		const void *buffer, size_t len)
+{
+	uint64_t *sum = ctxt;
+	const uint8_t *bytes = buffer;
+	(void)region; (void)offset;
+	for (size_t i = 0; i < len; i++) {
+		*sum = (*sum ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return true;
+}
+
+static uint64_t
+checksum(dispatch_data_t data)
+{
+	uint64_t sum = 0xcbf29ce484222325ull;
+	dispatch_data_apply_f(data, &sum, checksum_region);
+	return sum;
+}
+
+static dispatch_data_t
+bench(const char *name, dispatch_data_t in, dispatch_data_format_type_t from,
+		dispatch_data_format_type_t to)
+{
+	dispatch_data_t out = NULL;
+	uint64_t best = UINT64_MAX;
+	size_t len = dispatch_data_get_size(in);
+
+	for (int i = 0; i < iterations; i++) {
+		if (out) dispatch_release(out);
+		uint64_t start = now_ns();
+		out = dispatch_data_create_with_transform(in, from, to);
+		uint64_t ns = now_ns() - start;
+		if (ns < best) best = ns;
+	}
+	if (!out) {
+		printf("  %-22s failed\n", name);
+		exit(1);
+	}
+	printf("  %-22s %8.1f MB/s  %016llx\n", name, (double)len * 1e3 /
+			(double)best, (unsigned long long)checksum(out));
+	return out;
+}
+
+static void
+run_benchmarks(void)
+{
+	uint8_t *binary = malloc(size), *text = malloc(size);
+	uint64_t x = 88172645463325252ull;
+
+	for (size_t i = 0; i < size; i++) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		binary[i] = (uint8_t)x;
+		// mostly ASCII text with some two and three byte sequences
+		text[i] = (uint8_t)(' ' + x % 95);
+	}
+	for (size_t i = 0; i + 3 <= size; i += 97) {
+		memcpy(text + i, (i / 97) % 2 ? "\xc3\xa9 " : "\xe2\x82\xac", 3);
+	}
+
+	dispatch_data_t bin = make_data(binary, size);
+	dispatch_data_t txt = make_data(text, size);
+	dispatch_data_t out, flat;
+	const void *p;
+	size_t len;
+
+	out = bench("encode base64", bin, DISPATCH_DATA_FORMAT_TYPE_NONE,
+			DISPATCH_DATA_FORMAT_TYPE_BASE64);
+	flat = dispatch_data_create_map(out, &p, &len);
+	dispatch_release(out);
+	out = make_data(p, len);
+	dispatch_release(flat);
+	dispatch_release(bench("decode base64", out,
+			DISPATCH_DATA_FORMAT_TYPE_BASE64, DISPATCH_DATA_FORMAT_TYPE_NONE));
+	dispatch_release(out);
+
+	out = bench("encode base32", bin, DISPATCH_DATA_FORMAT_TYPE_NONE,
+			DISPATCH_DATA_FORMAT_TYPE_BASE32);
+	flat = dispatch_data_create_map(out, &p, &len);
+	dispatch_release(out);
+	out = make_data(p, len);
+	dispatch_release(flat);
+	dispatch_release(bench("decode base32", out,
+			DISPATCH_DATA_FORMAT_TYPE_BASE32, DISPATCH_DATA_FORMAT_TYPE_NONE));
+	dispatch_release(out);
+
+	out = bench("UTF-8 to UTF-16LE", txt, DISPATCH_DATA_FORMAT_TYPE_UTF8,
+			DISPATCH_DATA_FORMAT_TYPE_UTF16LE);
+	dispatch_release(bench("UTF-16LE to UTF-8", out,
+			DISPATCH_DATA_FORMAT_TYPE_UTF16LE, DISPATCH_DATA_FORMAT_TYPE_UTF8));
+	dispatch_release(out);
+
+	out = bench("UTF-8 to UTF-16BE", txt, DISPATCH_DATA_FORMAT_TYPE_UTF8,
+			DISPATCH_DATA_FORMAT_TYPE_UTF16BE);
+	dispatch_release(bench("UTF-16BE to UTF-8", out,
+			DISPATCH_DATA_FORMAT_TYPE_UTF16BE, DISPATCH_DATA_FORMAT_TYPE_UTF8));
+	dispatch_release(out);
+
+	dispatch_release(bin);
+	dispatch_release(txt);
+	free(binary);
+	free(text);
+}
+
+static int
+run_child(char *self, const char *simd, char **argv)
+{
+	char var[64];
+	size_t n = 0;
+	while (environ[n]) n++;
+
+	char **env = calloc(n + 2, sizeof(char *));
+	size_t j = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (strncmp(environ[i], "LIBDISPATCH_TRANSFORM_SIMD=", 27)) {
+			env[j++] = environ[i];
+		}
+	}
+	snprintf(var, sizeof(var), "LIBDISPATCH_TRANSFORM_SIMD=%s", simd);
+	env[j++] = var;
+	env[j] = NULL;
+
+	pid_t pid;
+	int status, r = posix_spawn(&pid, self, NULL, NULL, argv, env);
+	free(env);
+	if (r) {
+		fprintf(stderr, "posix_spawn(%s): %s\n", self, strerror(r));
+		return -1;
+	}
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-c] [-s size in KiB] [-r regions] "
+			"[-i iterations]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool child = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "cs:r:i:")) != -1) {
+		switch (ch) {
+		case 'c':
+			child = true;
+			break;
+		case 's':
+			size = (size_t)strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'r':
+			regions = atoi(optarg);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (size == 0 || regions <= 0 || iterations <= 0) usage(argv[0]);
+
+	if (child) {
+		run_benchmarks();
+		return 0;
+	}
+
+	char sbuf[32], rbuf[32], ibuf[32];
+	snprintf(sbuf, sizeof(sbuf), "%zu", size >> 10);
+	snprintf(rbuf, sizeof(rbuf), "%d", regions);
+	snprintf(ibuf, sizeof(ibuf), "%d", iterations);
+	char *child_argv[] = { argv[0], "-c", "-s", sbuf, "-r", rbuf, "-i", ibuf,
+			NULL };
+	char *self = argv[0];
+#if defined(__linux__)
+	self = "/proc/self/exe";
+#endif
+
+	printf("%zu KiB in %d regions, best of %d\n", size >> 10, regions,
+			iterations);
+	printf("portable kernels (LIBDISPATCH_TRANSFORM_SIMD=0)\n");
+	fflush(stdout);
+	if (run_child(self, "0", child_argv)) return 1;
+	printf("vector kernels (LIBDISPATCH_TRANSFORM_SIMD=1)\n");
+	fflush(stdout);
+	if (run_child(self, "1", child_argv)) return 1;
+	return 0;
+}
@@ -136,6 +136,24 @@ platform_cpu_count(void)
 #endif
 }
 
+#pragma mark huge pages
+
+// MALLOC_HUGE_PAGES if a large block of the given size should be mapped with
+// 2MB pages. Sizes that are not a multiple of 2MB never are. Small and medium
+// regions never are either: their free blocks are given back with madvise(),
+// which superpages ignore.
+static MALLOC_INLINE MALLOC_ALWAYS_INLINE uint32_t
+large_huge_page_flags(size_t size)
+{
+#if CONFIG_HUGE_PAGES
+	if (malloc_huge_pages_enabled && size >= malloc_huge_page_threshold &&
+			(size & MALLOC_HUGE_PAGE_MASK) == 0) {
+		return MALLOC_HUGE_PAGES;
+	}
+#endif // CONFIG_HUGE_PAGES
+	return 0;
+}
+
 #pragma mark szone locking
 
 static MALLOC_INLINE MALLOC_ALWAYS_INLINE void
@@ -333,10 +351,8 @@ recirc_list_splice_first(rack_t *rack, magazine_t *mag_ptr, region_trailer_t *no
 
 /*
  * hash_lookup_region_no_lock - Scan a hash ring looking for an entry for a
- * given region.
- *
- * FIXME: If consecutive queries of the same region are likely, a one-entry
- * cache would likely be a significant performance win here.
+ * given region. Only used when the slot itself is needed; pointer to region
+ * lookups go through the rack's radix map (see rack_region_lookup_no_lock).
  */
 static MALLOC_INLINE rgnhdl_t
 hash_lookup_region_no_lock(region_t *regions, size_t num_entries, size_t shift, region_t r)
@@ -525,12 +541,7 @@ region_set_cookie(region_cookie_t *cookiep)
 static MALLOC_INLINE region_t
 tiny_region_for_ptr_no_lock(rack_t *rack, const void *ptr)
 {
-	rgnhdl_t r = hash_lookup_region_no_lock(rack->region_generation->hashed_regions,
-			rack->region_generation->num_regions_allocated,
-			rack->region_generation->num_regions_allocated_shift,
-			TINY_REGION_FOR_PTR(ptr));
-
-	return r ? *r : r;
+	return rack_region_lookup_no_lock(rack, TINY_REGION_FOR_PTR(ptr));
 }
 
 /*
@@ -653,10 +664,7 @@ tiny_magazine_below_recirc_threshold(magazine_t *mag_ptr)
 static MALLOC_INLINE region_t
 small_region_for_ptr_no_lock(rack_t *rack, const void *ptr)
 {
-	rgnhdl_t r = hash_lookup_region_no_lock(rack->region_generation->hashed_regions,
-			rack->region_generation->num_regions_allocated, rack->region_generation->num_regions_allocated_shift,
-			SMALL_REGION_FOR_PTR(ptr));
-	return r ? *r : r;
+	return rack_region_lookup_no_lock(rack, SMALL_REGION_FOR_PTR(ptr));
 }
 
 #if CONFIG_RECIRC_DEPOT
@@ -704,10 +712,7 @@ medium_region_below_recirc_threshold(region_t region)
 static MALLOC_INLINE region_t
 medium_region_for_ptr_no_lock(rack_t *rack, const void *ptr)
 {
-	rgnhdl_t r = hash_lookup_region_no_lock(rack->region_generation->hashed_regions,
-			rack->region_generation->num_regions_allocated, rack->region_generation->num_regions_allocated_shift,
-			MEDIUM_REGION_FOR_PTR(ptr));
-	return r ? *r : r;
+	return rack_region_lookup_no_lock(rack, MEDIUM_REGION_FOR_PTR(ptr));
 }
 
 #endif // __MAGAZINE_INLINE_H
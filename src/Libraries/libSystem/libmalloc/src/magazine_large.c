@@ -224,6 +224,7 @@ large_entries_rehash_after_entry_no_lock(szone_t *szone, large_entry_t *entry)
 		szone->large_entries[index].address = (vm_address_t)0;
 		szone->large_entries[index].size = 0;
 		szone->large_entries[index].did_madvise_reusable = FALSE;
+		szone->large_entries[index].superpages = FALSE;
 		large_entry_insert_no_lock(szone, range); // this will reinsert in the
 		// proper place
 	} while (index != hash_index);
@@ -314,6 +315,7 @@ large_entry_free_no_lock(szone_t *szone, large_entry_t *entry)
 	entry->address = 0;
 	entry->size = 0;
 	entry->did_madvise_reusable = FALSE;
+	entry->superpages = FALSE;
 	large_entries_rehash_after_entry_no_lock(szone, entry);
 
 #if DEBUG_MALLOC
@@ -390,6 +392,19 @@ large_malloc(szone_t *szone, size_t num_kernel_pages, unsigned char alignment, b
 	range_to_deallocate.size = 0;
 	range_to_deallocate.address = 0;
 
+#if CONFIG_HUGE_PAGES
+	// Blocks above the huge page threshold are rounded up to whole 2MB pages
+	// so that they can be superpage backed, and so that the death-row cache
+	// recycles them as whole huge pages.
+	if (malloc_huge_pages_enabled && size >= malloc_huge_page_threshold &&
+			!(szone->debug_flags & (MALLOC_ADD_GUARD_PAGE_FLAGS | MALLOC_PURGEABLE)) &&
+			size + MALLOC_HUGE_PAGE_MASK > size) {
+		size = (size + MALLOC_HUGE_PAGE_MASK) & ~MALLOC_HUGE_PAGE_MASK;
+	}
+#endif // CONFIG_HUGE_PAGES
+	uint32_t huge_page_flags = large_huge_page_flags(size);
+	bool superpages;
+
 #if CONFIG_LARGE_CACHE
 	if (large_cache_enabled && size <= szone->large_cache_entry_limit) { // Look for a large_entry_t on the death-row cache?
 		SZONE_LOCK(szone);
@@ -401,7 +416,14 @@ large_malloc(szone_t *szone, size_t num_kernel_pages, unsigned char alignment, b
 			size_t this_size = szone->large_entry_cache[idx].size;
 			addr = (void *)szone->large_entry_cache[idx].address;
 
-			if (0 == alignment || 0 == (((uintptr_t)addr) & (((uintptr_t)1 << alignment) - 1))) {
+			// Superpage blocks are only handed out to huge page requests (and
+			// vice versa) so that cached 2MB pages are not wasted on smaller
+			// blocks.
+			boolean_t huge_match = (huge_page_flags != 0) ==
+					szone->large_entry_cache[idx].superpages;
+
+			if (huge_match && (0 == alignment ||
+					0 == (((uintptr_t)addr) & (((uintptr_t)1 << alignment) - 1)))) {
 				if (size == this_size) { // size match!
 					best = idx;
 					best_size = this_size;
@@ -428,6 +450,7 @@ large_malloc(szone_t *szone, size_t num_kernel_pages, unsigned char alignment, b
 		if (best > -1 && (best_size - size) < size) { // limit fragmentation to 50%
 			addr = (void *)szone->large_entry_cache[best].address;
 			boolean_t was_madvised_reusable = szone->large_entry_cache[best].did_madvise_reusable;
+			superpages = szone->large_entry_cache[best].superpages;
 
 			// Compact live ring to fill entry now vacated at large_entry_cache[best]
 			// while preserving time-order
@@ -472,6 +495,7 @@ large_malloc(szone_t *szone, size_t num_kernel_pages, unsigned char alignment, b
 				szone->large_entry_cache[best].address = 0;
 				szone->large_entry_cache[best].size = 0;
 				szone->large_entry_cache[best].did_madvise_reusable = FALSE;
+				szone->large_entry_cache[best].superpages = FALSE;
 			}
 
 			if ((szone->num_large_objects_in_use + 1) * 4 > szone->num_large_entries) {
@@ -487,6 +511,7 @@ large_malloc(szone_t *szone, size_t num_kernel_pages, unsigned char alignment, b
 			large_entry.address = (vm_address_t)addr;
 			large_entry.size = best_size;
 			large_entry.did_madvise_reusable = FALSE;
+			large_entry.superpages = superpages;
 			large_entry_insert_no_lock(szone, large_entry);
 
 			szone->num_large_objects_in_use++;
@@ -524,7 +549,9 @@ large_malloc(szone_t *szone, size_t num_kernel_pages, unsigned char alignment, b
 
 	// NOTE: we do not use MALLOC_FIX_GUARD_PAGE_FLAGS(szone->debug_flags) here
 	// because we want to always add either no guard page or both guard pages.
-	addr = mvm_allocate_pages(size, alignment, MALLOC_APPLY_LARGE_ASLR(szone->debug_flags), VM_MEMORY_MALLOC_LARGE);
+	addr = mvm_allocate_pages_huge(size, alignment,
+			MALLOC_APPLY_LARGE_ASLR(szone->debug_flags) | huge_page_flags,
+			VM_MEMORY_MALLOC_LARGE, &superpages);
 	if (addr == NULL) {
 		return NULL;
 	}
@@ -543,6 +570,7 @@ large_malloc(szone_t *szone, size_t num_kernel_pages, unsigned char alignment, b
 	large_entry.address = (vm_address_t)addr;
 	large_entry.size = size;
 	large_entry.did_madvise_reusable = FALSE;
+	large_entry.superpages = superpages;
 	large_entry_insert_no_lock(szone, large_entry);
 
 	szone->num_large_objects_in_use++;
@@ -567,10 +595,14 @@ free_large(szone_t *szone, void *ptr)
 	entry = large_entry_for_pointer_no_lock(szone, ptr);
 	if (entry) {
 #if CONFIG_LARGE_CACHE
+		// Superpages are wired, so there is nothing for the reuse madvise()
+		// calls to do on superpage blocks.
+		boolean_t huge = entry->superpages;
+
 		if (large_cache_enabled &&
 			entry->size <= szone->large_cache_entry_limit &&
-			-1 != madvise((void *)(entry->address), entry->size,
-						  MADV_CAN_REUSE)) { // Put the large_entry_t on the death-row cache?
+			(huge || -1 != madvise((void *)(entry->address), entry->size,
+						  MADV_CAN_REUSE))) { // Put the large_entry_t on the death-row cache?
 				int idx = szone->large_entry_cache_newest, stop_idx = szone->large_entry_cache_oldest;
 				large_entry_t this_entry = *entry; // Make a local copy, "entry" is volatile when lock is let go.
 				boolean_t reusable = TRUE;
@@ -621,7 +653,11 @@ free_large(szone_t *szone, void *ptr)
 				}
 
 				// madvise(..., MADV_REUSABLE) death-row arrivals if hoarding would exceed large_entry_cache_reserve_limit
-				if (should_madvise) {
+				if (should_madvise && huge) {
+					// A superpage block can't be given back with madvise(), so
+					// hoarding it past the reserve limit would pin the memory.
+					reusable = FALSE;
+				} else if (should_madvise) {
 					// Issue madvise to avoid paging out the dirtied free()'d pages in "entry"
 					MAGMALLOC_MADVFREEREGION((void *)szone, (void *)0, (void *)(this_entry.address), (int)this_entry.size); // DTrace USDT Probe
 
@@ -774,6 +810,13 @@ large_try_shrink_in_place(szone_t *szone, void *ptr, size_t old_size, size_t new
 			return ptr;
 		}
 
+		if (large_entry->superpages) {
+			// Deallocating part of a superpage releases the whole superpage,
+			// so superpage blocks keep their size.
+			SZONE_UNLOCK(szone);
+			return ptr;
+		}
+
 		large_entry->address = (vm_address_t)ptr;
 		large_entry->size = new_good_size;
 		szone->num_bytes_in_large_objects -= shrinkage;
@@ -806,6 +849,13 @@ large_try_realloc_in_place(szone_t *szone, void *ptr, size_t old_size, size_t ne
 	kern_return_t err;
 
 	SZONE_LOCK(szone);
+	large_entry = large_entry_for_pointer_no_lock(szone, ptr);
+	if (large_entry && large_entry->superpages) {
+		// Growing in place would tack base pages onto the end of a block
+		// that is then cached and freed as if it were all superpages.
+		SZONE_UNLOCK(szone);
+		return 0;
+	}
 	large_entry = large_entry_for_pointer_no_lock(szone, (void *)addr);
 	SZONE_UNLOCK(szone);
 
@@ -23,6 +23,111 @@
 
 #include "internal.h"
 
+#pragma mark region radix map
+
+static unsigned
+rack_radix_shift_for_type(rack_type_t type)
+{
+	switch (type) {
+	case RACK_TYPE_SMALL:
+		return SMALL_BLOCKS_ALIGN;
+	case RACK_TYPE_MEDIUM:
+		return MEDIUM_BLOCKS_ALIGN;
+	case RACK_TYPE_TINY:
+	case RACK_TYPE_NONE:
+	default:
+		return TINY_BLOCKS_ALIGN;
+	}
+}
+
+/*
+ * rack_radix_node_alloc_no_lock - Allocate a zero-filled radix map node. Like
+ * the hash ring, this must be a VM allocation to avoid recursing into the
+ * allocator that is asking for the node.
+ */
+static void *
+rack_radix_node_alloc_no_lock(size_t size)
+{
+	void *node = mvm_allocate_pages(round_page_quanta(size), 0, DISABLE_ASLR,
+			VM_MEMORY_MALLOC);
+	if (!node) {
+		MALLOC_REPORT_FATAL_ERROR(0, "unable to allocate region radix map node");
+	}
+	return node;
+}
+
+/*
+ * rack_radix_slot_no_lock - Returns the leaf slot for region r, allocating the
+ * intermediate nodes if create is set. Must be called with the region lock
+ * held. Newly allocated nodes are published with release semantics so that
+ * lock-free readers never observe a node before its (zero) contents.
+ */
+static region_t *
+rack_radix_slot_no_lock(rack_t *rack, region_t r, bool create)
+{
+	uintptr_t index = (uintptr_t)r >> rack->radix_shift;
+	uintptr_t root_index = index >> (RACK_RADIX_LEAF_BITS + RACK_RADIX_MID_BITS);
+	uintptr_t mid_index = (index >> RACK_RADIX_LEAF_BITS) & (RACK_RADIX_MID_ENTRIES - 1);
+
+	if (root_index >= RACK_RADIX_ROOT_ENTRIES) {
+		if (create) {
+			MALLOC_REPORT_FATAL_ERROR((uintptr_t)r,
+					"region outside of the region radix map range");
+		}
+		return NULL;
+	}
+
+	rack_radix_mid_t *mid = rack->radix_root[root_index];
+	if (!mid) {
+		if (!create) {
+			return NULL;
+		}
+		mid = rack_radix_node_alloc_no_lock(sizeof(rack_radix_mid_t));
+		os_atomic_store(&rack->radix_root[root_index], mid, release);
+	}
+
+	rack_radix_leaf_t *leaf = mid->leaves[mid_index];
+	if (!leaf) {
+		if (!create) {
+			return NULL;
+		}
+		leaf = rack_radix_node_alloc_no_lock(sizeof(rack_radix_leaf_t));
+		os_atomic_store(&mid->leaves[mid_index], leaf, release);
+	}
+
+	return &leaf->regions[index & (RACK_RADIX_LEAF_ENTRIES - 1)];
+}
+
+static void
+rack_radix_clear_no_lock(rack_t *rack, region_t r)
+{
+	region_t *slot = rack_radix_slot_no_lock(rack, r, false);
+	if (slot) {
+		os_atomic_store(slot, NULL, relaxed);
+	}
+}
+
+static void
+rack_radix_destroy(rack_t *rack)
+{
+	for (size_t i = 0; i < RACK_RADIX_ROOT_ENTRIES; i++) {
+		rack_radix_mid_t *mid = rack->radix_root[i];
+		if (!mid) {
+			continue;
+		}
+		for (size_t j = 0; j < RACK_RADIX_MID_ENTRIES; j++) {
+			if (mid->leaves[j]) {
+				mvm_deallocate_pages(mid->leaves[j],
+						round_page_quanta(sizeof(rack_radix_leaf_t)), 0);
+			}
+		}
+		mvm_deallocate_pages(mid, round_page_quanta(sizeof(rack_radix_mid_t)), 0);
+		rack->radix_root[i] = NULL;
+	}
+}
+
+#pragma mark rack
+
 void
 rack_init(rack_t *rack, rack_type_t type, uint32_t num_magazines, uint32_t debug_flags)
 {
@@ -37,6 +142,9 @@ rack_init(rack_t *rack, rack_type_t type, uint32_t num_magazines, uint32_t debug
 
 	memset(rack->initial_regions, '\0', sizeof(region_t) * INITIAL_NUM_REGIONS);
 
+	rack->radix_shift = rack_radix_shift_for_type(type);
+	memset(rack->radix_root, '\0', sizeof(rack->radix_root));
+
 	rack->cookie = (uintptr_t)malloc_entropy[0];
 
 	if (type == RACK_TYPE_SMALL) {
@@ -92,6 +200,7 @@ rack_destroy_regions(rack_t *rack, size_t region_size)
 		if ((rack->region_generation->hashed_regions[i] != HASHRING_OPEN_ENTRY) &&
 			(rack->region_generation->hashed_regions[i] != HASHRING_REGION_DEALLOCATED))
 		{
+			rack_radix_clear_no_lock(rack, rack->region_generation->hashed_regions[i]);
 			mvm_deallocate_pages(rack->region_generation->hashed_regions[i], region_size, MALLOC_FIX_GUARD_PAGE_FLAGS(rack->debug_flags));
 			rack->region_generation->hashed_regions[i] = HASHRING_REGION_DEALLOCATED;
 		}
@@ -107,6 +216,8 @@ rack_destroy(rack_t *rack)
 		mvm_deallocate_pages(rack->region_generation->hashed_regions, size, 0);
 	}
 
+	rack_radix_destroy(rack);
+
 	if (rack->num_magazines > 0) {
 		size_t size = round_page_quanta(sizeof(magazine_t) * (rack->num_magazines + 1));
 		mvm_deallocate_pages(&rack->magazines[-1], size, MALLOC_ADD_GUARD_PAGE_FLAGS);
@@ -124,6 +235,8 @@ rack_region_insert(rack_t *rack, region_t region)
 	// the hash ring.
 	// It is safe for all other threads to read the hash ring (hashed_regions) and
 	// the associated sizes (num_regions_allocated and num_tiny_regions).
+	// Pointer lookups do not use the hash ring at all; they go through the
+	// radix map, which never needs to be rehashed.
 
 	_malloc_lock_lock(&rack->region_lock);
 
@@ -156,6 +269,10 @@ rack_region_insert(rack_t *rack, region_t region)
 							   rack->region_generation->num_regions_allocated_shift,
 							   region);
 
+	// Publish the region for lock-free lookup only once it is on the hash
+	// ring, so that anything found through the radix map is also enumerable.
+	os_atomic_store(rack_radix_slot_no_lock(rack, region, true), region, release);
+
 	rack->num_regions++;
 	_malloc_lock_unlock(&rack->region_lock);
 }
@@ -190,6 +307,7 @@ rack_region_remove(rack_t *rack, region_t region, region_trailer_t *trailer)
 		// HASHRING_REGION_DEALLOCATED.  Using HASHRING_REGION_DEALLOCATED
 		// preserves the collision chain, using HASHRING_OPEN_ENTRY (0) would not.
 		*pSlot = HASHRING_REGION_DEALLOCATED;
+		rack_radix_clear_no_lock(rack, region);
 
 		// Atomically increment num_regions_dealloc
 #ifdef __LP64__
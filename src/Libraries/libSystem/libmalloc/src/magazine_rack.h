@@ -45,6 +45,43 @@ typedef struct region_hash_generation {
 	struct region_hash_generation *nextgen;
 } region_hash_generation_t;
 
+/*******************************************************************************
+ * Definitions for region radix map
+ *
+ * The hash ring above remains the canonical list of regions (it is what the
+ * enumerators and the remote introspection readers walk), but pointer to
+ * region lookups on the free path go through a three-level radix map indexed
+ * by region number. Interior nodes are only ever added, never removed or
+ * moved, so readers can walk the map without taking the region lock.
+ ******************************************************************************/
+
+#if MALLOC_TARGET_64BIT
+#define RACK_RADIX_ADDRESS_BITS 48
+#define RACK_RADIX_LEAF_BITS 11
+#define RACK_RADIX_MID_BITS 11
+#else // MALLOC_TARGET_64BIT
+#define RACK_RADIX_ADDRESS_BITS 32
+#define RACK_RADIX_LEAF_BITS 8
+#define RACK_RADIX_MID_BITS 2
+#endif // MALLOC_TARGET_64BIT
+
+// The root is sized for the smallest (tiny) region alignment; larger region
+// sizes simply leave the tail of the root unused.
+#define RACK_RADIX_MIN_SHIFT (SHIFT_TINY_CEIL_BLOCKS + SHIFT_TINY_QUANTUM)
+#define RACK_RADIX_ROOT_BITS (RACK_RADIX_ADDRESS_BITS - RACK_RADIX_MIN_SHIFT - \
+		RACK_RADIX_LEAF_BITS - RACK_RADIX_MID_BITS)
+#define RACK_RADIX_ROOT_ENTRIES (1ul << RACK_RADIX_ROOT_BITS)
+#define RACK_RADIX_MID_ENTRIES (1ul << RACK_RADIX_MID_BITS)
+#define RACK_RADIX_LEAF_ENTRIES (1ul << RACK_RADIX_LEAF_BITS)
+
+typedef struct rack_radix_leaf_s {
+	region_t regions[RACK_RADIX_LEAF_ENTRIES];
+} rack_radix_leaf_t;
+
+typedef struct rack_radix_mid_s {
+	rack_radix_leaf_t *leaves[RACK_RADIX_MID_ENTRIES];
+} rack_radix_mid_t;
+
 OS_ENUM(rack_type, uint32_t,
 	RACK_TYPE_NONE = 0,
 	RACK_TYPE_TINY,
@@ -67,6 +104,10 @@ typedef struct rack_s {
 	region_hash_generation_t rg[2];
 	region_t initial_regions[INITIAL_NUM_REGIONS];
 
+	// Lock-free region lookup, indexed by (address >> radix_shift)
+	unsigned radix_shift;
+	rack_radix_mid_t *radix_root[RACK_RADIX_ROOT_ENTRIES];
+
 	int num_magazines;
 	unsigned num_magazines_mask;
 	int num_magazines_mask_shift;
@@ -105,6 +146,39 @@ bool
 rack_region_maybe_dispose(rack_t *rack, region_t region, size_t region_size,
 		region_trailer_t *trailer);
 
+/*
+ * rack_region_lookup_no_lock - Returns the region of this rack that starts at
+ * the (region aligned) address r, or NULL if there is none. Safe to call
+ * without holding the region lock.
+ */
+MALLOC_NOEXPORT MALLOC_ALWAYS_INLINE
+static region_t
+rack_region_lookup_no_lock(rack_t *rack, region_t r)
+{
+	uintptr_t index = (uintptr_t)r >> rack->radix_shift;
+	uintptr_t root_index = index >> (RACK_RADIX_LEAF_BITS + RACK_RADIX_MID_BITS);
+
+	if (root_index >= RACK_RADIX_ROOT_ENTRIES) {
+		return NULL;
+	}
+
+	rack_radix_mid_t *mid = os_atomic_load(&rack->radix_root[root_index],
+			dependency);
+	if (!mid) {
+		return NULL;
+	}
+
+	rack_radix_leaf_t *leaf = os_atomic_load(
+			&mid->leaves[(index >> RACK_RADIX_LEAF_BITS) & (RACK_RADIX_MID_ENTRIES - 1)],
+			dependency);
+	if (!leaf) {
+		return NULL;
+	}
+
+	return os_atomic_load(&leaf->regions[index & (RACK_RADIX_LEAF_ENTRIES - 1)],
+			relaxed);
+}
+
 MALLOC_NOEXPORT MALLOC_ALWAYS_INLINE
 static void
 rack_region_lock(rack_t *rack)
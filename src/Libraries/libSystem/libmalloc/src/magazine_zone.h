@@ -93,6 +93,7 @@ typedef unsigned int grain_t; // N.B. wide enough to index all free slots
 #define CHECK_REGIONS (1 << 31)
 #define DISABLE_ASLR (1 << 30)
 #define DISABLE_LARGE_ASLR (1 << 29)
+#define MALLOC_HUGE_PAGES (1 << 28) // mvm_allocate_pages(): map 2MB pages
 
 #define MAX_RECORDER_BUFFER 256
 
@@ -731,6 +732,7 @@ typedef struct large_entry_s {
 	vm_address_t address;
 	vm_size_t size;
 	boolean_t did_madvise_reusable;
+	boolean_t superpages; // backed by 2MB pages, see large_malloc()
 } large_entry_t;
 
 #if !CONFIG_LARGE_CACHE && DEBUG_MALLOC
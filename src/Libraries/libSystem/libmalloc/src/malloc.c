@@ -1345,6 +1345,36 @@ set_flags_from_environment(void)
 	}
 #endif // CONFIG_LARGE_CACHE
 
+#if CONFIG_HUGE_PAGES
+	flag = getenv("MallocHugePages");
+	if (flag) {
+		const char *endp;
+		long value = malloc_common_convert_to_long(flag, &endp);
+		if (!*endp && endp != flag && (value == 0 || value == 1)) {
+			malloc_huge_pages_enabled = (value == 1);
+			if (malloc_huge_pages_enabled) {
+				malloc_report(ASL_LEVEL_INFO, "backing small and medium regions "
+						"and large blocks with 2MB pages\n");
+			}
+		} else {
+			malloc_report(ASL_LEVEL_ERR, "MallocHugePages must be 0 or 1.\n");
+		}
+	}
+
+	flag = getenv("MallocHugePagesThreshold");
+	if (flag) {
+		const char *endp;
+		long value = malloc_common_convert_to_long(flag, &endp);
+		if (!*endp && endp != flag && value > 0) {
+			malloc_huge_page_threshold = (size_t)value;
+			malloc_report(ASL_LEVEL_INFO, "Huge page threshold set to %lly\n",
+					(uint64_t)malloc_huge_page_threshold);
+		} else {
+			malloc_report(ASL_LEVEL_ERR, "MallocHugePagesThreshold must be positive - ignored.\n");
+		}
+	}
+#endif // CONFIG_HUGE_PAGES
+
 #if CONFIG_RECIRC_DEPOT
 	flag = getenv("MallocRecircRetainedRegions");
 	if (flag) {
@@ -1376,6 +1406,9 @@ set_flags_from_environment(void)
 				"  MallocCorruptionAbort is always set on 64-bit processes\n"
 				"- MallocErrorAbort to abort on any malloc error, including out of memory\n"\
 				"- MallocTracing to emit kdebug trace points on malloc entry points\n"\
+				"- MallocHugePages to back large blocks with 2MB pages;\n"\
+				"  such memory is wired and is not inherited by fork()ed children\n"\
+				"- MallocHugePagesThreshold <b> to only use 2MB pages for blocks of at least <b> bytes\n"\
 				"- MallocHelp - this help!\n");
 	}
 }
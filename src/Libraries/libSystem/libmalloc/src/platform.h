@@ -106,6 +106,13 @@
 #define CONFIG_REALLOC_CAN_USE_VMCOPY 1
 #endif
 
+// Opt-in (MallocHugePages) 2MB superpage backing for large blocks
+#if MALLOC_TARGET_64BIT && !MALLOC_TARGET_IOS
+#define CONFIG_HUGE_PAGES 1
+#else // MALLOC_TARGET_64BIT && !MALLOC_TARGET_IOS
+#define CONFIG_HUGE_PAGES 0
+#endif // MALLOC_TARGET_64BIT && !MALLOC_TARGET_IOS
+
 // memory resource exception handling
 #if MALLOC_TARGET_IOS || TARGET_OS_SIMULATOR
 #define ENABLE_MEMORY_RESOURCE_EXCEPTION_HANDLING 0
@@ -31,6 +31,12 @@ uint64_t malloc_entropy[2] = {0, 0};
 
 #define ENTROPIC_KABILLION 0x10000000 /* 256Mb */
 
+MALLOC_NOEXPORT
+bool malloc_huge_pages_enabled = false;
+
+MALLOC_NOEXPORT
+size_t malloc_huge_page_threshold = MALLOC_HUGE_PAGE_DEFAULT_THRESHOLD;
+
 // <rdar://problem/22277891> align 64bit ARM shift to 32MB PTE entries
 #if MALLOC_TARGET_IOS && MALLOC_TARGET_64BIT
 #define ENTROPIC_SHIFT 25
@@ -82,17 +88,42 @@ mvm_aslr_init(void)
 void *
 mvm_allocate_pages(size_t size, unsigned char align, uint32_t debug_flags,
 		int vm_page_label) {
+	bool superpages;
+	return mvm_allocate_pages_huge(size, align, debug_flags, vm_page_label,
+			&superpages);
+}
+
+void *
+mvm_allocate_pages_huge(size_t size, unsigned char align, uint32_t debug_flags,
+		int vm_page_label, bool *superpages) {
 	boolean_t add_prelude_guard_page = debug_flags & MALLOC_ADD_PRELUDE_GUARD_PAGE;
 	boolean_t add_postlude_guard_page = debug_flags & MALLOC_ADD_POSTLUDE_GUARD_PAGE;
 	boolean_t purgeable = debug_flags & MALLOC_PURGEABLE;
 	boolean_t use_entropic_range = !(debug_flags & DISABLE_ASLR);
+	boolean_t huge_pages = (debug_flags & MALLOC_HUGE_PAGES) && !purgeable &&
+			!add_prelude_guard_page && !add_postlude_guard_page &&
+			(size & MALLOC_HUGE_PAGE_MASK) == 0;
 	mach_vm_address_t vm_addr;
 	uintptr_t addr;
 	mach_vm_size_t allocation_size = round_page_quanta(size);
-	mach_vm_offset_t allocation_mask = ((mach_vm_offset_t)1 << align) - 1;
+	mach_vm_offset_t allocation_mask;
 	int alloc_flags = VM_FLAGS_ANYWHERE | VM_MAKE_TAG(vm_page_label);
 	kern_return_t kr;
 
+	*superpages = false;
+	if (huge_pages) {
+		// Huge page backed allocations are 2MB aligned, also when the kernel
+		// could not give us superpages and we fell back to base pages below;
+		// *superpages tells the caller which it got.
+		if (align < MALLOC_HUGE_PAGE_SHIFT) {
+			align = MALLOC_HUGE_PAGE_SHIFT;
+		}
+#ifdef VM_FLAGS_SUPERPAGE_SIZE_2MB
+		alloc_flags |= VM_FLAGS_SUPERPAGE_SIZE_2MB;
+#endif // VM_FLAGS_SUPERPAGE_SIZE_2MB
+	}
+	allocation_mask = ((mach_vm_offset_t)1 << align) - 1;
+
 	if (!allocation_size) {
 		allocation_size = vm_page_quanta_size;
 	}
@@ -124,6 +155,14 @@ retry:
 				allocation_mask, alloc_flags, MEMORY_OBJECT_NULL, 0, FALSE,
 				VM_PROT_DEFAULT, VM_PROT_ALL, VM_INHERIT_DEFAULT);
 	}
+#ifdef VM_FLAGS_SUPERPAGE_SIZE_2MB
+	if (kr && (alloc_flags & VM_FLAGS_SUPERPAGE_MASK)) {
+		// No superpages on this platform, or none left to hand out: fall
+		// back to 2MB aligned base pages rather than failing the allocation.
+		alloc_flags &= ~VM_FLAGS_SUPERPAGE_MASK;
+		goto retry;
+	}
+#endif // VM_FLAGS_SUPERPAGE_SIZE_2MB
 	if (kr) {
 		malloc_zone_error(debug_flags, false, "can't allocate region\n:"
 				"*** mach_vm_map(size=%lu, flags: %x) failed (error code=%d)\n",
@@ -131,6 +170,9 @@ retry:
 		return NULL;
 	}
 	addr = (uintptr_t)vm_addr;
+#ifdef VM_FLAGS_SUPERPAGE_SIZE_2MB
+	*superpages = (alloc_flags & VM_FLAGS_SUPERPAGE_MASK) != 0;
+#endif // VM_FLAGS_SUPERPAGE_SIZE_2MB
 
 	if (use_entropic_range) {
 		// Don't allow allocation to rise above entropic_limit (for tidiness).
@@ -35,10 +35,33 @@ MALLOC_NOEXPORT
 void
 mvm_aslr_init(void);
 
+#define MALLOC_HUGE_PAGE_SHIFT 21
+#define MALLOC_HUGE_PAGE_SIZE ((size_t)1 << MALLOC_HUGE_PAGE_SHIFT)
+#define MALLOC_HUGE_PAGE_MASK (MALLOC_HUGE_PAGE_SIZE - 1)
+#define MALLOC_HUGE_PAGE_DEFAULT_THRESHOLD MALLOC_HUGE_PAGE_SIZE
+
+// Set from the MallocHugePages and MallocHugePagesThreshold environment
+// variables.
+MALLOC_NOEXPORT
+extern bool malloc_huge_pages_enabled;
+
+MALLOC_NOEXPORT
+extern size_t malloc_huge_page_threshold;
+
 MALLOC_NOEXPORT
 void *
 mvm_allocate_pages(size_t size, unsigned char align, uint32_t debug_flags, int vm_page_label);
 
+/*
+ * mvm_allocate_pages_huge - mvm_allocate_pages(), which also reports in
+ * *superpages whether the pages ended up backed by superpages. With
+ * MALLOC_HUGE_PAGES they are 2MB aligned either way.
+ */
+MALLOC_NOEXPORT
+void *
+mvm_allocate_pages_huge(size_t size, unsigned char align, uint32_t debug_flags,
+		int vm_page_label, bool *superpages);
+
 MALLOC_NOEXPORT
 void
 mvm_deallocate_pages(void *addr, size_t size, unsigned debug_flags);
@@ -6,6 +6,7 @@
 //
 #include <darwintest.h>
 #include <stdlib.h>
+#include <string.h>
 #include <malloc/malloc.h>
 
 T_GLOBAL_META(T_META_RUN_CONCURRENTLY(true));
@@ -38,3 +39,32 @@ T_DECL(malloc_zone_batch, "malloc_zone_batch_malloc and malloc_zone_batch_free")
 	malloc_zone_batch_free(malloc_default_zone(), results, count);
 	free(results);
 }
+
+T_DECL(malloc_huge_pages_large, "MallocHugePages rounds and aligns large blocks",
+	   T_META_ENVVAR("MallocHugePages=1"),
+	   T_META_ENABLED(TARGET_OS_OSX && __LP64__))
+{
+	const size_t huge_page_size = 2 * 1024 * 1024;
+
+	// Stay above the medium allocator's limit so that these are large blocks.
+	void *ptr = malloc(19 * 1024 * 1024);
+	T_ASSERT_NOTNULL(ptr, "large allocation");
+	T_EXPECT_EQ((uintptr_t)ptr & (huge_page_size - 1), 0ul, "2MB aligned");
+	T_EXPECT_EQ(malloc_size(ptr), 10 * huge_page_size, "rounded to 2MB pages");
+	memset(ptr, 0xa, malloc_size(ptr));
+
+	// Shrinking must not give back part of a superpage: the block keeps its
+	// size, unless the kernel had no superpages and it is on base pages.
+	void *nptr = realloc(ptr, 9 * 1024 * 1024);
+	T_ASSERT_EQ_PTR(nptr, ptr, "shrink in place");
+	size_t nsize = malloc_size(nptr);
+	T_EXPECT_GE(nsize, (size_t)9 * 1024 * 1024, "still holds the new size");
+	T_EXPECT_EQ(((char *)nptr)[nsize - 1], 0xa, "tail still mapped");
+	free(nptr);
+
+	// A freed huge block is recycled for the next huge request.
+	void *again = malloc(20 * 1024 * 1024);
+	T_ASSERT_NOTNULL(again, "second large allocation");
+	T_EXPECT_EQ((uintptr_t)again & (huge_page_size - 1), 0ul, "2MB aligned");
+	free(again);
+}
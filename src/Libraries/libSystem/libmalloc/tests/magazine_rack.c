@@ -34,6 +34,33 @@ T_DECL(basic_magazine_deinit, "allocate deallocate magazines")
 	T_ASSERT_NULL(rack.magazines, "magazine deinit");
 }
 
+T_DECL(rack_region_radix_lookup, "region radix map insert, lookup and remove")
+{
+	struct rack_s rack;
+	memset(&rack, 'a', sizeof(rack));
+	rack_init(&rack, RACK_TYPE_TINY, 1, 0);
+
+	region_t region = mvm_allocate_pages(TINY_REGION_SIZE, TINY_BLOCKS_ALIGN,
+			0, VM_MEMORY_MALLOC);
+	T_ASSERT_NOTNULL(region, "region allocation");
+	T_ASSERT_NULL(rack_region_lookup_no_lock(&rack, region), "lookup before insert");
+
+	rack_region_insert(&rack, region);
+	T_ASSERT_EQ_PTR(rack_region_lookup_no_lock(&rack, region), region,
+			"lookup after insert");
+	T_ASSERT_NULL(rack_region_lookup_no_lock(&rack,
+			(region_t)((uintptr_t)region + TINY_REGION_SIZE)), "neighbour lookup");
+	T_ASSERT_NULL(rack_region_lookup_no_lock(&rack,
+			(region_t)(UINTPTR_MAX & ~(TINY_REGION_SIZE - 1))), "out of range lookup");
+
+	region_trailer_t trailer = { 0 };
+	T_ASSERT_TRUE(rack_region_remove(&rack, region, &trailer), "region remove");
+	T_ASSERT_NULL(rack_region_lookup_no_lock(&rack, region), "lookup after remove");
+
+	mvm_deallocate_pages(region, TINY_REGION_SIZE, 0);
+	rack_destroy(&rack);
+}
+
 void *
 pressure_thread(void *arg)
 {
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+#ifndef __MALLOC_TRACE_H
+#define __MALLOC_TRACE_H
+
+#include <stdint.h>
+
+//
+// Portable malloc trace format, written by malloc_trace_recorder and read by
+// malloc_trace_replay. Unlike the mtrace files used by malloc_replay, these
+// don't depend on ktrace and can be captured and replayed on any platform.
+//
+// A trace is a MALLOC_TRACE_HEADER_SIZE byte header followed by an array of
+// fixed size records. The index of a record in the file is its global
+// sequence number, so the file order is the order in which the operations
+// happened across all threads.
+//
+// Addresses are not recorded. Each live block is instead named by a small
+// address id; ids are handed out by the recorder and recycled once the block
+// is freed, so the largest id in a trace is bounded by the peak number of
+// live blocks rather than by the number of allocations.
+//
+
+#define MALLOC_TRACE_MAGIC			0x3272746dU	// "mtr2"
+#define MALLOC_TRACE_VERSION		1
+#define MALLOC_TRACE_HEADER_SIZE	4096
+
+// Values match the operation enum in malloc_replay.h.
+enum malloc_trace_op {
+	MALLOC_TRACE_OP_NONE = 0x00,		// unused slot, skipped on replay
+	MALLOC_TRACE_OP_MALLOC = 0x01,
+	MALLOC_TRACE_OP_FREE = 0x02,
+	MALLOC_TRACE_OP_REALLOC = 0x03,
+	MALLOC_TRACE_OP_MEMALIGN = 0x04,
+	MALLOC_TRACE_OP_CALLOC = 0x05,
+	MALLOC_TRACE_OP_VALLOC = 0x06,
+};
+
+struct malloc_trace_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t record_size;
+	uint64_t record_count;		// 0 if the recorder didn't exit cleanly
+	uint64_t max_id;			// largest address id used
+	uint32_t max_thread;		// largest thread index used
+	uint32_t page_size;			// page size of the recording process
+};
+
+struct malloc_trace_record {
+	uint8_t op;					// enum malloc_trace_op
+	uint8_t align_shift;		// MEMALIGN: log2(alignment)
+	uint16_t thread;			// thread index, in order of first use
+	uint32_t id;				// address id of the result, or of the freed block
+	uint32_t old_id;			// REALLOC: address id of the block passed in
+	uint32_t reserved;			// zero in the file; scratch space for readers
+	uint64_t size;				// requested size (count * size for CALLOC)
+};
+
+#if defined(__cplusplus)
+static_assert(sizeof(struct malloc_trace_header) <= MALLOC_TRACE_HEADER_SIZE,
+		"trace header does not fit");
+static_assert(sizeof(struct malloc_trace_record) == 24, "trace record size");
+#else
+_Static_assert(sizeof(struct malloc_trace_header) <= MALLOC_TRACE_HEADER_SIZE,
+		"trace header does not fit");
+_Static_assert(sizeof(struct malloc_trace_record) == 24, "trace record size");
+#endif
+
+#endif // __MALLOC_TRACE_H
@@ -0,0 +1,802 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+//
+// malloc_trace_recorder - records every malloc/free made by a process into a
+// portable malloc trace (see malloc_trace.h) for malloc_trace_replay.
+//
+// Build as a shared library and inject it into the process to trace:
+//
+//   Linux:
+//     cc -O2 -fPIC -shared -o libmalloc_trace_recorder.so malloc_trace_recorder.c -ldl -lpthread
+//     MallocTraceFile=/tmp/app.mtr2 LD_PRELOAD=./libmalloc_trace_recorder.so app
+//
+//   Darwin:
+//     cc -O2 -dynamiclib -o libmalloc_trace_recorder.dylib malloc_trace_recorder.c
+//     MallocTraceFile=/tmp/app.mtr2 DYLD_INSERT_LIBRARIES=./libmalloc_trace_recorder.dylib app
+//
+// A "%p" in MallocTraceFile is replaced by the process id, so that children
+// which inherit the environment each write a trace of their own. Without
+// one, the variable is removed from the environment once the trace is open
+// and children are not traced. A trace file that another live process is
+// recording into is never reused.
+//
+// The recorder never calls malloc itself. Records are written straight into
+// a shared mapping of the trace file, at the slot given by a global atomic
+// sequence number, so the file order is the order of the operations across
+// all threads and a crashed process still leaves a usable trace behind.
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else // __APPLE__
+#include <dlfcn.h>
+#include <malloc.h>
+#endif // __APPLE__
+
+#include "malloc_trace.h"
+
+#define RECORDS_PER_SEGMENT		((size_t)1 << 22)	// 96MB of records
+#define SEGMENT_SIZE			(RECORDS_PER_SEGMENT * sizeof(struct malloc_trace_record))
+#define MAX_SEGMENTS			((size_t)1 << 16)
+
+// The address to id map is split into stripes, each an open addressing
+// table with its own lock and its own list of ids available for reuse.
+#define ID_STRIPES				256
+#define ID_STRIPE_INITIAL		1024
+
+#define RECORDER_TLS __thread __attribute__((tls_model("initial-exec")))
+
+typedef struct {
+	uintptr_t address;
+	uint32_t id;
+} id_entry_t;
+
+typedef struct {
+	atomic_flag lock;
+	uint32_t count;
+	uint32_t capacity;			// power of 2
+	id_entry_t *entries;
+	uint32_t free_count;
+	uint32_t free_capacity;
+	uint32_t *free_ids;
+} id_stripe_t;
+
+static int s_fd = -1;
+static bool s_enabled;
+static atomic_uint_fast64_t s_next_record;
+static atomic_uint_fast32_t s_next_id;
+static atomic_uint_fast32_t s_next_thread;
+static struct malloc_trace_record *_Atomic s_segments[MAX_SEGMENTS];
+static pthread_mutex_t s_segment_lock = PTHREAD_MUTEX_INITIALIZER;
+static id_stripe_t s_stripes[ID_STRIPES];
+
+static RECORDER_TLS uint16_t t_thread;		// thread index + 1, 0 if unassigned
+static RECORDER_TLS bool t_busy;			// inside the recorder on this thread
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Real allocator entry points
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__APPLE__)
+
+// Calls to malloc() from inside an interposing image are not interposed, so
+// the real functions are simply the libSystem ones.
+#define real_malloc malloc
+#define real_free free
+#define real_calloc calloc
+#define real_realloc realloc
+#define real_posix_memalign posix_memalign
+#define real_valloc valloc
+
+static void
+recorder_resolve(void)
+{
+}
+
+#else // __APPLE__
+
+static void *(*real_malloc)(size_t);
+static void (*real_free)(void *);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_valloc)(size_t);
+
+// dlsym() can allocate before the real functions are known; those requests
+// are served from this buffer and never freed.
+static char s_bootstrap[64 * 1024] __attribute__((aligned(64)));
+static atomic_size_t s_bootstrap_used;
+
+static void *
+bootstrap_alloc(size_t size)
+{
+	size = (size + 63) & ~(size_t)63;
+	size_t offset = atomic_fetch_add(&s_bootstrap_used, size);
+	if (offset + size > sizeof(s_bootstrap)) {
+		return NULL;
+	}
+	return s_bootstrap + offset;
+}
+
+static bool
+is_bootstrap(void *ptr)
+{
+	return (char *)ptr >= s_bootstrap && (char *)ptr < s_bootstrap + sizeof(s_bootstrap);
+}
+
+static void
+recorder_resolve(void)
+{
+	static atomic_bool resolving;
+	if (real_malloc || atomic_exchange(&resolving, true)) {
+		return;
+	}
+	real_calloc = dlsym(RTLD_NEXT, "calloc");
+	real_free = dlsym(RTLD_NEXT, "free");
+	real_realloc = dlsym(RTLD_NEXT, "realloc");
+	real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+	real_valloc = dlsym(RTLD_NEXT, "valloc");
+	real_malloc = dlsym(RTLD_NEXT, "malloc");
+}
+
+#endif // __APPLE__
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Trace file
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static struct malloc_trace_record *
+recorder_segment(size_t segment)
+{
+	struct malloc_trace_record *base = atomic_load_explicit(&s_segments[segment],
+			memory_order_acquire);
+	if (base) {
+		return base;
+	}
+
+	pthread_mutex_lock(&s_segment_lock);
+	base = atomic_load_explicit(&s_segments[segment], memory_order_relaxed);
+	if (!base) {
+		off_t offset = MALLOC_TRACE_HEADER_SIZE + (off_t)segment * SEGMENT_SIZE;
+		if (ftruncate(s_fd, offset + SEGMENT_SIZE) == 0) {
+			void *map = mmap(NULL, SEGMENT_SIZE, PROT_READ | PROT_WRITE,
+					MAP_SHARED, s_fd, offset);
+			if (map != MAP_FAILED) {
+				base = map;
+				atomic_store_explicit(&s_segments[segment], base, memory_order_release);
+			}
+		}
+	}
+	pthread_mutex_unlock(&s_segment_lock);
+	return base;
+}
+
+static uint16_t
+recorder_thread(void)
+{
+	if (!t_thread) {
+		t_thread = (uint16_t)(atomic_fetch_add(&s_next_thread, 1) + 1);
+	}
+	return t_thread - 1;
+}
+
+// Reserves the next sequence number and fills in its record. For operations
+// on blocks that may be handed to another thread, this must be called with
+// the stripe lock held so that the sequence order matches the id map order.
+static void
+recorder_emit(uint8_t op, uint8_t align_shift, uint32_t id, uint32_t old_id,
+		uint64_t size)
+{
+	uint64_t seq = atomic_fetch_add_explicit(&s_next_record, 1, memory_order_relaxed);
+	size_t segment = seq / RECORDS_PER_SEGMENT;
+	if (segment >= MAX_SEGMENTS) {
+		return;
+	}
+	struct malloc_trace_record *base = recorder_segment(segment);
+	if (!base) {
+		return;
+	}
+
+	struct malloc_trace_record *record = &base[seq % RECORDS_PER_SEGMENT];
+	record->align_shift = align_shift;
+	record->thread = recorder_thread();
+	record->id = id;
+	record->old_id = old_id;
+	record->size = size;
+	atomic_store_explicit((_Atomic uint8_t *)&record->op, op, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Address ids
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void *
+recorder_map_anon(size_t size)
+{
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+	return map == MAP_FAILED ? NULL : map;
+}
+
+static id_stripe_t *
+stripe_for_address(uintptr_t address)
+{
+	uint64_t hash = (uint64_t)address * 0x9e3779b97f4a7c15ULL;
+	return &s_stripes[hash >> 56];
+}
+
+static uint32_t
+stripe_slot(id_stripe_t *stripe, uintptr_t address)
+{
+	uint64_t hash = ((uint64_t)address >> 4) * 0xff51afd7ed558ccdULL;
+	return (uint32_t)(hash >> 32) & (stripe->capacity - 1);
+}
+
+static void
+stripe_lock(id_stripe_t *stripe)
+{
+	while (atomic_flag_test_and_set_explicit(&stripe->lock, memory_order_acquire)) {
+		sched_yield();
+	}
+}
+
+static void
+stripe_unlock(id_stripe_t *stripe)
+{
+	atomic_flag_clear_explicit(&stripe->lock, memory_order_release);
+}
+
+static bool
+stripe_grow(id_stripe_t *stripe)
+{
+	uint32_t capacity = stripe->capacity ? stripe->capacity * 2 : ID_STRIPE_INITIAL;
+	id_entry_t *entries = recorder_map_anon(capacity * sizeof(id_entry_t));
+	if (!entries) {
+		return false;
+	}
+
+	id_entry_t *old_entries = stripe->entries;
+	uint32_t old_capacity = stripe->capacity;
+	stripe->entries = entries;
+	stripe->capacity = capacity;
+	for (uint32_t i = 0; i < old_capacity; i++) {
+		if (old_entries[i].address) {
+			uint32_t slot = stripe_slot(stripe, old_entries[i].address);
+			while (entries[slot].address) {
+				slot = (slot + 1) & (capacity - 1);
+			}
+			entries[slot] = old_entries[i];
+		}
+	}
+	if (old_entries) {
+		munmap(old_entries, old_capacity * sizeof(id_entry_t));
+	}
+	return true;
+}
+
+// Called with the stripe lock held. Maps address to id, or to a new id if
+// id is 0.
+static uint32_t
+stripe_insert(id_stripe_t *stripe, uintptr_t address, uint32_t id)
+{
+	if ((stripe->count + 1) * 4 > stripe->capacity * 3 && !stripe_grow(stripe)) {
+		return 0;
+	}
+
+	if (id) {
+		// caller already owns the id
+	} else if (stripe->free_count) {
+		id = stripe->free_ids[--stripe->free_count];
+	} else {
+		id = (uint32_t)atomic_fetch_add(&s_next_id, 1) + 1;
+	}
+
+	uint32_t slot = stripe_slot(stripe, address);
+	while (stripe->entries[slot].address) {
+		slot = (slot + 1) & (stripe->capacity - 1);
+	}
+	stripe->entries[slot].address = address;
+	stripe->entries[slot].id = id;
+	stripe->count++;
+	return id;
+}
+
+// Called with the stripe lock held. Removes the entry using backward shift
+// deletion so that no tombstones are needed.
+static uint32_t
+stripe_remove(id_stripe_t *stripe, uintptr_t address)
+{
+	if (!stripe->capacity) {
+		return 0;
+	}
+
+	uint32_t mask = stripe->capacity - 1;
+	uint32_t slot = stripe_slot(stripe, address);
+	while (stripe->entries[slot].address != address) {
+		if (!stripe->entries[slot].address) {
+			return 0;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	uint32_t id = stripe->entries[slot].id;
+	uint32_t hole = slot;
+	for (;;) {
+		slot = (slot + 1) & mask;
+		uintptr_t next = stripe->entries[slot].address;
+		if (!next) {
+			break;
+		}
+		uint32_t home = stripe_slot(stripe, next);
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			stripe->entries[hole] = stripe->entries[slot];
+			hole = slot;
+		}
+	}
+	stripe->entries[hole].address = 0;
+	stripe->entries[hole].id = 0;
+	stripe->count--;
+	return id;
+}
+
+// Called with the stripe lock held.
+static void
+stripe_release_id(id_stripe_t *stripe, uint32_t id)
+{
+	if (stripe->free_count == stripe->free_capacity) {
+		uint32_t capacity = stripe->free_capacity ? stripe->free_capacity * 2 : ID_STRIPE_INITIAL;
+		uint32_t *free_ids = recorder_map_anon(capacity * sizeof(uint32_t));
+		if (!free_ids) {
+			return; // leak the id; it just won't be reused
+		}
+		if (stripe->free_ids) {
+			memcpy(free_ids, stripe->free_ids, stripe->free_count * sizeof(uint32_t));
+			munmap(stripe->free_ids, stripe->free_capacity * sizeof(uint32_t));
+		}
+		stripe->free_ids = free_ids;
+		stripe->free_capacity = capacity;
+	}
+	stripe->free_ids[stripe->free_count++] = id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Recording
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static bool
+recorder_enter(void)
+{
+	if (!s_enabled || t_busy) {
+		return false;
+	}
+	t_busy = true;
+	return true;
+}
+
+static void
+recorder_leave(void)
+{
+	t_busy = false;
+}
+
+static void
+record_alloc(uint8_t op, void *ptr, uint64_t size, uint8_t align_shift)
+{
+	if (!ptr) {
+		return;
+	}
+	id_stripe_t *stripe = stripe_for_address((uintptr_t)ptr);
+	stripe_lock(stripe);
+	uint32_t id = stripe_insert(stripe, (uintptr_t)ptr, 0);
+	if (id) {
+		recorder_emit(op, align_shift, id, 0, size);
+	}
+	stripe_unlock(stripe);
+}
+
+// Removes ptr from the id map and records the free. Must happen before the
+// block is really freed, so that nobody else can be handed the address while
+// it is still in the map.
+static void
+record_free(void *ptr)
+{
+	id_stripe_t *stripe = stripe_for_address((uintptr_t)ptr);
+	stripe_lock(stripe);
+	uint32_t id = stripe_remove(stripe, (uintptr_t)ptr);
+	if (id) {
+		recorder_emit(MALLOC_TRACE_OP_FREE, 0, id, 0, 0);
+		stripe_release_id(stripe, id);
+	}
+	stripe_unlock(stripe);
+}
+
+static uint8_t
+align_shift_for(size_t alignment)
+{
+	uint8_t shift = 0;
+	while (((size_t)1 << shift) < alignment) {
+		shift++;
+	}
+	return shift;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Interposed entry points
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__APPLE__)
+#define RECORDER_ENTRY(name) static recorder_##name
+#define RECORDER_INTERPOSE(name) \
+	__attribute__((used)) static const struct { const void *replacement; const void *replacee; } \
+	_interpose_##name __attribute__((section("__DATA,__interpose"))) = \
+	{ (const void *)(uintptr_t)&recorder_##name, (const void *)(uintptr_t)&name };
+#else // __APPLE__
+#define RECORDER_ENTRY(name) name
+#define RECORDER_INTERPOSE(name)
+#endif // __APPLE__
+
+void *
+RECORDER_ENTRY(malloc)(size_t size)
+{
+	recorder_resolve();
+#if !defined(__APPLE__)
+	if (!real_malloc) {
+		return bootstrap_alloc(size);
+	}
+#endif // !__APPLE__
+	void *ptr = real_malloc(size);
+	if (recorder_enter()) {
+		record_alloc(MALLOC_TRACE_OP_MALLOC, ptr, size, 0);
+		recorder_leave();
+	}
+	return ptr;
+}
+RECORDER_INTERPOSE(malloc)
+
+void *
+RECORDER_ENTRY(calloc)(size_t count, size_t size)
+{
+	recorder_resolve();
+#if !defined(__APPLE__)
+	if (!real_calloc) {
+		// Bootstrap memory is static, and so already zeroed.
+		if (size && count > SIZE_MAX / size) {
+			return NULL;
+		}
+		return bootstrap_alloc(count * size);
+	}
+#endif // !__APPLE__
+	void *ptr = real_calloc(count, size);
+	if (recorder_enter()) {
+		record_alloc(MALLOC_TRACE_OP_CALLOC, ptr, (uint64_t)count * size, 0);
+		recorder_leave();
+	}
+	return ptr;
+}
+RECORDER_INTERPOSE(calloc)
+
+void
+RECORDER_ENTRY(free)(void *ptr)
+{
+	if (!ptr) {
+		return;
+	}
+#if !defined(__APPLE__)
+	if (is_bootstrap(ptr)) {
+		return;
+	}
+#endif // !__APPLE__
+	recorder_resolve();
+	if (recorder_enter()) {
+		record_free(ptr);
+		recorder_leave();
+	}
+	real_free(ptr);
+}
+RECORDER_INTERPOSE(free)
+
+void *
+RECORDER_ENTRY(realloc)(void *ptr, size_t size)
+{
+	recorder_resolve();
+#if !defined(__APPLE__)
+	if (!real_realloc || is_bootstrap(ptr)) {
+		// Only reachable during bootstrap, or for a block handed out then;
+		// neither is recorded.
+		void *new_ptr = real_malloc ? real_malloc(size) : bootstrap_alloc(size);
+		if (new_ptr && ptr) {
+			size_t available = s_bootstrap + sizeof(s_bootstrap) - (char *)ptr;
+			memcpy(new_ptr, ptr, size < available ? size : available);
+		}
+		return new_ptr;
+	}
+#endif // !__APPLE__
+	if (!ptr) {
+		void *new_ptr = real_realloc(NULL, size);
+		if (recorder_enter()) {
+			record_alloc(MALLOC_TRACE_OP_MALLOC, new_ptr, size, 0);
+			recorder_leave();
+		}
+		return new_ptr;
+	}
+	if (!recorder_enter()) {
+		return real_realloc(ptr, size);
+	}
+
+	// Take the old block out of the map without releasing its id, so that
+	// if the realloc fails it can go straight back in.
+	id_stripe_t *old_stripe = stripe_for_address((uintptr_t)ptr);
+	stripe_lock(old_stripe);
+	uint32_t old_id = stripe_remove(old_stripe, (uintptr_t)ptr);
+	stripe_unlock(old_stripe);
+
+	void *new_ptr = real_realloc(ptr, size);
+	if (!new_ptr && size) {
+		if (old_id) {
+			stripe_lock(old_stripe);
+			stripe_insert(old_stripe, (uintptr_t)ptr, old_id);
+			stripe_unlock(old_stripe);
+		}
+		recorder_leave();
+		return NULL;
+	}
+
+	if (!old_id) {
+		// Block from before recording started: looks like a fresh allocation.
+		record_alloc(MALLOC_TRACE_OP_MALLOC, new_ptr, size, 0);
+	} else if (new_ptr) {
+		id_stripe_t *stripe = stripe_for_address((uintptr_t)new_ptr);
+		stripe_lock(stripe);
+		uint32_t id = stripe_insert(stripe, (uintptr_t)new_ptr, 0);
+		if (id) {
+			recorder_emit(MALLOC_TRACE_OP_REALLOC, 0, id, old_id, size);
+		} else {
+			recorder_emit(MALLOC_TRACE_OP_FREE, 0, old_id, 0, 0);
+		}
+		stripe_unlock(stripe);
+	} else {
+		// realloc(ptr, 0) freed the block.
+		stripe_lock(old_stripe);
+		recorder_emit(MALLOC_TRACE_OP_FREE, 0, old_id, 0, 0);
+		stripe_unlock(old_stripe);
+	}
+
+	if (old_id) {
+		// The sequence number of the record above is already taken, so any
+		// later reuse of old_id is ordered after it.
+		stripe_lock(old_stripe);
+		stripe_release_id(old_stripe, old_id);
+		stripe_unlock(old_stripe);
+	}
+	recorder_leave();
+	return new_ptr;
+}
+RECORDER_INTERPOSE(realloc)
+
+int
+RECORDER_ENTRY(posix_memalign)(void **memptr, size_t alignment, size_t size)
+{
+	recorder_resolve();
+	int rv = real_posix_memalign(memptr, alignment, size);
+	if (rv == 0 && recorder_enter()) {
+		record_alloc(MALLOC_TRACE_OP_MEMALIGN, *memptr, size, align_shift_for(alignment));
+		recorder_leave();
+	}
+	return rv;
+}
+RECORDER_INTERPOSE(posix_memalign)
+
+void *
+RECORDER_ENTRY(valloc)(size_t size)
+{
+	recorder_resolve();
+	void *ptr = real_valloc(size);
+	if (recorder_enter()) {
+		record_alloc(MALLOC_TRACE_OP_VALLOC, ptr, size, 0);
+		recorder_leave();
+	}
+	return ptr;
+}
+RECORDER_INTERPOSE(valloc)
+
+#if !defined(__APPLE__)
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+	void *ptr = NULL;
+	return posix_memalign(&ptr, alignment < sizeof(void *) ? sizeof(void *) : alignment,
+			size) ? NULL : ptr;
+}
+
+void *
+memalign(size_t alignment, size_t size)
+{
+	return aligned_alloc(alignment, size);
+}
+#endif // !__APPLE__
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Setup and teardown
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void
+recorder_atfork_child(void)
+{
+	// The child shares the trace mapping with its parent; stop recording in
+	// the child rather than interleave two processes in one trace.
+	s_enabled = false;
+}
+
+// Copies the MallocTraceFile template into path, replacing each "%p" with
+// the process id. Returns false if the result does not fit.
+static bool
+recorder_expand_path(const char *template, char *path, size_t size,
+		bool *per_process)
+{
+	size_t len = 0;
+
+	*per_process = false;
+	for (const char *c = template; *c; c++) {
+		if (c[0] == '%' && c[1] == 'p') {
+			char digits[24];
+			size_t n = 0;
+			for (unsigned long pid = (unsigned long)getpid(); n == 0 || pid; pid /= 10) {
+				digits[n++] = (char)('0' + pid % 10);
+			}
+			if (len + n >= size) {
+				return false;
+			}
+			while (n) {
+				path[len++] = digits[--n];
+			}
+			*per_process = true;
+			c++;
+		} else {
+			if (len + 1 >= size) {
+				return false;
+			}
+			path[len++] = *c;
+		}
+	}
+	path[len] = '\0';
+	return true;
+}
+
+__attribute__((constructor))
+static void
+recorder_init(void)
+{
+	recorder_resolve();
+
+	const char *template = getenv("MallocTraceFile");
+	if (!template) {
+		return;
+	}
+
+	char path[PATH_MAX];
+	bool per_process;
+	bool ok = recorder_expand_path(template, path, sizeof(path), &per_process);
+	if (!per_process) {
+		// A shared name: only this process records into it.
+		unsetenv("MallocTraceFile");
+	}
+	if (!ok) {
+		return;
+	}
+
+	// The file is truncated only once it is locked, so that a trace which
+	// another process still has mapped is left alone. The lock goes away
+	// with the process.
+	s_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (s_fd < 0) {
+		return;
+	}
+	if (flock(s_fd, LOCK_EX | LOCK_NB) != 0) {
+		close(s_fd);
+		s_fd = -1;
+		return;
+	}
+
+	struct malloc_trace_header header = {
+		.magic = MALLOC_TRACE_MAGIC,
+		.version = MALLOC_TRACE_VERSION,
+		.record_size = sizeof(struct malloc_trace_record),
+		.page_size = (uint32_t)sysconf(_SC_PAGESIZE),
+	};
+	if (ftruncate(s_fd, 0) != 0 ||
+			pwrite(s_fd, &header, sizeof(header), 0) != sizeof(header) ||
+			ftruncate(s_fd, MALLOC_TRACE_HEADER_SIZE) != 0) {
+		close(s_fd);
+		s_fd = -1;
+		return;
+	}
+
+	pthread_atfork(NULL, NULL, recorder_atfork_child);
+	s_enabled = true;
+}
+
+__attribute__((destructor))
+static void
+recorder_fini(void)
+{
+	if (!s_enabled) {
+		return;
+	}
+	s_enabled = false;
+
+	uint64_t count = atomic_load(&s_next_record);
+	if (count > MAX_SEGMENTS * RECORDS_PER_SEGMENT) {
+		count = MAX_SEGMENTS * RECORDS_PER_SEGMENT;
+	}
+
+	struct malloc_trace_header header = {
+		.magic = MALLOC_TRACE_MAGIC,
+		.version = MALLOC_TRACE_VERSION,
+		.record_size = sizeof(struct malloc_trace_record),
+		.record_count = count,
+		.max_id = atomic_load(&s_next_id),
+		.max_thread = (uint32_t)atomic_load(&s_next_thread),
+		.page_size = (uint32_t)sysconf(_SC_PAGESIZE),
+	};
+	if (pwrite(s_fd, &header, sizeof(header), 0) == sizeof(header)) {
+		// Drop the unused tail of the last segment.
+		(void)ftruncate(s_fd, MALLOC_TRACE_HEADER_SIZE +
+				(off_t)(count * sizeof(struct malloc_trace_record)));
+	}
+}
@@ -0,0 +1,610 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+//
+// malloc_trace_replay - replays a portable malloc trace (see malloc_trace.h)
+// with one replay thread per recorded thread, and reports throughput, RSS
+// over time and fragmentation.
+//
+// The replayer only calls malloc(), so it measures whichever allocator it is
+// linked against or has injected into it:
+//
+//   c++ -std=c++11 -O2 -o malloc_trace_replay malloc_trace_replay.cpp -lpthread
+//   LD_PRELOAD=./libother_malloc.so ./malloc_trace_replay -r app.mtr2
+//   DYLD_INSERT_LIBRARIES=./libother_malloc.dylib ./malloc_trace_replay -r app.mtr2
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sysexits.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif // __APPLE__
+
+#include "malloc_trace.h"
+
+enum replay_mode {
+	// Every operation waits for the one before it in the trace, from any
+	// thread. Reproduces the recorded interleaving exactly.
+	REPLAY_MODE_EXACT,
+	// An operation only waits for the allocation that produced the block it
+	// frees or reallocs. Threads otherwise run freely.
+	REPLAY_MODE_DEPS,
+};
+
+struct replay_slot {
+	void *ptr;
+	uint64_t size;
+	std::atomic<uint32_t> ready;
+};
+
+struct replay_thread {
+	uint64_t *records;			// indices into s_records, ascending
+	uint64_t count;
+	uint64_t ops;
+	uint64_t failures;
+	uint64_t padding[4];		// keep the counters of neighbours apart
+};
+
+static struct malloc_trace_record *s_records;
+static uint64_t s_recordCount;
+static replay_slot *s_slots;
+static uint32_t s_slotCount;
+static replay_thread *s_threads;
+static uint32_t s_threadCount;
+static size_t s_pageSize;
+static replay_mode s_mode = REPLAY_MODE_EXACT;
+static bool s_touch = true;
+
+static std::atomic<uint64_t> s_nextRecord;
+static std::atomic<bool> s_go;
+static std::atomic<bool> s_done;
+
+static uint64_t s_skippedRecords;
+static uint64_t s_peakLiveBytes;
+static uint64_t s_finalLiveBytes;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// map_zeroed - Allocates bookkeeping memory outside of the allocator under
+//              test, and faults it in so that it is part of the RSS baseline.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void *
+map_zeroed(size_t size)
+{
+	if (!size) {
+		size = 1;
+	}
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(EX_OSERR);
+	}
+	memset(map, 0, size);
+	return map;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// resident_size - Current resident set size of this process, in bytes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t
+resident_size()
+{
+#if defined(__APPLE__)
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info,
+			&count) != KERN_SUCCESS) {
+		return 0;
+	}
+	return info.resident_size;
+#else // __APPLE__
+	// Read with a raw fd: stdio would allocate.
+	char buffer[128];
+	int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return 0;
+	}
+	ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (len <= 0) {
+		return 0;
+	}
+	buffer[len] = '\0';
+	unsigned long long size = 0, resident = 0;
+	if (sscanf(buffer, "%llu %llu", &size, &resident) != 2) {
+		return 0;
+	}
+	return resident * s_pageSize;
+#endif // __APPLE__
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// load_trace - Maps the trace file. The mapping is private and writable so
+//              that prepare_replay can annotate the records in place.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static bool
+load_trace(const char *path, malloc_trace_header *header)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+	struct stat sb;
+	if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < MALLOC_TRACE_HEADER_SIZE) {
+		fprintf(stderr, "%s is not a malloc trace\n", path);
+		close(fd);
+		return false;
+	}
+	void *map = mmap(NULL, (size_t)sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return false;
+	}
+
+	memcpy(header, map, sizeof(*header));
+	if (header->magic != MALLOC_TRACE_MAGIC ||
+			header->version != MALLOC_TRACE_VERSION ||
+			header->record_size != sizeof(malloc_trace_record)) {
+		fprintf(stderr, "%s is not a version %d malloc trace\n", path, MALLOC_TRACE_VERSION);
+		return false;
+	}
+
+	uint64_t available = ((uint64_t)sb.st_size - MALLOC_TRACE_HEADER_SIZE) /
+			sizeof(malloc_trace_record);
+	s_recordCount = header->record_count;
+	if (!s_recordCount || s_recordCount > available) {
+		// The recorder didn't exit cleanly; take what made it to the file.
+		// Unwritten slots read back as MALLOC_TRACE_OP_NONE.
+		s_recordCount = available;
+	}
+	s_records = (malloc_trace_record *)((char *)map + MALLOC_TRACE_HEADER_SIZE);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// prepare_replay - Rewrites the recorder's address ids, which are recycled,
+//                  into replay slots, which are not: every allocation in the
+//                  trace gets its own slot, stored in the record's reserved
+//                  field. A REALLOC's old_id is replaced by the slot of the
+//                  block it consumes. Operations on blocks that were never
+//                  seen allocated are dropped. Also splits the trace into
+//                  per-thread record lists and computes live bytes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static bool
+prepare_replay(uint32_t foldThreads)
+{
+	uint64_t maxId = 0;
+	uint32_t maxThread = 0;
+	for (uint64_t i = 0; i < s_recordCount; i++) {
+		const malloc_trace_record *r = &s_records[i];
+		if (r->op == MALLOC_TRACE_OP_NONE) {
+			continue;
+		}
+		maxId = std::max<uint64_t>(maxId, std::max(r->id, r->old_id));
+		maxThread = std::max<uint32_t>(maxThread, r->thread);
+	}
+
+	uint32_t *current = (uint32_t *)map_zeroed((maxId + 1) * sizeof(uint32_t));
+	uint64_t *liveSize = (uint64_t *)map_zeroed((maxId + 1) * sizeof(uint64_t));
+	uint64_t slots = 0, live = 0;
+
+	for (uint64_t i = 0; i < s_recordCount; i++) {
+		malloc_trace_record *r = &s_records[i];
+		uint32_t consumed = 0;
+
+		switch (r->op) {
+		case MALLOC_TRACE_OP_NONE:
+			continue;
+		case MALLOC_TRACE_OP_FREE:
+			consumed = current[r->id];
+			if (!consumed) {
+				r->op = MALLOC_TRACE_OP_NONE;
+				continue;
+			}
+			current[r->id] = 0;
+			live -= liveSize[r->id];
+			r->reserved = consumed;
+			continue;
+		case MALLOC_TRACE_OP_REALLOC:
+			consumed = current[r->old_id];
+			if (consumed) {
+				current[r->old_id] = 0;
+				live -= liveSize[r->old_id];
+			} else {
+				r->op = MALLOC_TRACE_OP_MALLOC;
+			}
+			r->old_id = consumed;
+			break;
+		case MALLOC_TRACE_OP_MALLOC:
+		case MALLOC_TRACE_OP_CALLOC:
+		case MALLOC_TRACE_OP_MEMALIGN:
+		case MALLOC_TRACE_OP_VALLOC:
+			break;
+		default:
+			fprintf(stderr, "Unknown operation %u at record %" PRIu64 "\n", r->op, i);
+			return false;
+		}
+
+		if (slots == UINT32_MAX - 1) {
+			fprintf(stderr, "Trace has too many allocations to replay\n");
+			return false;
+		}
+		r->reserved = (uint32_t)++slots;
+		current[r->id] = r->reserved;
+		liveSize[r->id] = r->size;
+		live += r->size;
+		s_peakLiveBytes = std::max(s_peakLiveBytes, live);
+	}
+	s_finalLiveBytes = live;
+	s_slotCount = (uint32_t)slots;
+	s_slots = (replay_slot *)map_zeroed((slots + 1) * sizeof(replay_slot));
+	munmap(current, (maxId + 1) * sizeof(uint32_t));
+	munmap(liveSize, (maxId + 1) * sizeof(uint64_t));
+
+	// Dropped records stay on their thread's list as no-ops, so that the
+	// exact mode sequence has no holes.
+	s_threadCount = maxThread + 1;
+	if (foldThreads && foldThreads < s_threadCount) {
+		s_threadCount = foldThreads;
+	}
+	s_threads = (replay_thread *)map_zeroed(s_threadCount * sizeof(replay_thread));
+	for (uint64_t i = 0; i < s_recordCount; i++) {
+		s_threads[s_records[i].thread % s_threadCount].count++;
+		if (s_records[i].op == MALLOC_TRACE_OP_NONE) {
+			s_skippedRecords++;
+		}
+	}
+	uint64_t *lists = (uint64_t *)map_zeroed(s_recordCount * sizeof(uint64_t));
+	for (uint32_t t = 0; t < s_threadCount; t++) {
+		s_threads[t].records = lists;
+		lists += s_threads[t].count;
+		s_threads[t].count = 0;
+	}
+	for (uint64_t i = 0; i < s_recordCount; i++) {
+		replay_thread *thread = &s_threads[s_records[i].thread % s_threadCount];
+		thread->records[thread->count++] = i;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// run_record - Performs one operation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void
+wait_for(std::atomic<uint32_t> *ready)
+{
+	for (unsigned spins = 0; !ready->load(std::memory_order_acquire); spins++) {
+		if (spins > 64) {
+			sched_yield();
+		}
+	}
+}
+
+static inline void
+dirty_memory(void *ptr, uint64_t size)
+{
+	if (!s_touch || !ptr) {
+		return;
+	}
+	for (uint64_t offset = 0; offset < size; offset += s_pageSize) {
+		((volatile char *)ptr)[offset] = 1;
+	}
+	if (size) {
+		((volatile char *)ptr)[size - 1] = 1;
+	}
+}
+
+static void
+run_record(replay_thread *thread, const malloc_trace_record *r)
+{
+	void *ptr = NULL;
+	replay_slot *consumed = NULL;
+
+	switch (r->op) {
+	case MALLOC_TRACE_OP_NONE:
+		return;
+	case MALLOC_TRACE_OP_FREE:
+		consumed = &s_slots[r->reserved];
+		if (s_mode == REPLAY_MODE_DEPS) {
+			wait_for(&consumed->ready);
+		}
+		free(consumed->ptr);
+		thread->ops++;
+		return;
+	case MALLOC_TRACE_OP_MALLOC:
+		ptr = malloc(r->size);
+		break;
+	case MALLOC_TRACE_OP_CALLOC:
+		ptr = calloc(1, r->size);
+		break;
+	case MALLOC_TRACE_OP_MEMALIGN: {
+		size_t alignment = std::max(sizeof(void *), (size_t)1 << r->align_shift);
+		if (posix_memalign(&ptr, alignment, r->size) != 0) {
+			ptr = NULL;
+		}
+		break;
+	}
+	case MALLOC_TRACE_OP_VALLOC:
+		ptr = valloc(r->size);
+		break;
+	case MALLOC_TRACE_OP_REALLOC:
+		consumed = &s_slots[r->old_id];
+		if (s_mode == REPLAY_MODE_DEPS) {
+			wait_for(&consumed->ready);
+		}
+		ptr = realloc(consumed->ptr, r->size);
+		if (!ptr && r->size) {
+			// The old block is still live; hand it on so it gets freed.
+			ptr = consumed->ptr;
+			thread->failures++;
+		}
+		break;
+	}
+
+	if (!ptr && r->size) {
+		thread->failures++;
+	}
+	dirty_memory(ptr, r->size);
+
+	replay_slot *slot = &s_slots[r->reserved];
+	slot->ptr = ptr;
+	slot->size = r->size;
+	slot->ready.store(1, std::memory_order_release);
+	thread->ops++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// replay_thread_main - Runs one thread's records, in order.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void
+replay_thread_main(replay_thread *thread)
+{
+	while (!s_go.load(std::memory_order_acquire)) {
+		sched_yield();
+	}
+
+	for (uint64_t i = 0; i < thread->count; i++) {
+		uint64_t index = thread->records[i];
+		if (s_mode == REPLAY_MODE_EXACT) {
+			for (unsigned spins = 0;
+					s_nextRecord.load(std::memory_order_acquire) != index; spins++) {
+				if (spins > 64) {
+					sched_yield();
+				}
+			}
+		}
+		run_record(thread, &s_records[index]);
+		if (s_mode == REPLAY_MODE_EXACT) {
+			s_nextRecord.store(index + 1, std::memory_order_release);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// sample_rss - Records RSS every interval until the replay is done, and
+//              returns the peak.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t
+sample_rss(FILE *csv, unsigned intervalMs, uint64_t baseline)
+{
+	uint64_t peak = 0;
+	auto start = std::chrono::steady_clock::now();
+	if (csv) {
+		fprintf(csv, "time_ms,rss_bytes\n");
+	}
+	for (;;) {
+		bool done = s_done.load(std::memory_order_acquire);
+		uint64_t rss = resident_size();
+		rss = rss > baseline ? rss - baseline : 0;
+		peak = std::max(peak, rss);
+		if (csv) {
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::steady_clock::now() - start).count();
+			fprintf(csv, "%lld,%" PRIu64 "\n", (long long)elapsed, rss);
+		}
+		if (done) {
+			return peak;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// usage - Output help.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static void
+usage()
+{
+	printf("malloc_trace_replay -r <input trace file> [-d] [-n] [-t threads] [-s csv file] [-i ms]\n");
+	printf("\t-d replay in dependency order instead of the exact recorded interleaving\n");
+	printf("\t-n don't dirty the allocated memory\n");
+	printf("\t-t <threads>\tfold the recorded threads onto this many replay threads\n");
+	printf("\t-s <csv file>\twrite RSS over time to this file\n");
+	printf("\t-i <ms>\tRSS sampling interval, default 10\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// main - Yep.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main(int argc, char **argv)
+{
+	const char *inputTrace = NULL;
+	const char *outputCsv = NULL;
+	uint32_t foldThreads = 0;
+	unsigned intervalMs = 10;
+	int c;
+
+	while ((c = getopt(argc, argv, "hr:dnt:s:i:")) != -1) {
+		switch (c) {
+		case 'r':
+			inputTrace = optarg;
+			break;
+		case 'd':
+			s_mode = REPLAY_MODE_DEPS;
+			break;
+		case 'n':
+			s_touch = false;
+			break;
+		case 't':
+			foldThreads = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			outputCsv = optarg;
+			break;
+		case 'i':
+			intervalMs = (unsigned)strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if (!inputTrace) {
+		usage();
+		return EX_USAGE;
+	}
+
+	s_pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+	malloc_trace_header header;
+	if (!load_trace(inputTrace, &header) || !prepare_replay(foldThreads)) {
+		return EX_DATAERR;
+	}
+
+	FILE *csv = NULL;
+	if (outputCsv) {
+		csv = fopen(outputCsv, "w");
+		if (!csv) {
+			fprintf(stderr, "Couldn't open %s: %s\n", outputCsv, strerror(errno));
+			return EX_CANTCREAT;
+		}
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(s_threadCount);
+	for (uint32_t t = 0; t < s_threadCount; t++) {
+		threads.emplace_back(replay_thread_main, &s_threads[t]);
+	}
+
+	uint64_t baseline = resident_size();
+	uint64_t peakRss = 0;
+	std::thread sampler([&] {
+		peakRss = sample_rss(csv, intervalMs, baseline);
+	});
+
+	auto start = std::chrono::steady_clock::now();
+	s_go.store(true, std::memory_order_release);
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	auto end = std::chrono::steady_clock::now();
+	uint64_t finalRss = resident_size();
+	finalRss = finalRss > baseline ? finalRss - baseline : 0;
+	s_done.store(true, std::memory_order_release);
+	sampler.join();
+	if (csv) {
+		fclose(csv);
+	}
+
+	uint64_t ops = 0, failures = 0;
+	for (uint32_t t = 0; t < s_threadCount; t++) {
+		ops += s_threads[t].ops;
+		failures += s_threads[t].failures;
+	}
+	double seconds = std::chrono::duration<double>(end - start).count();
+
+	printf("Trace:               %s\n", inputTrace);
+	printf("Mode:                %s\n", s_mode == REPLAY_MODE_EXACT ? "exact" : "deps");
+	printf("Threads:             %u\n", s_threadCount);
+	printf("Records:             %" PRIu64 " (%" PRIu64 " skipped)\n",
+			s_recordCount, s_skippedRecords);
+	printf("Failed allocations:  %" PRIu64 "\n", failures);
+	printf("Runtime:             %.3f s\n", seconds);
+	printf("Throughput:          %.0f ops/s\n", seconds > 0 ? ops / seconds : 0.0);
+	printf("Peak live bytes:     %" PRIu64 "\n", s_peakLiveBytes);
+	printf("Peak RSS:            %" PRIu64 "\n", peakRss);
+	printf("Final live bytes:    %" PRIu64 "\n", s_finalLiveBytes);
+	printf("Final RSS:           %" PRIu64 "\n", finalRss);
+	if (peakRss) {
+		// Overhead relative to what the program asked for, at the peak; only
+		// meaningful when the trace was replayed with -n unset.
+		printf("Peak fragmentation:  %.2f%%\n", peakRss > s_peakLiveBytes ?
+				100.0 * (peakRss - s_peakLiveBytes) / peakRss : 0.0);
+	}
+	if (finalRss) {
+		printf("Final fragmentation: %.2f%%\n", finalRss > s_finalLiveBytes ?
+				100.0 * (finalRss - s_finalLiveBytes) / finalRss : 0.0);
+	}
+	return 0;
+}
@@ -23,5 +23,19 @@
 
 #include "os/internal.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * Resolves `name` at load time to one of its variants, picked by `...` out of
+ * the CPU capabilities published in the commpage. Unlike _OS_VARIANT_RESOLVER
+ * this works for functions whose prototype is already declared in a header.
+ */
+#define OS_RESOLVER_CPU_CAPABILITIES(name, ...) \
+	void *OS_CONCAT(name, _resolver)(void) __asm__("_" OS_STRINGIFY(name)); \
+	void *OS_CONCAT(name, _resolver)(void) { \
+		__asm__(".symbol_resolver _" OS_STRINGIFY(name)); \
+		uint64_t capabilities = *(uint64_t *)_COMM_PAGE_CPU_CAPABILITIES64; \
+		__VA_ARGS__ \
+	}
+#endif
 
 #endif // __OS_RESOLVER_INTERNAL_H__
@@ -30,25 +30,147 @@
  * SUCH DAMAGE.
  */
 
-#include <platform/string.h>
+#include "string_internal.h"
 
 #if !_PLATFORM_OPTIMIZED_MEMCHR
 
+#include <stdint.h>
 #include <stdlib.h>
 
-void *
-_platform_memchr(const void *s, int c, size_t n)
+#if !_PLATFORM_STRING_V16
+static void *
+_platform_memchr_word(const void *s, int c, size_t n)
 {
-	if (n != 0) {
-		const unsigned char *p = s;
+	const unsigned char *p = s;
+	_platform_word_t rep = _platform_word_repeat(c), x;
 
-		do {
-			if (*p++ == (unsigned char)c)
-				return ((void *)(p - 1));
-		} while (--n != 0);
+	for (; n && ((uintptr_t)p & _PLATFORM_WORD_MASK); p++, n--) {
+		if (*p == (unsigned char)c)
+			return ((void *)p);
+	}
+	for (; n >= _PLATFORM_WORD_SIZE; p += _PLATFORM_WORD_SIZE,
+			n -= _PLATFORM_WORD_SIZE) {
+		x = _platform_word_zero_bytes(*(const _platform_word_t *)p ^ rep);
+		if (x)
+			return ((void *)(p + _platform_word_first_byte(x)));
+	}
+	for (; n; p++, n--) {
+		if (*p == (unsigned char)c)
+			return ((void *)p);
 	}
 	return (NULL);
 }
+#else
+static void *
+_platform_memchr_v16(const void *s, int c, size_t n)
+{
+	const unsigned char *p = s;
+	_platform_v16_t v = _platform_v16_splat(c);
+	size_t skip = (uintptr_t)p & 15;
+	uint64_t mask;
+
+	if (n == 0)
+		return (NULL);
+	p -= skip;
+	/* n counts from the aligned p now; huge n only needs to stay huge */
+	n = n > SIZE_MAX - skip ? SIZE_MAX : n + skip;
+	mask = _platform_v16_match(p, v, skip);
+	if (mask) {
+		skip += _platform_v16_first(mask);
+		return (skip < n ? (void *)(p + skip) : NULL);
+	}
+	for (;;) {
+		if (n <= 16)
+			return (NULL);
+		p += 16;
+		n -= 16;
+		if (n >= 64) {
+			_platform_v16_t m;
+			m = _platform_v16_or(
+					_platform_v16_or(
+						_platform_v16_eq(_platform_v16_load(p), v),
+						_platform_v16_eq(_platform_v16_load(p + 16), v)),
+					_platform_v16_or(
+						_platform_v16_eq(_platform_v16_load(p + 32), v),
+						_platform_v16_eq(_platform_v16_load(p + 48), v)));
+			if (!_platform_v16_mask(m)) {
+				p += 48;
+				n -= 48;
+				continue;
+			}
+		}
+		mask = _platform_v16_match(p, v, 0);
+		if (mask) {
+			skip = _platform_v16_first(mask);
+			return (skip < n ? (void *)(p + skip) : NULL);
+		}
+	}
+}
+#endif // _PLATFORM_STRING_V16
+
+#if _PLATFORM_STRING_AVX2
+_PLATFORM_AVX2
+static void *
+_platform_memchr_avx2(const void *s, int c, size_t n)
+{
+	const unsigned char *p = s;
+	__m256i v = _mm256_set1_epi8((char)c);
+	size_t skip = (uintptr_t)p & 31;
+	uint64_t mask;
+
+	if (n == 0)
+		return (NULL);
+	p -= skip;
+	/* n counts from the aligned p now; huge n only needs to stay huge */
+	n = n > SIZE_MAX - skip ? SIZE_MAX : n + skip;
+	mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_load_si256((const __m256i *)p), v)) >> skip;
+	if (mask) {
+		skip += (size_t)__builtin_ctzll(mask);
+		return (skip < n ? (void *)(p + skip) : NULL);
+	}
+	for (;;) {
+		if (n <= 32)
+			return (NULL);
+		p += 32;
+		n -= 32;
+		if (n >= 128) {
+			__m256i m;
+			m = _mm256_or_si256(
+					_mm256_or_si256(
+						_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)p), v),
+						_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)(p + 32)), v)),
+					_mm256_or_si256(
+						_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)(p + 64)), v),
+						_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)(p + 96)), v)));
+			if (!_mm256_movemask_epi8(m)) {
+				p += 96;
+				n -= 96;
+				continue;
+			}
+		}
+		mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_load_si256((const __m256i *)p), v));
+		if (mask) {
+			skip = (size_t)__builtin_ctzll(mask);
+			return (skip < n ? (void *)(p + skip) : NULL);
+		}
+	}
+}
+
+_PLATFORM_STRING_RESOLVER(_platform_memchr, _platform_memchr_avx2,
+		_platform_memchr_v16)
+#else
+void *
+_platform_memchr(const void *s, int c, size_t n)
+{
+#if _PLATFORM_STRING_V16
+	return _platform_memchr_v16(s, c, n);
+#else
+	return _platform_memchr_word(s, c, n);
+#endif
+}
+#endif // _PLATFORM_STRING_AVX2
 
 #if VARIANT_STATIC
 void *
@@ -30,22 +30,65 @@
  * SUCH DAMAGE.
  */
 
-#include <platform/string.h>
+#include "string_internal.h"
 
 #if !_PLATFORM_OPTIMIZED_MEMCMP
 
+static int
+_platform_memcmp_word(const unsigned char *p1, const unsigned char *p2,
+		size_t n)
+{
+	_platform_word_t x;
+	size_t i;
+
+	for (; n >= _PLATFORM_WORD_SIZE; p1 += _PLATFORM_WORD_SIZE,
+			p2 += _PLATFORM_WORD_SIZE, n -= _PLATFORM_WORD_SIZE) {
+		x = *(const _platform_uword_t *)p1 ^ *(const _platform_uword_t *)p2;
+		if (x) {
+			i = _platform_word_first_byte(x);
+			return (p1[i] - p2[i]);
+		}
+	}
+	for (; n != 0; p1++, p2++, n--) {
+		if (*p1 != *p2)
+			return (*p1 - *p2);
+	}
+	return (0);
+}
+
 int
 _platform_memcmp(const void *s1, const void *s2, size_t n)
 {
-	if (n != 0) {
-		const unsigned char *p1 = s1, *p2 = s2;
+	const unsigned char *p1 = s1, *p2 = s2;
+
+#if _PLATFORM_STRING_V16
+	uint64_t mask;
+	size_t i;
 
-		do {
-			if (*p1++ != *p2++)
-				return (*--p1 - *--p2);
-		} while (--n != 0);
+	if (n < 16)
+		return (_platform_memcmp_word(p1, p2, n));
+	for (;;) {
+		mask = ~_platform_v16_mask(_platform_v16_eq(_platform_v16_loadu(p1),
+				_platform_v16_loadu(p2))) & _PLATFORM_V16_FULL;
+		if (mask) {
+			i = _platform_v16_first(mask);
+			return (p1[i] - p2[i]);
+		}
+		if (n <= 16)
+			return (0);
+		p1 += 16;
+		p2 += 16;
+		n -= 16;
+		if (n < 16) {
+			/* Finish with a block overlapping the previous one */
+			p1 -= 16 - n;
+			p2 -= 16 - n;
+			n = 16;
+		}
 	}
-	return (0);
+#else
+	return (_platform_memcmp_word(p1, p2, n));
+#endif
 }
 
 #if VARIANT_STATIC
@@ -23,20 +23,41 @@
 
 #include <platform/string.h>
 
+#if !_PLATFORM_OPTIMIZED_MEMSET_PATTERN4 || \
+		!_PLATFORM_OPTIMIZED_MEMSET_PATTERN8 || \
+		!_PLATFORM_OPTIMIZED_MEMSET_PATTERN16
+
+/*
+ * Writes the pattern once, then keeps doubling what has been written with
+ * memmove, so that the copies run at memmove speed instead of a call every
+ * 4 to 16 bytes. Copies are capped to a page so that their source, the
+ * start of the buffer, stays in the cache.
+ */
+static void
+_platform_memset_pattern(void *b, const void *pattern, size_t size, size_t len)
+{
+	char *p = (char *)b;
+	size_t done, n;
+
+	done = len < size ? len : size;
+	_platform_memmove(p, pattern, done);
+	while (done < len) {
+		n = done < len - done ? done : len - done;
+		if (n > 4096)
+			n = 4096;
+		_platform_memmove(p + done, p, n);
+		done += n;
+	}
+}
+
+#endif
+
 #if !_PLATFORM_OPTIMIZED_MEMSET_PATTERN4
 
 void
 _platform_memset_pattern4(void *b, const void *pattern4, size_t len)
 {
-	char * start = (char *)b;
-	char * p = (char *)b;
-	while ((start + len) - p >= 4) {
-		_platform_memmove(p, pattern4, 4);
-		p += 4;
-	}
-	if ((start + len) - p != 0) {
-		_platform_memmove(p, pattern4, (start + len) - p);
-	}
+	_platform_memset_pattern(b, pattern4, 4, len);
 }
 
 #if VARIANT_STATIC
@@ -55,15 +76,7 @@ memset_pattern4(void *b, const void *pattern4, size_t len)
 void
 _platform_memset_pattern8(void *b, const void *pattern8, size_t len)
 {
-	char * start = (char *)b;
-	char * p = (char *)b;
-	while ((start + len) - p >= 8) {
-		_platform_memmove(p, pattern8, 8);
-		p += 8;
-	}
-	if ((start + len) - p != 0) {
-		_platform_memmove(p, pattern8, (start + len) - p);
-	}
+	_platform_memset_pattern(b, pattern8, 8, len);
 }
 
 #if VARIANT_STATIC
@@ -82,15 +95,7 @@ memset_pattern8(void *b, const void *pattern8, size_t len)
 void
 _platform_memset_pattern16(void *b, const void *pattern16, size_t len)
 {
-	char * start = (char *)b;
-	char * p = (char *)b;
-	while ((start + len) - p >= 16) {
-		_platform_memmove(p, pattern16, 16);
-		p += 16;
-	}
-	if ((start + len) - p != 0) {
-		_platform_memmove(p, pattern16, (start + len) - p);
-	}
+	_platform_memset_pattern(b, pattern16, 16, len);
 }
 
 #if VARIANT_STATIC
@@ -27,26 +27,57 @@
  * SUCH DAMAGE.
  */
 
-#include <platform/string.h>
+#include "string_internal.h"
 
 #if !_PLATFORM_OPTIMIZED_STRCHR
 
 #include <stdlib.h>
 
+#if _PLATFORM_STRING_V16
 char *
 _platform_strchr(const char *p, int ch)
 {
+	const char *s = (const char *)((uintptr_t)p & ~(uintptr_t)15);
+	_platform_v16_t c = _platform_v16_splat(ch), zero = _platform_v16_splat(0);
+	size_t skip = (size_t)(p - s);
+	uint64_t mask;
+
+	/* Stop at the first byte that is either ch or the terminator */
+	for (;; s += 16, skip = 0) {
+		_platform_v16_t v = _platform_v16_load(s);
+		mask = _platform_v16_mask(_platform_v16_or(_platform_v16_eq(v, c),
+				_platform_v16_eq(v, zero))) >> (skip * _PLATFORM_V16_BITS);
+		if (mask) {
+			s += skip + _platform_v16_first(mask);
+			return (*s == (char)ch ? (char *)s : NULL);
+		}
+	}
+}
+#else
+char *
+_platform_strchr(const char *p, int ch)
+{
+	_platform_word_t rep = _platform_word_repeat(ch), w, x;
 	char c;
 
 	c = ch;
-	for (;; ++p) {
+	for (; (uintptr_t)p & _PLATFORM_WORD_MASK; ++p) {
 		if (*p == c)
 			return ((char *)p);
 		if (*p == '\0')
 			return (NULL);
 	}
+	for (;; p += _PLATFORM_WORD_SIZE) {
+		w = *(const _platform_word_t *)p;
+		x = _platform_word_zero_bytes(w) | _platform_word_zero_bytes(w ^ rep);
+		if (x) {
+			p += _platform_word_first_byte(x);
+			return (*p == c ? (char *)p : NULL);
+		}
+	}
 	/* NOTREACHED */
 }
+#endif // _PLATFORM_STRING_V16
 
 #if VARIANT_STATIC
 char *
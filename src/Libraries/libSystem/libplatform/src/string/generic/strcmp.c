@@ -30,18 +30,71 @@
  * SUCH DAMAGE.
  */
 
-#include <platform/string.h>
+#include "string_internal.h"
 
 #if !_PLATFORM_OPTIMIZED_STRCMP
 
+#if _PLATFORM_STRING_V16
 int
 _platform_strcmp(const char *s1, const char *s2)
 {
+	const unsigned char *p1 = (const unsigned char *)s1;
+	const unsigned char *p2 = (const unsigned char *)s2;
+	_platform_v16_t v1, v2, zero = _platform_v16_splat(0);
+	uint64_t mask;
+	size_t i;
+
+	for (;; p1 += 16, p2 += 16) {
+		/* Unaligned loads must not cross into a page past the terminator */
+		if (((uintptr_t)p1 & (_PLATFORM_PAGE_SIZE - 1)) >
+				_PLATFORM_PAGE_SIZE - 16 ||
+				((uintptr_t)p2 & (_PLATFORM_PAGE_SIZE - 1)) >
+				_PLATFORM_PAGE_SIZE - 16) {
+			for (i = 0; i < 16; i++) {
+				if (p1[i] != p2[i] || p1[i] == '\0')
+					return (p1[i] - p2[i]);
+			}
+			continue;
+		}
+		v1 = _platform_v16_loadu(p1);
+		v2 = _platform_v16_loadu(p2);
+		mask = (~_platform_v16_mask(_platform_v16_eq(v1, v2)) &
+				_PLATFORM_V16_FULL) |
+				_platform_v16_mask(_platform_v16_eq(v1, zero));
+		if (mask) {
+			i = _platform_v16_first(mask);
+			return (p1[i] - p2[i]);
+		}
+	}
+}
+#else
+int
+_platform_strcmp(const char *s1, const char *s2)
+{
+	_platform_word_t w;
+
+	/* Compare words at a time when both strings can be aligned */
+	if ((((uintptr_t)s1 ^ (uintptr_t)s2) & _PLATFORM_WORD_MASK) == 0) {
+		while (((uintptr_t)s1 & _PLATFORM_WORD_MASK) && *s1 == *s2 &&
+				*s1 != '\0') {
+			s1++;
+			s2++;
+		}
+		while (((uintptr_t)s1 & _PLATFORM_WORD_MASK) == 0) {
+			w = *(const _platform_word_t *)s1;
+			if (w != *(const _platform_word_t *)s2 ||
+					_platform_word_zero_bytes(w))
+				break;
+			s1 += _PLATFORM_WORD_SIZE;
+			s2 += _PLATFORM_WORD_SIZE;
+		}
+	}
 	while (*s1 == *s2++)
 		if (*s1++ == '\0')
 			return (0);
 	return (*(const unsigned char *)s1 - *(const unsigned char *)(s2 - 1));
 }
+#endif // _PLATFORM_STRING_V16
 
 #if VARIANT_STATIC
 int
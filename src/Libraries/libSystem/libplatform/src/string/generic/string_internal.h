@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+#ifndef __PLATFORM_STRING_INTERNAL_H__
+#define __PLATFORM_STRING_INTERNAL_H__
+
+/*
+ * Building blocks shared by the generic string routines.
+ *
+ * Word-at-a-time helpers work on any target. On top of them, targets with
+ * 16 byte vectors (SSE2 on x86_64, NEON on arm64) get the _platform_v16_*
+ * primitives, with which the vector kernels are written once for both.
+ *
+ * The kernels only ever read aligned words or vectors past the end of the
+ * string they scan, which never crosses into another page: such reads are
+ * safe even though they go beyond the object.
+ */
+
+#include <platform/string.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define _PLATFORM_STRING_INLINE static inline __attribute__((__always_inline__))
+
+#define _PLATFORM_PAGE_SIZE 4096u
+
+#pragma mark - words
+
+typedef unsigned long __attribute__((__may_alias__)) _platform_word_t;
+typedef unsigned long __attribute__((__may_alias__, __aligned__(1)))
+		_platform_uword_t;
+
+#define _PLATFORM_WORD_SIZE		sizeof(_platform_word_t)
+#define _PLATFORM_WORD_MASK		(_PLATFORM_WORD_SIZE - 1)
+#define _PLATFORM_WORD_ONES		(~0ul / 0xff)
+#define _PLATFORM_WORD_HIGHS	(_PLATFORM_WORD_ONES * 0x80)
+
+// The word with every byte set to c
+_PLATFORM_STRING_INLINE _platform_word_t
+_platform_word_repeat(int c)
+{
+	return _PLATFORM_WORD_ONES * (unsigned char)c;
+}
+
+// 0x80 in every byte where x has a zero byte, and 0 in the others. Cheaper
+// tests have false positives after the first zero byte, this one is exact.
+_PLATFORM_STRING_INLINE _platform_word_t
+_platform_word_zero_bytes(_platform_word_t x)
+{
+	const _platform_word_t lows = ~_PLATFORM_WORD_HIGHS;
+	return ~(((x & lows) + lows) | x | lows);
+}
+
+// Index in memory order of the first non zero byte of x, which must not be 0
+_PLATFORM_STRING_INLINE size_t
+_platform_word_first_byte(_platform_word_t x)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return (size_t)__builtin_ctzl(x) / CHAR_BIT;
+#else
+	return (size_t)__builtin_clzl(x) / CHAR_BIT;
+#endif
+}
+
+#pragma mark - vectors
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+
+#define _PLATFORM_STRING_V16 1
+#define _PLATFORM_V16_BITS 1 // bits per byte in masks
+#define _PLATFORM_V16_FULL 0xffffull
+
+typedef __m128i _platform_v16_t;
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_load(const void *p)
+{
+	return _mm_load_si128((const __m128i *)p);
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_loadu(const void *p)
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+_PLATFORM_STRING_INLINE void
+_platform_v16_storeu(void *p, _platform_v16_t v)
+{
+	_mm_storeu_si128((__m128i *)p, v);
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_splat(int c)
+{
+	return _mm_set1_epi8((char)c);
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_eq(_platform_v16_t a, _platform_v16_t b)
+{
+	return _mm_cmpeq_epi8(a, b);
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_or(_platform_v16_t a, _platform_v16_t b)
+{
+	return _mm_or_si128(a, b);
+}
+
+// _PLATFORM_V16_BITS bits set for every byte of v that is 0xff
+_PLATFORM_STRING_INLINE uint64_t
+_platform_v16_mask(_platform_v16_t v)
+{
+	return (uint64_t)(unsigned)_mm_movemask_epi8(v);
+}
+
+#elif defined(__arm64__) || defined(__aarch64__)
+#include <arm_neon.h>
+
+#define _PLATFORM_STRING_V16 1
+#define _PLATFORM_V16_BITS 4 // bits per byte in masks
+#define _PLATFORM_V16_FULL (~0ull)
+
+typedef uint8x16_t _platform_v16_t;
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_load(const void *p)
+{
+	return vld1q_u8(__builtin_assume_aligned(p, 16));
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_loadu(const void *p)
+{
+	return vld1q_u8(p);
+}
+
+_PLATFORM_STRING_INLINE void
+_platform_v16_storeu(void *p, _platform_v16_t v)
+{
+	vst1q_u8(p, v);
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_splat(int c)
+{
+	return vdupq_n_u8((uint8_t)c);
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_eq(_platform_v16_t a, _platform_v16_t b)
+{
+	return vceqq_u8(a, b);
+}
+
+_PLATFORM_STRING_INLINE _platform_v16_t
+_platform_v16_or(_platform_v16_t a, _platform_v16_t b)
+{
+	return vorrq_u8(a, b);
+}
+
+// There is no movemask: narrowing shifts leave a nibble per byte instead
+_PLATFORM_STRING_INLINE uint64_t
+_platform_v16_mask(_platform_v16_t v)
+{
+	uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(n), 0);
+}
+
+#else
+#define _PLATFORM_STRING_V16 0
+#endif
+
+#if _PLATFORM_STRING_V16
+// Index of the first byte flagged in a non zero mask
+_PLATFORM_STRING_INLINE size_t
+_platform_v16_first(uint64_t mask)
+{
+	return (size_t)__builtin_ctzll(mask) / _PLATFORM_V16_BITS;
+}
+
+// Mask of the bytes of the aligned vector at p equal to v, ignoring the
+// `skip` first ones
+_PLATFORM_STRING_INLINE uint64_t
+_platform_v16_match(const void *p, _platform_v16_t v, size_t skip)
+{
+	_platform_v16_t eq = _platform_v16_eq(_platform_v16_load(p), v);
+	return _platform_v16_mask(eq) >> (skip * _PLATFORM_V16_BITS);
+}
+#endif // _PLATFORM_STRING_V16
+
+#pragma mark - resolvers
+
+// x86_64 also has AVX2 variants for the routines that scan long buffers,
+// chosen at load time. Static and dyld variants cannot use resolvers.
+#if defined(__x86_64__) && !VARIANT_STATIC && \
+		!defined(VARIANT_NO_RESOLVERS) && !defined(VARIANT_DYLD)
+#include "resolver.h"
+
+#define _PLATFORM_STRING_AVX2 1
+#define _PLATFORM_AVX2 __attribute__((__target__("avx2")))
+#include <immintrin.h>
+
+#define _PLATFORM_STRING_RESOLVER(name, avx2, fallback) \
+	OS_RESOLVER_CPU_CAPABILITIES(name, \
+		if (capabilities & kHasAVX2_0) { \
+			return (void *)(avx2); \
+		} \
+		return (void *)(fallback); \
+	)
+#else
+#define _PLATFORM_STRING_AVX2 0
+#endif
+
+#endif // __PLATFORM_STRING_INTERNAL_H__
@@ -29,10 +29,12 @@ __FBSDID("$FreeBSD: src/lib/libc/string/strlen.c,v 1.7 2009/01/26 07:31:28 delph
 
 #include <limits.h>
 #include <sys/types.h>
-#include <platform/string.h>
+#include "string_internal.h"
 
 #if !_PLATFORM_OPTIMIZED_STRLEN
 
+#if !_PLATFORM_STRING_V16
+
 /*
  * Portable strlen() for 32-bit and 64-bit systems.
  *
@@ -79,8 +81,8 @@ static const unsigned long mask80 = 0x8080808080808080;
 		    return (p - str + x);	\
 	} while (0)
 
-size_t
-_platform_strlen(const char *str)
+static size_t
+_platform_strlen_word(const char *str)
 {
 	const char *p;
 	const unsigned long *lp;
@@ -109,6 +111,95 @@ _platform_strlen(const char *str)
 	/* NOTREACHED */
 	return (0);
 }
+#else
+static size_t
+_platform_strlen_v16(const char *str)
+{
+	const char *p = (const char *)((uintptr_t)str & ~(uintptr_t)15);
+	_platform_v16_t zero = _platform_v16_splat(0);
+	uint64_t mask;
+
+	mask = _platform_v16_match(p, zero, (size_t)(str - p));
+	if (mask)
+		return (_platform_v16_first(mask));
+
+	/* Get to a cache line, to then test 4 vectors at once */
+	for (p += 16; (uintptr_t)p & 63; p += 16) {
+		mask = _platform_v16_match(p, zero, 0);
+		if (mask)
+			return (p - str + _platform_v16_first(mask));
+	}
+	for (;; p += 64) {
+		_platform_v16_t m;
+		m = _platform_v16_or(
+				_platform_v16_or(
+					_platform_v16_eq(_platform_v16_load(p), zero),
+					_platform_v16_eq(_platform_v16_load(p + 16), zero)),
+				_platform_v16_or(
+					_platform_v16_eq(_platform_v16_load(p + 32), zero),
+					_platform_v16_eq(_platform_v16_load(p + 48), zero)));
+		if (_platform_v16_mask(m))
+			break;
+	}
+	for (;; p += 16) {
+		mask = _platform_v16_match(p, zero, 0);
+		if (mask)
+			return (p - str + _platform_v16_first(mask));
+	}
+}
+#endif // _PLATFORM_STRING_V16
+
+#if _PLATFORM_STRING_AVX2
+_PLATFORM_AVX2
+static size_t
+_platform_strlen_avx2(const char *str)
+{
+	const char *p = (const char *)((uintptr_t)str & ~(uintptr_t)31);
+	__m256i zero = _mm256_setzero_si256();
+	uint64_t mask;
+
+#define _PLATFORM_STRLEN_AVX2_MATCH(p) (uint32_t)_mm256_movemask_epi8( \
+		_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)(p)), zero))
+
+	mask = _PLATFORM_STRLEN_AVX2_MATCH(p) >> (str - p);
+	if (mask)
+		return ((size_t)__builtin_ctzll(mask));
+	for (p += 32; (uintptr_t)p & 127; p += 32) {
+		mask = _PLATFORM_STRLEN_AVX2_MATCH(p);
+		if (mask)
+			return (p - str + (size_t)__builtin_ctzll(mask));
+	}
+	for (;; p += 128) {
+		__m256i m;
+		m = _mm256_min_epu8(
+				_mm256_min_epu8(_mm256_load_si256((const __m256i *)p),
+					_mm256_load_si256((const __m256i *)(p + 32))),
+				_mm256_min_epu8(_mm256_load_si256((const __m256i *)(p + 64)),
+					_mm256_load_si256((const __m256i *)(p + 96))));
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(m, zero)))
+			break;
+	}
+	for (;; p += 32) {
+		mask = _PLATFORM_STRLEN_AVX2_MATCH(p);
+		if (mask)
+			return (p - str + (size_t)__builtin_ctzll(mask));
+	}
+#undef _PLATFORM_STRLEN_AVX2_MATCH
+}
+
+_PLATFORM_STRING_RESOLVER(_platform_strlen, _platform_strlen_avx2,
+		_platform_strlen_v16)
+#else
+size_t
+_platform_strlen(const char *str)
+{
+#if _PLATFORM_STRING_V16
+	return _platform_strlen_v16(str);
+#else
+	return _platform_strlen_word(str);
+#endif
+}
+#endif // _PLATFORM_STRING_AVX2
 
 #if VARIANT_STATIC
 size_t
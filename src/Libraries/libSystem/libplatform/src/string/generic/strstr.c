@@ -37,30 +37,136 @@ static char sccsid[] = "@(#)strstr.c	8.1 (Berkeley) 6/4/93";
 __FBSDID("$FreeBSD: src/lib/libc/string/strstr.c,v 1.6 2009/02/03 17:58:20 danger Exp $");
 
 #include <sys/_types/_null.h>
-#include <platform/string.h>
+#include "string_internal.h"
 
 #if !_PLATFORM_OPTIMIZED_STRSTR
 
 /*
- * Find the first occurrence of find in s.
+ * Two-Way string matching (Crochemore and Perrin, 1991): linear time and
+ * constant space, where comparing the needle at every position is quadratic
+ * in the worst case.
+ *
+ * The needle is split at a critical factorization n = u.v; every window is
+ * matched against v left to right, then against u right to left. When the
+ * first byte of v does not match, the window directly jumps to the next
+ * occurrence of that byte with the vectorized strchr.
+ *
+ * The haystack length is only discovered as windows move forward, so that
+ * early matches do not cost a full strlen of the haystack.
  */
-char *
-_platform_strstr(const char *s, const char *find)
+
+#define _PLATFORM_STRSTR_LOOKAHEAD 256
+
+/*
+ * Start and period of the maximal suffix of n[0..len), for the byte order or
+ * for the reverse order. The larger of the two starts gives a critical
+ * factorization.
+ */
+static size_t
+_platform_strstr_maximal_suffix(const unsigned char *n, size_t len,
+		bool reverse, size_t *period)
 {
-	char c, sc;
-	size_t len;
+	size_t ms = SIZE_MAX, j = 0, k = 1, p = 1;
+	unsigned char a, b;
+
+	while (j + k < len) {
+		a = n[j + k];
+		b = n[ms + k];
+		if (reverse ? a > b : a < b) {
+			j += k;
+			k = 1;
+			p = j - ms;
+		} else if (a == b) {
+			if (k != p) {
+				k++;
+			} else {
+				j += p;
+				k = 1;
+			}
+		} else {
+			ms = j++;
+			k = p = 1;
+		}
+	}
+	*period = p;
+	return (ms + 1);
+}
 
-	if ((c = *find++) != '\0') {
-		len = _platform_strlen(find);
-		do {
-			do {
-				if ((sc = *s++) == '\0')
+/* Whether h has at least `need` bytes, extending the known length *hlen */
+_PLATFORM_STRING_INLINE bool
+_platform_strstr_available(const unsigned char *h, size_t *hlen, size_t need)
+{
+	if (need <= *hlen)
+		return (true);
+	*hlen += _platform_strnlen((const char *)h + *hlen,
+			need - *hlen + _PLATFORM_STRSTR_LOOKAHEAD);
+	return (need <= *hlen);
+}
+
+static char *
+_platform_strstr_twoway(const unsigned char *h, const unsigned char *n,
+		size_t nlen)
+{
+	size_t hlen = 0, suffix, period, rsuffix, rperiod, memory = 0, i, j;
+	bool periodic;
+	const char *next;
+
+	suffix = _platform_strstr_maximal_suffix(n, nlen, false, &period);
+	rsuffix = _platform_strstr_maximal_suffix(n, nlen, true, &rperiod);
+	if (rsuffix > suffix) {
+		suffix = rsuffix;
+		period = rperiod;
+	}
+
+	/*
+	 * When u is a suffix of v's period, shifting by the period can keep what
+	 * was already matched. Otherwise shift past the largest half.
+	 */
+	periodic = _platform_memcmp(n, n + period, suffix) == 0;
+	if (!periodic) {
+		period = (suffix > nlen - suffix ? suffix : nlen - suffix) + 1;
+	}
+
+	for (j = 0; _platform_strstr_available(h, &hlen, j + nlen); ) {
+		i = suffix > memory ? suffix : memory;
+		while (i < nlen && n[i] == h[i + j])
+			i++;
+		if (i < nlen) {
+			if (i == suffix && memory == 0) {
+				/* No window can match before the next n[suffix] */
+				next = _platform_strchr((const char *)h + j + suffix + 1,
+						n[suffix]);
+				if (next == NULL)
 					return (NULL);
-			} while (sc != c);
-		} while (_platform_strncmp(s, find, len) != 0);
-		s--;
+				j = (size_t)((const unsigned char *)next - h) - suffix;
+			} else {
+				j += i - suffix + 1;
+				memory = 0;
+			}
+			continue;
+		}
+		i = suffix;
+		while (i > memory && n[i - 1] == h[i - 1 + j])
+			i--;
+		if (i <= memory)
+			return ((char *)(h + j));
+		j += period;
+		if (periodic)
+			memory = nlen - period;
 	}
-	return ((char *)s);
+	return (NULL);
+}
+
+char *
+_platform_strstr(const char *s, const char *find)
+{
+	if (find[0] == '\0')
+		return ((char *)s);
+	s = _platform_strchr(s, find[0]);
+	if (s == NULL || find[1] == '\0')
+		return ((char *)s);
+	return (_platform_strstr_twoway((const unsigned char *)s,
+			(const unsigned char *)find, _platform_strlen(find)));
 }
 
 #if VARIANT_STATIC
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2026 The PureDarwin Project.
+ * All rights reserved.
+ *
+ * @LICENSE_HEADER_START@
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @LICENSE_HEADER_END@
+ */
+
+/*
+ * Throughput of the libplatform string primitives across lengths and
+ * alignments, next to byte-at-a-time loops as a baseline.
+ *
+ *   cc -O2 -o string_bench string_bench.c
+ *   ./string_bench [-t milliseconds per measurement] [function...]
+ *
+ * Functions are memchr, strlen, strchr, memcmp, strcmp, strstr and
+ * memset_pattern16, all of them by default. Results are checked against the
+ * baseline, and the program exits with 1 on any difference.
+ */
+
+#include <platform/string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_LEN (1u << 16)
+
+static const size_t lengths[] = { 1, 7, 16, 31, 64, 256, 1024, 4096, 65536 };
+static const size_t aligns[] = { 0, 1, 15 };
+
+static uint64_t budget_ns = 20 * 1000000ull;
+static char *buf1, *buf2;
+static volatile uintptr_t sink;
+static bool failed;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#pragma mark baselines
+
+__attribute__((noinline)) static void *
+byte_memchr(const void *s, int c, size_t n)
+{
+	for (const unsigned char *p = s; n; p++, n--) {
+		if (*p == (unsigned char)c) return (void *)p;
+	}
+	return NULL;
+}
+
+__attribute__((noinline)) static size_t
+byte_strlen(const char *s)
+{
+	const char *p = s;
+	while (*p) p++;
+	return (size_t)(p - s);
+}
+
+__attribute__((noinline)) static char *
+byte_strchr(const char *p, int c)
+{
+	for (;; p++) {
+		if (*p == (char)c) return (char *)p;
+		if (!*p) return NULL;
+	}
+}
+
+__attribute__((noinline)) static int
+byte_memcmp(const void *s1, const void *s2, size_t n)
+{
+	const unsigned char *p1 = s1, *p2 = s2;
+	for (; n; p1++, p2++, n--) {
+		if (*p1 != *p2) return *p1 - *p2;
+	}
+	return 0;
+}
+
+__attribute__((noinline)) static int
+byte_strcmp(const char *s1, const char *s2)
+{
+	while (*s1 == *s2++) {
+		if (!*s1++) return 0;
+	}
+	return *(const unsigned char *)s1 - *(const unsigned char *)(s2 - 1);
+}
+
+__attribute__((noinline)) static char *
+byte_strstr(const char *s, const char *find)
+{
+	size_t len = byte_strlen(find);
+	for (;; s++) {
+		if (!byte_memcmp(s, find, len)) return (char *)s;
+		if (!*s) return NULL;
+	}
+}
+
+__attribute__((noinline)) static void
+byte_memset_pattern16(void *b, const void *pattern16, size_t len)
+{
+	unsigned char *p = b;
+	for (size_t i = 0; i < len; i++) {
+		p[i] = ((const unsigned char *)pattern16)[i % 16];
+	}
+}
+
+#pragma mark cases
+
+// Runs one call of the function under test, or of its baseline
+typedef uintptr_t (*case_f)(bool baseline, char *s, size_t len);
+
+static uintptr_t
+case_memchr(bool baseline, char *s, size_t len)
+{
+	return (uintptr_t)(baseline ? byte_memchr : _platform_memchr)(s, '!', len);
+}
+
+static uintptr_t
+case_strlen(bool baseline, char *s, size_t len)
+{
+	(void)len;
+	return (baseline ? byte_strlen : _platform_strlen)(s);
+}
+
+static uintptr_t
+case_strchr(bool baseline, char *s, size_t len)
+{
+	(void)len;
+	return (uintptr_t)(baseline ? byte_strchr : _platform_strchr)(s, '!');
+}
+
+static uintptr_t
+case_memcmp(bool baseline, char *s, size_t len)
+{
+	char *t = buf2 + (s - buf1);
+	return (uintptr_t)(baseline ? byte_memcmp : _platform_memcmp)(s, t, len) > 0;
+}
+
+static uintptr_t
+case_strcmp(bool baseline, char *s, size_t len)
+{
+	char *t = buf2 + (s - buf1) + 1; // mutually misaligned
+	(void)len;
+	return (uintptr_t)(baseline ? byte_strcmp : _platform_strcmp)(s, t) > 0;
+}
+
+// A needle that partially matches often, found at the very end
+static uintptr_t
+case_strstr(bool baseline, char *s, size_t len)
+{
+	static const char needle[] = "abcabcabd";
+	(void)len;
+	return (uintptr_t)(baseline ? byte_strstr : _platform_strstr)(s, needle);
+}
+
+static uintptr_t
+case_memset_pattern16(bool baseline, char *s, size_t len)
+{
+	static const char pattern[16] = "0123456789abcdef";
+	(baseline ? byte_memset_pattern16 : _platform_memset_pattern16)(s, pattern,
+			len);
+	return (uintptr_t)byte_memcmp(s + len - 1, &pattern[(len - 1) % 16], 1);
+}
+
+static const struct {
+	const char *name;
+	case_f fn;
+	size_t min_len;
+} cases[] = {
+	{ "memchr", case_memchr, 1 },
+	{ "strlen", case_strlen, 1 },
+	{ "strchr", case_strchr, 1 },
+	{ "memcmp", case_memcmp, 1 },
+	{ "strcmp", case_strcmp, 1 },
+	{ "strstr", case_strstr, 16 },
+	{ "memset_pattern16", case_memset_pattern16, 1 },
+};
+
+#pragma mark harness
+
+// Fills the buffers so that every case scans exactly len bytes at s
+static void
+prepare(const char *name, char *s, size_t len)
+{
+	char *t = buf2 + (s - buf1);
+
+	for (size_t i = 0; i < len; i++) {
+		s[i] = "abcabcab"[i % 8];
+	}
+	s[len] = '\0';
+	if (!strcmp(name, "strstr")) {
+		memcpy(s + len - 9, "abcabcabd", 9);
+	} else {
+		s[len - 1] = '!';
+	}
+	// the second string only differs in the last byte
+	if (!strcmp(name, "strcmp")) t++;
+	memcpy(t, s, len + 1);
+	t[len - 1] = '"';
+}
+
+static double
+measure(case_f fn, bool baseline, char *s, size_t len)
+{
+	uint64_t start = now_ns(), ns, calls = 0, batch = 1;
+
+	do {
+		for (uint64_t i = 0; i < batch; i++) {
+			sink = fn(baseline, s, len);
+		}
+		calls += batch;
+		batch *= 2;
+		ns = now_ns() - start;
+	} while (ns < budget_ns);
+	return (double)ns / (double)calls;
+}
+
+static void
+bench(const char *name, case_f fn, size_t min_len)
+{
+	printf("%s\n", name);
+	for (size_t a = 0; a < sizeof(aligns) / sizeof(aligns[0]); a++) {
+		for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+			size_t len = lengths[l];
+			char *s = buf1 + 64 + aligns[a];
+			if (len < min_len) continue;
+
+			prepare(name, s, len);
+			uintptr_t want = fn(true, s, len);
+			prepare(name, s, len);
+			uintptr_t got = fn(false, s, len);
+			if (got != want) {
+				printf("  %zu bytes, alignment %zu: got %#lx expected %#lx\n",
+						len, aligns[a], (unsigned long)got,
+						(unsigned long)want);
+				failed = true;
+				continue;
+			}
+			double base = measure(fn, true, s, len);
+			double opt = measure(fn, false, s, len);
+			printf("  %6zu bytes +%-2zu %9.1f ns %8.2f GB/s  "
+					"(bytes: %9.1f ns) %6.2fx\n", len, aligns[a], opt,
+					(double)len / opt, base, base / opt);
+		}
+	}
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t milliseconds per measurement] "
+			"[function...]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int ch;
+
+	while ((ch = getopt(argc, argv, "t:")) != -1) {
+		switch (ch) {
+		case 't':
+			budget_ns = strtoull(optarg, NULL, 0) * 1000000ull;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (budget_ns == 0) usage(argv[0]);
+	argc -= optind;
+	argv += optind;
+
+	buf1 = aligned_alloc(4096, MAX_LEN + 4096);
+	buf2 = aligned_alloc(4096, MAX_LEN + 4096);
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		bool selected = argc == 0;
+		for (int j = 0; j < argc; j++) {
+			selected |= !strcmp(argv[j], cases[i].name);
+		}
+		if (selected) bench(cases[i].name, cases[i].fn, cases[i].min_len);
+	}
+	return failed;
+}